@@ -0,0 +1,155 @@
+/********************************************************
+ * cullbench.c - compares our old bounds mesh test with
+ * our frustum/AABB tests
+ *
+ * This is a standalone program and not part of our
+ * build, build and run it with something like:
+ * gcc -O2 -std=gnu99 -I../include -I../3rdparty cullbench.c -o cullbench -lGLEW -lGL -lm
+ * ./cullbench
+ *
+ * No GL context is needed, we only use the CPU side of
+ * our mesh library.
+ *
+ ********************************************************/
+
+#define STB_IMAGE_IMPLEMENTATION
+#define SYS_IMPLEMENTATION
+#define VARCHAR_IMPLEMENTATION
+#define LINKEDLIST_IMPLEMENTATION
+#define DYNARRAY_IMPLEMENTATION
+#define MATH3D_IMPLEMENTATION
+#define CULL_IMPLEMENTATION
+#define RQUEUE_IMPLEMENTATION
+#define BENCH_IMPLEMENTATION
+#define PROFILER_IMPLEMENTATION
+#define SHADER_IMPLEMENTATION
+#define TEXTURE_IMPLEMENTATION
+#define MATERIAL_IMPLEMENTATION
+#define MESH_IMPLEMENTATION
+#define JOBS_IMPLEMENTATION
+#define HEIGHTFIELD_IMPLEMENTATION
+#define TERRAIN_IMPLEMENTATION
+
+#include <GL/glew.h>
+#include <time.h>
+#include "system.h"
+#include "math3d.h"
+#include "cull.h"
+#include "shaders.h"
+#include "material.h"
+#include "mesh3d.h"
+#include "meshnode.h"
+
+#define NUM_BOXES   100000
+#define NUM_VIEWS   10
+
+// our scene, a bunch of randomly positioned boxes
+mat4          models[NUM_BOXES];
+aabb          boxes[NUM_BOXES];
+aabb4         boxes4[NUM_BOXES / 4];
+unsigned char visible[NUM_BOXES];
+
+// get a time in milliseconds
+double benchTime() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1000.0) + (t.tv_nsec / 1000000.0);
+};
+
+float benchRandom(float pMin, float pMax) {
+  return pMin + ((pMax - pMin) * rand() / RAND_MAX);
+};
+
+int main(int argc, char ** argv) {
+  meshNode *    node;
+  mat4          projection, view, viewProjection;
+  vec3          tmpvector, eye, lookat, up;
+  double        start, oldTime = 0.0, scalarTime = 0.0, simdTime = 0.0;
+  int           i, v, oldCount = 0, scalarCount = 0, simdCount = 0, mismatch = 0;
+
+  // create a bounds mesh the way our engine does
+  node = newMeshNode("box");
+  node->mesh = newMesh(24, 36);
+  meshMakeCube(node->mesh, 20.0, 20.0, 20.0, false, 3);
+  meshNodeMakeBounds(node);
+
+  // position our boxes
+  srand(1);
+  for (i = 0; i < NUM_BOXES; i++) {
+    mat4Identity(&models[i]);
+    mat4Translate(&models[i], vec3Set(&tmpvector, benchRandom(-50000.0, 50000.0), benchRandom(0.0, 500.0), benchRandom(-50000.0, 50000.0)));
+    mat4Rotate(&models[i], benchRandom(0.0, 360.0), vec3Set(&tmpvector, 0.0, 1.0, 0.0));
+
+    aabbTransform(&boxes[i], &node->boundsBox, &models[i]);
+    aabb4SetBox(&boxes4[i / 4], i % 4, &boxes[i]);
+  };
+
+  mat4Identity(&projection);
+  mat4Projection(&projection, 45.0, 1.6, 1.0, 100000.0);
+
+  for (v = 0; v < NUM_VIEWS; v++) {
+    frustum f;
+
+    // look in a different direction each time
+    vec3Set(&eye, 0.0, 1000.0, 0.0);
+    vec3Set(&lookat, sin(v * 2.0 * PI / NUM_VIEWS) * 1000.0, 900.0, cos(v * 2.0 * PI / NUM_VIEWS) * 1000.0);
+    vec3Set(&up, 0.0, 1.0, 0.0);
+    mat4Identity(&view);
+    mat4LookAt(&view, &eye, &lookat, &up);
+    mat4Copy(&viewProjection, &projection);
+    mat4Multiply(&viewProjection, &view);
+
+    // our old test, project our bounds mesh for each box
+    start = benchTime();
+    for (i = 0; i < NUM_BOXES; i++) {
+      mat4 mvp;
+
+      mat4Copy(&mvp, &viewProjection);
+      mat4Multiply(&mvp, &models[i]);
+      if (meshTestVolume(node->bounds, &mvp)) {
+        oldCount++;
+      };
+    };
+    oldTime += benchTime() - start;
+
+    // our new test, one box at a time
+    start = benchTime();
+    frustumFromMatrix(&f, &viewProjection);
+    for (i = 0; i < NUM_BOXES; i++) {
+      visible[i] = frustumTestAABB(&f, &boxes[i], NULL) != CULL_OUTSIDE;
+      scalarCount += visible[i];
+    };
+    scalarTime += benchTime() - start;
+
+    // and 4 boxes at a time
+    start = benchTime();
+    frustumFromMatrix(&f, &viewProjection);
+    for (i = 0; i < NUM_BOXES / 4; i++) {
+      unsigned int mask = frustumTestAABB4(&f, &boxes4[i], CULL_ALLPLANES);
+
+      simdCount += ((mask & 1) != 0) + ((mask & 2) != 0) + ((mask & 4) != 0) + ((mask & 8) != 0);
+      if ((mask & 1) != visible[i * 4]) mismatch++;
+      if (((mask & 2) != 0) != visible[(i * 4) + 1]) mismatch++;
+      if (((mask & 4) != 0) != visible[(i * 4) + 2]) mismatch++;
+      if (((mask & 8) != 0) != visible[(i * 4) + 3]) mismatch++;
+    };
+    simdTime += benchTime() - start;
+  };
+
+  printf("%d boxes, %d views\n", NUM_BOXES, NUM_VIEWS);
+  printf("meshTestVolume:   %8.2f ms per view, %d visible\n", oldTime / NUM_VIEWS, oldCount / NUM_VIEWS);
+  printf("frustumTestAABB:  %8.2f ms per view, %d visible\n", scalarTime / NUM_VIEWS, scalarCount / NUM_VIEWS);
+#ifdef CULL_SSE
+  printf("frustumTestAABB4: %8.2f ms per view, %d visible (SSE)\n", simdTime / NUM_VIEWS, simdCount / NUM_VIEWS);
+#else
+  printf("frustumTestAABB4: %8.2f ms per view, %d visible (scalar)\n", simdTime / NUM_VIEWS, simdCount / NUM_VIEWS);
+#endif
+  if (mismatch > 0) {
+    printf("%d boxes differ between our single and batched test!\n", mismatch);
+  };
+
+  meshNodeRelease(node);
+
+  return 0;
+};
@@ -0,0 +1,119 @@
+/********************************************************
+ * dynarraybench.c - measures how fast we can add entries
+ * to our dynamic array
+ *
+ * This is a standalone program and not part of our
+ * build, build and run it with something like:
+ * gcc -O2 -std=gnu99 -I../include dynarraybench.c -o dynarraybench
+ * ./dynarraybench
+ *
+ * We compare growing our array by a fixed number of
+ * entries as we used to, with our geometric growth, with
+ * reserving our space up front and with adding our
+ * entries in bulk. Our entries are the size of a vertex.
+ *
+ * Note that on Linux glibc grows large blocks in place
+ * through mremap which hides much of the cost of our fixed
+ * growth, on Windows and Mac OS X each realloc of a large
+ * array usually copies it. Our largest arrays are
+ * dominated by page faults on first touch.
+ *
+ ********************************************************/
+
+#define DYNARRAY_IMPLEMENTATION
+
+#include <time.h>
+#include "dynamicarray.h"
+
+// our entry, the size of our vertex structure
+typedef struct benchEntry {
+  float         values[8];
+} benchEntry;
+
+// we add our entries in bulk in blocks of this size
+#define BULK_SIZE     256
+
+// get a time in milliseconds
+double benchTime() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1000.0) + (t.tv_nsec / 1000000.0);
+};
+
+// adds an entry growing our array by DYNARRAY_EXPAND entries at a time, as dynArrayPush used to
+unsigned int benchFixedPush(dynarray * pArray, void * pData) {
+  if (pArray->numEntries == pArray->maxEntries) {
+    pArray->maxEntries += DYNARRAY_EXPAND;
+    pArray->data = realloc(pArray->data, pArray->entrySize * pArray->maxEntries);
+    if (pArray->data == NULL) {
+      return DYNARRAY_NOMEM;
+    };
+  };
+
+  memcpy((char *) pArray->data + (pArray->numEntries * pArray->entrySize), pData, pArray->entrySize);
+  return pArray->numEntries++;
+};
+
+// returns the number of million entries we add per second
+double benchRate(unsigned int pCount, double pTime) {
+  return pTime <= 0.0 ? 0.0 : (pCount / 1000.0) / pTime;
+};
+
+int main(int argc, char ** argv) {
+  benchEntry    entries[BULK_SIZE];
+  unsigned int  count, i, j;
+
+  for (i = 0; i < BULK_SIZE; i++) {
+    for (j = 0; j < 8; j++) {
+      entries[i].values[j] = (float) (i + j);
+    };
+  };
+
+  printf("%10s %14s %14s %14s %14s\n", "entries", "fixed", "geometric", "reserved", "bulk");
+
+  for (count = 1000; count <= 10000000; count *= 10) {
+    dynarray *    array;
+    double        start, fixedTime, geoTime, reserveTime, bulkTime;
+
+    array = newDynArray(sizeof(benchEntry));
+    start = benchTime();
+    for (i = 0; i < count; i++) {
+      benchFixedPush(array, &entries[i % BULK_SIZE]);
+    };
+    fixedTime = benchTime() - start;
+    dynArrayFree(array);
+
+    array = newDynArray(sizeof(benchEntry));
+    start = benchTime();
+    for (i = 0; i < count; i++) {
+      dynArrayPush(array, &entries[i % BULK_SIZE]);
+    };
+    geoTime = benchTime() - start;
+    dynArrayFree(array);
+
+    array = newDynArray(sizeof(benchEntry));
+    start = benchTime();
+    dynArrayReserve(array, count);
+    for (i = 0; i < count; i++) {
+      dynArrayPush(array, &entries[i % BULK_SIZE]);
+    };
+    reserveTime = benchTime() - start;
+    dynArrayFree(array);
+
+    array = newDynArray(sizeof(benchEntry));
+    start = benchTime();
+    for (i = 0; i < count; i += BULK_SIZE) {
+      dynArrayPushN(array, entries, count - i < BULK_SIZE ? count - i : BULK_SIZE);
+    };
+    bulkTime = benchTime() - start;
+    if (array->numEntries != count) {
+      printf("Bulk push added %u entries instead of %u!\n", array->numEntries, count);
+    };
+    dynArrayFree(array);
+
+    printf("%10u %8.1f M/s %8.1f M/s %8.1f M/s %8.1f M/s\n", count, benchRate(count, fixedTime), benchRate(count, geoTime), benchRate(count, reserveTime), benchRate(count, bulkTime));
+  };
+
+  return 0;
+};
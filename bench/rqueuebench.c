@@ -0,0 +1,170 @@
+/********************************************************
+ * rqueuebench.c - compares sorting our render list with
+ * qsort to sorting it through our render queue
+ *
+ * This is a standalone program and not part of our
+ * build, build and run it with something like:
+ * gcc -O2 -std=gnu99 -I../include -I../3rdparty rqueuebench.c -o rqueuebench -lGLEW -lGL -lm
+ * ./rqueuebench
+ *
+ * No GL context is needed, we only use the CPU side of
+ * our mesh library.
+ *
+ ********************************************************/
+
+#define STB_IMAGE_IMPLEMENTATION
+#define SYS_IMPLEMENTATION
+#define VARCHAR_IMPLEMENTATION
+#define LINKEDLIST_IMPLEMENTATION
+#define DYNARRAY_IMPLEMENTATION
+#define MATH3D_IMPLEMENTATION
+#define CULL_IMPLEMENTATION
+#define RQUEUE_IMPLEMENTATION
+#define BENCH_IMPLEMENTATION
+#define PROFILER_IMPLEMENTATION
+#define SHADER_IMPLEMENTATION
+#define TEXTURE_IMPLEMENTATION
+#define MATERIAL_IMPLEMENTATION
+#define MESH_IMPLEMENTATION
+#define JOBS_IMPLEMENTATION
+#define HEIGHTFIELD_IMPLEMENTATION
+#define TERRAIN_IMPLEMENTATION
+
+#include <GL/glew.h>
+#include <time.h>
+#include "system.h"
+#include "math3d.h"
+#include "cull.h"
+#include "renderqueue.h"
+#include "shaders.h"
+#include "material.h"
+#include "mesh3d.h"
+#include "meshnode.h"
+
+// our scene mimics our forest, 5000 trees each with a trunk and leaves in 3 LOD levels
+#define NUM_TREES     5000
+#define NUM_MESHES    6
+#define NUM_FRAMES    100
+
+renderMesh    entries[NUM_TREES * 2];
+
+// get a time in milliseconds
+double benchTime() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1000.0) + (t.tv_nsec / 1000000.0);
+};
+
+float benchRandom(float pMin, float pMax) {
+  return pMin + ((pMax - pMin) * rand() / RAND_MAX);
+};
+
+// the comparator we used to sort our render list with before we had our render queue
+int benchSort(const void * pA, const void * pB) {
+  renderMesh * a = (renderMesh *) pA;
+  renderMesh * b = (renderMesh *) pB;
+
+  if (a->mesh->material->priority < b->mesh->material->priority) {
+    return -1;
+  } else if (a->mesh->material->priority > b->mesh->material->priority) {
+    return 1;
+  } else if (a->mesh->material < b->mesh->material) {
+    return -1;
+  } else if (a->mesh->material > b->mesh->material) {
+    return 1;
+  } else if (a->mesh < b->mesh) {
+    return -1;
+  } else if (a->mesh > b->mesh) {
+    return 1;
+  } else if (a->z < b->z) {
+    return -1;
+  } else if (a->z > b->z) {
+    return 1;
+  } else {
+    return 0;
+  };
+};
+
+int main(int argc, char ** argv) {
+  material *    mats[2];
+  mesh3d *      meshes[NUM_MESHES];
+  renderQueue * queue;
+  double        start, oldTime = 0.0, newTime = 0.0;
+  int           i, f, mismatch = 0;
+
+  mats[0] = newMaterial("trunk");
+  mats[1] = newMaterial("leaves");
+  for (i = 0; i < NUM_MESHES; i++) {
+    meshes[i] = newMesh(24, 36);
+    meshSetMaterial(meshes[i], mats[i % 2]);
+  };
+
+  // pick a LOD for each tree
+  srand(1);
+  for (i = 0; i < NUM_TREES; i++) {
+    int lod = rand() % 3;
+    float z = benchRandom(-5000.0, -1.0);
+
+    mat4Identity(&entries[i * 2].model);
+    entries[i * 2].mesh = meshes[lod * 2];
+    entries[i * 2].z = z;
+    mat4Identity(&entries[(i * 2) + 1].model);
+    entries[(i * 2) + 1].mesh = meshes[(lod * 2) + 1];
+    entries[(i * 2) + 1].z = z;
+  };
+
+  queue = newRenderQueue(sizeof(renderMesh));
+
+  for (f = 0; f < NUM_FRAMES; f++) {
+    dynarray * list;
+
+    // our old approach, a fresh array each frame sorted with qsort
+    start = benchTime();
+    list = newDynArray(sizeof(renderMesh));
+    for (i = 0; i < NUM_TREES * 2; i++) {
+      dynArrayPush(list, &entries[i]);
+    };
+    dynArraySort(list, benchSort);
+    oldTime += benchTime() - start;
+
+    // our render queue
+    start = benchTime();
+    rqueueClear(queue);
+    for (i = 0; i < NUM_TREES * 2; i++) {
+      material * mat = entries[i].mesh->material;
+
+      rqueueAdd(queue, rqueueOpaqueKey(mat->priority, 0, mat->id, entries[i].mesh->id, -entries[i].z), &entries[i]);
+    };
+    rqueueSort(queue);
+    newTime += benchTime() - start;
+
+    // both should give us the same meshes in the same order, our old sort was back to front within a mesh
+    for (i = 0; i < NUM_TREES * 2; i++) {
+      renderMesh * a = (renderMesh *) dynArrayDataAtIndex(list, i);
+      renderMesh * b = (renderMesh *) rqueueItem(queue, i);
+
+      if (a->mesh != b->mesh) {
+        mismatch++;
+      };
+    };
+
+    dynArrayFree(list);
+  };
+
+  printf("%d entries, %d frames\n", NUM_TREES * 2, NUM_FRAMES);
+  printf("qsort:        %8.3f ms per frame\n", oldTime / NUM_FRAMES);
+  printf("render queue: %8.3f ms per frame\n", newTime / NUM_FRAMES);
+  if (mismatch > 0) {
+    printf("%d entries are grouped differently!\n", mismatch);
+  };
+
+  rqueueFree(queue);
+  for (i = 0; i < NUM_MESHES; i++) {
+    meshRelease(meshes[i]);
+  };
+  matRelease(mats[0]);
+  matRelease(mats[1]);
+
+  return 0;
+};
@@ -0,0 +1,499 @@
+/********************************************************
+ * benchmark.h - benchmark library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define BENCH_IMPLEMENTATION
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions.
+ *
+ * Our libraries report draw calls, triangles and shadow
+ * map rebuilds to the counters in this library, a
+ * benchmark records these for each frame together with
+ * the CPU and GPU time the frame took.
+ *
+ * GPU time is measured with timestamp queries which we
+ * read back a few frames later so we don't stall.
+ *
+ * A camera path is a list of keys with a time, eye and
+ * lookat position that we interpolate with a Catmull-Rom
+ * spline. A path can be parsed from text with one key
+ * per line:
+ * <time> <eye x> <eye y> <eye z> <lookat x> <lookat y> <lookat z>
+ * Lines starting with # are ignored.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef benchmarkh
+#define benchmarkh
+
+// our libraries we need
+#include "system.h"
+#include "dynamicarray.h"
+#include "math3d.h"
+
+// number of frames we wait before reading back our GPU timers
+#define BENCH_QUERIES         4
+
+// fields we record for each frame
+enum BENCH_FIELDS {
+  BENCH_CPUTIME,
+  BENCH_GPUTIME,
+  BENCH_DRAWCALLS,
+  BENCH_TRIANGLES,
+  BENCH_SHADOWREBUILDS,
+  BENCH_NUMFIELDS
+};
+
+// counters our libraries update while rendering
+typedef struct benchCounters {
+  unsigned int  drawCalls;            /* number of draw calls issued */
+  unsigned int  triangles;            /* number of triangles we've submitted */
+  unsigned int  shadowRebuilds;       /* number of shadow maps we've rendered */
+} benchCounters;
+
+// statistics for a single frame
+typedef struct benchFrame {
+  double        values[BENCH_NUMFIELDS]; /* our values, times are in milliseconds */
+} benchFrame;
+
+// structure for our benchmark
+typedef struct benchmark {
+  dynarray *    frames;               /* our recorded frames */
+  double        frameStart;           /* CPU time our current frame started */
+  GLuint        queries[BENCH_QUERIES][2]; /* timestamp queries at the start and end of our frames */
+  unsigned int  queryFrame[BENCH_QUERIES]; /* frame each of our queries belongs to */
+  bool          queryPending[BENCH_QUERIES]; /* true if we still need to read back our query */
+} benchmark;
+
+// a key in our camera path
+typedef struct benchPathKey {
+  float         time;                 /* time in seconds for this key */
+  vec3          eye;                  /* position of our camera */
+  vec3          lookat;               /* position our camera is looking at */
+} benchPathKey;
+
+// a camera path
+typedef struct benchPath {
+  dynarray *    keys;                 /* our keys, in order of time */
+} benchPath;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern benchCounters benchCount;
+
+void benchCountDraw(unsigned int pTriangles, unsigned int pInstances);
+void benchCountShadowRebuild(void);
+void benchResetCounters(void);
+double benchGetTime(void);
+
+benchmark * newBenchmark(void);
+void benchFree(benchmark * pBench);
+void benchFrameStart(benchmark * pBench);
+void benchFrameEnd(benchmark * pBench);
+void benchFinish(benchmark * pBench);
+double benchPercentile(benchmark * pBench, int pField, double pPercentile);
+bool benchWriteCSV(benchmark * pBench, const char * pFileName);
+void benchLogSummary(benchmark * pBench);
+
+benchPath * newBenchPath(void);
+void benchPathFree(benchPath * pPath);
+void benchPathAddKey(benchPath * pPath, float pTime, const vec3 * pEye, const vec3 * pLookat);
+bool benchPathParse(benchPath * pPath, const char * pText);
+void benchPathEval(benchPath * pPath, float pTime, vec3 * pEye, vec3 * pLookat);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef BENCH_IMPLEMENTATION
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// our counters
+benchCounters benchCount = { 0, 0, 0 };
+
+// names of our fields as we write them to our CSV file
+const char * benchFieldNames[BENCH_NUMFIELDS] = {
+  "cpu_ms",
+  "gpu_ms",
+  "draw_calls",
+  "triangles",
+  "shadow_rebuilds"
+};
+
+// count a draw call
+void benchCountDraw(unsigned int pTriangles, unsigned int pInstances) {
+  benchCount.drawCalls++;
+  benchCount.triangles += pTriangles * pInstances;
+};
+
+// count a shadow map being rendered
+void benchCountShadowRebuild(void) {
+  benchCount.shadowRebuilds++;
+};
+
+// reset our counters
+void benchResetCounters(void) {
+  memset(&benchCount, 0, sizeof(benchCount));
+};
+
+// get our CPU time in milliseconds
+double benchGetTime(void) {
+#if defined(WIN32) || defined(_WIN32)
+  LARGE_INTEGER frequency, counter;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (counter.QuadPart * 1000.0) / frequency.QuadPart;
+#else
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1000.0) + (t.tv_nsec / 1000000.0);
+#endif
+};
+
+// create a new benchmark, this must be called with our GL context active
+benchmark * newBenchmark(void) {
+  benchmark * bench = (benchmark *) malloc(sizeof(benchmark));
+  if (bench == NULL) {
+    errorlog(-1, "Couldn't allocate memory for our benchmark");
+  } else {
+    bench->frames = newDynArray(sizeof(benchFrame));
+    bench->frameStart = 0.0;
+    glGenQueries(BENCH_QUERIES * 2, &bench->queries[0][0]);
+    memset(bench->queryFrame, 0, sizeof(bench->queryFrame));
+    memset(bench->queryPending, 0, sizeof(bench->queryPending));
+  };
+
+  return bench;
+};
+
+// free our benchmark, this must be called with our GL context active
+void benchFree(benchmark * pBench) {
+  if (pBench == NULL) {
+    return;
+  };
+
+  glDeleteQueries(BENCH_QUERIES * 2, &pBench->queries[0][0]);
+  dynArrayFree(pBench->frames);
+  free(pBench);
+};
+
+// read back the GPU time of the frame using query pQuery
+void benchReadQuery(benchmark * pBench, unsigned int pQuery) {
+  GLuint64      start, end;
+  benchFrame *  frame;
+
+  if (!pBench->queryPending[pQuery]) {
+    return;
+  };
+
+  // note that this waits for our GPU if it hasn't finished this frame yet
+  glGetQueryObjectui64v(pBench->queries[pQuery][0], GL_QUERY_RESULT, &start);
+  glGetQueryObjectui64v(pBench->queries[pQuery][1], GL_QUERY_RESULT, &end);
+
+  frame = (benchFrame *) dynArrayDataAtIndex(pBench->frames, pBench->queryFrame[pQuery]);
+  if (frame != NULL) {
+    frame->values[BENCH_GPUTIME] = (end - start) / 1000000.0;
+  };
+
+  pBench->queryPending[pQuery] = false;
+};
+
+// start recording a frame
+void benchFrameStart(benchmark * pBench) {
+  unsigned int query;
+
+  if (pBench == NULL) {
+    return;
+  };
+
+  // make sure the query we're about to reuse has been read
+  query = pBench->frames->numEntries % BENCH_QUERIES;
+  benchReadQuery(pBench, query);
+
+  benchResetCounters();
+  pBench->frameStart = benchGetTime();
+  glQueryCounter(pBench->queries[query][0], GL_TIMESTAMP);
+};
+
+// finish recording a frame
+void benchFrameEnd(benchmark * pBench) {
+  benchFrame    frame;
+  unsigned int  query;
+
+  if (pBench == NULL) {
+    return;
+  };
+
+  query = pBench->frames->numEntries % BENCH_QUERIES;
+  glQueryCounter(pBench->queries[query][1], GL_TIMESTAMP);
+
+  frame.values[BENCH_CPUTIME] = benchGetTime() - pBench->frameStart;
+  frame.values[BENCH_GPUTIME] = 0.0; // filled in when we read back our query
+  frame.values[BENCH_DRAWCALLS] = benchCount.drawCalls;
+  frame.values[BENCH_TRIANGLES] = benchCount.triangles;
+  frame.values[BENCH_SHADOWREBUILDS] = benchCount.shadowRebuilds;
+
+  pBench->queryFrame[query] = dynArrayPush(pBench->frames, &frame);
+  pBench->queryPending[query] = true;
+};
+
+// read back any outstanding GPU timers, call this after our last frame
+void benchFinish(benchmark * pBench) {
+  unsigned int query;
+
+  if (pBench == NULL) {
+    return;
+  };
+
+  for (query = 0; query < BENCH_QUERIES; query++) {
+    benchReadQuery(pBench, query);
+  };
+};
+
+int benchCompareDouble(const void * pA, const void * pB) {
+  double a = *((double *) pA);
+  double b = *((double *) pB);
+
+  if (a < b) {
+    return -1;
+  } else if (a > b) {
+    return 1;
+  } else {
+    return 0;
+  };
+};
+
+// returns the given percentile (0.0 - 100.0) of a field over all our frames using the nearest rank
+double benchPercentile(benchmark * pBench, int pField, double pPercentile) {
+  double *      values;
+  double        result;
+  unsigned int  i, n, rank;
+
+  if (pBench == NULL) {
+    return 0.0;
+  } else if (pBench->frames->numEntries == 0) {
+    return 0.0;
+  };
+
+  n = pBench->frames->numEntries;
+  values = (double *) malloc(sizeof(double) * n);
+  if (values == NULL) {
+    errorlog(-1, "Couldn't allocate memory for our percentiles");
+    return 0.0;
+  };
+
+  for (i = 0; i < n; i++) {
+    values[i] = ((benchFrame *) dynArrayDataAtIndex(pBench->frames, i))->values[pField];
+  };
+  qsort(values, n, sizeof(double), benchCompareDouble);
+
+  rank = (unsigned int) ceil((pPercentile / 100.0) * n);
+  rank = rank < 1 ? 1 : (rank > n ? n : rank);
+  result = values[rank - 1];
+
+  free(values);
+
+  return result;
+};
+
+// write our frames to a CSV file, one line per frame
+bool benchWriteCSV(benchmark * pBench, const char * pFileName) {
+  FILE *        file;
+  unsigned int  i;
+  int           f;
+
+  if (pBench == NULL) {
+    return false;
+  };
+
+  file = fopen(pFileName, "w");
+  if (file == NULL) {
+    errorlog(-1, "Couldn't open %s for writing", pFileName);
+    return false;
+  };
+
+  fprintf(file, "frame");
+  for (f = 0; f < BENCH_NUMFIELDS; f++) {
+    fprintf(file, ",%s", benchFieldNames[f]);
+  };
+  fprintf(file, "\n");
+
+  for (i = 0; i < pBench->frames->numEntries; i++) {
+    benchFrame * frame = (benchFrame *) dynArrayDataAtIndex(pBench->frames, i);
+
+    fprintf(file, "%u,%.4f,%.4f,%.0f,%.0f,%.0f\n", i,
+      frame->values[BENCH_CPUTIME], frame->values[BENCH_GPUTIME], frame->values[BENCH_DRAWCALLS],
+      frame->values[BENCH_TRIANGLES], frame->values[BENCH_SHADOWREBUILDS]);
+  };
+
+  fclose(file);
+
+  return true;
+};
+
+// log the p50, p95 and p99 of each of our fields
+void benchLogSummary(benchmark * pBench) {
+  int f;
+
+  if (pBench == NULL) {
+    return;
+  };
+
+  errorlog(0, "Benchmark of %u frames", pBench->frames->numEntries);
+  for (f = 0; f < BENCH_NUMFIELDS; f++) {
+    errorlog(0, "%-16s p50 %10.3f  p95 %10.3f  p99 %10.3f", benchFieldNames[f],
+      benchPercentile(pBench, f, 50.0), benchPercentile(pBench, f, 95.0), benchPercentile(pBench, f, 99.0));
+  };
+};
+
+// create a new, empty, camera path
+benchPath * newBenchPath(void) {
+  benchPath * path = (benchPath *) malloc(sizeof(benchPath));
+  if (path == NULL) {
+    errorlog(-1, "Couldn't allocate memory for our camera path");
+  } else {
+    path->keys = newDynArray(sizeof(benchPathKey));
+  };
+
+  return path;
+};
+
+// free our camera path
+void benchPathFree(benchPath * pPath) {
+  if (pPath == NULL) {
+    return;
+  };
+
+  dynArrayFree(pPath->keys);
+  free(pPath);
+};
+
+// add a key to our path, keys must be added in strictly increasing order of time
+void benchPathAddKey(benchPath * pPath, float pTime, const vec3 * pEye, const vec3 * pLookat) {
+  benchPathKey key;
+
+  if (pPath == NULL) {
+    return;
+  };
+
+  key.time = pTime;
+  vec3Copy(&key.eye, pEye);
+  vec3Copy(&key.lookat, pLookat);
+  dynArrayPush(pPath->keys, &key);
+};
+
+// parse our camera path from text, returns false if a line couldn't be parsed or our keys aren't in increasing order of time
+bool benchPathParse(benchPath * pPath, const char * pText) {
+  const char *  line = pText;
+  int           lineNo = 1;
+
+  if (pPath == NULL) {
+    return false;
+  };
+
+  while ((line != NULL) && (*line != '\0')) {
+    float         time;
+    vec3          eye, lookat;
+    const char *  c = line;
+
+    // skip leading whitespace
+    while ((*c == ' ') || (*c == '\t')) {
+      c++;
+    };
+
+    if ((*c == '#') || (*c == '\r') || (*c == '\n') || (*c == '\0')) {
+      // comment or empty line
+    } else if (sscanf(c, "%f %f %f %f %f %f %f", &time, &eye.x, &eye.y, &eye.z, &lookat.x, &lookat.y, &lookat.z) == 7) {
+      // two keys at the same time would give us an empty segment to interpolate over
+      if ((pPath->keys->numEntries > 0) && (time <= ((benchPathKey *) dynArrayDataAtIndex(pPath->keys, pPath->keys->numEntries - 1))->time)) {
+        errorlog(lineNo, "Camera path keys must be in increasing order of time");
+        return false;
+      };
+
+      benchPathAddKey(pPath, time, &eye, &lookat);
+    } else {
+      errorlog(lineNo, "Couldn't parse camera path key");
+      return false;
+    };
+
+    // next line
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    };
+    lineNo++;
+  };
+
+  return true;
+};
+
+// interpolate between pB and pC using Catmull-Rom, pA and pD are our neighbouring points
+void benchCatmullRom(vec3 * pOut, const vec3 * pA, const vec3 * pB, const vec3 * pC, const vec3 * pD, float pT) {
+  float t2 = pT * pT;
+  float t3 = t2 * pT;
+
+  pOut->x = 0.5 * ((2.0 * pB->x) + (-pA->x + pC->x) * pT + (2.0 * pA->x - 5.0 * pB->x + 4.0 * pC->x - pD->x) * t2 + (-pA->x + 3.0 * pB->x - 3.0 * pC->x + pD->x) * t3);
+  pOut->y = 0.5 * ((2.0 * pB->y) + (-pA->y + pC->y) * pT + (2.0 * pA->y - 5.0 * pB->y + 4.0 * pC->y - pD->y) * t2 + (-pA->y + 3.0 * pB->y - 3.0 * pC->y + pD->y) * t3);
+  pOut->z = 0.5 * ((2.0 * pB->z) + (-pA->z + pC->z) * pT + (2.0 * pA->z - 5.0 * pB->z + 4.0 * pC->z - pD->z) * t2 + (-pA->z + 3.0 * pB->z - 3.0 * pC->z + pD->z) * t3);
+};
+
+// get our camera position at pTime, we stay at our first or last key outside of our path
+void benchPathEval(benchPath * pPath, float pTime, vec3 * pEye, vec3 * pLookat) {
+  benchPathKey *  keys;
+  unsigned int    n, i;
+  float           t;
+
+  if (pPath == NULL) {
+    return;
+  } else if (pPath->keys->numEntries == 0) {
+    return;
+  };
+
+  keys = (benchPathKey *) pPath->keys->data;
+  n = pPath->keys->numEntries;
+
+  if ((n == 1) || (pTime <= keys[0].time)) {
+    vec3Copy(pEye, &keys[0].eye);
+    vec3Copy(pLookat, &keys[0].lookat);
+    return;
+  } else if (pTime >= keys[n - 1].time) {
+    vec3Copy(pEye, &keys[n - 1].eye);
+    vec3Copy(pLookat, &keys[n - 1].lookat);
+    return;
+  };
+
+  // find the segment we're in
+  i = 0;
+  while ((i < n - 2) && (pTime >= keys[i + 1].time)) {
+    i++;
+  };
+
+  t = (pTime - keys[i].time) / (keys[i + 1].time - keys[i].time);
+
+  // and interpolate, at the ends we reuse our end points as neighbours
+  benchCatmullRom(pEye, &keys[i > 0 ? i - 1 : 0].eye, &keys[i].eye, &keys[i + 1].eye, &keys[i + 2 < n ? i + 2 : n - 1].eye, t);
+  benchCatmullRom(pLookat, &keys[i > 0 ? i - 1 : 0].lookat, &keys[i].lookat, &keys[i + 1].lookat, &keys[i + 2 < n ? i + 2 : n - 1].lookat, t);
+};
+
+#endif /* BENCH_IMPLEMENTATION */
+
+#endif /* !benchmarkh */
@@ -0,0 +1,320 @@
+/********************************************************
+ * cull.h - frustum culling library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define CULL_IMPLEMENTATION
+ *
+ * Note that this library depends on math3d.h
+ *
+ * When SSE is available boxes can be tested 4 at a time
+ * with frustumTestAABB4 and aabb4TestSphere, define
+ * CULL_NO_SIMD before including this file to use the
+ * scalar version instead.
+ *
+ * Bounding boxes are stored in center/extent form,
+ * our frustum is stored as 6 planes extracted from a
+ * (model)view projection matrix. Our planes point
+ * inwards so a positive distance is inside of our
+ * frustum.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ * 0.2  16-10-2026  Added testing boxes in batches of 4
+ * 0.3  16-10-2026  Added testing 4 boxes against a sphere
+ *
+ ********************************************************/
+
+#ifndef cullh
+#define cullh
+
+// include support libraries
+#include <string.h>
+#include "math3d.h"
+
+// check if we can use SSE
+#if !defined(CULL_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+// results of our frustum tests
+#define CULL_OUTSIDE    0
+#define CULL_INTERSECT  1
+#define CULL_INSIDE     2
+
+// mask with all our planes set
+#define CULL_ALLPLANES  0x3F
+
+// axis aligned bounding box
+typedef struct aabb {
+  vec3          center;         /* center of our box */
+  vec3          extent;         /* half size of our box along each axis */
+} aabb;
+
+// 4 axis aligned bounding boxes stored per component so we can test them in one go
+// note that these are always floats as that is what our SIMD code works with
+typedef struct aabb4 {
+  float         cx[4];          /* x of our centers */
+  float         cy[4];          /* y of our centers */
+  float         cz[4];          /* z of our centers */
+  float         ex[4];          /* x of our extents */
+  float         ey[4];          /* y of our extents */
+  float         ez[4];          /* z of our extents */
+} aabb4;
+
+// our frustum, planes are left, right, bottom, top, near, far
+typedef struct frustum {
+  vec4          planes[6];      /* normal in xyz, distance in w */
+} frustum;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+aabb * aabbFromMinMax(aabb * pSet, const vec3 * pMin, const vec3 * pMax);
+aabb * aabbMerge(aabb * pMergeTo, const aabb * pMerge);
+aabb * aabbTransform(aabb * pSet, const aabb * pBox, const mat4 * pMatrix);
+aabb4 * aabb4Clear(aabb4 * pSet);
+aabb4 * aabb4SetBox(aabb4 * pSet, int pIndex, const aabb * pBox);
+unsigned int aabb4TestSphere(const aabb4 * pBoxes, const vec3 * pCenter, float pRadius);
+
+frustum * frustumFromMatrix(frustum * pSet, const mat4 * pMVP);
+int frustumTestAABB(const frustum * pFrustum, const aabb * pBox, unsigned int * pPlaneMask);
+unsigned int frustumTestAABB4(const frustum * pFrustum, const aabb4 * pBoxes, unsigned int pPlaneMask);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef CULL_IMPLEMENTATION
+
+// set our box from a minimum and maximum corner
+aabb * aabbFromMinMax(aabb * pSet, const vec3 * pMin, const vec3 * pMax) {
+  pSet->center.x = (pMin->x + pMax->x) * 0.5;
+  pSet->center.y = (pMin->y + pMax->y) * 0.5;
+  pSet->center.z = (pMin->z + pMax->z) * 0.5;
+  pSet->extent.x = (pMax->x - pMin->x) * 0.5;
+  pSet->extent.y = (pMax->y - pMin->y) * 0.5;
+  pSet->extent.z = (pMax->z - pMin->z) * 0.5;
+
+  return pSet;
+};
+
+// grow our box so it also contains pMerge
+aabb * aabbMerge(aabb * pMergeTo, const aabb * pMerge) {
+  vec3 minVec, maxVec;
+
+  minVec.x = fmin(pMergeTo->center.x - pMergeTo->extent.x, pMerge->center.x - pMerge->extent.x);
+  minVec.y = fmin(pMergeTo->center.y - pMergeTo->extent.y, pMerge->center.y - pMerge->extent.y);
+  minVec.z = fmin(pMergeTo->center.z - pMergeTo->extent.z, pMerge->center.z - pMerge->extent.z);
+  maxVec.x = fmax(pMergeTo->center.x + pMergeTo->extent.x, pMerge->center.x + pMerge->extent.x);
+  maxVec.y = fmax(pMergeTo->center.y + pMergeTo->extent.y, pMerge->center.y + pMerge->extent.y);
+  maxVec.z = fmax(pMergeTo->center.z + pMergeTo->extent.z, pMerge->center.z + pMerge->extent.z);
+
+  return aabbFromMinMax(pMergeTo, &minVec, &maxVec);
+};
+
+// apply our matrix to our box, our result is the axis aligned box that contains our transformed box
+// pSet may equal pBox
+aabb * aabbTransform(aabb * pSet, const aabb * pBox, const mat4 * pMatrix) {
+  aabb box;
+
+  // our center is simply transformed
+  mat4ApplyToVec3(&box.center, &pBox->center, pMatrix);
+
+  // our extent is our original extent applied to the absolute values of our rotation/scale part
+  box.extent.x = (fabs(pMatrix->m[0][0]) * pBox->extent.x) + (fabs(pMatrix->m[1][0]) * pBox->extent.y) + (fabs(pMatrix->m[2][0]) * pBox->extent.z);
+  box.extent.y = (fabs(pMatrix->m[0][1]) * pBox->extent.x) + (fabs(pMatrix->m[1][1]) * pBox->extent.y) + (fabs(pMatrix->m[2][1]) * pBox->extent.z);
+  box.extent.z = (fabs(pMatrix->m[0][2]) * pBox->extent.x) + (fabs(pMatrix->m[1][2]) * pBox->extent.y) + (fabs(pMatrix->m[2][2]) * pBox->extent.z);
+
+  vec3Copy(&pSet->center, &box.center);
+  vec3Copy(&pSet->extent, &box.extent);
+
+  return pSet;
+};
+
+// clear our boxes, cleared boxes are centered on the origin with no size
+aabb4 * aabb4Clear(aabb4 * pSet) {
+  memset(pSet, 0, sizeof(aabb4));
+
+  return pSet;
+};
+
+// set one of our 4 boxes
+aabb4 * aabb4SetBox(aabb4 * pSet, int pIndex, const aabb * pBox) {
+  pSet->cx[pIndex] = pBox->center.x;
+  pSet->cy[pIndex] = pBox->center.y;
+  pSet->cz[pIndex] = pBox->center.z;
+  pSet->ex[pIndex] = pBox->extent.x;
+  pSet->ey[pIndex] = pBox->extent.y;
+  pSet->ez[pIndex] = pBox->extent.z;
+
+  return pSet;
+};
+
+// test 4 boxes against a sphere
+// returns a mask with bit 0 to 3 set for each box that our sphere touches
+unsigned int aabb4TestSphere(const aabb4 * pBoxes, const vec3 * pCenter, float pRadius) {
+#ifdef CULL_SSE
+  __m128  zero = _mm_setzero_ps();
+  __m128  dx, dy, dz, distance;
+
+  // distance from our center to the sides of our boxes along each axis, 0 if we're within our box
+  dx = _mm_sub_ps(_mm_loadu_ps(pBoxes->cx), _mm_set1_ps(pCenter->x));
+  dx = _mm_max_ps(_mm_sub_ps(_mm_max_ps(dx, _mm_sub_ps(zero, dx)), _mm_loadu_ps(pBoxes->ex)), zero);
+  dy = _mm_sub_ps(_mm_loadu_ps(pBoxes->cy), _mm_set1_ps(pCenter->y));
+  dy = _mm_max_ps(_mm_sub_ps(_mm_max_ps(dy, _mm_sub_ps(zero, dy)), _mm_loadu_ps(pBoxes->ey)), zero);
+  dz = _mm_sub_ps(_mm_loadu_ps(pBoxes->cz), _mm_set1_ps(pCenter->z));
+  dz = _mm_max_ps(_mm_sub_ps(_mm_max_ps(dz, _mm_sub_ps(zero, dz)), _mm_loadu_ps(pBoxes->ez)), zero);
+
+  // squared distance from our center to our boxes
+  distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+  return _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(pRadius * pRadius)));
+#else
+  unsigned int  touches = 0;
+  int           b;
+
+  for (b = 0; b < 4; b++) {
+    float dx = fmax(fabs(pBoxes->cx[b] - pCenter->x) - pBoxes->ex[b], 0.0);
+    float dy = fmax(fabs(pBoxes->cy[b] - pCenter->y) - pBoxes->ey[b], 0.0);
+    float dz = fmax(fabs(pBoxes->cz[b] - pCenter->z) - pBoxes->ez[b], 0.0);
+
+    if ((dx * dx) + (dy * dy) + (dz * dz) <= pRadius * pRadius) {
+      touches |= (1 << b);
+    };
+  };
+
+  return touches;
+#endif
+};
+
+// extract our frustum planes from our (model)view projection matrix
+// if pMVP includes a model matrix our planes are in model space
+frustum * frustumFromMatrix(frustum * pSet, const mat4 * pMVP) {
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    // planes are our w row plus or minus our x, y or z row
+    vec4Set(&pSet->planes[i * 2],
+      pMVP->m[0][3] + pMVP->m[0][i],
+      pMVP->m[1][3] + pMVP->m[1][i],
+      pMVP->m[2][3] + pMVP->m[2][i],
+      pMVP->m[3][3] + pMVP->m[3][i]);
+    vec4Set(&pSet->planes[(i * 2) + 1],
+      pMVP->m[0][3] - pMVP->m[0][i],
+      pMVP->m[1][3] - pMVP->m[1][i],
+      pMVP->m[2][3] - pMVP->m[2][i],
+      pMVP->m[3][3] - pMVP->m[3][i]);
+  };
+
+  // normalise our planes so w is a true distance
+  for (i = 0; i < 6; i++) {
+    MATH3D_FLOAT length = sqrt((pSet->planes[i].x * pSet->planes[i].x) + (pSet->planes[i].y * pSet->planes[i].y) + (pSet->planes[i].z * pSet->planes[i].z));
+    if (length > MATH3D_EPSILON) {
+      vec4Div(&pSet->planes[i], length);
+    };
+  };
+
+  return pSet;
+};
+
+// test our box against our frustum, returns CULL_OUTSIDE, CULL_INTERSECT or CULL_INSIDE
+// if pPlaneMask is not NULL only planes with their bit set are tested and on return only
+// the planes our box intersects remain set, pass this on when testing boxes contained
+// within this box (start with CULL_ALLPLANES)
+int frustumTestAABB(const frustum * pFrustum, const aabb * pBox, unsigned int * pPlaneMask) {
+  unsigned int  mask = pPlaneMask == NULL ? CULL_ALLPLANES : *pPlaneMask;
+  unsigned int  newMask = 0;
+  int           i;
+
+  for (i = 0; i < 6; i++) {
+    if (mask & (1 << i)) {
+      const vec4 * plane = &pFrustum->planes[i];
+      MATH3D_FLOAT distance = (plane->x * pBox->center.x) + (plane->y * pBox->center.y) + (plane->z * pBox->center.z) + plane->w;
+      MATH3D_FLOAT radius = (fabs(plane->x) * pBox->extent.x) + (fabs(plane->y) * pBox->extent.y) + (fabs(plane->z) * pBox->extent.z);
+
+      if (distance + radius < 0.0) {
+        // completely behind this plane
+        return CULL_OUTSIDE;
+      } else if (distance - radius < 0.0) {
+        // we intersect this plane
+        newMask |= (1 << i);
+      };
+    };
+  };
+
+  if (pPlaneMask != NULL) {
+    *pPlaneMask = newMask;
+  };
+
+  return newMask == 0 ? CULL_INSIDE : CULL_INTERSECT;
+};
+
+// test 4 boxes against the planes of our frustum that are set in pPlaneMask (use CULL_ALLPLANES to test all)
+// returns a mask with bit 0 to 3 set for each box that is (partially) inside of our frustum
+unsigned int frustumTestAABB4(const frustum * pFrustum, const aabb4 * pBoxes, unsigned int pPlaneMask) {
+#ifdef CULL_SSE
+  __m128  cx = _mm_loadu_ps(pBoxes->cx);
+  __m128  cy = _mm_loadu_ps(pBoxes->cy);
+  __m128  cz = _mm_loadu_ps(pBoxes->cz);
+  __m128  ex = _mm_loadu_ps(pBoxes->ex);
+  __m128  ey = _mm_loadu_ps(pBoxes->ey);
+  __m128  ez = _mm_loadu_ps(pBoxes->ez);
+  __m128  zero = _mm_setzero_ps();
+  __m128  outside = zero;
+  int     i;
+
+  for (i = 0; i < 6; i++) {
+    if (pPlaneMask & (1 << i)) {
+      const vec4 *  plane = &pFrustum->planes[i];
+      __m128        distance, radius;
+
+      // distance of our centers to our plane
+      distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane->x)), _mm_mul_ps(cy, _mm_set1_ps(plane->y)));
+      distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane->z)));
+      distance = _mm_add_ps(distance, _mm_set1_ps(plane->w));
+
+      // projected radius of our boxes
+      radius = _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabs(plane->x))), _mm_mul_ps(ey, _mm_set1_ps(fabs(plane->y))));
+      radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_set1_ps(fabs(plane->z))));
+
+      // completely behind this plane?
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    };
+  };
+
+  return (~_mm_movemask_ps(outside)) & 0x0F;
+#else
+  unsigned int  visible = 0x0F;
+  int           i, b;
+
+  for (i = 0; i < 6; i++) {
+    if (pPlaneMask & (1 << i)) {
+      const vec4 *  plane = &pFrustum->planes[i];
+      MATH3D_FLOAT  ax = fabs(plane->x), ay = fabs(plane->y), az = fabs(plane->z);
+
+      for (b = 0; b < 4; b++) {
+        MATH3D_FLOAT distance = (plane->x * pBoxes->cx[b]) + (plane->y * pBoxes->cy[b]) + (plane->z * pBoxes->cz[b]) + plane->w;
+        MATH3D_FLOAT radius = (ax * pBoxes->ex[b]) + (ay * pBoxes->ey[b]) + (az * pBoxes->ez[b]);
+
+        if (distance + radius < 0.0) {
+          // completely behind this plane
+          visible &= ~(1 << b);
+        };
+      };
+    };
+  };
+
+  return visible;
+#endif
+};
+
+#endif /* CULL_IMPLEMENTATION */
+
+#endif /* !cullh */
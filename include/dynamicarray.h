@@ -12,6 +12,8 @@
  *
  * Revision history:
  * 0.1  16-01-2016  First version with basic functions
+ * 0.2  16-10-2026  Grow geometrically, added reserve, clear,
+ *                  bulk push and an unchecked accessor
  *
  ********************************************************/
 
@@ -27,7 +29,7 @@
 
 #define DYNARRAY_NOENTRY      0xffffffff
 #define DYNARRAY_NOMEM        0xfffffffe
-#define DYNARRAY_EXPAND       100
+#define DYNARRAY_EXPAND       100     // minimum number of entries we allocate
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,10 +52,20 @@ extern "C" {
   
 dynarray * newDynArray(unsigned int pEntrySize);
 void dynArrayFree(dynarray * pArray);
+bool dynArrayReserve(dynarray * pArray, unsigned int pSize);
 bool dynArrayCheckSize(dynarray * pArray, unsigned int pMinSize);
+void dynArrayClear(dynarray * pArray);
 unsigned int dynArrayPush(dynarray * pArray, void * pData);
+unsigned int dynArrayPushN(dynarray * pArray, const void * pData, unsigned int pCount);
 void * dynArrayDataAtIndex(dynarray * pArray, unsigned int pIndex);
 void dynArraySort(dynarray * pArray, int (*compar)(const void *, const void *));
+
+// returns a pointer to the entry at that location without any checks, pIndex must be smaller then numEntries
+// use this in tight loops where pIndex is known to be valid, else use dynArrayDataAtIndex
+// mystruct * data = dynArrayItem(myArray, i);
+static inline void * dynArrayItem(const dynarray * pArray, unsigned int pIndex) {
+  return (char *) pArray->data + ((size_t) pIndex * pArray->entrySize);
+};
   
 #ifdef __cplusplus
 };
@@ -92,32 +104,68 @@ void dynArrayFree(dynarray * pArray) {
   free(pArray);
 };
 
-// check if we have enough space in our array
+// make sure our array can hold exactly pSize entries, use this when you know up front how much you'll add
+// dynArrayReserve(myArray, 15000); // make sure we can hold 15000 entries before realloc needs to be called
+bool dynArrayReserve(dynarray * pArray, unsigned int pSize) {
+  void * newData;
+
+  if (pArray == NULL) {
+    return false;
+  } else if ((pArray->data != NULL) && (pArray->maxEntries >= pSize)) {
+    // already large enough
+    return true;
+  } else if (pSize == 0) {
+    // nothing to allocate
+    return pArray->data != NULL;
+  };
+
+  newData = realloc(pArray->data, (size_t) pArray->entrySize * pSize);
+  if (newData == NULL) {
+    // something must have gone wrong!! we leave our array as it was
+    return false;
+  };
+
+  pArray->data = newData;
+  pArray->maxEntries = pSize;
+
+  return true;
+};
+
+// check if we have enough space in our array, if not we grow it by half its size so adding many entries one
+// by one only reallocates our buffer a logarithmic number of times
 // dynArrayCheckSize(myArray, 15); // make sure we can hold 15 entries before realloc needs to be called
 bool dynArrayCheckSize(dynarray * pArray, unsigned int pMinSize) {
+  unsigned int newSize;
+
   if (pArray == NULL) {
     return false;
+  } else if ((pArray->data != NULL) && (pArray->maxEntries >= pMinSize)) {
+    // already large enough
+    return true;
   };
-  
-  if (pArray->data == NULL) {
-    pArray->maxEntries = pMinSize > DYNARRAY_EXPAND ? pMinSize : DYNARRAY_EXPAND;
-    pArray->data = malloc(pArray->entrySize * pArray->maxEntries);
-  } else if (pArray->maxEntries < pMinSize) {
-    pArray->maxEntries += DYNARRAY_EXPAND;
-    if (pArray->maxEntries < pMinSize) {
-      // still not large enough? weird...
-      pArray->maxEntries = pMinSize;
-    };
-    pArray->data = realloc(pArray->data, pArray->entrySize * pArray->maxEntries);
+
+  newSize = pArray->maxEntries + (pArray->maxEntries / 2);
+  if (newSize < pArray->maxEntries) {
+    // overflow, can't grow any further than this
+    newSize = pMinSize;
+  } else if (newSize < DYNARRAY_EXPAND) {
+    newSize = DYNARRAY_EXPAND;
+  };
+  if (newSize < pMinSize) {
+    newSize = pMinSize;
   };
 
-  if (pArray->data == NULL) {
-    // something must have gone wrong!!
-    pArray->numEntries = 0;
-    pArray->maxEntries = 0;
+  return dynArrayReserve(pArray, newSize);
+};
+
+// removes all entries from our array but keeps our buffer so we can refill it without reallocating
+// dynArrayClear(myArray);
+void dynArrayClear(dynarray * pArray) {
+  if (pArray == NULL) {
+    return;
   };
-  
-  return pArray->data != NULL;
+
+  pArray->numEntries = 0;
 };
 
 // adds an entry at the end of our array
@@ -130,12 +178,34 @@ unsigned int dynArrayPush(dynarray * pArray, void * pData) {
   };
 
   // copy our data in place
-  memcpy((char *) pArray->data + (pArray->numEntries * pArray->entrySize), pData, pArray->entrySize);
+  memcpy((char *) pArray->data + ((size_t) pArray->numEntries * pArray->entrySize), pData, pArray->entrySize);
 
   // return and advance
   return pArray->numEntries++;
 };
 
+// adds pCount entries at the end of our array in one go, returns the index of the first entry added
+// dynArrayPushN(myArray, myDataArray, 15);
+unsigned int dynArrayPushN(dynarray * pArray, const void * pData, unsigned int pCount) {
+  unsigned int first;
+
+  if (pArray == NULL) {
+    return DYNARRAY_NOENTRY;
+  } else if (pArray->numEntries + pCount < pArray->numEntries) {
+    // that doesn't fit
+    return DYNARRAY_NOMEM;
+  } else if (!dynArrayCheckSize(pArray, pArray->numEntries + pCount)) {
+    return DYNARRAY_NOMEM;
+  };
+
+  // copy our data in place
+  first = pArray->numEntries;
+  memcpy((char *) pArray->data + ((size_t) first * pArray->entrySize), pData, (size_t) pCount * pArray->entrySize);
+  pArray->numEntries += pCount;
+
+  return first;
+};
+
 // returns a pointer to the entry at that location, it returns NULL if pIndex is out of bounds
 // as this is a pointer to the entry inside of our array you can both retrieve and change the data within our array
 // mystruct * data = dynArrayDataAtIndex(myArray, 15);
@@ -147,7 +217,7 @@ void * dynArrayDataAtIndex(dynarray * pArray, unsigned int pIndex) {
     return NULL;
   };
   
-  return (char *) pArray->data + (pIndex * pArray->entrySize);
+  return (char *) pArray->data + ((size_t) pIndex * pArray->entrySize);
 };
 
 // use qsort to sort our array
@@ -26,13 +26,21 @@
 #include "linkedlist.h"
 #include "varchar.h"
 #include "math3d.h"
+#include "cull.h"
+#include "renderqueue.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "jobs.h"
 #include "texturemap.h"
 #include "shaders.h"
 #include "material.h"
 // #include "tilemap.h"
 // #include "spritesheet.h"
 #include "mesh3d.h"
+#include "heightfield.h"
+#include "terrain.h"
 #include "meshnode.h"
+#include "meshcache.h"
 #include "gbuffer.h"
 
 #include "joysticks.h"
@@ -51,6 +59,7 @@ enum ENG_SHADERS {
   REFLECT_SHADER,
   SOLIDSHADOW_SHADER,
   TEXTURESHADOW_SHADER,
+  HMAPSHADOW_SHADER,
   NUM_SHADERS
 };
 
@@ -62,6 +71,16 @@ typedef void(* EngineError)(int, const char*, ...);
 typedef bool(* EngineKeyPressed)(int);
 
 void engineSetKeyPressedCallback(EngineKeyPressed pCallback);
+void engineSetFrameBuffer(GLuint pFrameBuffer);
+void engineSetShowInfo(bool pShow);
+void engineSetThinGBuffer(bool pThin);
+void engineSetStereo(bool pStereo);
+void engineSetPackedVertices(bool pPacked);
+void engineSetCompressedTextures(bool pCompressed);
+void engineSetShaderCache(bool pCache);
+void engineSetCPUTerrain(bool pCPU);
+void engineSetJobWorkers(int pWorkers);
+bool engineSetCameraPath(const char * pPath);
 void engineInit();
 void engineLoad(bool pHMD);
 void engineUnload();
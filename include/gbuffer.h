@@ -15,6 +15,22 @@
  *
  * Revision history:
  * 0.1  23-04-2016  First version with basic functions
+ * 0.2  16-10-2026  Light info is now loaded through a
+ *                  uniform block
+ * 0.3  16-10-2026  Report draw calls and shadow map
+ *                  rebuilds to our benchmark
+ * 0.4  16-10-2026  Point lights render their shadows into
+ *                  a cube map in a single pass
+ * 0.5  16-10-2026  Cache our static shadow casters and only
+ *                  render our dynamic casters each frame
+ * 0.6  16-10-2026  Added a thin layout that reconstructs our
+ *                  position from our depth buffer
+ * 0.7  16-10-2026  Point lights are binned into clusters and
+ *                  shaded in a single full screen pass
+ * 0.8  16-10-2026  Render both eyes side by side in a
+ *                  single pass for stereo
+ * 0.9  16-10-2026  Shadow casters can be culled as jobs
+ *                  before we render our shadow maps
  *
  ********************************************************/
 
@@ -25,10 +41,21 @@
 #include "math3d.h"
 #include "shaders.h"
 #include "texturemap.h"
+#include "dynamicarray.h"
+#include "cull.h"
 #include "meshnode.h"
+#include "benchmark.h"
 
 #define LIGHTS_MAXSHADOWMAPS 6
 
+// limits of our clustered lighting pass, these must match cluster.inc
+#define LIGHTS_MAXCLUSTERED       128   // maximum number of lights we shade in our clustered pass
+#define LIGHTS_MAXCLUSTERSHADOWS  4     // maximum number of shadow cube maps our clustered pass samples
+#define CLUSTER_TILESX            16    // number of tiles across our screen, must be a multiple of 4
+#define CLUSTER_TILESY            8     // number of tiles down our screen
+#define CLUSTER_SLICES            16    // number of depth slices
+#define CLUSTER_COUNT             (CLUSTER_TILESX * CLUSTER_TILESY * CLUSTER_SLICES)
+
 // enumeration to record what types of buffers we need
 enum GBUFFER_TEXTURE_TYPE {
   GBUFFER_TEXTURE_TYPE_POSITION,  /* Position */
@@ -48,22 +75,36 @@ typedef struct lightShader {
   char              name[50];         // name of the shader
   GLuint            program;          // shader program to use
   GLint             textureUniforms[GBUFFER_NUM_TEXTURES]; // uniforms
-  GLint             projectionId;     // ID of our projection matrix
-  GLint             lightPosId;       // position of our light
-  GLint             lightColId;       // color of our light
+  GLint             depthMapId;       // our depth buffer (thin layout only)
+  GLint             frameBlockId;     // our per frame block (we need our projection matrix)
+  GLint             lightBlockId;     // our light block
   GLint             lightMapId;       // light map
 
-  // local lighting (some good info here : http://ogldev.atspace.co.uk/www/tutorial20/tutorial20.html)
-  GLint             radiusId;         // radius of influence
-  GLint             attConstantId;    // constant attenuation factor
-  GLint             attLinearId;      // linear attenuation factor
-  GLint             attExpId;         // exponential attenuation factor
-
   // data for shadowmaps (max LIGHTS_MAXSHADOWMAPS)
   GLint             shadowMapId[LIGHTS_MAXSHADOWMAPS];   // ID of our shadow maps
-  GLint             shadowMatId[LIGHTS_MAXSHADOWMAPS];   // ID for our shadow matrices
+  GLint             shadowCubeId;     // ID of our shadow cube map
+
+  // data for our clustered pass
+  GLint             clusterBlockId;   // our cluster block
+  GLint             clusterGridId;    // offset and count into our index list for each cluster
+  GLint             clusterIndicesId; // light indices for each cluster
+  GLint             shadowCubesId[LIGHTS_MAXCLUSTERSHADOWS]; // IDs of the shadow cube maps of our clustered lights
 } lightShader;
 
+// std140 layout of our light block, this must match light.inc
+typedef struct lightBlock {
+  mat4              shadowMat[LIGHTS_MAXSHADOWMAPS];     // our shadow matrices with the inverse of our view applied
+  vec3              lightPos;         // position of our light with view matrix applied
+  GLfloat           radius;           // radius of influence
+
+  // local lighting (some good info here : http://ogldev.atspace.co.uk/www/tutorial20/tutorial20.html)
+  vec3              lightCol;         // color of our light
+  GLfloat           attConstant;      // constant attenuation factor
+  GLfloat           attLinear;        // linear attenuation factor
+  GLfloat           attExp;           // exponential attenuation factor
+  vec2              shadowDepth;      // depth terms of the projection of our shadow cube map
+} lightBlock;
+
 // and a structure to hold information about a light
 typedef struct lightSource {
   // standard info
@@ -83,9 +124,57 @@ typedef struct lightSource {
   vec3              shadowPos[LIGHTS_MAXSHADOWMAPS];     // remembering our position point for our shadow map
   vec3              shadowLA[LIGHTS_MAXSHADOWMAPS];      // remembering our lookat point for our shadow map
   texturemap *      shadowMap[LIGHTS_MAXSHADOWMAPS];     // shadowmaps for this light
+  texturemap *      shadowStatic[LIGHTS_MAXSHADOWMAPS];  // our static casters, we copy these into our shadowmaps before adding our dynamic casters
+  bool              shadowDynamic[LIGHTS_MAXSHADOWMAPS]; // do our shadowmaps contain dynamic casters?
   mat4              shadowMat[LIGHTS_MAXSHADOWMAPS];     // view-projection matrices for this light
+  texturemap *      shadowCube;       // shadow cube map (for point lights only)
+  texturemap *      shadowCubeStatic; // our static casters for our shadow cube map
+  vec2              shadowDepth;      // depth terms of the projection we used to render our cube map
+
+  // our shadow casters are culled in views that can be built as jobs before we render our shadow maps
+  bool              shadowPrepared[LIGHTS_MAXSHADOWMAPS];     // have we prepared our shadow maps for this frame?
+  shaderMatrices    shadowMatrices[LIGHTS_MAXSHADOWMAPS];     // matrices we render our shadow maps with
+  renderView *      shadowViews[LIGHTS_MAXSHADOWMAPS][2];     // our static (or all) casters and our dynamic casters
 } lightSource;
 
+// std140 layout of a light in our cluster block, this must match cluster.inc
+typedef struct clusterLight {
+  vec3              lightPos;         // position of our light with view matrix applied
+  GLfloat           radius;           // radius of influence
+  vec3              lightCol;         // color of our light
+  GLint             shadowSlot;       // which of our shadow cube maps belongs to this light, -1 if none
+  vec3              shadowPos;        // position of our light in world space, our shadow cube map is centered on this
+  GLfloat           attConstant;      // constant attenuation factor
+  vec2              shadowDepth;      // depth terms of the projection of our shadow cube map
+  GLfloat           attLinear;        // linear attenuation factor
+  GLfloat           attExp;           // exponential attenuation factor
+} clusterLight;
+
+// std140 layout of our cluster block, this must match cluster.inc
+typedef struct clusterBlock {
+  GLfloat           sliceScale;       // scale and bias that turn the log of our depth into a slice
+  GLfloat           sliceBias;
+  GLint             numLights;        // number of lights in our block
+  GLint             padding;
+  clusterLight      lights[LIGHTS_MAXCLUSTERED];
+} clusterBlock;
+
+// our screen divided into tiles and depth slices with the lights that touch each of them
+typedef struct lightClusters {
+  clusterBlock      block;            // our lights as we load them into our shader
+  lightSource *     shadows[LIGHTS_MAXCLUSTERSHADOWS]; // lights whose shadow cube maps we bind
+  int               numShadows;       // number of shadow cube maps we bind
+  aabb4             boxes[CLUSTER_COUNT / 4]; // bounds of our clusters in view space, 4 tiles in a row at a time
+  GLuint            grid[CLUSTER_COUNT * 2];  // offset and count into our index list for each cluster
+  int               tiles[4];         // first and last tile horizontally and vertically touched by any light
+  dynarray *        hits;             // cluster (shifted by 8 bits) and light index for each light touching a cluster
+  dynarray *        indices;          // our light indices sorted by cluster
+  GLuint            gridBuffer;       // buffer containing our grid
+  GLuint            gridTexture;      // buffer texture through which we read our grid
+  GLuint            indexBuffer;      // buffer containing our indices
+  GLuint            indexTexture;     // buffer texture through which we read our indices
+} lightClusters;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 // gBuffer
 
@@ -93,6 +182,9 @@ typedef struct lightSource {
 typedef struct gBuffer {
   int               width;            // width of this buffer
   int               height;           // height of this buffer
+  bool              thin;             // if true we use our thin layout, we don't store our position and pack our normals
+  bool              barrelDist;       // if true our lighting shaders apply barrel distortion
+  bool              stereo;           // if true we render both eyes side by side in one pass, see stereo.inc
   GLuint            textureIds[GBUFFER_NUM_TEXTURES]; // ids for our textures
   GLuint            depthBufferId;    // ID of our depth texture (if we needed one)  
   GLuint            frameBufferId;    // ID of our framebuffer for render to texture
@@ -100,6 +192,8 @@ typedef struct gBuffer {
   lightShader *     mainPassShader;   // shader to use for our main pass
   lightShader *     pointLightShader; // shader to use for our point lights
   lightShader *     spotLightShader;  // shader to use for ourspot lights
+  lightShader *     clusterShader;    // shader to use for our clustered point lights
+  lightClusters *   clusters;         // our clusters
 } gBuffer;
 
 #ifdef __cplusplus
@@ -117,17 +211,31 @@ lightSource * newLightSource(char * pName, const vec3 * pPosition);
 void lsRetain(lightSource * pLight);
 void lsRelease(lightSource * pLight);
 void lsSetLightMap(lightSource * pLight, texturemap * pMap);
+void lsInvalidateShadows(lightSource * pLight, const aabb * pBox);
+void lsPrepareShadowMapForSun(lightSource * pLight, int pMapIdx, float pSize, const vec3 * pEye, meshNode * pScene);
+void lsPrepareShadowMapsForLight(lightSource * pLight, meshNode * pScene);
 void lsRenderShadowMapForSun(lightSource * pLight, int pMapIdx, int pResolution, float pSize, const vec3 * pEye, meshNode * pScene);
+void lsRenderShadowCubeForLight(lightSource * pLight, int pResolution, meshNode * pScene);
 void lsRenderShadowMapsForLight(lightSource * pLight, int pResolution, meshNode * pScene);
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// clusters
+
+lightClusters * newLightClusters(void);
+void freeLightClusters(lightClusters * pClusters);
+void lcClear(lightClusters * pClusters);
+bool lcAddLight(lightClusters * pClusters, shaderMatrices * pMatrices, lightSource * pLight);
+unsigned int lcBuild(lightClusters * pClusters, shaderMatrices * pMatrices, int pEyes);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 // gBuffer
 
-gBuffer * newGBuffer(bool pBarrelDist);
+gBuffer * newGBuffer(bool pBarrelDist, bool pThin, bool pStereo);
 void freeGBuffer(gBuffer * pBuffer);
 bool gBufferRenderTo(gBuffer * pBuffer, int pWidth, int pHeight);
 void gBufferDoMainPass(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource * pSun);
 void gBufferDoLight(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource * pPointLight);
+void gBufferDoLights(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource ** pLights, int pCount);
 
 #ifdef __cplusplus
 };
@@ -139,7 +247,14 @@ void gBufferDoLight(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource *
 GLint  gBuffer_intFormats[GBUFFER_NUM_TEXTURES] = { GL_RGBA32F, GL_RGBA, GL_RGBA, GL_RGBA, GL_RGBA};
 GLenum gBuffer_formats[GBUFFER_NUM_TEXTURES] = { GL_RGBA, GL_RGBA, GL_RGBA, GL_RGBA, GL_RGBA };
 GLenum gBuffer_types[GBUFFER_NUM_TEXTURES] = { GL_FLOAT, GL_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE };
-GLenum gBuffer_drawBufs[GBUFFER_NUM_TEXTURES] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+int    gBuffer_pixelSizes[GBUFFER_NUM_TEXTURES] = { 16, 4, 4, 4, 4 };
+
+// our thin layout doesn't store our position (0 means we don't use the buffer) and packs our normals into two channels
+GLint  gBuffer_thinIntFormats[GBUFFER_NUM_TEXTURES] = { 0, GL_RG16, GL_RGBA8, GL_RGBA8, GL_RGBA8 };
+GLenum gBuffer_thinFormats[GBUFFER_NUM_TEXTURES] = { GL_RGBA, GL_RG, GL_RGBA, GL_RGBA, GL_RGBA };
+GLenum gBuffer_thinTypes[GBUFFER_NUM_TEXTURES] = { GL_FLOAT, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE };
+int    gBuffer_thinPixelSizes[GBUFFER_NUM_TEXTURES] = { 0, 4, 4, 4, 4 };
+
 char   gBuffer_uniforms[GBUFFER_NUM_TEXTURES][50] = { "worldPos", "normal", "ambient", "diffuse", "specular" };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -149,89 +264,52 @@ char   gBuffer_uniforms[GBUFFER_NUM_TEXTURES][50] = { "worldPos", "normal", "amb
 lightShader * newLightShader(const char * pName, const char * pVertexShader, const char * pFragmentShader, llist * pDefines) {
   lightShader * newShader = malloc(sizeof(lightShader));
   if (newShader != NULL) {
-    GLuint vertexShader = NO_SHADER;
-    GLuint fragmentShader = NO_SHADER;
+    GLenum        types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char *  files[2] = { pVertexShader, pFragmentShader };
 
     strcpy(newShader->name, pName);
-    newShader->program = NO_SHADER;
-
-    vertexShader = shaderLoad(GL_VERTEX_SHADER, pVertexShader, pDefines);
-    fragmentShader = shaderLoad(GL_FRAGMENT_SHADER, pFragmentShader, pDefines);
-
-    if ((vertexShader != NO_SHADER) && (fragmentShader != NO_SHADER)) {
-      newShader->program = shaderLink(2, vertexShader, fragmentShader);
-      if (newShader->program != NO_SHADER) {
-        int i;
-        char uName[250];
-
-        for (i = 0; i < GBUFFER_NUM_TEXTURES; i++) {
-          newShader->textureUniforms[i] = glGetUniformLocation(newShader->program, gBuffer_uniforms[i]);
-          if (newShader->textureUniforms[i] < 0) {
-            // infolog("Unknown uniform %s:%s", newShader->name, gBuffer_uniforms[i]);  // just log it, may not be a problem
-          };
-        };
-
-        newShader->projectionId = glGetUniformLocation(newShader->program, "projection");
-        if (newShader->projectionId < 0) {
-          // infolog("Unknown uniform %s:projection", newShader->name);
-        };
 
-        newShader->lightPosId = glGetUniformLocation(newShader->program, "lightPos");
-        if (newShader->lightPosId < 0) {
-          // infolog("Unknown uniform %s:lightPos", newShader->name);
-        };
+    // load our program from our program cache or compile it
+    newShader->program = shaderBuild(pName, 2, types, files, pDefines);
+    if (newShader->program != NO_SHADER) {
+      int i;
+      char uName[250];
 
-        newShader->lightColId = glGetUniformLocation(newShader->program, "lightCol");
-        if (newShader->lightColId < 0) {
-          // infolog("Unknown uniform %s:lightCol", newShader->name);
+      for (i = 0; i < GBUFFER_NUM_TEXTURES; i++) {
+        newShader->textureUniforms[i] = glGetUniformLocation(newShader->program, gBuffer_uniforms[i]);
+        if (newShader->textureUniforms[i] < 0) {
+          // infolog("Unknown uniform %s:%s", newShader->name, gBuffer_uniforms[i]);  // just log it, may not be a problem
         };
+      };
 
-        newShader->lightMapId = glGetUniformLocation(newShader->program, "lightMap");
-        if (newShader->lightMapId < 0) {
-          infolog("Unknown uniform %s:lightMap", newShader->name);
-        };
+      newShader->depthMapId = glGetUniformLocation(newShader->program, "depthMap");
 
-        newShader->radiusId = glGetUniformLocation(newShader->program, "radius");
-        if (newShader->radiusId < 0) {
-          // infolog("Unknown uniform %s:radius", newShader->name);
-        };
+      newShader->frameBlockId = shaderBindBlock(newShader->program, "frameData", SHADER_FRAMEBLOCK);
+      newShader->lightBlockId = shaderBindBlock(newShader->program, "lightData", SHADER_LIGHTBLOCK);
 
-        newShader->attConstantId = glGetUniformLocation(newShader->program, "attConstant");
-        if (newShader->attConstantId < 0) {
-          // infolog("Unknown uniform %s:attConstant", newShader->name);
-        };
+      newShader->lightMapId = glGetUniformLocation(newShader->program, "lightMap");
+      if (newShader->lightMapId < 0) {
+        infolog("Unknown uniform %s:lightMap", newShader->name);
+      };
 
-        newShader->attLinearId = glGetUniformLocation(newShader->program, "attLinear");
-        if (newShader->attLinearId < 0) {
-          // infolog("Unknown uniform %s:attLinear", newShader->name);
+      for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
+        sprintf(uName, "shadowMap[%d]", i);
+        newShader->shadowMapId[i] = glGetUniformLocation(newShader->program, uName);
+        if (newShader->shadowMapId[i] < 0) {
+          // infolog(newShader->shadowMapId[i], "Unknown uniform %s:%s", newShader->name, uName);
         };
+      };
 
-        newShader->attExpId = glGetUniformLocation(newShader->program, "attExp");
-        if (newShader->attExpId < 0) {
-          // infolog("Unknown uniform %s:attExp", newShader->name);
-        };
+      newShader->shadowCubeId = glGetUniformLocation(newShader->program, "shadowCube");
 
-        for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
-          sprintf(uName, "shadowMap[%d]", i);
-          newShader->shadowMapId[i] = glGetUniformLocation(newShader->program, uName);
-          if (newShader->shadowMapId[i] < 0) {
-            // infolog(newShader->shadowMapId[i], "Unknown uniform %s:%s", newShader->name, uName);
-          };
-          sprintf(uName, "shadowMat[%d]", i);
-          newShader->shadowMatId[i] = glGetUniformLocation(newShader->program, uName);
-          if (newShader->shadowMatId[i] < 0) {
-            // infolog(newShader->shadowMatId[i], "Unknown uniform %s:%s", newShader->name, uName);
-          };
-        };
+      newShader->clusterBlockId = shaderBindBlock(newShader->program, "clusterData", SHADER_CLUSTERBLOCK);
+      newShader->clusterGridId = glGetUniformLocation(newShader->program, "clusterGrid");
+      newShader->clusterIndicesId = glGetUniformLocation(newShader->program, "clusterIndices");
+      for (i = 0; i < LIGHTS_MAXCLUSTERSHADOWS; i++) {
+        sprintf(uName, "shadowCubes[%d]", i);
+        newShader->shadowCubesId[i] = glGetUniformLocation(newShader->program, uName);
       };
     };
-
-    if (vertexShader != NO_SHADER) {
-      glDeleteShader(vertexShader);
-    };
-    if (fragmentShader != NO_SHADER) {
-      glDeleteShader(fragmentShader);
-    };
   };
   return newShader;
 };
@@ -258,8 +336,10 @@ float lightMaxDistance(lightSource * pLight) {
 };
 
 // make a light shader the current shader and load up our uniforms
+// pLight can be NULL for our clustered pass, our lights are then taken from our clusters
 bool lightShaderSelect(lightShader * pShader, gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource * pLight) {
-  int     texture = 0, i;
+  int           texture = 0, i;
+  unsigned int  gen;
 
   if ((pShader == NULL) || (pBuffer == NULL)) {
     return false;
@@ -279,23 +359,16 @@ bool lightShaderSelect(lightShader * pShader, gBuffer * pBuffer, shaderMatrices
     };
   };
 
-  if (pShader->projectionId >= 0) {
-    glUniformMatrix4fv(pShader->projectionId, 1, false, (const GLfloat *) pMatrices->projection.m);
-  };
-
-  // setup the information related to our light source
-  if (pShader->lightPosId >= 0) {
-    mat4ApplyToVec3(&pLight->adjPosition, &pLight->position, &pMatrices->view);
-    glUniform3f(pShader->lightPosId, pLight->adjPosition.x, pLight->adjPosition.y, pLight->adjPosition.z);       
-  };
-
-  if (pShader->lightColId >= 0) {
-    glUniform3f(pShader->lightColId, pLight->lightCol.x, pLight->lightCol.y, pLight->lightCol.z);
+  if (pShader->depthMapId >= 0) {
+    glActiveTexture(GL_TEXTURE0 + texture);
+    glBindTexture(GL_TEXTURE_2D, pBuffer->depthBufferId);
+    glUniform1i(pShader->depthMapId, texture);
+    texture++;
   };
 
   if (pShader->lightMapId >= 0) {
     glActiveTexture(GL_TEXTURE0 + texture);
-    if (pLight->lightMap == NULL) {
+    if ((pLight == NULL) || (pLight->lightMap == NULL)) {
       glBindTexture(GL_TEXTURE_2D, 0);      
     } else {
       glBindTexture(GL_TEXTURE_2D, pLight->lightMap->textureId);      
@@ -304,25 +377,11 @@ bool lightShaderSelect(lightShader * pShader, gBuffer * pBuffer, shaderMatrices
     texture++;   
   };
 
-  // setup the information relate to our light strength
-  if (pShader->radiusId >= 0) {
-    glUniform1f(pShader->radiusId, lightMaxDistance(pLight));
-  };
-  if (pShader->attConstantId >= 0) {
-    glUniform1f(pShader->attConstantId, 0.2);
-  };
-  if (pShader->attLinearId >= 0) {
-    glUniform1f(pShader->attLinearId, 0.4 / (pLight->lightRadius));
-  };
-  if (pShader->attExpId >= 0) {
-    glUniform1f(pShader->attExpId, 0.4 / (pLight->lightRadius * pLight->lightRadius));
-  };
-
   // setup our shadow maps
   for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
     if (pShader->shadowMapId[i] >= 0) {
       glActiveTexture(GL_TEXTURE0 + texture);
-      if (pLight->shadowMap[i] == NULL) {
+      if ((pLight == NULL) || (pLight->shadowMap[i] == NULL)) {
         glBindTexture(GL_TEXTURE_2D, 0);      
       } else {
         glBindTexture(GL_TEXTURE_2D, pLight->shadowMap[i]->textureId);
@@ -330,16 +389,88 @@ bool lightShaderSelect(lightShader * pShader, gBuffer * pBuffer, shaderMatrices
       glUniform1i(pShader->shadowMapId[i], texture); 
       texture++;   
     };
-    if (pShader->shadowMatId[i] >= 0) {
-      mat4 shadowMat;
+  };  
+
+  if (pShader->shadowCubeId >= 0) {
+    glActiveTexture(GL_TEXTURE0 + texture);
+    if ((pLight == NULL) || (pLight->shadowCube == NULL)) {
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    } else {
+      glBindTexture(GL_TEXTURE_CUBE_MAP, pLight->shadowCube->textureId);
+    };
+    glUniform1i(pShader->shadowCubeId, texture);
+    texture++;
+  };
 
-      // as we only have our position in view space we need to apply the inverse of our view
-      mat4Copy(&shadowMat, &(pLight->shadowMat[i]));
-      mat4Multiply(&shadowMat, shdMatGetInvView(pMatrices));
+  // setup our clusters
+  if (pBuffer->clusters != NULL) {
+    if (pShader->clusterGridId >= 0) {
+      glActiveTexture(GL_TEXTURE0 + texture);
+      glBindTexture(GL_TEXTURE_BUFFER, pBuffer->clusters->gridTexture);
+      glUniform1i(pShader->clusterGridId, texture);
+      texture++;
+    };
 
-      glUniformMatrix4fv(pShader->shadowMatId[i], 1, false, (const GLfloat *) shadowMat.m);
+    if (pShader->clusterIndicesId >= 0) {
+      glActiveTexture(GL_TEXTURE0 + texture);
+      glBindTexture(GL_TEXTURE_BUFFER, pBuffer->clusters->indexTexture);
+      glUniform1i(pShader->clusterIndicesId, texture);
+      texture++;
     };
-  };  
+
+    for (i = 0; i < LIGHTS_MAXCLUSTERSHADOWS; i++) {
+      if (pShader->shadowCubesId[i] >= 0) {
+        glActiveTexture(GL_TEXTURE0 + texture);
+        if (i < pBuffer->clusters->numShadows) {
+          glBindTexture(GL_TEXTURE_CUBE_MAP, pBuffer->clusters->shadows[i]->shadowCube->textureId);
+        } else {
+          glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        };
+        glUniform1i(pShader->shadowCubesId[i], texture);
+        texture++;
+      };
+    };
+  };
+
+  // load our light block into our ring buffer and bind our frame block for our projection matrix
+  // if writing one made our ring wrap around, the other needs to be written again
+  do {
+    gen = shaderRingGen;
+
+    if ((pShader->lightBlockId >= 0) && (pLight != NULL)) {
+      lightBlock block;
+
+      memset(&block, 0, sizeof(lightBlock));
+
+      // setup the information related to our light source
+      mat4ApplyToVec3(&pLight->adjPosition, &pLight->position, &pMatrices->view);
+      vec3Copy(&block.lightPos, &pLight->adjPosition);
+      vec3Copy(&block.lightCol, &pLight->lightCol);
+
+      // setup the information relate to our light strength
+      block.radius = lightMaxDistance(pLight);
+      block.attConstant = 0.2;
+      block.attLinear = 0.4 / (pLight->lightRadius);
+      block.attExp = 0.4 / (pLight->lightRadius * pLight->lightRadius);
+      vec2Copy(&block.shadowDepth, &pLight->shadowDepth);
+
+      // as we only have our position in view space we need to apply the inverse of our view to our shadow matrices
+      for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
+        mat4Copy(&block.shadowMat[i], &(pLight->shadowMat[i]));
+        mat4Multiply(&block.shadowMat[i], shdMatGetInvView(pMatrices));
+      };
+
+      shaderRingBind(SHADER_LIGHTBLOCK, shaderRingWrite(&block, sizeof(lightBlock)), sizeof(lightBlock));
+    };
+
+    if ((pShader->clusterBlockId >= 0) && (pBuffer->clusters != NULL)) {
+      shaderRingBind(SHADER_CLUSTERBLOCK, shaderRingWrite(&pBuffer->clusters->block, sizeof(clusterBlock)), sizeof(clusterBlock));
+    };
+
+    if (pShader->frameBlockId >= 0) {
+      shdMatBindFrame(pMatrices);
+    };
+  } while (gen != shaderRingGen);
 
   return true;
 };
@@ -369,8 +500,16 @@ lightSource * newLightSource(char * pName, const vec3 * pPosition) {
       vec3Set(&newLight->shadowPos[i], 0.0, 0.0, 0.0);
       vec3Set(&newLight->shadowLA[i], 0.0, 0.0, 0.0);
       newLight->shadowMap[i] = NULL;
+      newLight->shadowStatic[i] = NULL;
+      newLight->shadowDynamic[i] = false;
       mat4Identity(&newLight->shadowMat[i]);
+      newLight->shadowPrepared[i] = false;
+      newLight->shadowViews[i][0] = NULL;
+      newLight->shadowViews[i][1] = NULL;
     };
+    newLight->shadowCube = NULL;
+    newLight->shadowCubeStatic = NULL;
+    vec2Set(&newLight->shadowDepth, 0.0, 0.0);
   };
   return newLight;
 };
@@ -402,6 +541,27 @@ void lsRelease(lightSource * pLight) {
         tmapRelease(pLight->shadowMap[i]);
         pLight->shadowMap[i] = NULL;
       };
+      if (pLight->shadowStatic[i] != NULL) {
+        tmapRelease(pLight->shadowStatic[i]);
+        pLight->shadowStatic[i] = NULL;
+      };
+      if (pLight->shadowViews[i][0] != NULL) {
+        rviewFree(pLight->shadowViews[i][0]);
+        pLight->shadowViews[i][0] = NULL;
+      };
+      if (pLight->shadowViews[i][1] != NULL) {
+        rviewFree(pLight->shadowViews[i][1]);
+        pLight->shadowViews[i][1] = NULL;
+      };
+    };
+
+    if (pLight->shadowCube != NULL) {
+      tmapRelease(pLight->shadowCube);
+      pLight->shadowCube = NULL;
+    };
+    if (pLight->shadowCubeStatic != NULL) {
+      tmapRelease(pLight->shadowCubeStatic);
+      pLight->shadowCubeStatic = NULL;
     };
 
     free(pLight);
@@ -431,17 +591,216 @@ void lsSetLightMap(lightSource * pLight, texturemap * pMap) {
   };
 };
 
-// render our shadow map
-// note that this likely sets our shadow map FBO and alters our viewport
-// calling code needs to reset it back to what it needs
-void lsRenderShadowMapForSun(lightSource * pLight, int pMapIdx, int pResolution, float pSize, const vec3 * pEye, meshNode * pScene) {
-  vec3 newLookat;
+// mark the shadow maps of our light that contain pBox for rebuilding, call this when a static object within pBox changed
+// pBox must be in world space, dynamic objects don't need this as we render them every frame
+// if pBox is NULL we rebuild all our shadow maps
+// note that our engine only ever passes NULL, nothing static moves in our scene and our texture streaming and terrain
+// chunk changes affect our whole scene, pBox is there for applications that move, add or remove static casters
+void lsInvalidateShadows(lightSource * pLight, const aabb * pBox) {
+  frustum f;
+  int     i;
+
+  if (pLight == NULL) {
+    return;
+  } else if (pBox == NULL) {
+    for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
+      pLight->shadowRebuild[i] = true;
+    };
+  } else if (pLight->type == 1) {
+    mat4  box;
+    vec3  tmpvector;
+    float far = lightMaxDistance(pLight) * 1.5;
+
+    // our cube map covers a box around our light
+    mat4Identity(&box);
+    mat4Ortho(&box, -far, far, -far, far, -far, far);
+    mat4Translate(&box, vec3Set(&tmpvector, -pLight->position.x, -pLight->position.y, -pLight->position.z));
+    frustumFromMatrix(&f, &box);
+    if (frustumTestAABB(&f, pBox, NULL) != CULL_OUTSIDE) {
+      pLight->shadowRebuild[0] = true;
+    };
+  } else {
+    // our shadow matrices hold the view-projection we rendered our shadow maps with
+    for (i = 0; i < LIGHTS_MAXSHADOWMAPS; i++) {
+      if (pLight->shadowMap[i] != NULL) {
+        frustumFromMatrix(&f, &pLight->shadowMat[i]);
+        if (frustumTestAABB(&f, pBox, NULL) != CULL_OUTSIDE) {
+          pLight->shadowRebuild[i] = true;
+        };
+      };
+    };
+  };
+};
+
+// makes our shadow map (or cube map) our render target and sets up our state for rendering shadows
+// note that this sets our shadow map FBO and alters our viewport
+bool lsShadowRenderTo(texturemap * pTMap, int pResolution, bool pCube) {
+  if (pCube) {
+    if (!tmapRenderToShadowCube(pTMap, pResolution)) {
+      return false;
+    };
+  } else if (!tmapRenderToShadowMap(pTMap, pResolution, pResolution)) {
+    return false;
+  };
+
+  // rest our last used material
+  matResetLastUsed();
+
+  // set our viewport
+  glViewport(0, 0, pResolution, pResolution);
+
+  // enable and configure our backface culling, note that here we cull our front facing polygons
+  // to minimize shading artifacts
+  glEnable(GL_CULL_FACE);   // enable culling
+  glFrontFace(GL_CW);       // clockwise
+  glCullFace(GL_FRONT);     // frontface culling
+
+  // enable our depth test
+  glEnable(GL_DEPTH_TEST);  // check our depth
+  glDepthMask(GL_TRUE);     // enable writing to our depth buffer
+
+  // disable alpha blending  
+  glDisable(GL_BLEND);
+
+  // solid polygons
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);    
+
+  return true;
+};
+
+// queue building the casters we need for our shadow map (or cube map) as jobs, pViews holds our views for our static and dynamic casters.
+// This mirrors lsRenderShadowCasters, if nothing in our scene moves we only need our casters when we rebuild,
+// else we need our static casters if we rebuild or haven't got a cache yet and our dynamic casters each frame
+void lsQueueShadowCasters(renderView ** pViews, bool pRebuild, bool pHasStatic, shaderMatrices * pMatrices, meshNode * pScene, float pRadius) {
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    if (pViews[i] == NULL) {
+      pViews[i] = newRenderView();
+    } else {
+      rviewClear(pViews[i]);
+    };
+  };
+
+  if (!meshNodeHasDynamic(pScene)) {
+    if (pRebuild) {
+      rviewQueue(pViews[0], pScene, pMatrices, pRadius, MESHNODE_ALLCASTERS, true);
+    };
+  } else {
+    if (pRebuild || !pHasStatic) {
+      rviewQueue(pViews[0], pScene, pMatrices, pRadius, MESHNODE_STATICCASTERS, true);
+    };
+    rviewQueue(pViews[1], pScene, pMatrices, pRadius, MESHNODE_DYNAMICCASTERS, true);
+  };
+};
+
+// waits for the view holding pCasters, if we didn't queue it up front (or our shadows were invalidated since) we build it now.
+// Returns the number of casters in our view
+unsigned int lsShadowView(renderView ** pView, shaderMatrices * pMatrices, meshNode * pScene, float pRadius, int pCasters) {
+  if (*pView == NULL) {
+    *pView = newRenderView();
+    if (*pView == NULL) {
+      return 0;
+    };
+  };
+
+  rviewWait(*pView);
+  if (((*pView)->queued == false) || ((*pView)->casters != pCasters)) {
+    profBegin("cull");
+    rviewBuild(*pView, pScene, pMatrices, pRadius, pCasters, true);
+    profEnd();
+  };
+
+  return rqueueCount((*pView)->opaque);
+};
+
+// renders our casters into pTarget, if pRadius is larger then 0 we render a cube map of that radius
+// if nothing in our scene moves we only render when pRebuild is true and render straight into pTarget,
+// else we keep our static casters in pStatic (which we create if needed) and only render them when pRebuild is true.
+// Each frame we copy them into pTarget and render our dynamic casters on top, unless no dynamic casters are
+// within our light now or last time, pDynamic remembers if pTarget contains dynamic casters.
+// Our casters are taken from pViews as queued by lsQueueShadowCasters.
+// returns true if we rendered our static casters
+bool lsRenderShadowCasters(texturemap * pTarget, texturemap ** pStatic, bool * pDynamic, bool pRebuild, int pResolution, shaderMatrices * pMatrices, meshNode * pScene, renderView ** pViews, float pRadius) {
+  bool          cube = pRadius > 0.0;
+  bool          rebuilt = false;
+  unsigned int  count;
+
+  if (!meshNodeHasDynamic(pScene)) {
+    // nothing moves, we can keep what we have
+    if (pRebuild && lsShadowRenderTo(pTarget, pResolution, cube)) {
+      glClear(GL_DEPTH_BUFFER_BIT);
+
+      lsShadowView(&pViews[0], pMatrices, pScene, pRadius, MESHNODE_ALLCASTERS);
+      meshNodeShadowRenderView(pViews[0], pMatrices, cube);
+      rebuilt = true;
+    };
+  } else {
+    if (*pStatic == NULL) {
+      // create our cache if we haven't got one already
+      *pStatic = newTextureMap(cube ? "shadowcubestatic" : "shadowmapstatic");
+      pRebuild = true;
+    };
+
+    if (pRebuild && lsShadowRenderTo(*pStatic, pResolution, cube)) {
+      profBegin("static");
+      glClear(GL_DEPTH_BUFFER_BIT);
+
+      lsShadowView(&pViews[0], pMatrices, pScene, pRadius, MESHNODE_STATICCASTERS);
+      meshNodeShadowRenderView(pViews[0], pMatrices, cube);
+      rebuilt = true;
+      profEnd();
+    };
+
+    // find what moves within the reach of our light
+    profBegin("dynamic");
+    count = lsShadowView(&pViews[1], pMatrices, pScene, pRadius, MESHNODE_DYNAMICCASTERS);
+
+    // now start with a copy of our static casters and add what moves
+    if ((count == 0) && (*pDynamic == false) && (rebuilt == false)) {
+      // our shadow map already contains just our static casters
+    } else if (lsShadowRenderTo(pTarget, pResolution, cube)) {
+      if (cube) {
+        tmapCopyShadowCube(pTarget, *pStatic);
+      } else {
+        tmapCopyShadowMap(pTarget, *pStatic);
+      };
+
+      if (count > 0) {
+        meshNodeShadowRenderView(pViews[1], pMatrices, cube);
+      };
+
+      *pDynamic = count > 0;
+    };
+    profEnd();
+  };
+
+  // our scene may change once we're done so make sure nothing is still culling it
+  rviewWait(pViews[0]);
+  rviewWait(pViews[1]);
+
+  // and we're done
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  return rebuilt;
+};
+
+// work out the matrices for our shadow map and queue culling its casters as jobs,
+// call this early in our frame so our casters are culled while we do other work.
+// lsRenderShadowMapForSun calls this itself if we haven't
+void lsPrepareShadowMapForSun(lightSource * pLight, int pMapIdx, float pSize, const vec3 * pEye, meshNode * pScene) {
+  vec3            newLookat;
+  mat4            tmpmatrix;
+  vec3            tmpvector;
+  shaderMatrices *  matrices = &pLight->shadowMatrices[pMapIdx];
 
   if (pLight->type != 0) {
     // this logic only works for directional lights
     return;
   };
 
+  pLight->shadowPrepared[pMapIdx] = true;
+
   // prevent rebuilds if we only move a tiny bit....
   newLookat.x = pEye->x - fmod(pEye->x, pSize/100.0);
   newLookat.y = pEye->y - fmod(pEye->y, pSize/100.0);
@@ -461,101 +820,139 @@ void lsRenderShadowMapForSun(lightSource * pLight, int pMapIdx, int pResolution,
     pLight->shadowMap[pMapIdx] = newTextureMap("shadowmap");
   };
 
-  // we'll initialize a shadow map for our sun
-  if (pLight->shadowRebuild[pMapIdx] == false) {
-    // reuse it as is...
-  } else if (pScene == NULL) {
+  if (pScene == NULL) {
     // nothing to render..
-  } else if (tmapRenderToShadowMap(pLight->shadowMap[pMapIdx], pResolution, pResolution)) {
-    mat4            tmpmatrix;
-    vec3            tmpvector;
-    shaderMatrices  matrices;
+    return;
+  };
 
-    // rest our last used material
-    matResetLastUsed();
+  // need to create our projection matrix first
+  // for our sun we need an orthographic projection as rays of sunlight pretty much are parallel to each other.
+  // if this was a spotlight a perspective projection gives the best result
+  mat4Identity(&tmpmatrix);
+  mat4Ortho(&tmpmatrix, -pSize, pSize, -pSize, pSize, -50000.0, 50000.0);
+  shdMatSetProjection(matrices, &tmpmatrix);
+
+  // We are going to adjust our sun's position based on our camera position.
+  // We position the sun such that our camera location would be at Z = 0.
+  // Our near plane is actually behind our 'sun' which gives us some wiggleroom.
+  // Note that this should result in the same calculations for all 3 shadow maps at this time
+  vec3Copy(&pLight->adjPosition, &pLight->position);
+  vec3Normalise(&pLight->adjPosition);  // normalize our sun position vector
+  vec3Mult(&pLight->adjPosition, 10000.0); // move the sun far enough away
+  vec3Add(&pLight->adjPosition, &pLight->shadowLA[pMapIdx]); // position in relation to our camera
+
+  // Now we can create our view matrix, here we use a lookat matrix from our sun looking towards our camera position.
+  // There is an argument to use our lookat point instead as in worst case scenarios half our of shadowmap could
+  // relate to what is behind our camera but using our lookat point risks not covering enough with our shadowmap.
+  //
+  // Note that for our 'up-vector' we're using an Z-axis aligned vector. This is because our sun will be straight
+  // up at noon and we'd get an unusable view matrix. An Z-axis aligned vector assumes that our sun goes from east
+  // to west along the X/Y axis and the Z of our sun will be 0. Our 'up-vector' thus points due north (or south
+  // depending on your definition).
+  // If you do not align your coordinate system to a compass you'll have to calculate an up-vector that points to your
+  // north or south 
+  mat4Identity(&tmpmatrix);
+  mat4LookAt(&tmpmatrix, &pLight->adjPosition, &pLight->shadowLA[pMapIdx], vec3Set(&tmpvector, 0.0, 0.0, 1.0));
+  shdMatSetView(matrices, &tmpmatrix);
+
+  // now we override our eye position to be at our camera position, this is important for our LOD calculations
+  shdMatSetEyePos(matrices, &pLight->shadowLA[pMapIdx]);
+
+  // and start culling the casters we'll need
+  lsQueueShadowCasters(pLight->shadowViews[pMapIdx], pLight->shadowRebuild[pMapIdx], pLight->shadowStatic[pMapIdx] != NULL, matrices, pScene, 0.0);
+};
 
-    // set our viewport
-    glViewport(0, 0, pResolution, pResolution);
+// render our shadow map
+// note that this likely sets our shadow map FBO and alters our viewport
+// calling code needs to reset it back to what it needs
+void lsRenderShadowMapForSun(lightSource * pLight, int pMapIdx, int pResolution, float pSize, const vec3 * pEye, meshNode * pScene) {
+  if (pLight->type != 0) {
+    // this logic only works for directional lights
+    return;
+  };
 
-    // enable and configure our backface culling, note that here we cull our front facing polygons
-    // to minimize shading artifacts
-    glEnable(GL_CULL_FACE);   // enable culling
-    glFrontFace(GL_CW);       // clockwise
-    glCullFace(GL_FRONT);     // frontface culling
+  if (!pLight->shadowPrepared[pMapIdx]) {
+    lsPrepareShadowMapForSun(pLight, pMapIdx, pSize, pEye, pScene);
+  };
+  pLight->shadowPrepared[pMapIdx] = false;
 
-    // enable our depth test
-    glEnable(GL_DEPTH_TEST);  // check our depth
-    glDepthMask(GL_TRUE);     // enable writing to our depth buffer
+  if (pScene == NULL) {
+    // nothing to render..
+    return;
+  };
 
-    // disable alpha blending  
-    glDisable(GL_BLEND);
+  // and now render our scene for shadow maps (note that we only render materials that have a shadow shader and we ignore transparent objects)
+  // our static casters are only rendered if our snapped position changed
+  if (lsRenderShadowCasters(pLight->shadowMap[pMapIdx], &pLight->shadowStatic[pMapIdx], &pLight->shadowDynamic[pMapIdx], pLight->shadowRebuild[pMapIdx], pResolution, &pLight->shadowMatrices[pMapIdx], pScene, pLight->shadowViews[pMapIdx], 0.0)) {
+    // now remember our view-projection matrix, we need it later on when rendering our scene
+    mat4Copy(&pLight->shadowMat[pMapIdx], shdMatGetViewProjection(&pLight->shadowMatrices[pMapIdx]));
 
-    // solid polygons
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);    
+    // we can keep it.
+    pLight->shadowRebuild[pMapIdx] = false;
+    benchCountShadowRebuild();
+  };
+};
 
-    // clear our depth buffer
-    glClear(GL_DEPTH_BUFFER_BIT);      
+// work out the matrices for our point light shadow cube map and queue culling its casters as jobs
+void lsPrepareShadowCubeForLight(lightSource * pLight, meshNode * pScene) {
+  mat4            tmpmatrix;
+  vec3            tmpvector;
+  shaderMatrices *  matrices = &pLight->shadowMatrices[0];
+  float           far = lightMaxDistance(pLight) * 1.5;
 
-    // need to create our projection matrix first
-    // for our sun we need an orthographic projection as rays of sunlight pretty much are parallel to each other.
-    // if this was a spotlight a perspective projection gives the best result
-    mat4Identity(&tmpmatrix);
-    mat4Ortho(&tmpmatrix, -pSize, pSize, -pSize, pSize, -50000.0, 50000.0);
-    shdMatSetProjection(&matrices, &tmpmatrix);
-
-    // We are going to adjust our sun's position based on our camera position.
-    // We position the sun such that our camera location would be at Z = 0.
-    // Our near plane is actually behind our 'sun' which gives us some wiggleroom.
-    // Note that this should result in the same calculations for all 3 shadow maps at this time
-    vec3Copy(&pLight->adjPosition, &pLight->position);
-    vec3Normalise(&pLight->adjPosition);  // normalize our sun position vector
-    vec3Mult(&pLight->adjPosition, 10000.0); // move the sun far enough away
-    vec3Add(&pLight->adjPosition, &pLight->shadowLA[pMapIdx]); // position in relation to our camera
-
-    // Now we can create our view matrix, here we use a lookat matrix from our sun looking towards our camera position.
-    // There is an argument to use our lookat point instead as in worst case scenarios half our of shadowmap could
-    // relate to what is behind our camera but using our lookat point risks not covering enough with our shadowmap.
-    //
-    // Note that for our 'up-vector' we're using an Z-axis aligned vector. This is because our sun will be straight
-    // up at noon and we'd get an unusable view matrix. An Z-axis aligned vector assumes that our sun goes from east
-    // to west along the X/Y axis and the Z of our sun will be 0. Our 'up-vector' thus points due north (or south
-    // depending on your definition).
-    // If you do not align your coordinate system to a compass you'll have to calculate an up-vector that points to your
-    // north or south 
-    mat4Identity(&tmpmatrix);
-    mat4LookAt(&tmpmatrix, &pLight->adjPosition, &pLight->shadowLA[pMapIdx], vec3Set(&tmpvector, 0.0, 0.0, 1.0));
-    shdMatSetView(&matrices, &tmpmatrix);
+  pLight->shadowPrepared[0] = true;
 
-    // now we override our eye position to be at our camera position, this is important for our LOD calculations
-    shdMatSetEyePos(&matrices, &pLight->shadowLA[pMapIdx]);
+  if (pLight->shadowCube == NULL) {
+    // create our cube map if we haven't got one already
+    pLight->shadowCube = newTextureMap("shadowcube");
+  };
 
-    // and now render our scene for shadow maps (note that we only render materials that have a shadow shader and we ignore transparent objects)
-    meshNodeShadowMap(pScene, &matrices);    
+  // set the projection of a single face, our geometry shader rotates our view towards each face
+  mat4Identity(&tmpmatrix);
+  mat4Projection(&tmpmatrix, 90.0, 1.0, 1.0, far);
+  shdMatSetProjection(matrices, &tmpmatrix); // call our set function to reset our flags
 
-    // now remember our view-projection matrix, we need it later on when rendering our scene
-    mat4Copy(&pLight->shadowMat[pMapIdx], shdMatGetViewProjection(&matrices));
+  // our lighting shader needs our depth terms to compare its distance with our cube map
+  vec2Set(&pLight->shadowDepth, tmpmatrix.m[2][2], tmpmatrix.m[3][2]);
 
-    // we can keep it.
-    pLight->shadowRebuild[pMapIdx] = false;
+  // our view just moves our light to the origin
+  mat4Identity(&tmpmatrix);
+  mat4Translate(&tmpmatrix, vec3Set(&tmpvector, -pLight->position.x, -pLight->position.y, -pLight->position.z));
+  shdMatSetView(matrices, &tmpmatrix);
+
+  // our lighting shader uses this to get the direction from our light to what we're lighting
+  mat4Copy(&pLight->shadowMat[0], &tmpmatrix);
 
-    // and we're done
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  // and start culling the casters we'll need
+  if (pScene != NULL) {
+    lsQueueShadowCasters(pLight->shadowViews[0], pLight->shadowRebuild[0], pLight->shadowCubeStatic != NULL, matrices, pScene, far);
   };
 };
 
-void lsRenderShadowMapsForLight(lightSource * pLight, int pResolution, meshNode * pScene) {
-  int i;
+// render our point light shadows into a cube map, we submit our scene once and our layered shadow shaders
+// render each triangle to the faces of our cube it is visible in
+void lsRenderShadowCubeForLight(lightSource * pLight, int pResolution, meshNode * pScene) {
+  if (!pLight->shadowPrepared[0]) {
+    lsPrepareShadowCubeForLight(pLight, pScene);
+  };
+  pLight->shadowPrepared[0] = false;
+
+  if (pScene == NULL) {
+    // nothing to render..
+    return;
+  };
 
-  // our point light need lookats set
-  vec3 lookats[] = {
-       0.0, -100.0,    0.0, 
-     100.0,    0.0,    0.0, 
-    -100.0,    0.0,    0.0, 
-       0.0,  100.0,    0.0, 
-       0.0,    0.0,  100.0, 
-       0.0,    0.0, -100.0, 
+  // and render
+  if (lsRenderShadowCasters(pLight->shadowCube, &pLight->shadowCubeStatic, &pLight->shadowDynamic[0], pLight->shadowRebuild[0], pResolution, &pLight->shadowMatrices[0], pScene, pLight->shadowViews[0], lightMaxDistance(pLight) * 1.5)) {
+    // we can keep it.
+    pLight->shadowRebuild[0] = false;
+    benchCountShadowRebuild();
   };
+};
 
+// work out the matrices for the shadow maps of our light and queue culling their casters as jobs,
+// lsRenderShadowMapsForLight calls this itself if we haven't
+void lsPrepareShadowMapsForLight(lightSource * pLight, meshNode * pScene) {
   if (pLight->type == 0) {
     // this logic doesn't work for directional lights
     return;
@@ -572,86 +969,367 @@ void lsRenderShadowMapsForLight(lightSource * pLight, int pResolution, meshNode
     pLight->shadowRebuild[0] = true;
   };
 
+  if (pLight->type == 1) {
+    // point lights render into a cube map
+    lsPrepareShadowCubeForLight(pLight, pScene);
+  } else {
+    mat4            tmpmatrix;
+    vec3            tmpvector, lookat;
+    shaderMatrices *  matrices = &pLight->shadowMatrices[0];
+
+    pLight->shadowPrepared[0] = true;
+
+    if (pLight->shadowMap[0] == NULL) {
+      // create our shadow map if we haven't got one already
+      pLight->shadowMap[0] = newTextureMap("shadowmap");
+    };
+
+    // set our projection
+    mat4Identity(&tmpmatrix);
+    mat4Projection(&tmpmatrix, pLight->lightAngle, 1.0, 1.0, lightMaxDistance(pLight) * 1.5);
+    shdMatSetProjection(matrices, &tmpmatrix); // call our set function to reset our flags
+
+    // now make a view based on our light position
+    mat4Identity(&tmpmatrix);
+    vec3Copy(&lookat, &pLight->position);
+    vec3Add(&lookat, &pLight->lookat);
+    mat4LookAt(&tmpmatrix, &pLight->position, &lookat, vec3Set(&tmpvector, 0.0, 1.0, 0.0));
+    shdMatSetView(matrices, &tmpmatrix);
+
+    // and start culling the casters we'll need
+    if (pScene != NULL) {
+      lsQueueShadowCasters(pLight->shadowViews[0], pLight->shadowRebuild[0], pLight->shadowStatic[0] != NULL, matrices, pScene, 0.0);
+    };
+  };
+};
+
+void lsRenderShadowMapsForLight(lightSource * pLight, int pResolution, meshNode * pScene) {
+  if (pLight->type == 0) {
+    // this logic doesn't work for directional lights
+    return;
+  };
+
+  if (!pLight->shadowPrepared[0]) {
+    lsPrepareShadowMapsForLight(pLight, pScene);
+  };
+
   // we'll initialize our shadow maps for our light
-  if (pLight->shadowRebuild[0] == false) {
-    // reuse it as is...
-  } else if (pScene == NULL) {
+  if (pScene == NULL) {
     // nothing to render..
+  } else if (pLight->type == 1) {
+    // point lights render into a cube map
+    lsRenderShadowCubeForLight(pLight, pResolution, pScene);
+  } else if (lsRenderShadowCasters(pLight->shadowMap[0], &pLight->shadowStatic[0], &pLight->shadowDynamic[0], pLight->shadowRebuild[0], pResolution, &pLight->shadowMatrices[0], pScene, pLight->shadowViews[0], 0.0)) {
+    // now remember our view-projection matrix, we need it later on when rendering our scene
+    mat4Copy(&pLight->shadowMat[0], shdMatGetViewProjection(&pLight->shadowMatrices[0]));
+
+    // we can keep it.
+    pLight->shadowRebuild[0] = false;
+    benchCountShadowRebuild();
+  };
+
+  pLight->shadowPrepared[0] = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// clusters
+
+// create a new set of clusters, we fill these each frame
+lightClusters * newLightClusters(void) {
+  lightClusters * newClusters = malloc(sizeof(lightClusters));
+  if (newClusters != NULL) {
+    memset(&newClusters->block, 0, sizeof(clusterBlock));
+    memset(newClusters->grid, 0, sizeof(newClusters->grid));
+    newClusters->numShadows = 0;
+    newClusters->hits = newDynArray(sizeof(unsigned int));
+    newClusters->indices = newDynArray(sizeof(unsigned char));
+
+    // create our buffers and the buffer textures through which our shader reads them
+    glGenBuffers(1, &newClusters->gridBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, newClusters->gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(newClusters->grid), newClusters->grid, GL_STREAM_DRAW);
+    glGenTextures(1, &newClusters->gridTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, newClusters->gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, newClusters->gridBuffer);
+
+    glGenBuffers(1, &newClusters->indexBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, newClusters->indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, LIGHTS_MAXCLUSTERED, NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &newClusters->indexTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, newClusters->indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, newClusters->indexBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  };
+  return newClusters;
+};
+
+// free up all resources related to our clusters
+void freeLightClusters(lightClusters * pClusters) {
+  if (pClusters == NULL) {
+    return;
+  };
+
+  glDeleteTextures(1, &pClusters->gridTexture);
+  glDeleteBuffers(1, &pClusters->gridBuffer);
+  glDeleteTextures(1, &pClusters->indexTexture);
+  glDeleteBuffers(1, &pClusters->indexBuffer);
+
+  dynArrayFree(pClusters->hits);
+  dynArrayFree(pClusters->indices);
+
+  free(pClusters);
+};
+
+// remove all lights from our clusters, call this at the start of each frame
+void lcClear(lightClusters * pClusters) {
+  pClusters->block.numLights = 0;
+  pClusters->numShadows = 0;
+};
+
+// add a light to our clusters, returns false if we can't shade this light in our clustered pass
+// this can be because it isn't a point light or because we've run out of room
+bool lcAddLight(lightClusters * pClusters, shaderMatrices * pMatrices, lightSource * pLight) {
+  clusterLight * light;
+
+  if (pLight->type != 1) {
+    // we only do point lights
+    return false;
+  } else if (pClusters->block.numLights == LIGHTS_MAXCLUSTERED) {
+    return false;
+  } else if ((pLight->shadowCube != NULL) && (pClusters->numShadows == LIGHTS_MAXCLUSTERSHADOWS)) {
+    return false;
+  };
+
+  mat4ApplyToVec3(&pLight->adjPosition, &pLight->position, &pMatrices->view);
+  if (pLight->adjPosition.z > lightMaxDistance(pLight)) {
+    // this light is behind us, nothing to do
+    return true;
+  };
+
+  light = &pClusters->block.lights[pClusters->block.numLights++];
+
+  // setup the information related to our light source
+  vec3Copy(&light->lightPos, &pLight->adjPosition);
+  vec3Copy(&light->lightCol, &pLight->lightCol);
+  vec3Copy(&light->shadowPos, &pLight->position);
+  vec2Copy(&light->shadowDepth, &pLight->shadowDepth);
+
+  // setup the information relate to our light strength
+  light->radius = lightMaxDistance(pLight);
+  light->attConstant = 0.2;
+  light->attLinear = 0.4 / (pLight->lightRadius);
+  light->attExp = 0.4 / (pLight->lightRadius * pLight->lightRadius);
+
+  // and claim a shadow cube map slot
+  if (pLight->shadowCube != NULL) {
+    light->shadowSlot = pClusters->numShadows;
+    pClusters->shadows[pClusters->numShadows++] = pLight;
   } else {
-    int numMaps = pLight->type == 1 ? 6 : 1;
-    for (i = 0; i < numMaps; i++) {
-      if (pLight->shadowMap[i] == NULL) {
-        // create our shadow map if we haven't got one already
-        pLight->shadowMap[i] = newTextureMap("shadowmap");
-      };
+    light->shadowSlot = -1;
+  };
+
+  return true;
+};
 
-      if (tmapRenderToShadowMap(pLight->shadowMap[i], pResolution, pResolution)) {
-        mat4            tmpmatrix;
-        vec3            tmpvector, lookat;
-        shaderMatrices  matrices;
+// get the depth slice for a distance from our camera
+int lcSlice(lightClusters * pClusters, float pDepth) {
+  int slice = (int) floorf((logf(pDepth) * pClusters->block.sliceScale) + pClusters->block.sliceBias);
 
-        // rest our last used material
-        matResetLastUsed();
+  return slice < 0 ? 0 : (slice >= CLUSTER_SLICES ? CLUSTER_SLICES - 1 : slice);
+};
 
-        // set our viewport
-        glViewport(0, 0, pResolution, pResolution);
+// get the tile for a coordinate in normalized device coordinates
+int lcTile(float pCoord, int pTiles) {
+  int tile = (int) floorf((pCoord + 1.0) * 0.5 * pTiles);
 
-        // enable and configure our backface culling, note that here we cull our front facing polygons
-        // to minimize shading artifacts
-        glEnable(GL_CULL_FACE);   // enable culling
-        glFrontFace(GL_CW);       // clockwise
-        glCullFace(GL_FRONT);     // frontface culling
+  return tile < 0 ? 0 : (tile >= pTiles ? pTiles - 1 : tile);
+};
+
+// bin the lights we've added into our clusters and load the result into our buffers
+// pEyes is 2 if we're rendering both eyes in one pass, our clusters then cover the same part of each eye
+// returns the number of light/cluster pairs we've found, if 0 there is nothing to render
+unsigned int lcBuild(lightClusters * pClusters, shaderMatrices * pMatrices, int pEyes) {
+  float         near, far;
+  float         depths[CLUSTER_SLICES + 1];
+  unsigned int  i, hit, offset, numHits;
+  unsigned char * indices;
+  int           l, s, tx, ty, b, e;
+
+  // our near plane follows from our projection (our eyes share it), our far plane is the furthest any of our lights reach
+  near = pMatrices->eyeProjection[0].m[3][2] / (pMatrices->eyeProjection[0].m[2][2] - 1.0);
+  far = near * 2.0;
+  for (l = 0; l < pClusters->block.numLights; l++) {
+    far = fmax(far, pClusters->block.lights[l].radius - pClusters->block.lights[l].lightPos.z);
+  };
 
-        // enable our depth test
-        glEnable(GL_DEPTH_TEST);  // check our depth
-        glDepthMask(GL_TRUE);     // enable writing to our depth buffer
+  // our slices are spaced logarithmically so each is roughly as deep as it is wide
+  pClusters->block.sliceScale = CLUSTER_SLICES / logf(far / near);
+  pClusters->block.sliceBias = -logf(near) * pClusters->block.sliceScale;
+  for (s = 0; s <= CLUSTER_SLICES; s++) {
+    depths[s] = near * powf(far / near, (float) s / CLUSTER_SLICES);
+  };
 
-        // disable alpha blending  
-        glDisable(GL_BLEND);
+  // calculate the bounds of our clusters, our tiles widen linearly with depth so the corners
+  // at the front and back of each slice give us our bounds, in stereo our bounds contain the cluster for both eyes
+  for (s = 0; s < CLUSTER_SLICES; s++) {
+    for (ty = 0; ty < CLUSTER_TILESY; ty++) {
+      aabb4 * boxes = &pClusters->boxes[((s * CLUSTER_TILESY) + ty) * (CLUSTER_TILESX / 4)];
+
+      for (tx = 0; tx < CLUSTER_TILESX; tx++) {
+        float minX = 1.0e10, maxX = -1.0e10, minY = 1.0e10, maxY = -1.0e10;
+        aabb4 * box = &boxes[tx / 4];
+
+        for (e = 0; e < pEyes; e++) {
+          const mat4 * P = &pMatrices->eyeProjection[e];
+          float x0 = -1.0 + (2.0 * tx / CLUSTER_TILESX) + P->m[2][0];
+          float x1 = -1.0 + (2.0 * (tx + 1) / CLUSTER_TILESX) + P->m[2][0];
+          float y0 = -1.0 + (2.0 * ty / CLUSTER_TILESY) + P->m[2][1];
+          float y1 = -1.0 + (2.0 * (ty + 1) / CLUSTER_TILESY) + P->m[2][1];
+
+          minX = fmin(minX, (fmin(fmin(depths[s] * x0, depths[s + 1] * x0), fmin(depths[s] * x1, depths[s + 1] * x1)) - P->m[3][0]) / P->m[0][0]);
+          maxX = fmax(maxX, (fmax(fmax(depths[s] * x0, depths[s + 1] * x0), fmax(depths[s] * x1, depths[s + 1] * x1)) - P->m[3][0]) / P->m[0][0]);
+          minY = fmin(minY, (fmin(fmin(depths[s] * y0, depths[s + 1] * y0), fmin(depths[s] * y1, depths[s + 1] * y1)) - P->m[3][1]) / P->m[1][1]);
+          maxY = fmax(maxY, (fmax(fmax(depths[s] * y0, depths[s + 1] * y0), fmax(depths[s] * y1, depths[s + 1] * y1)) - P->m[3][1]) / P->m[1][1]);
+        };
 
-        // solid polygons
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);    
+        box->cx[tx % 4] = (minX + maxX) * 0.5;
+        box->cy[tx % 4] = (minY + maxY) * 0.5;
+        box->cz[tx % 4] = -(depths[s] + depths[s + 1]) * 0.5;
+        box->ex[tx % 4] = (maxX - minX) * 0.5;
+        box->ey[tx % 4] = (maxY - minY) * 0.5;
+        box->ez[tx % 4] = (depths[s + 1] - depths[s]) * 0.5;
+      };
+    };
+  };
 
-        // clear our depth buffer
-        glClear(GL_DEPTH_BUFFER_BIT);      
+  // now find the clusters each light touches, we first find the range of clusters its bounding box covers
+  // and then test 4 clusters in a row at a time against its sphere
+  dynArrayClear(pClusters->hits);
+  memset(pClusters->grid, 0, sizeof(pClusters->grid));
+  pClusters->tiles[0] = CLUSTER_TILESX;
+  pClusters->tiles[1] = CLUSTER_TILESY;
+  pClusters->tiles[2] = -1;
+  pClusters->tiles[3] = -1;
+  for (l = 0; l < pClusters->block.numLights; l++) {
+    const clusterLight *  light = &pClusters->block.lights[l];
+    float                 depth = -light->lightPos.z;
+    int                   s0, s1, tx0, tx1, ty0, ty1;
+
+    if (depth + light->radius < near) {
+      // in front of our near plane
+      continue;
+    };
 
-        // set our projection
-        mat4Identity(&tmpmatrix);
-        mat4Projection(&tmpmatrix, pLight->type == 1 ? 90.0 : pLight->lightAngle, 1.0, 1.0, lightMaxDistance(pLight) * 1.5);
-        shdMatSetProjection(&matrices, &tmpmatrix); // call our set function to reset our flags
+    s0 = lcSlice(pClusters, fmax(depth - light->radius, near));
+    s1 = lcSlice(pClusters, depth + light->radius);
 
-        // now make a view based on our light position
-        mat4Identity(&tmpmatrix);
-        vec3Copy(&lookat, &pLight->position);
-        if (pLight->type == 1) {
-          vec3Add(&lookat, &lookats[i]);
-        } else if (pLight->type == 2) {
-          vec3Add(&lookat, &pLight->lookat);
+    if (depth - light->radius <= near) {
+      // our light surrounds our near plane, it can touch any tile
+      tx0 = 0;
+      tx1 = CLUSTER_TILESX - 1;
+      ty0 = 0;
+      ty1 = CLUSTER_TILESY - 1;
+    } else {
+      float minX = 1.0e10, maxX = -1.0e10, minY = 1.0e10, maxY = -1.0e10;
+
+      // project the corners of the box around our light, in stereo we take the tiles touched in either eye
+      for (e = 0; e < pEyes; e++) {
+        const mat4 * P = &pMatrices->eyeProjection[e];
+
+        for (i = 0; i < 8; i++) {
+          float cx = light->lightPos.x + ((i & 1) ? light->radius : -light->radius);
+          float cy = light->lightPos.y + ((i & 2) ? light->radius : -light->radius);
+          float cz = light->lightPos.z + ((i & 4) ? light->radius : -light->radius);
+          float w = (P->m[0][3] * cx) + (P->m[1][3] * cy) + (P->m[2][3] * cz) + P->m[3][3];
+          float x = ((P->m[0][0] * cx) + (P->m[1][0] * cy) + (P->m[2][0] * cz) + P->m[3][0]) / w;
+          float y = ((P->m[0][1] * cx) + (P->m[1][1] * cy) + (P->m[2][1] * cz) + P->m[3][1]) / w;
+
+          minX = fmin(minX, x);
+          maxX = fmax(maxX, x);
+          minY = fmin(minY, y);
+          maxY = fmax(maxY, y);
         };
-        mat4LookAt(&tmpmatrix, &pLight->position, &lookat, vec3Set(&tmpvector, 0.0, 1.0, 0.0));
-        shdMatSetView(&matrices, &tmpmatrix);
+      };
+
+      if ((maxX < -1.0) || (minX > 1.0) || (maxY < -1.0) || (minY > 1.0)) {
+        // off screen
+        continue;
+      };
 
-        // and render
-        meshNodeShadowMap(pScene, &matrices);
+      tx0 = lcTile(minX, CLUSTER_TILESX);
+      tx1 = lcTile(maxX, CLUSTER_TILESX);
+      ty0 = lcTile(minY, CLUSTER_TILESY);
+      ty1 = lcTile(maxY, CLUSTER_TILESY);
+    };
+
+    for (s = s0; s <= s1; s++) {
+      for (ty = ty0; ty <= ty1; ty++) {
+        int row = ((s * CLUSTER_TILESY) + ty) * CLUSTER_TILESX;
 
-        // now remember our view-projection matrix, we need it later on when rendering our scene
-        mat4Copy(&pLight->shadowMat[i], shdMatGetViewProjection(&matrices));
+        for (tx = tx0 & ~3; tx <= tx1; tx += 4) {
+          unsigned int touches = aabb4TestSphere(&pClusters->boxes[(row + tx) / 4], &light->lightPos, light->radius);
 
-        // we can keep it.
-        pLight->shadowRebuild[i] = false;
+          for (b = 0; b < 4; b++) {
+            if ((touches & (1 << b)) && (tx + b >= tx0) && (tx + b <= tx1)) {
+              hit = ((row + tx + b) << 8) | l;
+              dynArrayPush(pClusters->hits, &hit);
+              pClusters->grid[((row + tx + b) * 2) + 1]++;
 
-        // and we're done
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+              pClusters->tiles[0] = tx + b < pClusters->tiles[0] ? tx + b : pClusters->tiles[0];
+              pClusters->tiles[1] = ty < pClusters->tiles[1] ? ty : pClusters->tiles[1];
+              pClusters->tiles[2] = tx + b > pClusters->tiles[2] ? tx + b : pClusters->tiles[2];
+              pClusters->tiles[3] = ty > pClusters->tiles[3] ? ty : pClusters->tiles[3];
+            };
+          };
+        };
       };
     };
   };
+
+  // turn our counts into offsets
+  numHits = pClusters->hits->numEntries;
+  offset = 0;
+  for (i = 0; i < CLUSTER_COUNT; i++) {
+    pClusters->grid[i * 2] = offset;
+    offset += pClusters->grid[(i * 2) + 1];
+    pClusters->grid[(i * 2) + 1] = 0;
+  };
+
+  // and sort our light indices by cluster, as we added our hits light by light each list remains in light order
+  if (!dynArrayReserve(pClusters->indices, numHits > 0 ? numHits : 1)) {
+    errorlog(-1, "Couldn't allocate memory for our light clusters");
+    return 0;
+  };
+  indices = (unsigned char *) pClusters->indices->data;
+  for (i = 0; i < numHits; i++) {
+    unsigned int cluster;
+
+    hit = *((unsigned int *) dynArrayItem(pClusters->hits, i));
+    cluster = hit >> 8;
+    indices[pClusters->grid[cluster * 2] + pClusters->grid[(cluster * 2) + 1]] = hit & 0xFF;
+    pClusters->grid[(cluster * 2) + 1]++;
+  };
+  pClusters->indices->numEntries = numHits;
+
+  // load into our buffers
+  glBindBuffer(GL_TEXTURE_BUFFER, pClusters->gridBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(pClusters->grid), pClusters->grid, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, pClusters->indexBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, numHits > 0 ? numHits : 1, indices, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  return numHits;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 // gBuffer
 
-// create a new geometry buffer
-gBuffer * newGBuffer(bool pBarrelDist) {
+// create a new geometry buffer, if pThin is true we use our thin layout
+// note that our material shaders need to be loaded with the same layout, see outputs.fs
+// if pStereo is true we render both eyes into one buffer, our material shaders then need the stereo define as well
+gBuffer * newGBuffer(bool pBarrelDist, bool pThin, bool pStereo) {
   gBuffer * newBuffer = malloc(sizeof(gBuffer));
   if (newBuffer != NULL) {
     llist * defines = newVarcharList();
@@ -659,6 +1337,9 @@ gBuffer * newGBuffer(bool pBarrelDist) {
     // we create our texture object but do not initialize anything until a size is known
     newBuffer->width = 0;
     newBuffer->height = 0;
+    newBuffer->thin = pThin;
+    newBuffer->barrelDist = pBarrelDist;
+    newBuffer->stereo = pStereo;
     glGenTextures(GBUFFER_NUM_TEXTURES, newBuffer->textureIds);
     glGenTextures(1, &newBuffer->depthBufferId);
 
@@ -668,10 +1349,18 @@ gBuffer * newGBuffer(bool pBarrelDist) {
     if (pBarrelDist) {
       vclistAddString(defines, "barreldist");
     };
+    if (pThin) {
+      vclistAddString(defines, "thingbuffer");
+    };
+    if (pStereo) {
+      vclistAddString(defines, "stereo");
+    };
 
     newBuffer->mainPassShader = newLightShader("geomainpass", "geomainpass.vs", "geomainpass.fs", defines);
     newBuffer->pointLightShader = newLightShader("geopointlight", "geopointlight.vs", "geopointlight.fs", defines);
     newBuffer->spotLightShader = newLightShader("geospotlight", "geospotlight.vs", "geospotlight.fs", defines);
+    newBuffer->clusterShader = newLightShader("geoclustered", "geomainpass.vs", "geoclustered.fs", defines);
+    newBuffer->clusters = newLightClusters();
 
     // no longer need our defines
     if (defines != NULL) {
@@ -697,6 +1386,16 @@ void freeGBuffer(gBuffer * pBuffer) {
     pBuffer->mainPassShader = NULL;
   };
 
+  if (pBuffer->clusterShader != NULL) {
+    freeLightShader(pBuffer->clusterShader);
+    pBuffer->clusterShader = NULL;
+  };
+
+  if (pBuffer->clusters != NULL) {
+    freeLightClusters(pBuffer->clusters);
+    pBuffer->clusters = NULL;
+  };
+
   if (pBuffer->VAO != GL_UNDEF_OBJ) {
     glDeleteVertexArrays(1, &(pBuffer->VAO));    
     pBuffer->VAO = GL_UNDEF_OBJ;
@@ -726,8 +1425,13 @@ bool gBufferRenderTo(gBuffer * pBuffer, int pWidth, int pHeight) {
 
   if (pBuffer->frameBufferId == 0) {
     // need to recreate it!
-    GLenum status;
-    int i;
+    GLint *   intFormats = pBuffer->thin ? gBuffer_thinIntFormats : gBuffer_intFormats;
+    GLenum *  formats = pBuffer->thin ? gBuffer_thinFormats : gBuffer_formats;
+    GLenum *  types = pBuffer->thin ? gBuffer_thinTypes : gBuffer_types;
+    int *     pixelSizes = pBuffer->thin ? gBuffer_thinPixelSizes : gBuffer_pixelSizes;
+    GLenum    drawBufs[GBUFFER_NUM_TEXTURES];
+    GLenum    status;
+    int       i, count = 0, size = 4; // we start with the size of our depth buffer
 
     // remember these
     pBuffer->width = pWidth;
@@ -737,15 +1441,20 @@ bool gBufferRenderTo(gBuffer * pBuffer, int pWidth, int pHeight) {
     glGenFramebuffers(1, &pBuffer->frameBufferId);
     glBindFramebuffer(GL_FRAMEBUFFER, pBuffer->frameBufferId);
 
-    // init our texture buffers
+    // init our texture buffers, the buffers we use are attached in order and match the outputs in outputs.fs
     for (i = 0; i < GBUFFER_NUM_TEXTURES; i++) {
-      glBindTexture(GL_TEXTURE_2D, pBuffer->textureIds[i]);
-      glTexImage2D(GL_TEXTURE_2D, 0, gBuffer_intFormats[i], pBuffer->width, pBuffer->height, 0, gBuffer_formats[i], gBuffer_types[i], NULL); 
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, pBuffer->textureIds[i], 0);
+      if (intFormats[i] != 0) {
+        glBindTexture(GL_TEXTURE_2D, pBuffer->textureIds[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, intFormats[i], pBuffer->width, pBuffer->height, 0, formats[i], types[i], NULL); 
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + count, GL_TEXTURE_2D, pBuffer->textureIds[i], 0);
+        drawBufs[count] = GL_COLOR_ATTACHMENT0 + count;
+        size += pixelSizes[i];
+        count++;
+      };
     };
 
     // create our depth buffer 
@@ -756,7 +1465,7 @@ bool gBufferRenderTo(gBuffer * pBuffer, int pWidth, int pHeight) {
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, pBuffer->depthBufferId, 0);
 
     // and finalize our frame buffer
-    glDrawBuffers(GBUFFER_NUM_TEXTURES, gBuffer_drawBufs);
+    glDrawBuffers(count, drawBufs);
     status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
       errorlog(status, "Couldn't init framebuffer (errno = %i)", status);
@@ -764,7 +1473,7 @@ bool gBufferRenderTo(gBuffer * pBuffer, int pWidth, int pHeight) {
       pBuffer->frameBufferId = 0;
       return false;
     } else {
-      errorlog(0, "Created gbuffer %i, %i", pBuffer->width, pBuffer->height);
+      errorlog(0, "Created %s gbuffer %i, %i (%.1f MB)", pBuffer->thin ? "thin" : "full", pBuffer->width, pBuffer->height, (pBuffer->width * pBuffer->height * size) / (1024.0 * 1024.0));
     };
   } else {
     // we can reuse it!
@@ -804,6 +1513,7 @@ void gBufferDoMainPass(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSourc
 
   // and draw
   glDrawArrays(GL_TRIANGLES, 0, 3 * 2);
+  benchCountDraw(2, 1);
 
   // and clear our selected vertex array object
   glBindVertexArray(0);
@@ -850,11 +1560,19 @@ void gBufferDoLight(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource *
     };
     glBindVertexArray(pBuffer->VAO);
 
-    // and draw
-    if (pLight->type == 1) {
-      glDrawArrays(GL_TRIANGLE_FAN, 0, 1 + 37);
-    } else if (pLight->type == 2) {
-      glDrawArrays(GL_TRIANGLE_FAN, 0, 1 + 37);
+    // and draw, in stereo we draw our light once for each eye
+    if (pBuffer->stereo) {
+      glEnable(GL_CLIP_DISTANCE0);
+      glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 1 + 37, 2);
+      glDisable(GL_CLIP_DISTANCE0);
+      benchCountDraw(36, 2);
+    } else {
+      if (pLight->type == 1) {
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 1 + 37);
+      } else if (pLight->type == 2) {
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 1 + 37);
+      };
+      benchCountDraw(36, 1);
     };
 
     // and clear our selected vertex array object
@@ -862,6 +1580,81 @@ void gBufferDoLight(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource *
   };
 };
 
+// draw all our lights, point lights are binned into our clusters and shaded in a single full screen pass,
+// spot lights and point lights that don't fit into our clusters are drawn one by one with gBufferDoLight.
+// Like gBufferDoLight this assumes gBufferDoMainPass was called before and that we have setup blending,
+// pLights can contain NULL entries.
+void gBufferDoLights(gBuffer * pBuffer, shaderMatrices * pMatrices, lightSource ** pLights, int pCount) {
+  unsigned int  numHits;
+  int           i;
+
+  if (pBuffer == NULL) {
+    return;
+  } else if ((pBuffer->clusters == NULL) || (pBuffer->clusterShader == NULL) || (pBuffer->clusterShader->program == NO_SHADER)) {
+    // no clustered lighting, draw our lights one by one
+    for (i = 0; i < pCount; i++) {
+      if (pLights[i] != NULL) {
+        profBegin("light");
+        gBufferDoLight(pBuffer, pMatrices, pLights[i]);
+        profEnd();
+      };
+    };
+    return;
+  };
+
+  // add our lights to our clusters
+  lcClear(pBuffer->clusters);
+  for (i = 0; i < pCount; i++) {
+    if (pLights[i] == NULL) {
+      // skip
+    } else if (!lcAddLight(pBuffer->clusters, pMatrices, pLights[i])) {
+      profBegin("light");
+      gBufferDoLight(pBuffer, pMatrices, pLights[i]);
+      profEnd();
+    };
+  };
+
+  profBegin("binning");
+  numHits = lcBuild(pBuffer->clusters, pMatrices, pBuffer->stereo ? 2 : 1);
+  profEnd();
+
+  if (numHits > 0) {
+    profBegin("clustered");
+
+    // select our program
+    lightShaderSelect(pBuffer->clusterShader, pBuffer, pMatrices, NULL);
+
+    // only render to the tiles our lights touch, with barrel distortion our tiles don't line up with our screen
+    // and in stereo each tile appears once for each eye
+    if (!pBuffer->barrelDist && !pBuffer->stereo) {
+      const int * tiles = pBuffer->clusters->tiles;
+      GLint       viewport[4];
+
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      glEnable(GL_SCISSOR_TEST);
+      glScissor(viewport[0] + (viewport[2] * tiles[0] / CLUSTER_TILESX), viewport[1] + (viewport[3] * tiles[1] / CLUSTER_TILESY),
+        (viewport[2] * (tiles[2] + 1) / CLUSTER_TILESX) - (viewport[2] * tiles[0] / CLUSTER_TILESX),
+        (viewport[3] * (tiles[3] + 1) / CLUSTER_TILESY) - (viewport[3] * tiles[1] / CLUSTER_TILESY));
+    };
+
+    // select our VAO
+    if (pBuffer->VAO == GL_UNDEF_OBJ) {
+      glGenVertexArrays(1, &(pBuffer->VAO));
+    };
+    glBindVertexArray(pBuffer->VAO);
+
+    // and draw
+    glDrawArrays(GL_TRIANGLES, 0, 3 * 2);
+    benchCountDraw(2, 1);
+
+    // and clear our selected vertex array object
+    glBindVertexArray(0);
+    glDisable(GL_SCISSOR_TEST);
+
+    profEnd();
+  };
+};
+
 #endif /* GBUFF_IMPLEMENTATION */
 
 #endif /* !gbufferh */
\ No newline at end of file
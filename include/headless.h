@@ -0,0 +1,293 @@
+/********************************************************
+ * headless.h - offscreen rendering without a window
+ * by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define HEADLESS_IMPLEMENTATION
+ *
+ * This creates an OpenGL 3.3 core context through EGL
+ * without a window or display server. We use the
+ * EGL_MESA_platform_surfaceless extension when available
+ * which works with Mesa's llvmpipe on machines without
+ * a GPU, else we use the default display.
+ *
+ * As we have no window we render into a framebuffer of
+ * the size requested.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef headlessh
+#define headlessh
+
+// include GLEW and EGL
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// include some standard libraries
+#include <stdbool.h>
+#include <string.h>
+
+// and some of our internal stuff...
+#include "system.h"
+
+// structure for maintaining our offscreen context
+typedef struct headlessContext {
+  EGLDisplay    display;        /* our EGL display */
+  EGLContext    context;        /* our GL context */
+  int           width;          /* width of our framebuffer */
+  int           height;         /* height of our framebuffer */
+  GLuint        frameBufferId;  /* framebuffer we render to */
+  GLuint        colorBufferId;  /* color attachment of our framebuffer */
+  GLuint        depthBufferId;  /* depth/stencil attachment of our framebuffer */
+} headlessContext;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool headlessInit(headlessContext * pContext, int pWidth, int pHeight);
+void headlessBind(headlessContext * pContext);
+bool headlessSavePPM(headlessContext * pContext, const char * pFileName);
+void headlessTerminate(headlessContext * pContext);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef HEADLESS_IMPLEMENTATION
+
+// returns true if pName is in our space separated list of extensions
+bool headlessHasExtension(const char * pExtensions, const char * pName) {
+  const char *  ext = pExtensions;
+  size_t        len = strlen(pName);
+
+  if (ext == NULL) {
+    return false;
+  };
+
+  while ((ext = strstr(ext, pName)) != NULL) {
+    if (((ext == pExtensions) || (ext[-1] == ' ')) && ((ext[len] == ' ') || (ext[len] == '\0'))) {
+      return true;
+    };
+    ext += len;
+  };
+
+  return false;
+};
+
+// get our EGL display, preferably one that doesn't need a display server
+EGLDisplay headlessGetDisplay(void) {
+  const char * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  if (headlessHasExtension(extensions, "EGL_MESA_platform_surfaceless")) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay != NULL) {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      if (display != EGL_NO_DISPLAY) {
+        errorlog(0, "Using surfaceless EGL display");
+        return display;
+      };
+    };
+  };
+#endif
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+};
+
+// create our offscreen context and a framebuffer of pWidth x pHeight to render into
+bool headlessInit(headlessContext * pContext, int pWidth, int pHeight) {
+  EGLint        major, minor, numConfigs;
+  EGLConfig     config;
+  GLenum        err;
+  EGLint        configAttribs[] = {
+    EGL_SURFACE_TYPE, 0,                  /* we don't render to a surface, EGL defaults to window surfaces */
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLint        contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+
+  memset(pContext, 0, sizeof(headlessContext));
+  pContext->display = EGL_NO_DISPLAY;
+  pContext->context = EGL_NO_CONTEXT;
+  pContext->width = pWidth;
+  pContext->height = pHeight;
+
+  pContext->display = headlessGetDisplay();
+  if (pContext->display == EGL_NO_DISPLAY) {
+    errorlog(-1, "Couldn't get an EGL display");
+    return false;
+  } else if (!eglInitialize(pContext->display, &major, &minor)) {
+    errorlog(eglGetError(), "Couldn't initialize EGL");
+    pContext->display = EGL_NO_DISPLAY;
+    return false;
+  };
+
+  errorlog(0, "Initialized EGL %i.%i", major, minor);
+
+  if (!headlessHasExtension(eglQueryString(pContext->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+    errorlog(-1, "EGL_KHR_surfaceless_context is not supported");
+    headlessTerminate(pContext);
+    return false;
+  } else if (!eglBindAPI(EGL_OPENGL_API)) {
+    errorlog(eglGetError(), "Couldn't bind the OpenGL API");
+    headlessTerminate(pContext);
+    return false;
+  } else if (!eglChooseConfig(pContext->display, configAttribs, &config, 1, &numConfigs) || (numConfigs == 0)) {
+    errorlog(eglGetError(), "Couldn't find an EGL config for OpenGL");
+    headlessTerminate(pContext);
+    return false;
+  };
+
+  pContext->context = eglCreateContext(pContext->display, config, EGL_NO_CONTEXT, contextAttribs);
+  if (pContext->context == EGL_NO_CONTEXT) {
+    errorlog(eglGetError(), "Couldn't create an OpenGL 3.3 core context");
+    headlessTerminate(pContext);
+    return false;
+  } else if (!eglMakeCurrent(pContext->display, EGL_NO_SURFACE, EGL_NO_SURFACE, pContext->context)) {
+    errorlog(eglGetError(), "Couldn't make our context current");
+    headlessTerminate(pContext);
+    return false;
+  };
+
+  // init GLEW, note that GLEW may complain about not having a GLX display, our GL functions are loaded by then
+  glewExperimental = true;
+  err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  if (err == GLEW_ERROR_NO_GLX_DISPLAY) {
+    err = GLEW_OK;
+  };
+#endif
+#ifdef GLEW_ERROR_GLX_VERSION_11_ONLY
+  if (err == GLEW_ERROR_GLX_VERSION_11_ONLY) {
+    err = GLEW_OK;
+  };
+#endif
+  if (err != GLEW_OK) {
+    errorlog(err, (char*) glewGetErrorString(err));
+    headlessTerminate(pContext);
+    return false;
+  };
+
+  // GLEW may have left an error behind
+  glGetError();
+
+  errorlog(0, "Using %s on %s", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+
+  // and create the framebuffer we render to
+  glGenRenderbuffers(1, &pContext->colorBufferId);
+  glBindRenderbuffer(GL_RENDERBUFFER, pContext->colorBufferId);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, pWidth, pHeight);
+
+  glGenRenderbuffers(1, &pContext->depthBufferId);
+  glBindRenderbuffer(GL_RENDERBUFFER, pContext->depthBufferId);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, pWidth, pHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &pContext->frameBufferId);
+  glBindFramebuffer(GL_FRAMEBUFFER, pContext->frameBufferId);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pContext->colorBufferId);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, pContext->depthBufferId);
+
+  err = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (err != GL_FRAMEBUFFER_COMPLETE) {
+    errorlog(err, "Couldn't create our %i x %i framebuffer", pWidth, pHeight);
+    headlessTerminate(pContext);
+    return false;
+  };
+
+  headlessBind(pContext);
+
+  return true;
+};
+
+// make our framebuffer the current output
+void headlessBind(headlessContext * pContext) {
+  glBindFramebuffer(GL_FRAMEBUFFER, pContext->frameBufferId);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+};
+
+// save the contents of our framebuffer as a binary PPM file
+bool headlessSavePPM(headlessContext * pContext, const char * pFileName) {
+  unsigned char * pixels;
+  FILE *          file;
+  int             y;
+
+  pixels = (unsigned char *) malloc(pContext->width * pContext->height * 3);
+  if (pixels == NULL) {
+    errorlog(-1, "Couldn't allocate memory for our screenshot");
+    return false;
+  };
+
+  file = fopen(pFileName, "wb");
+  if (file == NULL) {
+    errorlog(-1, "Couldn't open %s for writing", pFileName);
+    free(pixels);
+    return false;
+  };
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, pContext->frameBufferId);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, pContext->width, pContext->height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+  // OpenGL is bottom up, PPM is top down
+  fprintf(file, "P6\n%i %i\n255\n", pContext->width, pContext->height);
+  for (y = pContext->height - 1; y >= 0; y--) {
+    fwrite(pixels + (y * pContext->width * 3), 1, pContext->width * 3, file);
+  };
+
+  fclose(file);
+  free(pixels);
+
+  return true;
+};
+
+// cleanup our framebuffer and context
+void headlessTerminate(headlessContext * pContext) {
+  if (pContext->context != EGL_NO_CONTEXT) {
+    if (pContext->frameBufferId != 0) {
+      glDeleteFramebuffers(1, &pContext->frameBufferId);
+      pContext->frameBufferId = 0;
+    };
+
+    if (pContext->colorBufferId != 0) {
+      glDeleteRenderbuffers(1, &pContext->colorBufferId);
+      pContext->colorBufferId = 0;
+    };
+
+    if (pContext->depthBufferId != 0) {
+      glDeleteRenderbuffers(1, &pContext->depthBufferId);
+      pContext->depthBufferId = 0;
+    };
+
+    eglMakeCurrent(pContext->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(pContext->display, pContext->context);
+    pContext->context = EGL_NO_CONTEXT;
+  };
+
+  if (pContext->display != EGL_NO_DISPLAY) {
+    eglTerminate(pContext->display);
+    pContext->display = EGL_NO_DISPLAY;
+  };
+};
+
+#endif /* HEADLESS_IMPLEMENTATION */
+
+#endif /* !headlessh */
@@ -0,0 +1,645 @@
+/********************************************************
+ * heightfield.h - height field library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define HEIGHTFIELD_IMPLEMENTATION
+ *
+ * Note that this library depends on math3d.h, cull.h and
+ * texturemap.h
+ *
+ * We convert the red channel of a height map into a grid
+ * of heights once and build a min/max pyramid on top of
+ * it. Our field repeats just like our texture does with
+ * GL_REPEAT and we sample it the way GL_LINEAR does so
+ * our heights match what our shaders render.
+ *
+ * Our pyramid gives us conservative bounds for any region
+ * of our field with a handful of lookups and lets us skip
+ * large parts of our field when casting rays.
+ *
+ * When SSE2 is available heights are sampled 4 at a time,
+ * define HFIELD_NO_SIMD before including this file to use
+ * the scalar version instead.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef heightfieldh
+#define heightfieldh
+
+// include support libraries
+#include <string.h>
+#include "system.h"
+#include "math3d.h"
+#include "cull.h"
+#include "texturemap.h"
+
+// check if we can use SSE2, we need it to convert our positions into sample indices
+#if !defined(HFIELD_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define HFIELD_SSE
+#include <emmintrin.h>
+#endif
+
+// maximum number of levels in our pyramid, enough for a 32768x32768 height map
+#define HFIELD_MAXLEVELS 16
+
+// our height field
+typedef struct heightField {
+  unsigned int  retainCount;          /* retain count for this object */
+  char          name[50];             /* name of our height map */
+  int           width;                /* number of samples along x */
+  int           height;               /* number of samples along z */
+  float         mapScale;             /* our field repeats every mapScale units */
+  float         mapHeight;            /* height of a white pixel in our height map */
+  float *       heights;              /* our samples */
+  int           levels;               /* number of levels in our pyramid */
+  int           cellsX[HFIELD_MAXLEVELS]; /* number of cells along x on each level */
+  int           cellsZ[HFIELD_MAXLEVELS]; /* number of cells along z on each level */
+  float *       minMax[HFIELD_MAXLEVELS]; /* minimum and maximum height of each cell, our last level has a single cell */
+} heightField;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+heightField * newHeightField(const texturemap * pHeightMap, float pMapScale, float pMapHeight);
+void hfieldRetain(heightField * pField);
+void hfieldRelease(heightField * pField);
+float hfieldGetHeight(const heightField * pField, float pX, float pZ);
+void hfieldGetHeights(const heightField * pField, const float * pX, const float * pZ, float * pHeights, unsigned int pCount);
+void hfieldGetNormals(const heightField * pField, const float * pX, const float * pZ, vec3 * pNormals, unsigned int pCount);
+aabb * hfieldGetBounds(const heightField * pField, aabb * pSet, float pMinX, float pMinZ, float pMaxX, float pMaxZ);
+bool hfieldIntersectRay(const heightField * pField, const vec3 * pOrigin, const vec3 * pDir, float pMaxDist, float * pDist);
+bool hfieldIntersectSegment(const heightField * pField, const vec3 * pFrom, const vec3 * pTo, vec3 * pHit);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef HEIGHTFIELD_IMPLEMENTATION
+
+// wrap pIndex into 0 to pSize - 1
+static inline int hfieldWrap(int pIndex, int pSize) {
+  pIndex = pIndex % pSize;
+
+  return pIndex < 0 ? pIndex + pSize : pIndex;
+};
+
+// create a height field from the red channel of pHeightMap, which must have kept its data.
+// Our field repeats every pMapScale units and white is pMapHeight high
+heightField * newHeightField(const texturemap * pHeightMap, float pMapScale, float pMapHeight) {
+  heightField * newField;
+  int           i, x, z, level;
+
+  if (pHeightMap == NULL) {
+    errorlog(-1, "Attempted to create height field without a height map");
+    return NULL;
+  } else if (pHeightMap->data == NULL) {
+    errorlog(-1, "Height map %s has no data for our height field", pHeightMap->name);
+    return NULL;
+  } else if ((pHeightMap->width <= 0) || (pHeightMap->height <= 0) || (pHeightMap->width > (1 << (HFIELD_MAXLEVELS - 1))) || (pHeightMap->height > (1 << (HFIELD_MAXLEVELS - 1)))) {
+    errorlog(-1, "Height map %s has an unsupported size of %i x %i", pHeightMap->name, pHeightMap->width, pHeightMap->height);
+    return NULL;
+  };
+
+  newField = (heightField *) malloc(sizeof(heightField));
+  if (newField == NULL) {
+    errorlog(-1, "Couldn't allocate memory for height field");
+    return NULL;
+  };
+
+  newField->retainCount = 1;
+  strncpy(newField->name, pHeightMap->name, sizeof(newField->name) - 1);
+  newField->name[sizeof(newField->name) - 1] = '\0';
+  newField->width = pHeightMap->width;
+  newField->height = pHeightMap->height;
+  newField->mapScale = pMapScale;
+  newField->mapHeight = pMapHeight;
+  newField->levels = 0;
+  memset(newField->minMax, 0, sizeof(newField->minMax));
+
+  // convert our height map, our data is always RGBA
+  newField->heights = (float *) malloc(sizeof(float) * newField->width * newField->height);
+  if (newField->heights == NULL) {
+    errorlog(-1, "Couldn't allocate memory for height field");
+    hfieldRelease(newField);
+    return NULL;
+  };
+  for (i = 0; i < newField->width * newField->height; i++) {
+    newField->heights[i] = pHeightMap->data[i * 4] * pMapHeight / 255.0;
+  };
+
+  // our first level has a cell for each sample, each cell covers the quad between that sample and the next
+  // samples along x and z, wrapping around our edges, so it bounds everything our bilinear filtering returns
+  newField->cellsX[0] = newField->width;
+  newField->cellsZ[0] = newField->height;
+  newField->minMax[0] = (float *) malloc(sizeof(float) * 2 * newField->width * newField->height);
+  if (newField->minMax[0] == NULL) {
+    errorlog(-1, "Couldn't allocate memory for height field");
+    hfieldRelease(newField);
+    return NULL;
+  };
+  for (z = 0; z < newField->height; z++) {
+    int z1 = (z + 1) % newField->height;
+
+    for (x = 0; x < newField->width; x++) {
+      int   x1 = (x + 1) % newField->width;
+      float h00 = newField->heights[(z * newField->width) + x];
+      float h10 = newField->heights[(z * newField->width) + x1];
+      float h01 = newField->heights[(z1 * newField->width) + x];
+      float h11 = newField->heights[(z1 * newField->width) + x1];
+      float * cell = newField->minMax[0] + (((z * newField->width) + x) * 2);
+
+      cell[0] = fmin(fmin(h00, h10), fmin(h01, h11));
+      cell[1] = fmax(fmax(h00, h10), fmax(h01, h11));
+    };
+  };
+  newField->levels = 1;
+
+  // each following level combines 2x2 cells of the level before it, our last cell on a row may only have one
+  for (level = 1; (newField->cellsX[level - 1] > 1) || (newField->cellsZ[level - 1] > 1); level++) {
+    int     prevX = newField->cellsX[level - 1];
+    int     prevZ = newField->cellsZ[level - 1];
+    float * prev = newField->minMax[level - 1];
+    float * cells;
+
+    newField->cellsX[level] = (prevX + 1) / 2;
+    newField->cellsZ[level] = (prevZ + 1) / 2;
+    cells = (float *) malloc(sizeof(float) * 2 * newField->cellsX[level] * newField->cellsZ[level]);
+    if (cells == NULL) {
+      errorlog(-1, "Couldn't allocate memory for height field");
+      hfieldRelease(newField);
+      return NULL;
+    };
+    newField->minMax[level] = cells;
+    newField->levels = level + 1;
+
+    for (z = 0; z < newField->cellsZ[level]; z++) {
+      for (x = 0; x < newField->cellsX[level]; x++) {
+        float * cell = cells + (((z * newField->cellsX[level]) + x) * 2);
+        int     cx, cz;
+
+        cell[0] = prev[(((z * 2 * prevX) + (x * 2)) * 2)];
+        cell[1] = prev[(((z * 2 * prevX) + (x * 2)) * 2) + 1];
+        for (cz = z * 2; (cz < (z * 2) + 2) && (cz < prevZ); cz++) {
+          for (cx = x * 2; (cx < (x * 2) + 2) && (cx < prevX); cx++) {
+            float * from = prev + (((cz * prevX) + cx) * 2);
+
+            if (cell[0] > from[0]) { cell[0] = from[0]; };
+            if (cell[1] < from[1]) { cell[1] = from[1]; };
+          };
+        };
+      };
+    };
+  };
+
+  infolog("Height field %s, %i x %i samples, %i levels, heights %0.1f to %0.1f", newField->name, newField->width, newField->height, newField->levels, newField->minMax[newField->levels - 1][0], newField->minMax[newField->levels - 1][1]);
+
+  return newField;
+};
+
+// retain our height field
+void hfieldRetain(heightField * pField) {
+  if (pField == NULL) {
+    errorlog(-1, "Attempted to retain NULL height field");
+  } else {
+    pField->retainCount++;
+  };
+};
+
+// release our height field and free it if it reaches a retain count of 0
+void hfieldRelease(heightField * pField) {
+  int level;
+
+  if (pField == NULL) {
+    errorlog(-1, "Attempted to release NULL height field");
+    return;
+  } else if (pField->retainCount > 1) {
+    pField->retainCount--;
+
+    return;
+  } else {
+    if (pField->heights != NULL) {
+      free(pField->heights);
+    };
+
+    for (level = 0; level < HFIELD_MAXLEVELS; level++) {
+      if (pField->minMax[level] != NULL) {
+        free(pField->minMax[level]);
+      };
+    };
+
+    free(pField);
+  };
+};
+
+// get our height at pX, pZ
+float hfieldGetHeight(const heightField * pField, float pX, float pZ) {
+  float u, v, h0, h1;
+  int   x0, z0, x1, z1;
+
+  if (pField == NULL) {
+    return 0.0;
+  };
+
+  // our samples are at the center of our texels
+  u = (pX * pField->width / pField->mapScale) - 0.5;
+  v = (pZ * pField->height / pField->mapScale) - 0.5;
+  x0 = floor(u);
+  z0 = floor(v);
+  u -= x0;
+  v -= z0;
+
+  x0 = hfieldWrap(x0, pField->width);
+  z0 = hfieldWrap(z0, pField->height);
+  x1 = (x0 + 1) % pField->width;
+  z1 = (z0 + 1) % pField->height;
+  z0 *= pField->width;
+  z1 *= pField->width;
+
+  h0 = pField->heights[z0 + x0] + (u * (pField->heights[z0 + x1] - pField->heights[z0 + x0]));
+  h1 = pField->heights[z1 + x0] + (u * (pField->heights[z1 + x1] - pField->heights[z1 + x0]));
+
+  return h0 + (v * (h1 - h0));
+};
+
+#ifdef HFIELD_SSE
+// floor 4 values, SSE2 has no floor instruction so we truncate and correct our negative values
+static inline __m128 hfieldFloor4(__m128 pValues) {
+  __m128 trunc = _mm_cvtepi32_ps(_mm_cvttps_epi32(pValues));
+
+  return _mm_sub_ps(trunc, _mm_and_ps(_mm_cmpgt_ps(trunc, pValues), _mm_set1_ps(1.0f)));
+};
+#endif
+
+// get the heights at pCount positions, pHeights may not overlap pX or pZ
+void hfieldGetHeights(const heightField * pField, const float * pX, const float * pZ, float * pHeights, unsigned int pCount) {
+  unsigned int  i = 0;
+
+  if (pField == NULL) {
+    memset(pHeights, 0, sizeof(float) * pCount);
+    return;
+  };
+
+#ifdef HFIELD_SSE
+  {
+    __m128  scaleX = _mm_set1_ps(pField->width / pField->mapScale);
+    __m128  scaleZ = _mm_set1_ps(pField->height / pField->mapScale);
+    __m128  width = _mm_set1_ps(pField->width);
+    __m128  height = _mm_set1_ps(pField->height);
+    __m128  invWidth = _mm_set1_ps(1.0 / pField->width);
+    __m128  invHeight = _mm_set1_ps(1.0 / pField->height);
+    __m128  half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= pCount; i += 4) {
+      __m128  u = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(pX + i), scaleX), half);
+      __m128  v = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(pZ + i), scaleZ), half);
+      __m128  fu = hfieldFloor4(u);
+      __m128  fv = hfieldFloor4(v);
+      __m128  h00, h10, h01, h11, h0, h1;
+      int     x[4], z[4], j;
+      float   c00[4], c10[4], c01[4], c11[4];
+
+      // our fractions
+      u = _mm_sub_ps(u, fu);
+      v = _mm_sub_ps(v, fv);
+
+      // wrap our sample indices into our field
+      fu = _mm_sub_ps(fu, _mm_mul_ps(hfieldFloor4(_mm_mul_ps(fu, invWidth)), width));
+      fv = _mm_sub_ps(fv, _mm_mul_ps(hfieldFloor4(_mm_mul_ps(fv, invHeight)), height));
+      _mm_storeu_si128((__m128i *) x, _mm_cvttps_epi32(fu));
+      _mm_storeu_si128((__m128i *) z, _mm_cvttps_epi32(fv));
+
+      // there is no gather in SSE2 so we fetch our corners one by one, rounding may have left us just outside of our field
+      for (j = 0; j < 4; j++) {
+        int x0 = x[j] >= pField->width ? x[j] - pField->width : (x[j] < 0 ? x[j] + pField->width : x[j]);
+        int z0 = z[j] >= pField->height ? z[j] - pField->height : (z[j] < 0 ? z[j] + pField->height : z[j]);
+        int x1 = x0 + 1 == pField->width ? 0 : x0 + 1;
+        int z1 = (z0 + 1 == pField->height ? 0 : z0 + 1) * pField->width;
+
+        z0 *= pField->width;
+        c00[j] = pField->heights[z0 + x0];
+        c10[j] = pField->heights[z0 + x1];
+        c01[j] = pField->heights[z1 + x0];
+        c11[j] = pField->heights[z1 + x1];
+      };
+
+      h00 = _mm_loadu_ps(c00);
+      h10 = _mm_loadu_ps(c10);
+      h01 = _mm_loadu_ps(c01);
+      h11 = _mm_loadu_ps(c11);
+      h0 = _mm_add_ps(h00, _mm_mul_ps(u, _mm_sub_ps(h10, h00)));
+      h1 = _mm_add_ps(h01, _mm_mul_ps(u, _mm_sub_ps(h11, h01)));
+      _mm_storeu_ps(pHeights + i, _mm_add_ps(h0, _mm_mul_ps(v, _mm_sub_ps(h1, h0))));
+    };
+  };
+#endif
+
+  // and handle whatever is left
+  for (; i < pCount; i++) {
+    pHeights[i] = hfieldGetHeight(pField, pX[i], pZ[i]);
+  };
+};
+
+// get the normals at pCount positions, we use central differences over the distance between our samples
+void hfieldGetNormals(const heightField * pField, const float * pX, const float * pZ, vec3 * pNormals, unsigned int pCount) {
+  float         offsetX[64], offsetZ[64], left[64], right[64], front[64], back[64];
+  float         stepX, stepZ;
+  unsigned int  i, j, count;
+
+  if (pField == NULL) {
+    for (i = 0; i < pCount; i++) {
+      vec3Set(&pNormals[i], 0.0, 1.0, 0.0);
+    };
+    return;
+  };
+
+  stepX = pField->mapScale / pField->width;
+  stepZ = pField->mapScale / pField->height;
+
+  // we do this in batches so our height lookups stay vectorised
+  for (i = 0; i < pCount; i += count) {
+    count = pCount - i > 64 ? 64 : pCount - i;
+
+    for (j = 0; j < count; j++) {
+      offsetX[j] = pX[i + j] - stepX;
+    };
+    hfieldGetHeights(pField, offsetX, pZ + i, left, count);
+    for (j = 0; j < count; j++) {
+      offsetX[j] = pX[i + j] + stepX;
+    };
+    hfieldGetHeights(pField, offsetX, pZ + i, right, count);
+    for (j = 0; j < count; j++) {
+      offsetZ[j] = pZ[i + j] - stepZ;
+    };
+    hfieldGetHeights(pField, pX + i, offsetZ, front, count);
+    for (j = 0; j < count; j++) {
+      offsetZ[j] = pZ[i + j] + stepZ;
+    };
+    hfieldGetHeights(pField, pX + i, offsetZ, back, count);
+
+    for (j = 0; j < count; j++) {
+      vec3Set(&pNormals[i + j], (left[j] - right[j]) * stepZ, 2.0 * stepX * stepZ, (front[j] - back[j]) * stepX);
+      vec3Normalise(&pNormals[i + j]);
+    };
+  };
+};
+
+// get the minimum and maximum height of the cells pX0 to pX1 and pZ0 to pZ1 on our first level,
+// our range must lie within our field. We pick the level on which our range spans at most 3 cells
+// so this may include some cells around our range
+void hfieldCellRange(const heightField * pField, int pX0, int pZ0, int pX1, int pZ1, float * pMin, float * pMax) {
+  int level = 0, x, z;
+
+  while ((level < pField->levels - 1) && ((((pX1 >> level) - (pX0 >> level)) > 2) || (((pZ1 >> level) - (pZ0 >> level)) > 2))) {
+    level++;
+  };
+
+  for (z = pZ0 >> level; z <= (pZ1 >> level); z++) {
+    for (x = pX0 >> level; x <= (pX1 >> level); x++) {
+      const float * cell = pField->minMax[level] + (((z * pField->cellsX[level]) + x) * 2);
+
+      if (*pMin > cell[0]) { *pMin = cell[0]; };
+      if (*pMax < cell[1]) { *pMax = cell[1]; };
+    };
+  };
+};
+
+// split the cells pFrom to pTo into at most 2 ranges that lie within our field, returns the number of ranges
+int hfieldWrapRange(int pFrom, int pTo, int pSize, int * pRanges) {
+  if (pTo - pFrom + 1 >= pSize) {
+    // we cover our whole field
+    pRanges[0] = 0;
+    pRanges[1] = pSize - 1;
+    return 1;
+  };
+
+  pTo = hfieldWrap(pFrom, pSize) + (pTo - pFrom);
+  pFrom = hfieldWrap(pFrom, pSize);
+  if (pTo < pSize) {
+    pRanges[0] = pFrom;
+    pRanges[1] = pTo;
+    return 1;
+  };
+
+  pRanges[0] = pFrom;
+  pRanges[1] = pSize - 1;
+  pRanges[2] = 0;
+  pRanges[3] = pTo - pSize;
+  return 2;
+};
+
+// get a box that contains our height field between pMinX, pMinZ and pMaxX, pMaxZ.
+// This is conservative, the heights in our box may be a little wider then our actual heights
+aabb * hfieldGetBounds(const heightField * pField, aabb * pSet, float pMinX, float pMinZ, float pMaxX, float pMaxZ) {
+  vec3  minVec, maxVec;
+  float minH = 0.0, maxH = 0.0;
+  int   rangesX[4], rangesZ[4], countX, countZ, x, z;
+
+  if (pField != NULL) {
+    // find the cells our region covers, each cell starts at a sample
+    countX = hfieldWrapRange(floor((pMinX * pField->width / pField->mapScale) - 0.5), floor((pMaxX * pField->width / pField->mapScale) - 0.5), pField->width, rangesX);
+    countZ = hfieldWrapRange(floor((pMinZ * pField->height / pField->mapScale) - 0.5), floor((pMaxZ * pField->height / pField->mapScale) - 0.5), pField->height, rangesZ);
+
+    minH = pField->minMax[pField->levels - 1][1];
+    maxH = pField->minMax[pField->levels - 1][0];
+    for (z = 0; z < countZ; z++) {
+      for (x = 0; x < countX; x++) {
+        hfieldCellRange(pField, rangesX[x * 2], rangesZ[z * 2], rangesX[(x * 2) + 1], rangesZ[(z * 2) + 1], &minH, &maxH);
+      };
+    };
+  };
+
+  vec3Set(&minVec, pMinX, minH, pMinZ);
+  vec3Set(&maxVec, pMaxX, maxH, pMaxZ);
+  return aabbFromMinMax(pSet, &minVec, &maxVec);
+};
+
+// find the cell on pLevel that contains pPos along an axis with pSize samples, pPos is in samples and may lie outside of our field.
+// Returns our cell index and sets pStart and pEnd to the edges of our cell in samples
+int hfieldFindCell(int pLevel, float pPos, int pSize, float * pStart, float * pEnd) {
+  float tile = floor(pPos / pSize) * pSize;
+  int   sample = (int) floor(pPos - tile);
+  int   cell;
+
+  if (sample < 0) {
+    sample = 0;
+  } else if (sample >= pSize) {
+    sample = pSize - 1;
+  };
+
+  cell = sample >> pLevel;
+  *pStart = tile + (cell << pLevel);
+  *pEnd = tile + ((cell + 1) << pLevel > pSize ? pSize : (cell + 1) << pLevel);
+
+  return cell;
+};
+
+// find the first point where the ray from pOrigin in direction pDir hits our height field within pMaxDist.
+// pDist is set to the distance along our ray in multiples of pDir. If our origin is below our field we hit at 0.0.
+// We walk down our pyramid and skip any cell our ray passes over entirely.
+bool hfieldIntersectRay(const heightField * pField, const vec3 * pOrigin, const vec3 * pDir, float pMaxDist, float * pDist) {
+  double  ox, oz, dx, dz, oy, dy, t, tEnd, nudge;
+  float   minH, maxH;
+  int     level, top;
+
+  if (pField == NULL) {
+    return false;
+  };
+
+  top = pField->levels - 1;
+  minH = pField->minMax[top][0];
+  maxH = pField->minMax[top][1];
+
+  // work in samples along x and z
+  ox = (pOrigin->x * pField->width / pField->mapScale) - 0.5;
+  oz = (pOrigin->z * pField->height / pField->mapScale) - 0.5;
+  oy = pOrigin->y;
+  dx = pDir->x * pField->width / pField->mapScale;
+  dz = pDir->z * pField->height / pField->mapScale;
+  dy = pDir->y;
+
+  // only the part of our ray between our lowest and highest point matters
+  t = 0.0;
+  tEnd = pMaxDist;
+  if (oy > maxH) {
+    if (dy >= 0.0) {
+      return false;
+    };
+    t = (oy - maxH) / -dy;
+  } else if (dy > 0.0) {
+    tEnd = fmin(tEnd, (maxH - oy) / dy);
+  };
+  if ((dy < 0.0) && (oy > minH)) {
+    // we're always below our field beyond this point so we must have hit it by then
+    tEnd = fmin(tEnd, ((oy - minH) / -dy) + 1.0);
+  };
+
+  // how far we move past the edge of a cell so we end up in the next one
+  nudge = fmax(fabs(dx), fabs(dz));
+  nudge = nudge > 0.0 ? 0.0001 / nudge : 0.0;
+
+  level = top;
+  while (t <= tEnd) {
+    float   startX, endX, startZ, endZ;
+    double  tExit, yMin;
+    int     cx, cz;
+    const float * cell;
+
+    // find the cell we're in and where we leave it
+    cx = hfieldFindCell(level, ox + (dx * t), pField->width, &startX, &endX);
+    cz = hfieldFindCell(level, oz + (dz * t), pField->height, &startZ, &endZ);
+    tExit = tEnd;
+    if (dx > 0.0) {
+      tExit = fmin(tExit, (endX - ox) / dx);
+    } else if (dx < 0.0) {
+      tExit = fmin(tExit, (startX - ox) / dx);
+    };
+    if (dz > 0.0) {
+      tExit = fmin(tExit, (endZ - oz) / dz);
+    } else if (dz < 0.0) {
+      tExit = fmin(tExit, (startZ - oz) / dz);
+    };
+    if (tExit < t) {
+      tExit = t;
+    };
+
+    cell = pField->minMax[level] + (((cz * pField->cellsX[level]) + cx) * 2);
+    yMin = oy + (dy * (dy < 0.0 ? tExit : t));
+    if (yMin > cell[1]) {
+      // we pass over this cell, move to the next one and try a bigger cell
+      if (nudge == 0.0) {
+        return false;
+      };
+      t = tExit + nudge;
+      level = level < top ? level + 1 : top;
+    } else if (level > 0) {
+      // we may hit something in here, take a closer look
+      level--;
+    } else {
+      // intersect with the bilinear patch of this cell, along our ray our height is a quadratic function
+      int     x1 = (cx + 1) % pField->width, z1 = (cz + 1) % pField->height;
+      double  h00 = pField->heights[(cz * pField->width) + cx];
+      double  h10 = pField->heights[(cz * pField->width) + x1];
+      double  h01 = pField->heights[(z1 * pField->width) + cx];
+      double  h11 = pField->heights[(z1 * pField->width) + x1];
+      double  u0 = ox + (dx * t) - startX, v0 = oz + (dz * t) - startZ;
+      double  cB = h10 - h00, cC = h01 - h00, cD = h11 - h10 - h01 + h00;
+      double  a = -cD * dx * dz;
+      double  b = dy - ((cB * dx) + (cC * dz) + (cD * ((u0 * dz) + (v0 * dx))));
+      double  c = oy + (dy * t) - (h00 + (cB * u0) + (cC * v0) + (cD * u0 * v0));
+      double  sEnd = tExit - t, s = -1.0;
+
+      if (c <= 0.0) {
+        // we start below our field
+        s = 0.0;
+      } else if (fabs(a) < 1.0e-12) {
+        if (b < 0.0) {
+          s = -c / b;
+        };
+      } else {
+        double disc = (b * b) - (4.0 * a * c);
+
+        if (disc >= 0.0) {
+          double r1, r2;
+
+          disc = sqrt(disc);
+          r1 = (-b - disc) / (2.0 * a);
+          r2 = (-b + disc) / (2.0 * a);
+          if (r1 > r2) {
+            double swap = r1;
+            r1 = r2;
+            r2 = swap;
+          };
+          s = r1 >= 0.0 ? r1 : r2;
+        };
+      };
+
+      if ((s >= 0.0) && (s <= sEnd) && (t + s <= pMaxDist)) {
+        *pDist = t + s;
+        return true;
+      };
+
+      // on to the next cell
+      if (nudge == 0.0) {
+        return false;
+      };
+      t = tExit + nudge;
+      level = top > 0 ? 1 : 0;
+    };
+  };
+
+  return false;
+};
+
+// find the first point where the segment from pFrom to pTo hits our height field, returns false if we have a clear line of sight.
+// pHit may be NULL
+bool hfieldIntersectSegment(const heightField * pField, const vec3 * pFrom, const vec3 * pTo, vec3 * pHit) {
+  vec3  dir;
+  float dist;
+
+  vec3Copy(&dir, pTo);
+  vec3Sub(&dir, pFrom);
+  if (!hfieldIntersectRay(pField, pFrom, &dir, 1.0, &dist)) {
+    return false;
+  };
+
+  if (pHit != NULL) {
+    vec3Mult(&dir, dist);
+    vec3Copy(pHit, pFrom);
+    vec3Add(pHit, &dir);
+  };
+
+  return true;
+};
+
+#endif /* HEIGHTFIELD_IMPLEMENTATION */
+
+#endif /* !heightfieldh */
@@ -0,0 +1,440 @@
+/********************************************************
+ * jobs.h - job system library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define JOBS_IMPLEMENTATION
+ *
+ * We run a fixed pool of worker threads, each with its
+ * own deque of jobs. A thread pushes and pops jobs at the
+ * bottom of its own deque, when it runs out it steals
+ * from the top of the deque of another thread. Threads
+ * that aren't workers, like our GL thread, share one
+ * extra deque.
+ *
+ * Jobs count down a jobCounter when they finish so we
+ * can wait for a group of jobs, a thread that waits runs
+ * jobs itself until its counter reaches zero.
+ *
+ * If no workers are running jobs are simply run when
+ * they are added.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef jobsh
+#define jobsh
+
+// include support libraries
+#include "system.h"
+
+// maximum number of worker threads we start
+#define JOBS_MAXWORKERS 16
+
+// number of jobs each deque can hold, must be a power of two. If a deque is full we run our job straight away
+#define JOBS_DEQUESIZE  256
+
+// a job, pData is whatever was passed to jobsAdd
+typedef void (*jobFunc)(void * pData);
+
+// a batch of a parallel for, we need to handle the entries pFrom up to but not including pTo
+typedef void (*jobForFunc)(void * pData, unsigned int pFrom, unsigned int pTo);
+
+// counts the jobs that haven't finished yet, zero this before adding jobs to it
+typedef struct jobCounter {
+  volatile int  count;                /* number of jobs that haven't finished */
+} jobCounter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool jobsStart(int pWorkers);
+void jobsStop(void);
+int jobsNumWorkers(void);
+void jobsAdd(jobFunc pFunc, void * pData, jobCounter * pCounter);
+void jobsParallelFor(jobForFunc pFunc, void * pData, unsigned int pCount, unsigned int pBatch, jobCounter * pCounter);
+bool jobsDone(const jobCounter * pCounter);
+void jobsWait(jobCounter * pCounter);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef JOBS_IMPLEMENTATION
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32)
+typedef HANDLE              jobsThread;
+typedef CRITICAL_SECTION    jobsMutex;
+typedef CONDITION_VARIABLE  jobsCond;
+#define jobsMutexInit(m)    InitializeCriticalSection(m)
+#define jobsMutexFree(m)    DeleteCriticalSection(m)
+#define jobsMutexLock(m)    EnterCriticalSection(m)
+#define jobsMutexUnlock(m)  LeaveCriticalSection(m)
+#define jobsCondInit(c)     InitializeConditionVariable(c)
+#define jobsCondFree(c)
+#define jobsCondWait(c, m)  SleepConditionVariableCS(c, m, INFINITE)
+#define jobsCondWake(c)     WakeConditionVariable(c)
+#define jobsCondWakeAll(c)  WakeAllConditionVariable(c)
+#define jobsYield()         SwitchToThread()
+#define jobsAtomicAdd(v, a) (InterlockedExchangeAdd((volatile LONG *) (v), (a)) + (a))
+#define jobsAtomicLoad(v)   InterlockedCompareExchange((volatile LONG *) (v), 0, 0)
+#define JOBS_THREADLOCAL    __declspec(thread)
+#else
+typedef pthread_t           jobsThread;
+typedef pthread_mutex_t     jobsMutex;
+typedef pthread_cond_t      jobsCond;
+#define jobsMutexInit(m)    pthread_mutex_init(m, NULL)
+#define jobsMutexFree(m)    pthread_mutex_destroy(m)
+#define jobsMutexLock(m)    pthread_mutex_lock(m)
+#define jobsMutexUnlock(m)  pthread_mutex_unlock(m)
+#define jobsCondInit(c)     pthread_cond_init(c, NULL)
+#define jobsCondFree(c)     pthread_cond_destroy(c)
+#define jobsCondWait(c, m)  pthread_cond_wait(c, m)
+#define jobsCondWake(c)     pthread_cond_signal(c)
+#define jobsCondWakeAll(c)  pthread_cond_broadcast(c)
+#define jobsYield()         sched_yield()
+#define jobsAtomicAdd(v, a) __atomic_add_fetch((v), (a), __ATOMIC_ACQ_REL)
+#define jobsAtomicLoad(v)   __atomic_load_n((v), __ATOMIC_ACQUIRE)
+#define JOBS_THREADLOCAL    __thread
+#endif
+
+// a job as stored in our deques
+typedef struct jobEntry {
+  jobFunc       func;                 /* our job, NULL if this is a batch of a parallel for */
+  jobForFunc    forFunc;              /* our batch */
+  void *        data;                 /* data for our job */
+  unsigned int  from;                 /* first entry of our batch */
+  unsigned int  to;                   /* entry after the last entry of our batch */
+  jobCounter *  counter;              /* counter we count down when we're done, may be NULL */
+} jobEntry;
+
+// deque of jobs of one thread, our owner works at our bottom, other threads steal from our top
+typedef struct jobDeque {
+  jobsMutex     mutex;                /* protects our deque */
+  unsigned int  top;                  /* index of our oldest job */
+  unsigned int  bottom;               /* index after our newest job */
+  jobEntry      jobs[JOBS_DEQUESIZE]; /* our jobs, indices wrap around */
+} jobDeque;
+
+bool              jobsRunning = false;              // true if our workers are running
+int               jobsWorkerCount = 0;              // number of workers we've started
+jobsThread        jobsWorkers[JOBS_MAXWORKERS];     // our worker threads
+jobDeque          jobsDeques[JOBS_MAXWORKERS + 1];  // our deques, deque 0 is shared by everything that isn't a worker
+jobsMutex         jobsSleepMutex;                   // our workers wait on our condition while there is nothing to do
+jobsCond          jobsSleepCond;                    // signals our workers there is work or that they should quit
+volatile int      jobsQueued = 0;                   // number of jobs in our deques
+bool              jobsQuit = false;                 // if true our workers exit once our deques are empty
+JOBS_THREADLOCAL int jobsThreadIndex = 0;           // index of the deque of the current thread
+
+// push a job onto the bottom of our deque, returns false if our deque is full
+bool jobsPush(jobDeque * pDeque, const jobEntry * pJob) {
+  bool pushed = false;
+
+  jobsMutexLock(&pDeque->mutex);
+  if (pDeque->bottom - pDeque->top < JOBS_DEQUESIZE) {
+    memcpy(&pDeque->jobs[pDeque->bottom & (JOBS_DEQUESIZE - 1)], pJob, sizeof(jobEntry));
+    pDeque->bottom++;
+    pushed = true;
+  };
+  jobsMutexUnlock(&pDeque->mutex);
+
+  if (pushed) {
+    jobsAtomicAdd(&jobsQueued, 1);
+
+    // wake up one of our workers
+    jobsMutexLock(&jobsSleepMutex);
+    jobsCondWake(&jobsSleepCond);
+    jobsMutexUnlock(&jobsSleepMutex);
+  };
+
+  return pushed;
+};
+
+// take a job from our deque, our owner takes our newest job, other threads our oldest
+bool jobsTake(jobDeque * pDeque, jobEntry * pJob, bool pSteal) {
+  bool taken = false;
+
+  jobsMutexLock(&pDeque->mutex);
+  if (pDeque->bottom != pDeque->top) {
+    if (pSteal) {
+      memcpy(pJob, &pDeque->jobs[pDeque->top & (JOBS_DEQUESIZE - 1)], sizeof(jobEntry));
+      pDeque->top++;
+    } else {
+      pDeque->bottom--;
+      memcpy(pJob, &pDeque->jobs[pDeque->bottom & (JOBS_DEQUESIZE - 1)], sizeof(jobEntry));
+    };
+    taken = true;
+  };
+  jobsMutexUnlock(&pDeque->mutex);
+
+  if (taken) {
+    jobsAtomicAdd(&jobsQueued, -1);
+  };
+
+  return taken;
+};
+
+// run our job and count down its counter
+void jobsRun(const jobEntry * pJob) {
+  if (pJob->func != NULL) {
+    pJob->func(pJob->data);
+  } else {
+    pJob->forFunc(pJob->data, pJob->from, pJob->to);
+  };
+
+  if (pJob->counter != NULL) {
+    jobsAtomicAdd(&pJob->counter->count, -1);
+  };
+};
+
+// run one job from our own deque or, if that is empty, one we steal from another thread. Returns false if there was nothing to do
+bool jobsRunOne(void) {
+  jobEntry  job;
+  int       i;
+
+  if (jobsTake(&jobsDeques[jobsThreadIndex], &job, false)) {
+    jobsRun(&job);
+    return true;
+  };
+
+  // start with the thread after us so our thieves spread out
+  for (i = 1; i <= jobsWorkerCount; i++) {
+    if (jobsTake(&jobsDeques[(jobsThreadIndex + i) % (jobsWorkerCount + 1)], &job, true)) {
+      jobsRun(&job);
+      return true;
+    };
+  };
+
+  return false;
+};
+
+// our worker, runs jobs until we're told to quit
+#if defined(WIN32) || defined(_WIN32)
+DWORD WINAPI jobsWorker(LPVOID pParam) {
+#else
+void * jobsWorker(void * pParam) {
+#endif
+  jobsThreadIndex = (int) (size_t) pParam;
+
+  while (true) {
+    if (!jobsRunOne()) {
+      bool quit;
+
+      // nothing to do, wait until something is added
+      jobsMutexLock(&jobsSleepMutex);
+      while ((jobsAtomicLoad(&jobsQueued) == 0) && !jobsQuit) {
+        jobsCondWait(&jobsSleepCond, &jobsSleepMutex);
+      };
+      quit = jobsQuit && (jobsAtomicLoad(&jobsQueued) == 0);
+      jobsMutexUnlock(&jobsSleepMutex);
+
+      if (quit) {
+        break;
+      };
+    };
+  };
+
+#if defined(WIN32) || defined(_WIN32)
+  return 0;
+#else
+  return NULL;
+#endif
+};
+
+// start pWorkers worker threads, if pWorkers is negative we start one less then we have cores so our GL thread has one to itself.
+// If pWorkers is 0 we run our jobs as they are added
+bool jobsStart(int pWorkers) {
+  int i;
+
+  if (jobsRunning) {
+    return true;
+  };
+
+  if (pWorkers < 0) {
+#if defined(WIN32) || defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pWorkers = info.dwNumberOfProcessors - 1;
+#else
+    pWorkers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+#endif
+  };
+  if (pWorkers <= 0) {
+    infolog("Running our jobs without workers");
+    return true;
+  } else if (pWorkers > JOBS_MAXWORKERS) {
+    pWorkers = JOBS_MAXWORKERS;
+  };
+
+  for (i = 0; i <= pWorkers; i++) {
+    jobsMutexInit(&jobsDeques[i].mutex);
+    jobsDeques[i].top = 0;
+    jobsDeques[i].bottom = 0;
+  };
+  jobsMutexInit(&jobsSleepMutex);
+  jobsCondInit(&jobsSleepCond);
+  jobsQueued = 0;
+  jobsQuit = false;
+  jobsThreadIndex = 0;
+
+  // our deques need to be ready before our first worker starts stealing
+  jobsWorkerCount = pWorkers;
+  for (i = 0; i < pWorkers; i++) {
+#if defined(WIN32) || defined(_WIN32)
+    jobsWorkers[i] = CreateThread(NULL, 0, jobsWorker, (LPVOID) (size_t) (i + 1), 0, NULL);
+    if (jobsWorkers[i] == NULL) {
+      break;
+    };
+#else
+    if (pthread_create(&jobsWorkers[i], NULL, jobsWorker, (void *) (size_t) (i + 1)) != 0) {
+      break;
+    };
+#endif
+  };
+
+  if (i < pWorkers) {
+    errorlog(-1, "Couldn't start our job workers");
+
+    // stop the workers we did start, they haven't got anything to do yet
+    jobsWorkerCount = i;
+    jobsRunning = true;
+    jobsStop();
+    return false;
+  };
+
+  jobsRunning = true;
+  infolog("Started %i job workers", jobsWorkerCount);
+
+  return true;
+};
+
+// stop our workers, they finish any jobs still queued first
+void jobsStop(void) {
+  int i;
+
+  if (!jobsRunning) {
+    return;
+  };
+
+  jobsMutexLock(&jobsSleepMutex);
+  jobsQuit = true;
+  jobsCondWakeAll(&jobsSleepCond);
+  jobsMutexUnlock(&jobsSleepMutex);
+
+  for (i = 0; i < jobsWorkerCount; i++) {
+#if defined(WIN32) || defined(_WIN32)
+    WaitForSingleObject(jobsWorkers[i], INFINITE);
+    CloseHandle(jobsWorkers[i]);
+#else
+    pthread_join(jobsWorkers[i], NULL);
+#endif
+  };
+
+  // anything added by a job that was the last to run is run here
+  while (jobsRunOne()) {
+  };
+
+  for (i = 0; i <= jobsWorkerCount; i++) {
+    jobsMutexFree(&jobsDeques[i].mutex);
+  };
+  jobsCondFree(&jobsSleepCond);
+  jobsMutexFree(&jobsSleepMutex);
+
+  jobsWorkerCount = 0;
+  jobsRunning = false;
+};
+
+// returns the number of workers we're running
+int jobsNumWorkers(void) {
+  return jobsWorkerCount;
+};
+
+// add a job, pCounter is counted down once our job is finished and may be NULL
+void jobsAdd(jobFunc pFunc, void * pData, jobCounter * pCounter) {
+  jobEntry job;
+
+  job.func = pFunc;
+  job.forFunc = NULL;
+  job.data = pData;
+  job.from = 0;
+  job.to = 0;
+  job.counter = pCounter;
+
+  if (pCounter != NULL) {
+    jobsAtomicAdd(&pCounter->count, 1);
+  };
+
+  if (!jobsRunning || !jobsPush(&jobsDeques[jobsThreadIndex], &job)) {
+    jobsRun(&job);
+  };
+};
+
+// call pFunc for pCount entries split into batches of pBatch entries, each batch is a job that counts down pCounter
+void jobsParallelFor(jobForFunc pFunc, void * pData, unsigned int pCount, unsigned int pBatch, jobCounter * pCounter) {
+  jobEntry      job;
+  unsigned int  from;
+
+  if (pBatch == 0) {
+    pBatch = 1;
+  };
+
+  if (!jobsRunning || (pCount <= pBatch)) {
+    // no point in splitting this up
+    if (pCount > 0) {
+      pFunc(pData, 0, pCount);
+    };
+    return;
+  };
+
+  job.func = NULL;
+  job.forFunc = pFunc;
+  job.data = pData;
+  job.counter = pCounter;
+
+  for (from = 0; from < pCount; from += pBatch) {
+    job.from = from;
+    job.to = pCount - from > pBatch ? from + pBatch : pCount;
+
+    if (pCounter != NULL) {
+      jobsAtomicAdd(&pCounter->count, 1);
+    };
+
+    if (!jobsPush(&jobsDeques[jobsThreadIndex], &job)) {
+      jobsRun(&job);
+    };
+  };
+};
+
+// returns true if all jobs counted by pCounter have finished
+bool jobsDone(const jobCounter * pCounter) {
+  return jobsAtomicLoad(&pCounter->count) == 0;
+};
+
+// wait until all jobs counted by pCounter have finished, we run jobs while we wait
+void jobsWait(jobCounter * pCounter) {
+  while (jobsAtomicLoad(&pCounter->count) > 0) {
+    if (!jobsRunning || !jobsRunOne()) {
+      // our jobs are being run by others
+      jobsYield();
+    };
+  };
+};
+
+#endif /* JOBS_IMPLEMENTATION */
+
+#endif /* !jobsh */
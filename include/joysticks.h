@@ -15,6 +15,8 @@
  *
  * Revision history:
  * 0.1  28-01-2016  First version with basic functions
+ * 0.2  16-10-2026  GLFW support can be left out for
+ *                  headless builds
  *
  ********************************************************/
 
@@ -42,7 +44,9 @@ extern "C" {
   
 const joystickInfo * getJoystickInfo(int pIndex);
 void initJoystickInfo(void);
+#ifndef HEADLESS
 void updateJoystickInfoGLFW(void);
+#endif
 
 #ifdef __cplusplus
 };
@@ -76,6 +80,7 @@ void initJoystickInfo(void) {
   };
 };
 
+#ifndef HEADLESS
 // implementation for updating joystick information through GLFW
 void updateJoystickInfoGLFW(void) {
   int           i;
@@ -106,6 +111,7 @@ void updateJoystickInfoGLFW(void) {
     };
   };
 };
+#endif /* !HEADLESS */
 
 #endif /* JOYSTICK_IMPLEMENTATION */
 
@@ -17,6 +17,12 @@
  * 0.1  17-01-2016  First version with basic functions
  * 0.2  06-02-2016  Added matSelectProgram and changed
  *                  texture mapping
+ * 0.3  16-10-2026  Added selecting instanced shaders
+ * 0.4  16-10-2026  Material properties are now loaded
+ *                  through a uniform buffer
+ * 0.5  16-10-2026  Added an id for sorting our render queue
+ * 0.6  16-10-2026  Added selecting layered shadow shaders
+ * 0.7  16-10-2026  Bind our bump map to shadow shaders that use it
  *
  ********************************************************/
 
@@ -29,9 +35,20 @@
 #include "shaders.h"
 #include "texturemap.h"
 
+// std140 layout of our material block, this must match material.inc
+typedef struct materialBlock {
+  vec3              matColor;         // diffuse color for this material
+  GLfloat           alpha;            // alpha for our material
+  vec3              matSpecColor;     // specular color for this material
+  GLfloat           ambient;          // ambient factor for our material
+  GLfloat           shininess;        // shininess of this material
+  GLfloat           padding[3];       // std140 rounds our block up to a multiple of a vec4
+} materialBlock;
+
 // structure for our material info
 typedef struct material {
   unsigned int      retainCount;      // retain count for this object
+  unsigned int      id;               // unique id for this material, used to sort our render queue
   int               priority;         // render priority for our material (0 = highest, infinity = lowest)
   char              name[50];         // name of our material
   bool              twoSided;         // is this a two sided material?
@@ -47,6 +64,9 @@ typedef struct material {
   texturemap *      diffuseMap;       // id of our diffuse map
   texturemap *      reflectMap;       // id of our reflectionmap
   texturemap *      bumpMap;          // id of our bumpmap (normal map/height map)
+
+  GLuint            UBO;              // uniform buffer holding our material block
+  materialBlock     uboData;          // copy of what we last loaded into our uniform buffer
 } material;
 
 #ifdef __cplusplus
@@ -64,8 +84,12 @@ void matSetDiffuseMap(material * pMat, texturemap * pTMap);
 void matSetReflectMap(material * pMat, texturemap * pTMap);
 void matSetBumpMap(material * pMat, texturemap * pTMap);
 void matResetLastUsed(void);
+void matSetShadowLayered(bool pLayered);
+shaderInfo * matGetShadowShader(material * pMat);
 bool matSelectProgram(material * pMat, shaderMatrices * pMatrices);
+bool matSelectProgramInstanced(material * pMat, shaderMatrices * pMatrices);
 bool matSelectShadow(material * pMat, shaderMatrices * pMatrices);
+bool matSelectShadowInstanced(material * pMat, shaderMatrices * pMatrices);
 
 bool matParseMtl(const char * pData, llist * pMaterials);
 
@@ -75,12 +99,16 @@ bool matParseMtl(const char * pData, llist * pMaterials);
 
 #ifdef MATERIAL_IMPLEMENTATION
 
+// id we give to our next material
+unsigned int matNextId = 1;
+
 // creates a new material
 // material * myMaterial = newMaterial("FunkyColor");
 material * newMaterial(char * pName) {
   material * newMat = (material *) malloc(sizeof(material));
   if (newMat != NULL) {
     newMat->retainCount = 1;
+    newMat->id = matNextId++;
     newMat->priority = 10;
     strcpy(newMat->name, pName);
     newMat->matShader = NULL;
@@ -94,6 +122,8 @@ material * newMaterial(char * pName) {
     newMat->diffuseMap = NULL;
     newMat->reflectMap = NULL;
     newMat->bumpMap = NULL;
+    newMat->UBO = GL_UNDEF_OBJ;
+    memset(&newMat->uboData, 0, sizeof(materialBlock));
   };
   
   return newMat;
@@ -136,6 +166,12 @@ void matRelease(material * pMat) {
     // release shader
     matSetShader(pMat, NULL);
     matSetShadowShader(pMat, NULL);
+
+    // release our uniform buffer
+    if (pMat->UBO != GL_UNDEF_OBJ) {
+      glDeleteBuffers(1, &pMat->UBO);
+      pMat->UBO = GL_UNDEF_OBJ;
+    };
     
     // and free...
     free(pMat);
@@ -279,38 +315,88 @@ void matSetBumpMap(material * pMat, texturemap * pTMap) {
   };
 };
 
-// remember what material we last selected
+// load our material properties into our uniform buffer if they've changed and bind it
+void matBindBlock(material * pMat) {
+  materialBlock block;
+
+  memset(&block, 0, sizeof(materialBlock));
+  vec3Copy(&block.matColor, &pMat->matColor);
+  block.alpha = pMat->alpha;
+  vec3Copy(&block.matSpecColor, &pMat->matSpecColor);
+  block.ambient = pMat->ambient;
+  block.shininess = pMat->shininess;
+
+  if (pMat->UBO == GL_UNDEF_OBJ) {
+    glGenBuffers(1, &pMat->UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, pMat->UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(materialBlock), &block, GL_STATIC_DRAW);
+    memcpy(&pMat->uboData, &block, sizeof(materialBlock));
+  } else if (memcmp(&pMat->uboData, &block, sizeof(materialBlock)) != 0) {
+    glBindBuffer(GL_UNIFORM_BUFFER, pMat->UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(materialBlock), &block);
+    memcpy(&pMat->uboData, &block, sizeof(materialBlock));
+  };
+
+  glBindBufferBase(GL_UNIFORM_BUFFER, SHADER_MATERIALBLOCK, pMat->UBO);
+};
+
+// remember what material and shader we last selected
 material * matLastMaterial = NULL;
+shaderInfo * matLastShader = NULL;
+
+// are we rendering our shadows to a cube map?
+bool matShadowLayered = false;
 
 // reset the last material we used
 void matResetLastUsed(void) {
   matLastMaterial = NULL;
+  matLastShader = NULL;
 };
 
-bool matSelectProgram(material * pMat, shaderMatrices * pMatrices) {
+// when set our shadow shaders are replaced by their layered variants so we render to all faces of a cube map at once
+void matSetShadowLayered(bool pLayered) {
+  matShadowLayered = pLayered;
+};
+
+// returns the shadow shader we currently use for our material, NULL if it doesn't cast shadows
+shaderInfo * matGetShadowShader(material * pMat) {
+  if (pMat == NULL) {
+    return NULL;
+  } else if (pMat->shadowShader == NULL) {
+    return NULL;
+  } else if (matShadowLayered) {
+    return pMat->shadowShader->layered;
+  } else {
+    return pMat->shadowShader;
+  };
+};
+
+// select pShader and load the properties of our material into it
+bool matSelectShader(material * pMat, shaderInfo * pShader, shaderMatrices * pMatrices) {
   int     texture = 0, i;
   
   if (pMat == NULL) {
     errorlog(-1, "No material selected!");
     return false;
-  } else if (pMat->matShader == NULL) {
+  } else if (pShader == NULL) {
     errorlog(-1, "No shader setup for this material!");
     return false;
-  } else if (pMat->matShader->program == NO_SHADER) {
+  } else if (pShader->program == NO_SHADER) {
     errorlog(-1, "No shader compiled for this material!");
     return false;
   };
 
-  if (pMat == matLastMaterial) {
+  if ((pMat == matLastMaterial) && (pShader == matLastShader)) {
     // Assume we're already using this material. Not sure if this has any noticable effect.
     // We assume the following is static:
     // - program
     // - textures
-    // - projection and view matrices
+    // - material properties
     // If this is wrong matResetLastUsed should be called beforehand
   } else {
     // remember for next time
     matLastMaterial = pMat;
+    matLastShader = pShader;
 
     // infolog("Select material %s (%li)", pMat->name, pMat->priority);
 
@@ -320,134 +406,101 @@ bool matSelectProgram(material * pMat, shaderMatrices * pMatrices) {
       glEnable(GL_CULL_FACE);   // enable culling
     }
 
-    glUseProgram(pMat->matShader->program);
+    glUseProgram(pShader->program);
 
     // setup our material
-    if (pMat->matShader->alphaId >= 0) {
-      glUniform1f(pMat->matShader->alphaId, pMat->alpha);      
-    };
-
-    if (pMat->matShader->ambientId >= 0) {
-      glUniform1f(pMat->matShader->ambientId, pMat->ambient);       
-    };
-
-    if (pMat->matShader->matColorId >= 0) {
-      glUniform3f(pMat->matShader->matColorId, pMat->matColor.x, pMat->matColor.y, pMat->matColor.z);      
+    if (pShader->materialBlockId >= 0) {
+      matBindBlock(pMat);
     };
 
-    if (pMat->matShader->matSpecColorId >= 0) {
-      glUniform3f(pMat->matShader->matSpecColorId, pMat->matSpecColor.x, pMat->matSpecColor.y, pMat->matSpecColor.z);      
-    };
-    
-    if (pMat->matShader->shininessId >= 0) {
-      glUniform1f(pMat->matShader->shininessId, pMat->shininess);      
-    };
-
-    if (pMat->matShader->textureMapId >= 0) {
+    if (pShader->textureMapId >= 0) {
       glActiveTexture(GL_TEXTURE0 + texture);
       if (pMat->diffuseMap == NULL) {
         glBindTexture(GL_TEXTURE_2D, 0);      
       } else {
         glBindTexture(GL_TEXTURE_2D, pMat->diffuseMap->textureId);      
       }
-      glUniform1i(pMat->matShader->textureMapId, texture); 
+      glUniform1i(pShader->textureMapId, texture); 
       texture++;   
     };
 
-    if (pMat->matShader->reflectMapId >= 0) {
+    if (pShader->reflectMapId >= 0) {
       glActiveTexture(GL_TEXTURE0 + texture);
       if (pMat->reflectMap == NULL) {
         glBindTexture(GL_TEXTURE_2D, 0);      
       } else {
         glBindTexture(GL_TEXTURE_2D, pMat->reflectMap->textureId);      
       }
-      glUniform1i(pMat->matShader->reflectMapId, texture); 
+      glUniform1i(pShader->reflectMapId, texture); 
       texture++;   
     };  
 
-    if (pMat->matShader->bumpMapId >= 0) {
+    if (pShader->bumpMapId >= 0) {
       glActiveTexture(GL_TEXTURE0 + texture);
       if (pMat->bumpMap == NULL) {
         glBindTexture(GL_TEXTURE_2D, 0);      
       } else {
         glBindTexture(GL_TEXTURE_2D, pMat->bumpMap->textureId);      
       }
-      glUniform1i(pMat->matShader->bumpMapId, texture); 
+      glUniform1i(pShader->bumpMapId, texture); 
       texture++;   
     };
-
-    // setup camera info
-    if (pMat->matShader->eyePosId >= 0) {
-      vec3    tmpvector;
-      shdMatGetEyePos(pMatrices, &tmpvector);
-      glUniform3f(pMat->matShader->eyePosId, tmpvector.x, tmpvector.y, tmpvector.z);       
-    };
-  
-    // setup our projection and view matrices
-    if (pMat->matShader->projectionMatrixId >= 0) {
-      glUniformMatrix4fv(pMat->matShader->projectionMatrixId, 1, false, (const GLfloat *) pMatrices->projection.m);
-    };
-
-    if (pMat->matShader->viewMatrixId >= 0) {
-      glUniformMatrix4fv(pMat->matShader->viewMatrixId, 1, false, (const GLfloat *) pMatrices->view.m);
-    };
   };
   
-  // these will likely have changed
-  if (pMat->matShader->modelMatrixId >= 0) {
-    glUniformMatrix4fv(pMat->matShader->modelMatrixId, 1, false, (const GLfloat *) pMatrices->model.m);
-  };
-  
-  if (pMat->matShader->modelViewMatrixId >= 0) {
-    glUniformMatrix4fv(pMat->matShader->modelViewMatrixId, 1, false, (const GLfloat *) shdMatGetModelView(pMatrices)->m);
-  };
+  // our frame block is only reloaded if our projection or view has changed, our object block will likely have changed
+  shdMatBind(pMatrices, pShader->frameBlockId >= 0, pShader->objectBlockId >= 0);
 
-  // calculate the inverse of our model-view
-  if (pMat->matShader->modelViewInverseId >= 0) {
-    glUniformMatrix4fv(pMat->matShader->modelViewInverseId, 1, false, (const GLfloat *) shdMatGetInvModelView(pMatrices)->m);
-  };
-  
-  // our normal matrix taken from our model matrix
-  if (pMat->matShader->normalMatrixId >= 0) {
-    glUniformMatrix3fv(pMat->matShader->normalMatrixId, 1, false, (const GLfloat *) shdMatGetNormal(pMatrices)->m);
-  };
+  return true;
+};
 
-  // our normal matrix taken from our modelView matrix
-  if (pMat->matShader->normalViewId >= 0) {
-    glUniformMatrix3fv(pMat->matShader->normalViewId, 1, false, (const GLfloat *) shdMatGetNormalView(pMatrices)->m);
+// select the shader for our material
+bool matSelectProgram(material * pMat, shaderMatrices * pMatrices) {
+  if (pMat == NULL) {
+    errorlog(-1, "No material selected!");
+    return false;
   };
-  
-  if (pMat->matShader->mvpId >= 0) {
-    glUniformMatrix4fv(pMat->matShader->mvpId, 1, false, (const GLfloat *) shdMatGetMvp(pMatrices)->m);
+
+  return matSelectShader(pMat, pMat->matShader, pMatrices);
+};
+
+// select the instanced variant of the shader for our material, our model matrices come from our instance buffer
+bool matSelectProgramInstanced(material * pMat, shaderMatrices * pMatrices) {
+  if (pMat == NULL) {
+    errorlog(-1, "No material selected!");
+    return false;
+  } else if (pMat->matShader == NULL) {
+    errorlog(-1, "No shader setup for this material!");
+    return false;
   };
 
-  return true;
+  return matSelectShader(pMat, pMat->matShader->instanced, pMatrices);
 };
 
-bool matSelectShadow(material * pMat, shaderMatrices * pMatrices) {
+// select pShader for rendering our material into a shadow map
+bool matSelectShadowShader(material * pMat, shaderInfo * pShader, shaderMatrices * pMatrices) {
   int     texture = 0;
   
   if (pMat == NULL) {
     // ignore this, we don't cast shadows
     return false;
-  } else if (pMat->shadowShader == NULL) {
+  } else if (pShader == NULL) {
     // ignore this, we don't cast shadows
     return false;
-  } else if (pMat->shadowShader->program == NO_SHADER) {
+  } else if (pShader->program == NO_SHADER) {
     errorlog(-1, "No shadow shader compiled for this material!");
     return false;
   };
 
-  if (pMat == matLastMaterial) {
+  if ((pMat == matLastMaterial) && (pShader == matLastShader)) {
     // Assume we're already using this material.
     // We assume the following is static:
     // - program
     // - textures
-    // - projection and view matrices
     // If this is wrong matResetLastUsed should be called beforehand
   } else {
     // remember for next time
     matLastMaterial = pMat;
+    matLastShader = pShader;
 
     // infolog("Select shadow material %s", pMat->name);
 
@@ -457,28 +510,60 @@ bool matSelectShadow(material * pMat, shaderMatrices * pMatrices) {
       glEnable(GL_CULL_FACE);   // enable culling
     }
 
-    glUseProgram(pMat->shadowShader->program);
+    glUseProgram(pShader->program);
 
-    if (pMat->shadowShader->textureMapId >= 0) {
+    if (pShader->textureMapId >= 0) {
       glActiveTexture(GL_TEXTURE0 + texture);
       if (pMat->diffuseMap == NULL) {
         glBindTexture(GL_TEXTURE_2D, 0);      
       } else {
         glBindTexture(GL_TEXTURE_2D, pMat->diffuseMap->textureId);      
       }
-      glUniform1i(pMat->shadowShader->textureMapId, texture); 
+      glUniform1i(pShader->textureMapId, texture); 
       texture++;   
     };
-  };
 
-  // our mvp will have changed
-  if (pMat->shadowShader->mvpId >= 0) {
-    glUniformMatrix4fv(pMat->shadowShader->mvpId, 1, false, (const GLfloat *) shdMatGetMvp(pMatrices)->m);
+    // our terrain reads its heights from our bump map
+    if (pShader->bumpMapId >= 0) {
+      glActiveTexture(GL_TEXTURE0 + texture);
+      if (pMat->bumpMap == NULL) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+      } else {
+        glBindTexture(GL_TEXTURE_2D, pMat->bumpMap->textureId);
+      }
+      glUniform1i(pShader->bumpMapId, texture);
+      texture++;
+    };
   };
 
+  // our instanced shader uses our frame block, everything else our object block
+  shdMatBind(pMatrices, pShader->frameBlockId >= 0, pShader->objectBlockId >= 0);
+
   return true;  
 };
 
+// select the shadow shader for our material
+bool matSelectShadow(material * pMat, shaderMatrices * pMatrices) {
+  if (pMat == NULL) {
+    // ignore this, we don't cast shadows
+    return false;
+  };
+
+  return matSelectShadowShader(pMat, matGetShadowShader(pMat), pMatrices);
+};
+
+// select the instanced variant of the shadow shader for our material
+bool matSelectShadowInstanced(material * pMat, shaderMatrices * pMatrices) {
+  shaderInfo * shader = matGetShadowShader(pMat);
+
+  if (shader == NULL) {
+    // ignore this, we don't cast shadows
+    return false;
+  };
+
+  return matSelectShadowShader(pMat, shader->instanced, pMatrices);
+};
+
 // parse data loaded from a wavefront .mtl file
 // note that loading the data from disk should be implemented separately
 // https://en.wikipedia.org/wiki/Wavefront_.obj_file
@@ -583,20 +668,20 @@ bool matParseMtl(const char * pData, llist * pMaterials) {
                 // our diffuse texture map
                 if (mat != NULL) {
                   // load our diffuse map, note that it will be retained inside of matSetDiffuseMap!;
-                  matSetDiffuseMap(mat, getTextureMapByFileName(line->text + 7, GL_LINEAR, GL_REPEAT, false));
+                  matSetDiffuseMap(mat, getStreamedTextureMap(line->text + 7, GL_LINEAR, GL_REPEAT, TMAP_PLACEHOLDER_GRAY));
                   tmapMakeMipMap(mat->diffuseMap);
                 };                
               } else if (varcharCmp(what, "map_refl") == 0) {
                 // our reflect texture map
                 if (mat != NULL) {
                   // load our relection map, note that it will be retained inside of matSetRelectMap!;
-                  matSetReflectMap(mat, getTextureMapByFileName(line->text + 9, GL_LINEAR, GL_CLAMP_TO_EDGE, false));
+                  matSetReflectMap(mat, getStreamedTextureMap(line->text + 9, GL_LINEAR, GL_CLAMP_TO_EDGE, TMAP_PLACEHOLDER_BLACK));
                 };                                
               } else if (varcharCmp(what, "map_bump") == 0) {
                 // our bump/normal texture map
                 if (mat != NULL) {
                   // load our bump map, note that it will be retained inside of matSetBumpMap!;
-                  matSetBumpMap(mat, getTextureMapByFileName(line->text + 9, GL_LINEAR, GL_REPEAT, false));
+                  matSetBumpMap(mat, getStreamedTextureMap(line->text + 9, GL_LINEAR, GL_REPEAT, TMAP_PLACEHOLDER_NORMAL));
                   tmapMakeMipMap(mat->bumpMap);
                 };                                
               } else {
@@ -54,6 +54,7 @@
  * 0.1  07-03-2015  First version with basic functions
  * 0.2  31-01-2016  Fixed inverse matrix function
  * 0.3  23-02-2016  Added vec4Mult and vec4Div 
+ * 0.4  16-10-2026  Added mat4StereoUnion
  *
  ********************************************************/
 
@@ -179,6 +180,7 @@ mat4* mat4Ortho(mat4* pMatrix, MATH3D_FLOAT pLeft, MATH3D_FLOAT pRight, MATH3D_F
 mat4* mat4Frustum(mat4* pMatrix, MATH3D_FLOAT pLeft, MATH3D_FLOAT pRight, MATH3D_FLOAT pBottom, MATH3D_FLOAT pTop, MATH3D_FLOAT pZNear, MATH3D_FLOAT pZFar);
 mat4* mat4Projection(mat4* pMatrix, MATH3D_FLOAT pFOV, MATH3D_FLOAT pAspect, MATH3D_FLOAT pZNear, MATH3D_FLOAT pZFar);
 mat4* mat4Stereo(mat4* pMatrix, MATH3D_FLOAT pFOV, MATH3D_FLOAT pAspect, MATH3D_FLOAT pZNear, MATH3D_FLOAT pZFar, float pIOD, float pProjPlane, int pMode);
+mat4* mat4StereoUnion(mat4* pMatrix, MATH3D_FLOAT pFOV, MATH3D_FLOAT pAspect, MATH3D_FLOAT pZNear, MATH3D_FLOAT pZFar, float pIOD, float pProjPlane);
 mat4* mat4LookAt(mat4* pMatrix, const vec3* pEye, const vec3* pLookat, const vec3* pUp);
 
 mat3* mat3FromMat4(mat3* pSet, const mat4* pFrom);
@@ -1133,6 +1135,40 @@ mat4* mat4Stereo(mat4* pMatrix, MATH3D_FLOAT pFOV, MATH3D_FLOAT pAspect, MATH3D_
   return pMatrix;
 };
 
+// Applies a 3D projection matrix that contains the frustums of both our eyes as created by mat4Stereo,
+// this is used to cull our scene once when we render both eyes in a single pass.
+// Same parameters as mat4Stereo but without pMode
+mat4* mat4StereoUnion(mat4* pMatrix, MATH3D_FLOAT pFOV, MATH3D_FLOAT pAspect, MATH3D_FLOAT pZNear, MATH3D_FLOAT pZFar, float pIOD, float pProjPlane) {
+  MATH3D_FLOAT ymax, xmax, eye, nearWidth, farWidth, slope, apex;
+  vec3 tmpVector;
+
+  ymax = pZNear * tan(pFOV * PI / 360.0f);
+  xmax = ymax * pAspect;
+  eye = pIOD / 2.0;
+
+  // at a distance d both eyes together are (xmax * d / near) + (eye * |1 - d / projplane|) wide to either side,
+  // this is convex so the line through the widths at our near and far plane contains both frustums
+  nearWidth = xmax + (eye * fabs(1.0 - (pZNear / pProjPlane)));
+  farWidth = (xmax * pZFar / pZNear) + (eye * fabs(1.0 - (pZFar / pProjPlane)));
+  slope = (farWidth - nearWidth) / (pZFar - pZNear);
+
+  // our frustum has its apex where that line crosses our center, which is behind our eyes
+  apex = slope > 0.0 ? pZNear - (nearWidth / slope) : 0.0;
+  if (apex > 0.0) {
+    apex = 0.0;
+  };
+  slope = nearWidth / (pZNear - apex);
+  if (farWidth / (pZFar - apex) > slope) {
+    slope = farWidth / (pZFar - apex);
+  };
+
+  // build our frustum from our apex and move it back into place, vertically our eyes don't differ
+  mat4Frustum(pMatrix, -slope * (pZNear - apex), slope * (pZNear - apex), -ymax * (pZNear - apex) / pZNear, ymax * (pZNear - apex) / pZNear, pZNear - apex, pZFar - apex);
+  mat4Translate(pMatrix, vec3Set(&tmpVector, 0.0, 0.0, apex));
+
+  return pMatrix;
+};
+
 // Applies a look-at matrix to create a view matrix
 // pEye is the position of our camera
 // pLookat is the position we're looking at
@@ -19,21 +19,49 @@
  * 0.3  08-02-2016  Added automatic load into GL memory
  *                  and passing a matrix to adjust loading
  *                  our wavefront file
+ * 0.4  16-10-2026  Hash based vertex lookup and in place tokenizer for
+ *                  our wavefront parser
+ * 0.5  16-10-2026  Added instanced rendering
+ * 0.6  16-10-2026  Added an id for sorting our render queue
+ * 0.7  16-10-2026  Report draw calls to our benchmark
+ * 0.8  16-10-2026  Add indices of a face in one go
+ * 0.9  16-10-2026  Render multiple views of a mesh in one draw call
+ * 0.10 16-10-2026  Load vertex and index data into GL straight from a
+ *                  buffer and keep bounds for meshes without CPU data
+ * 0.11 16-10-2026  Optional packed vertex layout and 16 bit indices
+ * 0.12 16-10-2026  Reorder triangles and vertices for our vertex cache
+ *                  and to reduce overdraw
  *
  ********************************************************/
 
 #ifndef mesh3dh
 #define mesh3dh
 
+#include <stdint.h>
+
 #include "system.h"
 #include "linkedlist.h"
 #include "dynamicarray.h"
 #include "varchar.h"
 #include "math3d.h"
 #include "material.h"
+#include "benchmark.h"
 
 #define BUFFER_EXPAND     100
 
+// first attribute location used for our per instance model matrix (a mat4 uses 4 locations)
+#define MESH_INSTANCE_ATTRIB  3
+
+// attribute locations of the scale and offset our shaders apply to our positions (see meshSetPacked)
+#define MESH_POSSCALE_ATTRIB  7
+#define MESH_POSOFFSET_ATTRIB 8
+
+// size of the FIFO vertex cache we optimize our meshes for
+#define MESH_VERTEX_CACHE     16
+
+// how much our cache efficiency may suffer to get more clusters to sort for overdraw
+#define MESH_OVERDRAW_THRESHOLD 1.05
+
 // structure for our vertices
 typedef struct vertex {
   vec3          V;                    // position of our vertice (XYZ)
@@ -41,14 +69,30 @@ typedef struct vertex {
   vec2          T;                    // texture coordinates (XY)
 } vertex;
 
+// structure for our packed vertices as loaded into GL memory, 16 instead of 32 bytes
+typedef struct packedVertex {
+  GLushort      V[4];                 // position within our bounds as normalized unsigned shorts (XYZ, W is padding)
+  GLuint        N;                    // normal as a signed normalized 10_10_10_2 value (XYZ)
+  GLhalf        T[2];                 // texture coordinates as half floats (XY)
+} packedVertex;
+
+// statistics of how well the order of our indices uses a vertex cache
+typedef struct meshOptStats {
+  float         acmr;                 // average cache miss ratio, cache misses per triangle (0.5 - 3.0)
+  float         atvr;                 // average transform to vertex ratio, cache misses per vertex (1.0 is ideal)
+} meshOptStats;
+
 // structure for encapsulating mesh data
 typedef struct mesh3d {
   unsigned int  retainCount;          // retain count for this object
+  unsigned int  id;                   // unique id for this mesh, used to sort our render queue
   bool          visible;              // if true we render this
   char          name[50];             // name for this mesh 
   bool          canRender;            // if true we can render this
   bool          isLoaded;             // if true this is loaded into our GL memory
   int           verticesPerFace;      // vertices per face, 3 and 4 are currently supported
+  bool          packed;               // if true we load our vertices into GL memory in our packed layout
+  bool          optimized;            // if true we've optimized the order of our triangles and vertices
   
   // material to use
   material *    material;             // our material
@@ -57,6 +101,11 @@ typedef struct mesh3d {
   dynarray *    vertices;             // our vertices
   dynarray *    indices;              // our indices
   
+  // bounds, used when our vertices are only loaded into our GL memory
+  bool          hasBounds;            // if true minBounds/maxBounds are set
+  vec3          minBounds;            // minimum of our vertices
+  vec3          maxBounds;            // maximum of our vertices
+
   // default model matrix
   mat4          defModel;             // our default model matrix
 
@@ -64,6 +113,7 @@ typedef struct mesh3d {
   GLuint        VAO;                  // our vertex array object
   GLuint        VBO[2];               // our two vertex buffer objects
   GLuint        loadedIndices;        // number of indices loaded into GPU
+  GLenum        indexType;            // type of our indices in GPU memory, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
 } mesh3d;
 
 #ifdef __cplusplus
@@ -75,6 +125,8 @@ llist * newMeshList(void);
 void meshRetain(mesh3d * pMesh);
 void meshRelease(mesh3d * pMesh);
 void meshSetMaterial(mesh3d * pMesh, material * pMat);
+void meshSetPacked(mesh3d * pMesh, bool pPacked);
+void meshSetPackObj(bool pPacked);
 GLuint meshAddVertex(mesh3d * pMesh, const vertex * pVertex);
 GLuint meshAddVNT(mesh3d * pMesh, const vec3 * pVector, const vec3 * pNormal, const vec2 * pCoords);
 void meshFlipNormals(mesh3d * pMesh);
@@ -84,9 +136,14 @@ bool meshAddQuad(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC, GLuint pD);
 void meshFlipFaces(mesh3d * pMesh);
 void meshCenter(mesh3d * pMesh);
 void meshOffset(mesh3d * pMesh, const vec3 * pOffset);
+void meshMeasureCache(const GLuint * pIndices, GLuint pNumIndices, GLuint pNumVertices, meshOptStats * pStats);
+bool meshOptimize(mesh3d * pMesh, bool pReport);
+bool meshCopyDataToGL(mesh3d * pMesh, const vertex * pVertices, GLuint pNumVertices, const GLuint * pIndices, GLuint pNumIndices);
 bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers);
 bool meshTestVolume(mesh3d * pMesh, const mat4 * pMVP);
+void meshSetViews(int pViews);
 bool meshRender(mesh3d * pMesh);
+bool meshRenderInstanced(mesh3d * pMesh, GLuint pInstanceVBO, GLintptr pOffset, GLsizei pCount);
 
 bool meshMakePlane(mesh3d * pMesh, int pHorzTiles, int pVertTiles, float pWidth, float pHeight, bool pAddQuads);
 bool meshMakeCube(mesh3d * pMesh, GLfloat pWidth, GLfloat pHeight, GLfloat pDepth, bool pFBLRTB, int verticesPerFace);
@@ -100,6 +157,15 @@ bool meshParseObj(const char * pData, llist * pAddToMeshList, llist * pMaterials
 
 #ifdef MESH_IMPLEMENTATION
 
+// id we give to our next mesh
+unsigned int meshNextId = 1;
+
+// number of views we render each mesh to
+int meshViews = 1;
+
+// if true meshes we load from wavefront files use our packed layout
+bool meshPackObj = false;
+
 // Initialize a new mesh that either has been allocated on the heap or allocated with
 void meshInit(mesh3d * pMesh, GLuint pInitialVertices, GLuint pInitialIndices) {
   if (pMesh == NULL) {
@@ -109,10 +175,13 @@ void meshInit(mesh3d * pMesh, GLuint pInitialVertices, GLuint pInitialIndices) {
 //  errorlog(0, "New mesh (%p)", pMesh);
   
   pMesh->retainCount = 1;
+  pMesh->id = meshNextId++;
   pMesh->canRender = true;
   pMesh->isLoaded = false;
   pMesh->visible = true;
   pMesh->verticesPerFace = 3;
+  pMesh->packed = false;
+  pMesh->optimized = false;
   strcpy(pMesh->name, "New");
   
   // init our material
@@ -125,7 +194,7 @@ void meshInit(mesh3d * pMesh, GLuint pInitialVertices, GLuint pInitialIndices) {
     pMesh->vertices = newDynArray(sizeof(vertex));
     if (pMesh->vertices == NULL) {
       errorlog(1, "Couldn''t allocate vertex array data");          
-    } else if (!dynArrayCheckSize(pMesh->vertices, pInitialVertices)) {
+    } else if (!dynArrayReserve(pMesh->vertices, pInitialVertices)) {
       errorlog(1, "Couldn''t allocate vertex array data");      
     };
   };
@@ -137,17 +206,22 @@ void meshInit(mesh3d * pMesh, GLuint pInitialVertices, GLuint pInitialIndices) {
     pMesh->indices = newDynArray(sizeof(GLuint));
     if (pMesh->indices == NULL) {
       errorlog(1, "Couldn''t allocate index array data");          
-    } else if (!dynArrayCheckSize(pMesh->indices, pInitialIndices)) {
+    } else if (!dynArrayReserve(pMesh->indices, pInitialIndices)) {
       errorlog(1, "Couldn''t allocate index array data");      
     };
   };
   
+  pMesh->hasBounds = false;
+  vec3Set(&(pMesh->minBounds), 0.0, 0.0, 0.0);
+  vec3Set(&(pMesh->maxBounds), 0.0, 0.0, 0.0);
+
   mat4Identity(&(pMesh->defModel));
   
   pMesh->VAO = GL_UNDEF_OBJ;
   pMesh->VBO[0] = GL_UNDEF_OBJ;
   pMesh->VBO[1] = GL_UNDEF_OBJ;
   pMesh->loadedIndices = 0;
+  pMesh->indexType = GL_UNSIGNED_INT;
 };
 
 mesh3d * newMesh(GLuint pInitialVertices, GLuint pInitialIndices) {
@@ -236,6 +310,22 @@ void meshSetMaterial(mesh3d * pMesh, material * pMat) {
   };
 };
 
+// use our packed vertex layout for this mesh, this must be set before our mesh is loaded into GL memory.
+// Our positions are stored relative to our bounds so only shaders that apply MESH_POSSCALE_ATTRIB and
+// MESH_POSOFFSET_ATTRIB to their positions (standard.vs and shadow.vs) can render packed meshes.
+void meshSetPacked(mesh3d * pMesh, bool pPacked) {
+  if (pMesh == NULL) {
+    return;
+  };
+
+  pMesh->packed = pPacked;
+};
+
+// use our packed vertex layout for meshes we load from wavefront files from now on
+void meshSetPackObj(bool pPacked) {
+  meshPackObj = pPacked;
+};
+
 // adds a vertex to our buffer and returns the index in our vertice buffer
 // return GL_UNDEF_OBJ if we couldn't allocate memory
 GLuint meshAddVertex(mesh3d * pMesh, const vertex * pVertex) {
@@ -320,6 +410,8 @@ bool meshAddLine(mesh3d * pMesh, GLuint pA, GLuint pB) {
 // adds a face (3 indices into vertex array)
 // returns false on failure
 bool meshAddFace(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC) {
+  GLuint indices[3];
+
   if (pMesh == NULL) {
     return false;
   } else if (pMesh->verticesPerFace != 3) {
@@ -338,9 +430,10 @@ bool meshAddFace(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC) {
     };
   };
   
-  dynArrayPush(pMesh->indices, &pA);
-  dynArrayPush(pMesh->indices, &pB);
-  dynArrayPush(pMesh->indices, &pC);
+  indices[0] = pA;
+  indices[1] = pB;
+  indices[2] = pC;
+  dynArrayPushN(pMesh->indices, indices, 3);
   pMesh->isLoaded = false;
   
   return true;
@@ -354,6 +447,8 @@ bool meshAddFace(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC) {
 // a------b
 // returns false on failure
 bool meshAddQuad(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC, GLuint pD) {
+  GLuint indices[4];
+
   if (pMesh == NULL) {
     return false;
   } else if (pMesh->verticesPerFace != 4) {
@@ -372,10 +467,11 @@ bool meshAddQuad(mesh3d * pMesh, GLuint pA, GLuint pB, GLuint pC, GLuint pD) {
     };
   };
   
-  dynArrayPush(pMesh->indices, &pA);
-  dynArrayPush(pMesh->indices, &pB);
-  dynArrayPush(pMesh->indices, &pC);
-  dynArrayPush(pMesh->indices, &pD);
+  indices[0] = pA;
+  indices[1] = pB;
+  indices[2] = pC;
+  indices[3] = pD;
+  dynArrayPushN(pMesh->indices, indices, 4);
   pMesh->isLoaded = false;
   
   return true;
@@ -463,23 +559,547 @@ void meshOffset(mesh3d * pMesh, const vec3 * pOffset) {
   };
 };
 
-// copies our vertex and index data to our GPU, creates/overwrites buffer objects as needed
-// if pFreeBuffers is set to true our source data is freed up
+// Our optimizer reorders the triangles of a mesh so our GPU can reuse more transformed vertices and
+// so triangles on the outside of our mesh are drawn first and occlude the rest (less overdraw).
+// We follow "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" by Sander, Nehab
+// and Barczak (2007):
+// - Tipsify walks our mesh fanning around vertices that are still in our cache
+// - whenever Tipsify can't continue from our cache we start a new cluster, we split these further
+//   where our cache has warmed up enough, and sort our clusters from the outside in
+// - finally we reorder our vertices in the order our indices first use them so fetching them is linear
+
+// simulate a FIFO cache of MESH_VERTEX_CACHE entries for our indices
+void meshMeasureCache(const GLuint * pIndices, GLuint pNumIndices, GLuint pNumVertices, meshOptStats * pStats) {
+  GLuint *  inserted;
+  GLuint    timer = MESH_VERTEX_CACHE + 1;
+  GLuint    misses = 0, used = 0, i;
+
+  pStats->acmr = 0.0;
+  pStats->atvr = 0.0;
+  if ((pNumIndices < 3) || (pNumVertices == 0)) {
+    return;
+  };
+
+  inserted = (GLuint *) calloc(pNumVertices, sizeof(GLuint));
+  if (inserted == NULL) {
+    return;
+  };
+
+  for (i = 0; i < pNumIndices; i++) {
+    GLuint v = pIndices[i];
+
+    if (inserted[v] == 0) {
+      used++;
+    };
+
+    if ((timer - inserted[v]) > MESH_VERTEX_CACHE) {
+      // not in our cache
+      inserted[v] = timer++;
+      misses++;
+    };
+  };
+
+  pStats->acmr = (float) misses / (float) (pNumIndices / 3);
+  pStats->atvr = (float) misses / (float) used;
+
+  free(inserted);
+};
+
+// reorder our triangles with Tipsify, returns our new indices, calling function is responsible for freeing these
+// pClusters is filled with the first triangle of each point where we had to restart our cache
+GLuint * meshOptTipsify(const GLuint * pIndices, GLuint pNumTriangles, GLuint pNumVertices, GLuint * pClusters, GLuint * pNumClusters) {
+  GLuint *  result = (GLuint *) malloc(sizeof(GLuint) * pNumTriangles * 3);
+  GLuint *  offsets = (GLuint *) calloc(pNumVertices + 1, sizeof(GLuint));
+  GLuint *  live = (GLuint *) calloc(pNumVertices, sizeof(GLuint));
+  GLuint *  cacheTime = (GLuint *) calloc(pNumVertices, sizeof(GLuint));
+  GLuint *  adjacency = (GLuint *) malloc(sizeof(GLuint) * pNumTriangles * 3);
+  GLuint *  deadEnd = (GLuint *) malloc(sizeof(GLuint) * pNumTriangles * 3);
+  GLuint *  candidates = (GLuint *) malloc(sizeof(GLuint) * pNumTriangles * 3);
+  bool *    emitted = (bool *) calloc(pNumTriangles, sizeof(bool));
+  GLuint    timer = MESH_VERTEX_CACHE + 1;
+  GLuint    deadEndTop = 0, cursor = 0, numTriangles = 0, i, j;
+  int       fan;
+
+  if ((result == NULL) || (offsets == NULL) || (live == NULL) || (cacheTime == NULL) || (adjacency == NULL) || (deadEnd == NULL) || (candidates == NULL) || (emitted == NULL)) {
+    errorlog(1, "Couldn't allocate memory to optimize our mesh");
+    free(result);
+    result = NULL;
+  } else {
+    // build our vertex to triangle adjacency
+    for (i = 0; i < pNumTriangles * 3; i++) {
+      live[pIndices[i]]++;
+    };
+    for (i = 0; i < pNumVertices; i++) {
+      offsets[i + 1] = offsets[i] + live[i];
+    };
+    for (i = 0; i < pNumTriangles * 3; i++) {
+      GLuint v = pIndices[i];
+      adjacency[offsets[v]++] = i / 3;
+    };
+    for (i = pNumVertices; i > 0; i--) {
+      offsets[i] = offsets[i - 1];
+    };
+    offsets[0] = 0;
+
+    *pNumClusters = 1;
+    pClusters[0] = 0;
+    fan = pIndices[0];
+    while (fan >= 0) {
+      GLuint  numCandidates = 0;
+      int     bestPriority = -1;
+
+      // output all triangles around our fan vertex we haven't output yet
+      for (i = offsets[fan]; i < offsets[fan + 1]; i++) {
+        GLuint t = adjacency[i];
+
+        if (!emitted[t]) {
+          for (j = 0; j < 3; j++) {
+            GLuint v = pIndices[(t * 3) + j];
+
+            result[(numTriangles * 3) + j] = v;
+            deadEnd[deadEndTop++] = v;
+            candidates[numCandidates++] = v;
+            live[v]--;
+
+            if ((timer - cacheTime[v]) > MESH_VERTEX_CACHE) {
+              cacheTime[v] = timer++;
+            };
+          };
+
+          emitted[t] = true;
+          numTriangles++;
+        };
+      };
+
+      // find the next vertex to fan around, we prefer the oldest vertex that will still be in our cache
+      // after we output its remaining triangles
+      fan = -1;
+      for (i = 0; i < numCandidates; i++) {
+        GLuint v = candidates[i];
+
+        if (live[v] > 0) {
+          int priority = 0;
+
+          if ((timer - cacheTime[v]) + (2 * live[v]) <= MESH_VERTEX_CACHE) {
+            priority = timer - cacheTime[v];
+          };
+
+          if (priority > bestPriority) {
+            bestPriority = priority;
+            fan = v;
+          };
+        };
+      };
+
+      if (fan < 0) {
+        // dead end, check recently used vertices first and then just the next vertex with triangles left
+        while ((fan < 0) && (deadEndTop > 0)) {
+          GLuint v = deadEnd[--deadEndTop];
+          if (live[v] > 0) {
+            fan = v;
+          };
+        };
+        while ((fan < 0) && (cursor < pNumVertices)) {
+          if (live[cursor] > 0) {
+            fan = cursor;
+          } else {
+            cursor++;
+          };
+        };
+
+        // we lose our cache here so this is where a new cluster starts
+        if ((fan >= 0) && (numTriangles < pNumTriangles)) {
+          pClusters[(*pNumClusters)++] = numTriangles;
+        };
+      };
+    };
+  };
+
+  free(offsets);
+  free(live);
+  free(cacheTime);
+  free(adjacency);
+  free(deadEnd);
+  free(candidates);
+  free(emitted);
+
+  return result;
+};
+
+// cluster we sort to reduce overdraw
+typedef struct meshOptCluster {
+  GLuint        first;                // first triangle of our cluster
+  GLuint        count;                // number of triangles in our cluster
+  float         sortValue;            // how far our cluster faces outwards
+} meshOptCluster;
+
+// sort our clusters, the ones facing most outward first
+int meshOptCompareClusters(const void * pA, const void * pB) {
+  const meshOptCluster * a = (const meshOptCluster *) pA;
+  const meshOptCluster * b = (const meshOptCluster *) pB;
+
+  if (a->sortValue > b->sortValue) {
+    return -1;
+  } else if (a->sortValue < b->sortValue) {
+    return 1;
+  } else if (a->first < b->first) {
+    return -1;
+  } else if (a->first > b->first) {
+    return 1;
+  } else {
+    return 0;
+  };
+};
+
+// sort the clusters Tipsify gave us so triangles on the outside of our mesh are drawn first
+// we split our clusters further as soon as our cache has warmed up enough that our ACMR stays within pThreshold
+// of the ACMR of the cluster we're splitting, more clusters means more freedom to sort
+// returns our new indices, calling function is responsible for freeing these
+GLuint * meshOptOverdraw(const vertex * pVertices, const GLuint * pIndices, GLuint pNumTriangles, GLuint pNumVertices, const GLuint * pClusters, GLuint pNumClusters, float pThreshold) {
+  GLuint *          result = (GLuint *) malloc(sizeof(GLuint) * pNumTriangles * 3);
+  GLuint *          inserted = (GLuint *) calloc(pNumVertices, sizeof(GLuint));
+  meshOptCluster *  clusters = (meshOptCluster *) malloc(sizeof(meshOptCluster) * pNumTriangles);
+  GLuint            numClusters = 0, timer = MESH_VERTEX_CACHE + 1, c, i, j;
+  vec3              meshCenter;
+  float             meshArea = 0.0;
+
+  if ((result == NULL) || (inserted == NULL) || (clusters == NULL)) {
+    errorlog(1, "Couldn't allocate memory to optimize our mesh");
+    free(result);
+    free(inserted);
+    free(clusters);
+    return NULL;
+  };
+
+  // split our clusters, we restart our cache simulation at each split
+  for (c = 0; c < pNumClusters; c++) {
+    GLuint end = (c + 1 < pNumClusters) ? pClusters[c + 1] : pNumTriangles;
+    GLuint misses = 0;
+    float  acmr;
+
+    // determine the ACMR of our cluster on its own
+    timer += MESH_VERTEX_CACHE + 1;
+    for (i = pClusters[c] * 3; i < end * 3; i++) {
+      GLuint v = pIndices[i];
+
+      if ((timer - inserted[v]) > MESH_VERTEX_CACHE) {
+        inserted[v] = timer++;
+        misses++;
+      };
+    };
+    acmr = (float) misses / (float) (end - pClusters[c]);
+    misses = 0;
+
+    clusters[numClusters].first = pClusters[c];
+    clusters[numClusters].count = 0;
+    timer += MESH_VERTEX_CACHE + 1;
+    for (i = pClusters[c]; i < end; i++) {
+      for (j = 0; j < 3; j++) {
+        GLuint v = pIndices[(i * 3) + j];
+
+        if ((timer - inserted[v]) > MESH_VERTEX_CACHE) {
+          inserted[v] = timer++;
+          misses++;
+        };
+      };
+      clusters[numClusters].count++;
+
+      if ((i + 1 < end) && ((float) misses <= (pThreshold * acmr * clusters[numClusters].count))) {
+        numClusters++;
+        clusters[numClusters].first = i + 1;
+        clusters[numClusters].count = 0;
+        timer += MESH_VERTEX_CACHE + 1;
+        misses = 0;
+      };
+    };
+    numClusters++;
+  };
+
+  // find the center of our mesh, weighted by area
+  vec3Set(&meshCenter, 0.0, 0.0, 0.0);
+  for (i = 0; i < pNumTriangles; i++) {
+    const vec3 * A = &(pVertices[pIndices[(i * 3)]].V);
+    const vec3 * B = &(pVertices[pIndices[(i * 3) + 1]].V);
+    const vec3 * C = &(pVertices[pIndices[(i * 3) + 2]].V);
+    vec3 AB, AC, normal, center;
+    float area;
+
+    vec3Sub(vec3Copy(&AB, B), A);
+    vec3Sub(vec3Copy(&AC, C), A);
+    area = vec3Lenght(vec3Cross(&normal, &AB, &AC));
+
+    vec3Add(vec3Add(vec3Copy(&center, A), B), C);
+    vec3Add(&meshCenter, vec3Mult(&center, area / 3.0));
+    meshArea += area;
+  };
+  if (meshArea > 0.0) {
+    vec3Div(&meshCenter, meshArea);
+  };
+
+  // determine how far each cluster faces away from our center
+  for (c = 0; c < numClusters; c++) {
+    vec3  clusterCenter, clusterNormal;
+    float clusterArea = 0.0;
+
+    vec3Set(&clusterCenter, 0.0, 0.0, 0.0);
+    vec3Set(&clusterNormal, 0.0, 0.0, 0.0);
+    for (i = clusters[c].first; i < clusters[c].first + clusters[c].count; i++) {
+      const vec3 * A = &(pVertices[pIndices[(i * 3)]].V);
+      const vec3 * B = &(pVertices[pIndices[(i * 3) + 1]].V);
+      const vec3 * C = &(pVertices[pIndices[(i * 3) + 2]].V);
+      vec3 AB, AC, normal, center;
+      float area;
+
+      vec3Sub(vec3Copy(&AB, B), A);
+      vec3Sub(vec3Copy(&AC, C), A);
+      area = vec3Lenght(vec3Cross(&normal, &AB, &AC));
+
+      vec3Add(vec3Add(vec3Copy(&center, A), B), C);
+      vec3Add(&clusterCenter, vec3Mult(&center, area / 3.0));
+      vec3Add(&clusterNormal, &normal);
+      clusterArea += area;
+    };
+
+    clusters[c].sortValue = 0.0;
+    if ((clusterArea > 0.0) && (vec3Lenght(&clusterNormal) > 0.0)) {
+      vec3Div(&clusterCenter, clusterArea);
+      vec3Sub(&clusterCenter, &meshCenter);
+      vec3Normalise(&clusterNormal);
+      clusters[c].sortValue = vec3Dot(&clusterCenter, &clusterNormal);
+    };
+  };
+
+  // sort and output our clusters
+  qsort(clusters, numClusters, sizeof(meshOptCluster), meshOptCompareClusters);
+  for (c = 0, i = 0; c < numClusters; c++) {
+    memcpy(result + (i * 3), pIndices + (clusters[c].first * 3), sizeof(GLuint) * 3 * clusters[c].count);
+    i += clusters[c].count;
+  };
+
+  free(inserted);
+  free(clusters);
+
+  return result;
+};
+
+// optimize the order of our triangles and vertices for our vertex cache and overdraw
+// this only works on triangle meshes that still have their data, returns false if nothing was done
+// if pReport is true we log the ACMR (cache misses per triangle) and ATVR (cache misses per vertex) before and after
+bool meshOptimize(mesh3d * pMesh, bool pReport) {
+  GLuint *      clusters;
+  GLuint *      tipsified;
+  GLuint *      ordered;
+  GLuint *      remap;
+  vertex *      vertices;
+  GLuint        numTriangles, numVertices, numClusters = 0, next = 0, i;
+  meshOptStats  before, after, tipsify, overdraw;
+  int           pass;
+
+  if (pMesh == NULL) {
+    return false;
+  } else if ((pMesh->verticesPerFace != 3) || (pMesh->vertices == NULL) || (pMesh->indices == NULL)) {
+    return false;
+  } else if ((pMesh->vertices->numEntries == 0) || (pMesh->indices->numEntries < 3)) {
+    return false;
+  };
+
+  numTriangles = pMesh->indices->numEntries / 3;
+  numVertices = pMesh->vertices->numEntries;
+  meshMeasureCache(pMesh->indices->data, numTriangles * 3, numVertices, &before);
+
+  // reorder our triangles
+  clusters = (GLuint *) malloc(sizeof(GLuint) * numTriangles);
+  if (clusters == NULL) {
+    errorlog(1, "Couldn't allocate memory to optimize our mesh");
+    return false;
+  };
+
+  tipsified = meshOptTipsify(pMesh->indices->data, numTriangles, numVertices, clusters, &numClusters);
+  if (tipsified == NULL) {
+    free(clusters);
+    return false;
+  };
+
+  // sorting for overdraw breaks up our cache at each cluster, we don't accept this costing more than our threshold
+  // if splitting our clusters costs too much we try again with just the clusters Tipsify gave us
+  meshMeasureCache(tipsified, numTriangles * 3, numVertices, &tipsify);
+  for (pass = 0; pass < 2; pass++) {
+    ordered = meshOptOverdraw(pMesh->vertices->data, tipsified, numTriangles, numVertices, clusters, numClusters, pass == 0 ? MESH_OVERDRAW_THRESHOLD : 0.0);
+    if (ordered != NULL) {
+      meshMeasureCache(ordered, numTriangles * 3, numVertices, &overdraw);
+      if (overdraw.acmr <= tipsify.acmr * MESH_OVERDRAW_THRESHOLD) {
+        break;
+      };
+      free(ordered);
+      ordered = NULL;
+    };
+  };
+  free(clusters);
+
+  if (ordered == NULL) {
+    ordered = tipsified;
+    overdraw = tipsify;
+  } else {
+    free(tipsified);
+  };
+
+  // meshes that are already well ordered may get slightly worse, then we keep our triangle order
+  if (overdraw.acmr > before.acmr) {
+    memcpy(ordered, pMesh->indices->data, sizeof(GLuint) * numTriangles * 3);
+  };
+
+  // and reorder our vertices in the order we first use them, any vertices we don't use are dropped
+  remap = (GLuint *) malloc(sizeof(GLuint) * numVertices);
+  vertices = (vertex *) malloc(sizeof(vertex) * numVertices);
+  if ((remap == NULL) || (vertices == NULL)) {
+    errorlog(1, "Couldn't allocate memory to optimize our mesh");
+    free(remap);
+    free(vertices);
+    free(ordered);
+    return false;
+  };
+
+  memset(remap, 0xFF, sizeof(GLuint) * numVertices);
+  for (i = 0; i < numTriangles * 3; i++) {
+    GLuint v = ordered[i];
+
+    if (remap[v] == 0xFFFFFFFF) {
+      memcpy(&(vertices[next]), dynArrayDataAtIndex(pMesh->vertices, v), sizeof(vertex));
+      remap[v] = next++;
+    };
+
+    ordered[i] = remap[v];
+  };
+
+  memcpy(pMesh->vertices->data, vertices, sizeof(vertex) * next);
+  pMesh->vertices->numEntries = next;
+  memcpy(pMesh->indices->data, ordered, sizeof(GLuint) * numTriangles * 3);
+  pMesh->optimized = true;
+
+  if (pReport) {
+    meshMeasureCache(pMesh->indices->data, numTriangles * 3, next, &after);
+    errorlog(0, "Optimized %s, %u triangles in %u clusters, ACMR %0.3f -> %0.3f, ATVR %0.3f -> %0.3f", pMesh->name, numTriangles, numClusters, before.acmr, after.acmr, before.atvr, after.atvr);
+  };
+
+  free(remap);
+  free(vertices);
+  free(ordered);
+
+  return true;
+};
+
+// convert a float to a half float, we round to nearest and flush values too small for a half float to zero
+GLhalf meshFloatToHalf(float pValue) {
+  union {
+    float     f;
+    uint32_t  u;
+  } bits;
+  uint32_t  sign, mantissa;
+  int       exponent;
+
+  bits.f = pValue;
+  sign = (bits.u >> 16) & 0x8000;
+  exponent = (int) ((bits.u >> 23) & 0xFF) - 127 + 15;
+  mantissa = bits.u & 0x7FFFFF;
+
+  if (exponent <= 0) {
+    // too small, we don't bother with denormals
+    return (GLhalf) sign;
+  } else if (exponent >= 31) {
+    // too large (or infinite/NaN), clamp to infinity
+    return (GLhalf) (sign | 0x7C00);
+  };
+
+  // round our mantissa, this may carry into our exponent which is fine
+  mantissa += 0x1000;
+  return (GLhalf) (sign + ((exponent << 10) + (mantissa >> 13)));
+};
+
+// pack a normal into a signed normalized 10_10_10_2 value
+GLuint meshPackNormal(const vec3 * pNormal) {
+  float   values[3] = { pNormal->x, pNormal->y, pNormal->z };
+  GLuint  packed = 0;
+  int     i;
+
+  for (i = 0; i < 3; i++) {
+    float v = values[i] < -1.0 ? -1.0 : (values[i] > 1.0 ? 1.0 : values[i]);
+    int   c = (int) floorf(v * 511.0 + 0.5);
+
+    packed |= ((GLuint) c & 0x3FF) << (i * 10);
+  };
+
+  return packed;
+};
+
+// converts our vertices to our packed layout, positions are stored relative to the bounds of our mesh
+// which we determine here if we don't have them yet
+// returns NULL on failure, calling function is responsible for freeing the data
+packedVertex * meshPackVertices(mesh3d * pMesh, const vertex * pVertices, GLuint pNumVertices) {
+  packedVertex *  packed;
+  vec3            scale;
+  GLuint          i;
+
+  packed = (packedVertex *) malloc(sizeof(packedVertex) * pNumVertices);
+  if (packed == NULL) {
+    errorlog(1, "Couldn't allocate packed vertex data");
+    return NULL;
+  };
+
+  if (!pMesh->hasBounds) {
+    vec3Copy(&(pMesh->minBounds), &(pVertices[0].V));
+    vec3Copy(&(pMesh->maxBounds), &(pVertices[0].V));
+    for (i = 1; i < pNumVertices; i++) {
+      const vec3 * V = &(pVertices[i].V);
+
+      if (pMesh->minBounds.x > V->x) { pMesh->minBounds.x = V->x; };
+      if (pMesh->minBounds.y > V->y) { pMesh->minBounds.y = V->y; };
+      if (pMesh->minBounds.z > V->z) { pMesh->minBounds.z = V->z; };
+
+      if (pMesh->maxBounds.x < V->x) { pMesh->maxBounds.x = V->x; };
+      if (pMesh->maxBounds.y < V->y) { pMesh->maxBounds.y = V->y; };
+      if (pMesh->maxBounds.z < V->z) { pMesh->maxBounds.z = V->z; };
+    };
+    pMesh->hasBounds = true;
+  };
+
+  // our scale maps our bounds to 0 - 65535, a flat axis simply stays 0
+  vec3Sub(vec3Copy(&scale, &(pMesh->maxBounds)), &(pMesh->minBounds));
+  scale.x = scale.x > 0.0 ? 65535.0 / scale.x : 0.0;
+  scale.y = scale.y > 0.0 ? 65535.0 / scale.y : 0.0;
+  scale.z = scale.z > 0.0 ? 65535.0 / scale.z : 0.0;
+
+  for (i = 0; i < pNumVertices; i++) {
+    const vertex * vert = &(pVertices[i]);
+    float x = (vert->V.x - pMesh->minBounds.x) * scale.x;
+    float y = (vert->V.y - pMesh->minBounds.y) * scale.y;
+    float z = (vert->V.z - pMesh->minBounds.z) * scale.z;
+
+    packed[i].V[0] = (GLushort) (x < 0.0 ? 0.0 : (x > 65535.0 ? 65535.0 : x + 0.5));
+    packed[i].V[1] = (GLushort) (y < 0.0 ? 0.0 : (y > 65535.0 ? 65535.0 : y + 0.5));
+    packed[i].V[2] = (GLushort) (z < 0.0 ? 0.0 : (z > 65535.0 ? 65535.0 : z + 0.5));
+    packed[i].V[3] = 0;
+    packed[i].N = meshPackNormal(&(vert->N));
+    packed[i].T[0] = meshFloatToHalf(vert->T.x);
+    packed[i].T[1] = meshFloatToHalf(vert->T.y);
+  };
+
+  return packed;
+};
+
+// copies vertex and index data to our GPU, creates/overwrites buffer objects as needed
+// our data is taken as is so it can come straight from a file we've loaded or mapped
+// unless our mesh is packed or our indices fit in 16 bits, then we convert a copy
 // returns false on failure
-bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers) {
+bool meshCopyDataToGL(mesh3d * pMesh, const vertex * pVertices, GLuint pNumVertices, const GLuint * pIndices, GLuint pNumIndices) {
   if (pMesh == NULL) {
     return false;
   };
   
   // do we have data to load?
-  if ((pMesh->vertices == NULL) || (pMesh->indices==NULL)) {
+  if ((pVertices == NULL) || (pIndices == NULL) || (pNumVertices == 0) || (pNumIndices == 0)) {
     errorlog(3, "No data to copy to GL");
     pMesh->canRender = false;
     return false;
-  } else if ((pMesh->vertices->numEntries == 0) || (pMesh->indices->numEntries == 0)) {
-    errorlog(3, "No data to copy to GL");
-    pMesh->canRender = false;
-    return false;    
   };
 
   // infolog("Copying %s to GL", pMesh->name);
@@ -498,20 +1118,58 @@ bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers) {
   
   // now load our vertices into our first VBO
   glBindBuffer(GL_ARRAY_BUFFER, pMesh->VBO[0]);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex) * pMesh->vertices->numEntries, pMesh->vertices->data, GL_STATIC_DRAW);
-  
-  // now we need to configure our attributes, we use one for our position and one for our color attribute 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) 0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) sizeof(vec3));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) (sizeof(vec3) + sizeof(vec3)));
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  if (pMesh->packed) {
+    packedVertex * packed = meshPackVertices(pMesh, pVertices, pNumVertices);
+    if (packed == NULL) {
+      glBindVertexArray(0);
+      pMesh->canRender = false;
+      return false;
+    };
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packedVertex) * pNumVertices, packed, GL_STATIC_DRAW);
+    free(packed);
+
+    // our attributes are converted back to floats as they are fetched, our shader scales our position to our bounds
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packedVertex), (GLvoid *) 0);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(packedVertex), (GLvoid *) (sizeof(GLushort) * 4));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(packedVertex), (GLvoid *) (sizeof(GLushort) * 4 + sizeof(GLuint)));
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex) * pNumVertices, pVertices, GL_STATIC_DRAW);
+
+    // now we need to configure our attributes, we use one for our position and one for our color attribute 
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) 0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) sizeof(vec3));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid *) (sizeof(vec3) + sizeof(vec3)));
+  };
   
-  // now we load our indices into our second VBO
+  // now we load our indices into our second VBO, if all our vertices can be indexed with 16 bits we use half the memory
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pMesh->VBO[1]);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pMesh->indices->numEntries, pMesh->indices->data, GL_STATIC_DRAW);
-  pMesh->loadedIndices = pMesh->indices->numEntries;
+  if (pNumVertices <= 65536) {
+    GLushort * shortIndices = (GLushort *) malloc(sizeof(GLushort) * pNumIndices);
+    GLuint     i;
+
+    if (shortIndices == NULL) {
+      errorlog(1, "Couldn't allocate index data");
+      glBindVertexArray(0);
+      pMesh->canRender = false;
+      return false;
+    };
+
+    for (i = 0; i < pNumIndices; i++) {
+      shortIndices[i] = (GLushort) pIndices[i];
+    };
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * pNumIndices, shortIndices, GL_STATIC_DRAW);
+    pMesh->indexType = GL_UNSIGNED_SHORT;
+    free(shortIndices);
+  } else {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pNumIndices, pIndices, GL_STATIC_DRAW);
+    pMesh->indexType = GL_UNSIGNED_INT;
+  };
+  pMesh->loadedIndices = pNumIndices;
   
   // at this point in time our two buffers are bound to our vertex array so any time we bind our vertex array
   // our two buffers are bound aswell
@@ -519,6 +1177,32 @@ bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers) {
   // and clear our selected vertex array object
   glBindVertexArray(0);
   
+  pMesh->canRender = true;
+  pMesh->isLoaded = true;
+  return true;
+};
+
+// copies our vertex and index data to our GPU, creates/overwrites buffer objects as needed
+// if pFreeBuffers is set to true our source data is freed up
+// returns false on failure
+bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers) {
+  if (pMesh == NULL) {
+    return false;
+  };
+  
+  // do we have data to load?
+  if ((pMesh->vertices == NULL) || (pMesh->indices==NULL)) {
+    errorlog(3, "No data to copy to GL");
+    pMesh->canRender = false;
+    return false;
+  } else if (!pMesh->optimized) {
+    meshOptimize(pMesh, false);
+  };
+
+  if (!meshCopyDataToGL(pMesh, pMesh->vertices->data, pMesh->vertices->numEntries, pMesh->indices->data, pMesh->indices->numEntries)) {
+    return false;
+  };
+  
   if (pFreeBuffers) {
 //    errorlog(0, "Free vertex array of %p (%p)", pMesh, pMesh->verticesData);
 
@@ -529,8 +1213,6 @@ bool meshCopyToGL(mesh3d * pMesh, bool pFreeBuffers) {
     pMesh->indices = NULL;
   };
   
-  pMesh->canRender = true;
-  pMesh->isLoaded = true;
   return true;
 };
 
@@ -617,8 +1299,8 @@ bool meshTestVolume(mesh3d * pMesh, const mat4 * pMVP) {
   return false;
 };
 
-// render our mesh
-bool meshRender(mesh3d * pMesh) {
+// make sure our mesh is loaded and bind its VAO, returns false if we can't render it
+bool meshBindForRender(mesh3d * pMesh) {
   if (pMesh == NULL) {
     return false;
   } else if (pMesh->canRender == false) {
@@ -641,17 +1323,98 @@ bool meshRender(mesh3d * pMesh) {
   };
   
   glBindVertexArray(pMesh->VAO);
-  if (pMesh->verticesPerFace == 2) {
-    glDrawElements(GL_LINES, pMesh->loadedIndices, GL_UNSIGNED_INT, 0); 
+
+  // our position scale and offset are constant for our whole mesh so we set them as generic attribute values
+  if (pMesh->packed) {
+    glVertexAttrib3f(MESH_POSSCALE_ATTRIB, pMesh->maxBounds.x - pMesh->minBounds.x, pMesh->maxBounds.y - pMesh->minBounds.y, pMesh->maxBounds.z - pMesh->minBounds.z);
+    glVertexAttrib3f(MESH_POSOFFSET_ATTRIB, pMesh->minBounds.x, pMesh->minBounds.y, pMesh->minBounds.z);
+  } else {
+    glVertexAttrib3f(MESH_POSSCALE_ATTRIB, 1.0, 1.0, 1.0);
+    glVertexAttrib3f(MESH_POSOFFSET_ATTRIB, 0.0, 0.0, 0.0);
+  };
+
+  return true;
+};
+
+// render our mesh
+// number of triangles we submit when rendering our mesh, our quad patches count as 2 triangles before tesselation
+unsigned int meshTriangleCount(mesh3d * pMesh) {
+  if (pMesh->verticesPerFace == 3) {
+    return pMesh->loadedIndices / 3;
+  } else if (pMesh->verticesPerFace == 4) {
+    return (pMesh->loadedIndices / 4) * 2;
+  } else {
+    return 0;
+  };
+};
+
+// set the number of views we render to, each view is drawn as a separate instance of our mesh.
+// For stereo we render both eyes in one pass, our shaders use gl_InstanceID to pick the eye (see stereo.inc)
+void meshSetViews(int pViews) {
+  meshViews = pViews < 1 ? 1 : pViews;
+};
+
+bool meshRender(mesh3d * pMesh) {
+  if (!meshBindForRender(pMesh)) {
+    return false;
+  };
+
+  if (meshViews > 1) {
+    if (pMesh->verticesPerFace == 2) {
+      glDrawElementsInstanced(GL_LINES, pMesh->loadedIndices, pMesh->indexType, 0, meshViews);
+    } else if (pMesh->verticesPerFace == 3) {
+      glDrawElementsInstanced(GL_TRIANGLES, pMesh->loadedIndices, pMesh->indexType, 0, meshViews);
+    } else if (pMesh->verticesPerFace == 4) {
+      glDrawElementsInstanced(GL_PATCHES, pMesh->loadedIndices, pMesh->indexType, 0, meshViews);
+    };
+  } else if (pMesh->verticesPerFace == 2) {
+    glDrawElements(GL_LINES, pMesh->loadedIndices, pMesh->indexType, 0); 
   } else if (pMesh->verticesPerFace == 3) {
-    glDrawElements(GL_TRIANGLES, pMesh->loadedIndices, GL_UNSIGNED_INT, 0); 
+    glDrawElements(GL_TRIANGLES, pMesh->loadedIndices, pMesh->indexType, 0); 
   } else if (pMesh->verticesPerFace == 4) {
-    glDrawElements(GL_PATCHES, pMesh->loadedIndices, GL_UNSIGNED_INT, 0); 
+    glDrawElements(GL_PATCHES, pMesh->loadedIndices, pMesh->indexType, 0); 
   };
+  benchCountDraw(meshTriangleCount(pMesh), meshViews);
   
   return true;
 };
 
+// render pCount copies of our mesh in one draw call
+// pInstanceVBO should contain a model matrix (mat4) for each instance starting at pOffset,
+// our shader needs to read these from attribute MESH_INSTANCE_ATTRIB onwards.
+// If we render multiple views each model matrix is used for that many instances in a row
+bool meshRenderInstanced(mesh3d * pMesh, GLuint pInstanceVBO, GLintptr pOffset, GLsizei pCount) {
+  int i;
+
+  if (pCount <= 0) {
+    return true;
+  } else if (pInstanceVBO == GL_UNDEF_OBJ) {
+    errorlog(6, "No instance buffer to render");
+    return false;
+  } else if (!meshBindForRender(pMesh)) {
+    return false;
+  };
+
+  // point our instance attributes at our model matrices, these advance once per instance (or once per set of views)
+  glBindBuffer(GL_ARRAY_BUFFER, pInstanceVBO);
+  for (i = 0; i < 4; i++) {
+    glEnableVertexAttribArray(MESH_INSTANCE_ATTRIB + i);
+    glVertexAttribPointer(MESH_INSTANCE_ATTRIB + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (GLvoid *) (pOffset + (i * sizeof(vec4))));
+    glVertexAttribDivisor(MESH_INSTANCE_ATTRIB + i, meshViews);
+  };
+
+  if (pMesh->verticesPerFace == 2) {
+    glDrawElementsInstanced(GL_LINES, pMesh->loadedIndices, pMesh->indexType, 0, pCount * meshViews);
+  } else if (pMesh->verticesPerFace == 3) {
+    glDrawElementsInstanced(GL_TRIANGLES, pMesh->loadedIndices, pMesh->indexType, 0, pCount * meshViews);
+  } else if (pMesh->verticesPerFace == 4) {
+    glDrawElementsInstanced(GL_PATCHES, pMesh->loadedIndices, pMesh->indexType, 0, pCount * meshViews);
+  };
+  benchCountDraw(meshTriangleCount(pMesh), pCount * meshViews);
+
+  return true;
+};
+
 //////////////////////////////////////////////////////////
 //  Some nice useful primitives....
 
@@ -843,10 +1606,10 @@ bool meshMakeCube(mesh3d * pMesh, GLfloat pWidth, GLfloat pHeight, GLfloat pDept
   
   // reset our buffers but reuse memory (if any)
   if (pMesh->vertices != NULL) {
-    pMesh->vertices->numEntries = 0;    
+    dynArrayClear(pMesh->vertices);
   };
   if (pMesh->indices != NULL) {
-    pMesh->indices->numEntries = 0;
+    dynArrayClear(pMesh->indices);
   };
   
   // add our vertices
@@ -891,10 +1654,10 @@ bool meshMakeSphere(mesh3d * pMesh, GLfloat pRadius) {
   
   // reset our buffers but reuse memory (if any)
   if (pMesh->vertices != NULL) {
-    pMesh->vertices->numEntries = 0;    
+    dynArrayClear(pMesh->vertices);
   };
   if (pMesh->indices != NULL) {
-    pMesh->indices->numEntries = 0;
+    dynArrayClear(pMesh->indices);
   };
 
   // slices of X every 7.5 degrees and yes we duplicate our first vertex (e.g. 145 points)
@@ -941,53 +1704,171 @@ typedef struct objVertexIdx {
   unsigned int  meshVertexIdx;      // resulting index in our mesh vertex buffer
 } objVertexIdx;
 
+// hash map of the vertices we've already added to our mesh
+// we use open addressing with linear probing, a posIdx of 0 marks an empty slot
+typedef struct objVertexMap {
+  unsigned int    size;             // number of slots, always a power of 2
+  unsigned int    count;            // number of slots in use
+  objVertexIdx *  slots;            // our slots
+} objVertexMap;
+
+#define OBJ_MAP_INITSIZE 1024
+
+// hash our index triple
+unsigned int objMapHash(unsigned int pPosIdx, unsigned int pCoordIdx, unsigned int pNormalIdx) {
+  unsigned int hash = pPosIdx * 73856093u;
+  hash ^= pCoordIdx * 19349663u;
+  hash ^= pNormalIdx * 83492791u;
+  hash ^= hash >> 16;
+
+  return hash;
+};
+
+// returns the slot holding our triple or the empty slot where it should be added
+objVertexIdx * objMapFindSlot(objVertexMap * pMap, unsigned int pPosIdx, unsigned int pCoordIdx, unsigned int pNormalIdx) {
+  unsigned int mask = pMap->size - 1;
+  unsigned int i = objMapHash(pPosIdx, pCoordIdx, pNormalIdx) & mask;
+
+  while (true) {
+    objVertexIdx * slot = &pMap->slots[i];
+    if (slot->posIdx == 0) {
+      return slot;
+    } else if ((slot->posIdx == pPosIdx) && (slot->coordIdx == pCoordIdx) && (slot->normalIdx == pNormalIdx)) {
+      return slot;
+    };
+
+    i = (i + 1) & mask;
+  };
+};
+
+// (re)allocate our slots, existing entries are rehashed
+bool objMapResize(objVertexMap * pMap, unsigned int pSize) {
+  objVertexIdx *  oldSlots = pMap->slots;
+  unsigned int    oldSize = pMap->size;
+  unsigned int    i;
+
+  pMap->slots = (objVertexIdx *) calloc(pSize, sizeof(objVertexIdx));
+  if (pMap->slots == NULL) {
+    errorlog(-1, "Couldn't allocate memory for vertex map");
+    pMap->slots = oldSlots;
+    return false;
+  };
+  pMap->size = pSize;
+
+  if (oldSlots != NULL) {
+    for (i = 0; i < oldSize; i++) {
+      if (oldSlots[i].posIdx != 0) {
+        objVertexIdx * slot = objMapFindSlot(pMap, oldSlots[i].posIdx, oldSlots[i].coordIdx, oldSlots[i].normalIdx);
+        memcpy(slot, &oldSlots[i], sizeof(objVertexIdx));
+      };
+    };
+
+    free(oldSlots);
+  };
+
+  return true;
+};
+
+// empty our map but keep our slots for our next mesh
+void objMapClear(objVertexMap * pMap) {
+  if (pMap->slots != NULL) {
+    memset(pMap->slots, 0, sizeof(objVertexIdx) * pMap->size);
+  };
+  pMap->count = 0;
+};
+
+void objMapFree(objVertexMap * pMap) {
+  if (pMap->slots != NULL) {
+    free(pMap->slots);
+    pMap->slots = NULL;
+  };
+  pMap->size = 0;
+  pMap->count = 0;
+};
+
+// skip spaces and tabs but never go beyond pTo
+const char * objSkipSpaces(const char * pFrom, const char * pTo) {
+  while ((pFrom < pTo) && ((*pFrom == ' ') || (*pFrom == '\t'))) {
+    pFrom++;
+  };
+
+  return pFrom;
+};
+
+// parse up to pCount floats separated by whitespace, stops at the first value that doesn't parse (like sscanf would)
+int objParseFloats(const char * pFrom, const char * pTo, float * pValues, int pCount) {
+  int count = 0;
+
+  while (count < pCount) {
+    char * end;
+
+    pFrom = objSkipSpaces(pFrom, pTo);
+    if (pFrom >= pTo) {
+      return count;
+    };
+
+    // note, our line always ends on a CR, LF or 0 so strtof can't run past our line
+    pValues[count] = strtof(pFrom, &end);
+    if (end == pFrom) {
+      return count;
+    };
+
+    pFrom = end;
+    count++;
+  };
+
+  return count;
+};
+
+// parse one index out of a face entry, returns 0 if our entry is empty (like sscanf's %i would leave it)
+unsigned int objParseIndex(const char * pFrom, const char * pTo) {
+  pFrom = objSkipSpaces(pFrom, pTo);
+  if ((pFrom >= pTo) || (*pFrom == '/')) {
+    return 0;
+  };
+
+  return (unsigned int) strtol(pFrom, NULL, 0);
+};
+
+// copy part of our line into a zero terminated buffer, truncating if needed
+void objCopyText(char * pDest, size_t pSize, const char * pFrom, const char * pTo) {
+  size_t len = pTo - pFrom;
+  if (len >= pSize) {
+    len = pSize - 1;
+  };
+
+  memcpy(pDest, pFrom, len);
+  pDest[len] = '\0';
+};
+
 // see if we have our vertex, else adds it, and returns the index
-unsigned int objFindIndex(mesh3d * pMesh, varchar * pText, dynarray * pObjVertices, dynarray * pPos, dynarray * pNorm, dynarray * pCoords) {
+unsigned int objFindIndex(mesh3d * pMesh, const char * pFrom, const char * pTo, objVertexMap * pMap, dynarray * pPos, dynarray * pNorm, dynarray * pCoords) {
   objVertexIdx    findVertex = { 0, 0, 0, 0 };
+  objVertexIdx *  slot;
   vertex          newVertex;
-  unsigned int    from = 0;
-  unsigned int    pos;
-  varchar *       idx;
-  int             i;
-  
-  // add dividers
-  varcharAppend(pText, "///", 3);
-  
-  // find position index
-  pos = varcharPos(pText, "/", from);
-  idx = varcharMid(pText, from, pos);
-  if (idx == NULL) {
-    // huh? really?! we must have a position!
-    return 0;
-  } else {
-    sscanf(idx->text,"%i", &findVertex.posIdx);
-    varcharRelease(idx);
-    
-    from = pos + 1;
-    pos = varcharPos(pText, "/", from);
-    idx = varcharMid(pText, from, pos);
-    if (idx == NULL) {
-      // this is allowed
-      findVertex.coordIdx = 0;
-    } else {
-      sscanf(idx->text,"%i", &findVertex.coordIdx);
-      varcharRelease(idx);      
-    };
-    
-    from = pos + 1;
-    pos = varcharPos(pText, "/", from);
-    idx = varcharMid(pText, from, pos);
-    if (idx == NULL) {
-      // this is allowed
-      findVertex.normalIdx = 0;
-    } else {
-      sscanf(idx->text,"%i", &findVertex.normalIdx);
-      varcharRelease(idx);      
+  const char *    divider;
+
+  // find our position index
+  findVertex.posIdx = objParseIndex(pFrom, pTo);
+
+  // find our texture coordinate index, this is optional
+  divider = memchr(pFrom, '/', pTo - pFrom);
+  if (divider != NULL) {
+    pFrom = divider + 1;
+    findVertex.coordIdx = objParseIndex(pFrom, pTo);
+
+    // find our normal index, this is optional
+    divider = memchr(pFrom, '/', pTo - pFrom);
+    if (divider != NULL) {
+      findVertex.normalIdx = objParseIndex(divider + 1, pTo);
     };
   };
 
   // range check our indices (note they start at 1, 0 = undefined)
-  if (findVertex.posIdx > pPos->numEntries) {
+  if (findVertex.posIdx == 0) {
+    errorlog(0, "Vertex missing");
+    return 0;
+  } else if (findVertex.posIdx > pPos->numEntries) {
     errorlog(0, "Vertex out of bounds %i > %i", findVertex.posIdx, pPos->numEntries);
     return 0;
   };
@@ -997,281 +1878,252 @@ unsigned int objFindIndex(mesh3d * pMesh, varchar * pText, dynarray * pObjVertic
   };
   if (findVertex.normalIdx > pNorm->numEntries) {
     errorlog(0, "Normal out of bounds %i > %i", findVertex.normalIdx, pNorm->numEntries);
-    findVertex.normalIdx = 0;    
+    findVertex.normalIdx = 0;
   };
-  
-//  errorlog(0, "Parsed %i, %i, %i", findVertex.posIdx, findVertex.coordIdx, findVertex.normalIdx);
-  
-  // let's see if we already have it...
-  for (i = 0; i < pObjVertices->numEntries; i++) {
-    objVertexIdx compare;
-    memcpy(&compare, dynArrayDataAtIndex(pObjVertices, i), sizeof(objVertexIdx));
-    if ((compare.posIdx == findVertex.posIdx) && (compare.coordIdx == findVertex.coordIdx) && (compare.normalIdx == findVertex.normalIdx)) {
-      return compare.meshVertexIdx;
+
+  // make sure our map stays at most half full
+  if (pMap->slots == NULL) {
+    if (!objMapResize(pMap, OBJ_MAP_INITSIZE)) {
+      return 0;
+    };
+  } else if ((pMap->count + 1) * 2 > pMap->size) {
+    if (!objMapResize(pMap, pMap->size * 2)) {
+      return 0;
     };
   };
-  
+
+  // let's see if we already have it...
+  slot = objMapFindSlot(pMap, findVertex.posIdx, findVertex.coordIdx, findVertex.normalIdx);
+  if (slot->posIdx != 0) {
+    return slot->meshVertexIdx;
+  };
+
   // setup our new vertex
   vec3Copy(&newVertex.V, (vec3 *)dynArrayDataAtIndex(pPos, findVertex.posIdx - 1));
-  
+
   if (findVertex.coordIdx == 0) {
     newVertex.T.x = 0.0;
     newVertex.T.y = 0.0;
   } else {
-    vec2Copy(&newVertex.T, (vec2 *)dynArrayDataAtIndex(pCoords, findVertex.coordIdx - 1));    
+    vec2Copy(&newVertex.T, (vec2 *)dynArrayDataAtIndex(pCoords, findVertex.coordIdx - 1));
   };
 
   if (findVertex.normalIdx == 0) {
     vec3Copy(&newVertex.N, &newVertex.V);
     vec3Normalise(&newVertex.N);
   } else {
-    vec3Copy(&newVertex.N, (vec3 *)dynArrayDataAtIndex(pNorm, findVertex.normalIdx - 1));    
+    vec3Copy(&newVertex.N, (vec3 *)dynArrayDataAtIndex(pNorm, findVertex.normalIdx - 1));
   };
-  
+
   findVertex.meshVertexIdx = meshAddVertex(pMesh, &newVertex);
-  dynArrayPush(pObjVertices, &findVertex);
-  
+  memcpy(slot, &findVertex, sizeof(objVertexIdx));
+  pMap->count++;
+
   return findVertex.meshVertexIdx;
 };
 
+// check if the marker at the start of our line matches
+bool objIsMarker(const char * pFrom, const char * pTo, const char * pMarker) {
+  size_t len = pTo - pFrom;
+
+  return (strlen(pMarker) == len) && (memcmp(pFrom, pMarker, len) == 0);
+};
+
+// add our current mesh to our list and start a new one
+mesh3d * objNewMesh(mesh3d * pMesh, llist * pAddToMeshList, objVertexMap * pMap, const char * pFrom, const char * pTo) {
+  // first round of our old...
+  if (pMesh != NULL) {
+    llistAddTo(pAddToMeshList, pMesh);
+    meshRelease(pMesh);
+  };
+
+  // our new mesh
+  pMesh = newMesh(0, 0);
+  if (pMesh != NULL) {
+    objCopyText(pMesh->name, sizeof(pMesh->name), pFrom, pTo);
+    pMesh->packed = meshPackObj;
+  };
+
+  // our vertex indices start fresh
+  objMapClear(pMap);
+
+  return pMesh;
+};
+
 // parse data loaded from a wavefront .obj file
-// note that loading the dpDataata from disk should be implemented separately
+// note that loading the data from disk should be implemented separately
 // https://en.wikipedia.org/wiki/Wavefront_.obj_file
+// we parse our data in place, lines and entries are only ever referenced by pointer
 bool meshParseObj(const char * pData, llist * pAddToMeshList, llist * pMaterials, mat4 * pAdjust) {
-  bool          finished = false;
-  unsigned int  pos = 0;
-  unsigned int  start = 0;
-  unsigned int  len = 0;
+  static const char defaultName[] = "Default";
+  const char *  lineStart = pData;
+  const char *  pos = pData;
   int           linecount = 1;
   dynarray *    positions = newDynArray(sizeof(vec3));
   dynarray *    normals = newDynArray(sizeof(vec3));
   dynarray *    coords = newDynArray(sizeof(vec2));
   mesh3d *      mesh = NULL;
-  dynarray *    objVertices = NULL;
+  objVertexMap  objVertices = { 0, 0, NULL };
   mat3          normalMat;
-  
+
   // this will give issues if a non uniform scale is used...
   mat3FromMat4(&normalMat, pAdjust);
-  
-  while (!finished) {
-    if ((pData[pos] == 13) || (pData[pos] == 10) || (pData[pos] == 0)) {
-      if (len > 0) {
-        varchar * line = newVarchar();
-        varcharAppend(line, pData + start, len);
 
-        varcharTrim(line);
-        
-        if (line->text[0] == '#') {
+  while (true) {
+    if ((*pos == 13) || (*pos == 10) || (*pos == 0)) {
+      if (pos > lineStart) {
+        const char * from = lineStart;
+        const char * to = pos;
+
+        // trim spaces and tabs
+        from = objSkipSpaces(from, to);
+        while ((to > from) && ((to[-1] == ' ') || (to[-1] == '\t'))) {
+          to--;
+        };
+
+        if ((from < to) && (*from == '#')) {
           // skip, this is a comment
         } else {
-          unsigned int pos;
-        
-          pos = varcharPos(line, " ", 0);
-          if ((pos != VARCHAR_NOTFOUND) && (pos > 0)) {
-            varchar * what = varcharMid(line, 0, pos);
-            if (what == NULL) {
-              errorlog(linecount, "Insufficient memory");
-            } else {
-              if (what->len == 0) {        
-                errorlog(linecount, "Couldn't extract marker");        
-              } else if (varcharCmp(what, "mtllib") == 0) {
-                // load this material library, we're ignoring this, the material library should already be loaded...
-              } else if (varcharCmp(what, "v") == 0) {
-                // load a vertex
-                vec3 vertex, adjvertex;
-                sscanf(line->text + 2, "%f %f %f", &vertex.x, &vertex.y, &vertex.z);
-                
-                mat4ApplyToVec3(&adjvertex, &vertex, pAdjust);
-              
-                dynArrayPush(positions, &adjvertex);
-              } else if (varcharCmp(what, "vn") == 0) {
-                // load a normal
-                vec3 vertex, adjvertex;
-                sscanf(line->text + 2, "%f %f %f", &vertex.x, &vertex.y, &vertex.z);
-              
-                mat3ApplyToVec3(&adjvertex, &vertex, &normalMat);
-                vec3Normalise(&adjvertex);
-              
-                dynArrayPush(normals, &adjvertex);
-              } else if (varcharCmp(what, "vt") == 0) {
-                // load a texture coordinate
-                vec2 vertex;
-                sscanf(line->text + 2, "%f %f", &vertex.x, &vertex.y);
-
-                vertex.y = 1.0 - vertex.y;
-              
-                dynArrayPush(coords, &vertex);
-              } else if (varcharCmp(what, "o") == 0) {
-                // new object
-                // infolog("Found object %s", line->text + 2);
-                
-                // first round of our old...
-                if (objVertices != NULL) {
-                  dynArrayFree(objVertices);
-                  objVertices = NULL;
-                };
-                if (mesh != NULL) {
-                  llistAddTo(pAddToMeshList, mesh);
-                  meshRelease(mesh);
-                  mesh = NULL;
-                };
-              
-                // our new mesh
-                mesh = newMesh(0, 0);
-                strcpy(mesh->name, line->text + 2);
-              
-                // also need a new vertices index array
-                objVertices = newDynArray(sizeof(objVertexIdx));
-              } else if (varcharCmp(what, "g") == 0) {
-                // new group
-                // infolog("Found group %s", line->text + 2);
-              
-                // first round of our old...
-                if (objVertices != NULL) {
-                  dynArrayFree(objVertices);
-                  objVertices = NULL;
-                };
-                if (mesh != NULL) {
-                  llistAddTo(pAddToMeshList, mesh);
-                  meshRelease(mesh);
-                  mesh = NULL;
-                };
-              
-                // our new mesh
-                mesh = newMesh(0, 0);
-                strcpy(mesh->name, line->text + 2);
-              
-                // also need a new vertices index array
-                objVertices = newDynArray(sizeof(objVertexIdx));
-              } else if (varcharCmp(what, "usemtl") == 0) {
-                // use material
-                if (pMaterials != NULL) {
-                  // first we check if we need to create an object and then we start adding our face
-                  if (mesh == NULL) {
-                    // infolog("Adding default mesh");
-                    mesh = newMesh(0, 0);
-                    strcpy(mesh->name, "Default");                
-                  };
-                  if (objVertices == NULL) {
-                    objVertices = newDynArray(sizeof(objVertexIdx));                
-                  };
-                  
-                  // we only support one material per object...
-                  if (mesh->material == NULL) {
-                    // set our material, if it can't be found NULL is returned which is fine
-                    meshSetMaterial(mesh, getMatByName(pMaterials, line->text + 7));
-                  };
-                };
-              } else if (varcharCmp(what, "s") == 0) {
-                // shininess, ignore for now
-              } else if (varcharCmp(what, "f") == 0) {
-                // face
-                unsigned int from = pos + 1;
-                unsigned int idx[3];
-                int count = 0;
-              
-                // first we check if we need to create an object and then we start adding our face
+          const char * space = memchr(from, ' ', to - from);
+
+          if ((space != NULL) && (space > from)) {
+            const char * args = space + 1;
+
+            if (objIsMarker(from, space, "mtllib")) {
+              // load this material library, we're ignoring this, the material library should already be loaded...
+            } else if (objIsMarker(from, space, "v")) {
+              // load a vertex
+              float values[3] = { 0.0, 0.0, 0.0 };
+              vec3 vertex, adjvertex;
+              objParseFloats(args, to, values, 3);
+              vec3Set(&vertex, values[0], values[1], values[2]);
+
+              mat4ApplyToVec3(&adjvertex, &vertex, pAdjust);
+
+              dynArrayPush(positions, &adjvertex);
+            } else if (objIsMarker(from, space, "vn")) {
+              // load a normal
+              float values[3] = { 0.0, 0.0, 0.0 };
+              vec3 vertex, adjvertex;
+              objParseFloats(args, to, values, 3);
+              vec3Set(&vertex, values[0], values[1], values[2]);
+
+              mat3ApplyToVec3(&adjvertex, &vertex, &normalMat);
+              vec3Normalise(&adjvertex);
+
+              dynArrayPush(normals, &adjvertex);
+            } else if (objIsMarker(from, space, "vt")) {
+              // load a texture coordinate
+              float values[2] = { 0.0, 0.0 };
+              vec2 vertex;
+              objParseFloats(args, to, values, 2);
+
+              vertex.x = values[0];
+              vertex.y = 1.0 - values[1];
+
+              dynArrayPush(coords, &vertex);
+            } else if (objIsMarker(from, space, "o") || objIsMarker(from, space, "g")) {
+              // new object or group
+              mesh = objNewMesh(mesh, pAddToMeshList, &objVertices, args, to);
+            } else if (objIsMarker(from, space, "usemtl")) {
+              // use material
+              if (pMaterials != NULL) {
+                // first we check if we need to create an object
                 if (mesh == NULL) {
-                  // infolog("Adding default mesh");
-                  mesh = newMesh(0, 0);
-                  strcpy(mesh->name, "Default");                
+                  mesh = objNewMesh(NULL, pAddToMeshList, &objVertices, defaultName, defaultName + strlen(defaultName));
+                };
+
+                // we only support one material per object...
+                if ((mesh != NULL) && (mesh->material == NULL)) {
+                  char matName[256];
+                  objCopyText(matName, sizeof(matName), args, to);
+
+                  // set our material, if it can't be found NULL is returned which is fine
+                  meshSetMaterial(mesh, getMatByName(pMaterials, matName));
                 };
-                if (objVertices == NULL) {
-                  objVertices = newDynArray(sizeof(objVertexIdx));                
+              };
+            } else if (objIsMarker(from, space, "s")) {
+              // shininess, ignore for now
+            } else if (objIsMarker(from, space, "f")) {
+              // face
+              unsigned int idx[3];
+              int count = 0;
+
+              // first we check if we need to create an object and then we start adding our face
+              if (mesh == NULL) {
+                mesh = objNewMesh(NULL, pAddToMeshList, &objVertices, defaultName, defaultName + strlen(defaultName));
+              };
+
+              // now process our face data, entries are separated by spaces
+              while ((mesh != NULL) && (args < to)) {
+                const char * entryEnd = memchr(args, ' ', to - args);
+                if (entryEnd == NULL) {
+                  entryEnd = to;
                 };
-              
-                // errorlog(linecount, "Testing '%s'", line->text);
-              
-                // append a space to our line so we can more easily process the line
-                varcharAppend(line, " ", 1);
-
-                // now process our face data...
-                while ((pos = varcharPos(line, " ", from)) != VARCHAR_NOTFOUND) {
-                  varchar * index = varcharMid(line, from, pos - from);
-                  if (index == NULL) {
-                    // ignore
-                  } else if (index->len == 0) {
-                    // ignore
-                    varcharRelease(index);
-                  } else {
-                    // errorlog(linecount, "Found: '%s'", index->text);                
-                    if (count < 2) {
-                      idx[count] = objFindIndex(mesh, index, objVertices, positions, normals, coords);
-                      count++;
-                    } else {
-                      idx[2] = objFindIndex(mesh, index, objVertices, positions, normals, coords);
-                  
-                      meshAddFace(mesh, idx[2], idx[1], idx[0]);
-                      idx[1] = idx[2];
-                    };
-                  
-                    varcharRelease(index);
-                  };                
-                
-                  from = pos + 1;
+
+                if (entryEnd == args) {
+                  // ignore empty entries
+                } else if (count < 2) {
+                  idx[count] = objFindIndex(mesh, args, entryEnd, &objVertices, positions, normals, coords);
+                  count++;
+                } else {
+                  idx[2] = objFindIndex(mesh, args, entryEnd, &objVertices, positions, normals, coords);
+
+                  meshAddFace(mesh, idx[2], idx[1], idx[0]);
+                  idx[1] = idx[2];
                 };
-              } else {
-                errorlog(linecount, "Unknown type %s", what->text);              
+
+                args = entryEnd + 1;
               };
-          
-              // no longer needed
-              varcharRelease(what);            
+            } else {
+              errorlog(linecount, "Unknown type %.*s", (int) (space - from), from);
             };
           } else {
             // for now we report what is unhandled
-            errorlog(linecount, "Can't parse line %s", line->text);          
+            errorlog(linecount, "Can't parse line %.*s", (int) (to - from), from);
           };
         };
-        
-        varcharRelease(line);
       };
-      
-      if ((pData[pos] == 13) && (pData[pos+1] == 10)) {
+
+      if (*pos == 0) {
+        // we're done
+        break;
+      } else if ((pos[0] == 13) && (pos[1] == 10)) {
         // window crlf, skip the lf
         pos++;
       };
 
       // next line...
-      start = pos + 1;
-      len = 0;
+      pos++;
+      lineStart = pos;
       linecount++;
     } else {
-      len++;
-    };
-    
-    if (pData[pos] == 0) {
-      finished = true;
-    } else {
-      pos++;      
+      pos++;
     };
   };
-  
-  // add our final mesh  
-  if (objVertices != NULL) {
-    dynArrayFree(objVertices);
-    objVertices = NULL;
-  };
 
+  // add our final mesh
   if (mesh != NULL) {
     llistAddTo(pAddToMeshList, mesh);
     meshRelease(mesh);
     mesh = NULL;
   };
-  
+
   // free up our temporary data
+  objMapFree(&objVertices);
   if (positions != NULL) {
     dynArrayFree(positions);
     positions = NULL;
   }
   if (normals != NULL) {
     dynArrayFree(normals);
-    normals = NULL;    
+    normals = NULL;
   };
   if (coords != NULL) {
     dynArrayFree(coords);
-    coords = NULL;    
+    coords = NULL;
   };
-  
+
   return true;
 };
 
@@ -0,0 +1,537 @@
+/********************************************************
+ * meshcache.h - binary mesh cache library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define MESH_IMPLEMENTATION
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions.
+ *
+ * Parsing a wavefront file is slow, we need to tokenize
+ * the text, convert numbers, dedupe our vertices and
+ * apply our adjustment matrix. After we've done this once
+ * we write the result to a cache file next to our source
+ * file, <file>.cache, which contains:
+ * - a header with the size, modification time and hash
+ *   of our source file and the adjustment matrix used
+ * - a table with one entry per mesh with its name,
+ *   material name, bounds and where its data lives
+ * - all our vertices in one stream
+ * - all our indices in one stream
+ *
+ * On the next run we map the cache file into memory and
+ * hand our vertex and index streams straight to GL.
+ *
+ * If the size and modification time of our source file
+ * don't match we hash our source file, if the hash still
+ * matches (say the file was copied) we update the time
+ * in our cache, else we parse our source file again.
+ *
+ * Our cache uses the byte order and vertex layout of the
+ * machine that wrote it, the version and sizes in our
+ * header make sure we never load a cache we can't use.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ * 0.2  16-10-2026  Optimize our meshes before we write our cache
+ *
+ ********************************************************/
+
+#ifndef meshcacheh
+#define meshcacheh
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "system.h"
+#include "linkedlist.h"
+#include "math3d.h"
+#include "material.h"
+#include "mesh3d.h"
+#include "benchmark.h"
+
+// increase this whenever our layout or the way we parse our source changes
+#define MESHCACHE_VERSION     2
+
+// header at the start of our cache file
+typedef struct meshCacheHeader {
+  char          magic[4];             // always "MSHC"
+  uint32_t      version;              // MESHCACHE_VERSION
+  uint32_t      vertexSize;           // sizeof(vertex) when written
+  uint32_t      indexSize;            // sizeof(GLuint) when written
+  uint64_t      sourceSize;           // size of our source file
+  int64_t       sourceTime;           // modification time of our source file
+  uint32_t      sourceHash;           // FNV-1a hash of our source file
+  uint32_t      meshCount;            // number of meshes in our table
+  mat4          adjust;               // adjustment matrix applied when parsing
+  uint64_t      vertexOffset;         // offset of our vertex stream
+  uint64_t      indexOffset;          // offset of our index stream
+  uint64_t      fileSize;             // total size of our cache file
+} meshCacheHeader;
+
+// entry in our mesh table, follows our header
+typedef struct meshCacheEntry {
+  char          name[50];             // name of our mesh
+  char          material[50];         // name of our material, empty if none
+  int32_t       verticesPerFace;      // vertices per face
+  uint32_t      firstVertex;          // first vertex in our vertex stream
+  uint32_t      vertexCount;          // number of vertices
+  uint32_t      firstIndex;           // first index in our index stream
+  uint32_t      indexCount;           // number of indices
+  vec3          minBounds;            // minimum of our vertices
+  vec3          maxBounds;            // maximum of our vertices
+} meshCacheEntry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t meshCacheHash(const void * pData, size_t pSize);
+bool meshCacheWrite(const char * pFileName, llist * pMeshList, const meshCacheHeader * pSource);
+bool meshCacheRead(const char * pFileName, llist * pAddToMeshList, llist * pMaterials, const char * pSourceName, const meshCacheHeader * pSource);
+bool meshLoadObj(const char * pPath, const char * pFileName, llist * pAddToMeshList, llist * pMaterials, mat4 * pAdjust);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef MESH_IMPLEMENTATION
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// file we've mapped into memory
+typedef struct mcMapping {
+  const char *  data;                 // our data
+  size_t        size;                 // size of our data
+#if defined(WIN32) || defined(_WIN32)
+  HANDLE        file;                 // our file handle
+  HANDLE        map;                  // our mapping handle
+#else
+  int           file;                 // our file descriptor
+#endif
+} mcMapping;
+
+// map a file into memory, returns false on failure
+bool mcMap(mcMapping * pMapping, const char * pFileName) {
+#if defined(WIN32) || defined(_WIN32)
+  LARGE_INTEGER size;
+
+  pMapping->data = NULL;
+  pMapping->map = NULL;
+  pMapping->file = CreateFileA(pFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (pMapping->file == INVALID_HANDLE_VALUE) {
+    return false;
+  } else if (!GetFileSizeEx(pMapping->file, &size) || (size.QuadPart == 0)) {
+    CloseHandle(pMapping->file);
+    return false;
+  };
+  pMapping->size = (size_t) size.QuadPart;
+
+  pMapping->map = CreateFileMappingA(pMapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (pMapping->map == NULL) {
+    CloseHandle(pMapping->file);
+    return false;
+  };
+
+  pMapping->data = (const char *) MapViewOfFile(pMapping->map, FILE_MAP_READ, 0, 0, 0);
+  if (pMapping->data == NULL) {
+    CloseHandle(pMapping->map);
+    CloseHandle(pMapping->file);
+    return false;
+  };
+#else
+  struct stat   st;
+  void *        data;
+
+  pMapping->data = NULL;
+  pMapping->file = open(pFileName, O_RDONLY);
+  if (pMapping->file < 0) {
+    return false;
+  } else if ((fstat(pMapping->file, &st) != 0) || (st.st_size == 0)) {
+    close(pMapping->file);
+    return false;
+  };
+  pMapping->size = (size_t) st.st_size;
+
+  data = mmap(NULL, pMapping->size, PROT_READ, MAP_PRIVATE, pMapping->file, 0);
+  if (data == MAP_FAILED) {
+    close(pMapping->file);
+    return false;
+  };
+  pMapping->data = (const char *) data;
+#endif
+
+  return true;
+};
+
+// unmap a file we mapped with mcMap
+void mcUnmap(mcMapping * pMapping) {
+  if (pMapping->data == NULL) {
+    return;
+  };
+
+#if defined(WIN32) || defined(_WIN32)
+  UnmapViewOfFile(pMapping->data);
+  CloseHandle(pMapping->map);
+  CloseHandle(pMapping->file);
+#else
+  munmap((void *) pMapping->data, pMapping->size);
+  close(pMapping->file);
+#endif
+
+  pMapping->data = NULL;
+};
+
+// FNV-1a hash of a block of data
+uint32_t meshCacheHash(const void * pData, size_t pSize) {
+  const unsigned char * data = (const unsigned char *) pData;
+  uint32_t              hash = 2166136261u;
+  size_t                i;
+
+  for (i = 0; i < pSize; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  };
+
+  return hash;
+};
+
+// write our mesh list to a cache file
+// pSource should have our source size, time, hash and adjustment matrix filled in
+// returns false on failure
+bool meshCacheWrite(const char * pFileName, llist * pMeshList, const meshCacheHeader * pSource) {
+  meshCacheHeader header;
+  meshCacheEntry  entry;
+  llistNode *     node;
+  FILE *          file;
+  uint32_t        vertexCount = 0;
+  uint32_t        indexCount = 0;
+  bool            success = true;
+
+  // build our header
+  memcpy(&header, pSource, sizeof(meshCacheHeader));
+  memcpy(header.magic, "MSHC", 4);
+  header.version = MESHCACHE_VERSION;
+  header.vertexSize = sizeof(vertex);
+  header.indexSize = sizeof(GLuint);
+  header.meshCount = 0;
+
+  for (node = pMeshList->first; node != NULL; node = node->next) {
+    mesh3d * mesh = (mesh3d *) node->data;
+
+    header.meshCount++;
+    if ((mesh->vertices != NULL) && (mesh->indices != NULL)) {
+      vertexCount += mesh->vertices->numEntries;
+      indexCount += mesh->indices->numEntries;
+    };
+  };
+
+  header.vertexOffset = sizeof(meshCacheHeader) + (header.meshCount * sizeof(meshCacheEntry));
+  header.vertexOffset = (header.vertexOffset + 15) & ~((uint64_t) 15);
+  header.indexOffset = header.vertexOffset + ((uint64_t) vertexCount * sizeof(vertex));
+  header.fileSize = header.indexOffset + ((uint64_t) indexCount * sizeof(GLuint));
+
+  file = fopen(pFileName, "wb");
+  if (file == NULL) {
+    errorlog(-1, "Couldn't create mesh cache %s", pFileName);
+    return false;
+  };
+
+  success = fwrite(&header, sizeof(meshCacheHeader), 1, file) == 1;
+
+  // write our mesh table
+  vertexCount = 0;
+  indexCount = 0;
+  for (node = pMeshList->first; success && (node != NULL); node = node->next) {
+    mesh3d * mesh = (mesh3d *) node->data;
+    int      i;
+
+    memset(&entry, 0, sizeof(meshCacheEntry));
+    strncpy(entry.name, mesh->name, sizeof(entry.name) - 1);
+    if (mesh->material != NULL) {
+      strncpy(entry.material, mesh->material->name, sizeof(entry.material) - 1);
+    };
+    entry.verticesPerFace = mesh->verticesPerFace;
+    entry.firstVertex = vertexCount;
+    entry.firstIndex = indexCount;
+
+    if ((mesh->vertices != NULL) && (mesh->indices != NULL)) {
+      entry.vertexCount = mesh->vertices->numEntries;
+      entry.indexCount = mesh->indices->numEntries;
+
+      // determine our bounds
+      for (i = 0; i < entry.vertexCount; i++) {
+        vertex * vert = (vertex *) dynArrayDataAtIndex(mesh->vertices, i);
+
+        if ((i == 0) || (entry.minBounds.x > vert->V.x)) { entry.minBounds.x = vert->V.x; };
+        if ((i == 0) || (entry.minBounds.y > vert->V.y)) { entry.minBounds.y = vert->V.y; };
+        if ((i == 0) || (entry.minBounds.z > vert->V.z)) { entry.minBounds.z = vert->V.z; };
+
+        if ((i == 0) || (entry.maxBounds.x < vert->V.x)) { entry.maxBounds.x = vert->V.x; };
+        if ((i == 0) || (entry.maxBounds.y < vert->V.y)) { entry.maxBounds.y = vert->V.y; };
+        if ((i == 0) || (entry.maxBounds.z < vert->V.z)) { entry.maxBounds.z = vert->V.z; };
+      };
+    };
+
+    vertexCount += entry.vertexCount;
+    indexCount += entry.indexCount;
+
+    success = fwrite(&entry, sizeof(meshCacheEntry), 1, file) == 1;
+  };
+
+  // pad up to our vertex stream
+  if (success) {
+    char padding[16];
+    long size = (long) (header.vertexOffset - sizeof(meshCacheHeader) - (header.meshCount * sizeof(meshCacheEntry)));
+
+    memset(padding, 0, sizeof(padding));
+    success = (size == 0) || (fwrite(padding, 1, size, file) == size);
+  };
+
+  // write our vertex stream
+  for (node = pMeshList->first; success && (node != NULL); node = node->next) {
+    mesh3d * mesh = (mesh3d *) node->data;
+
+    if ((mesh->vertices != NULL) && (mesh->indices != NULL) && (mesh->vertices->numEntries > 0)) {
+      success = fwrite(mesh->vertices->data, sizeof(vertex), mesh->vertices->numEntries, file) == mesh->vertices->numEntries;
+    };
+  };
+
+  // write our index stream
+  for (node = pMeshList->first; success && (node != NULL); node = node->next) {
+    mesh3d * mesh = (mesh3d *) node->data;
+
+    if ((mesh->vertices != NULL) && (mesh->indices != NULL) && (mesh->indices->numEntries > 0)) {
+      success = fwrite(mesh->indices->data, sizeof(GLuint), mesh->indices->numEntries, file) == mesh->indices->numEntries;
+    };
+  };
+
+  if (fclose(file) != 0) {
+    success = false;
+  };
+
+  if (!success) {
+    // don't leave a broken cache behind
+    errorlog(-1, "Couldn't write mesh cache %s", pFileName);
+    remove(pFileName);
+  };
+
+  return success;
+};
+
+// check if the header of our cache is one we can use, returns false if not
+bool mcCheckHeader(const mcMapping * pMapping, const meshCacheHeader * pHeader) {
+  if (pMapping->size < sizeof(meshCacheHeader)) {
+    return false;
+  } else if (memcmp(pHeader->magic, "MSHC", 4) != 0) {
+    return false;
+  } else if (pHeader->version != MESHCACHE_VERSION) {
+    return false;
+  } else if ((pHeader->vertexSize != sizeof(vertex)) || (pHeader->indexSize != sizeof(GLuint))) {
+    return false;
+  } else if (pHeader->fileSize != pMapping->size) {
+    return false;
+  } else if (pHeader->vertexOffset < sizeof(meshCacheHeader) + ((uint64_t) pHeader->meshCount * sizeof(meshCacheEntry))) {
+    return false;
+  } else if ((pHeader->indexOffset < pHeader->vertexOffset) || (pHeader->fileSize < pHeader->indexOffset)) {
+    return false;
+  };
+
+  return true;
+};
+
+// update the modification time in our cache after we found our source unchanged
+void mcUpdateTime(const char * pFileName, int64_t pTime) {
+  FILE * file = fopen(pFileName, "r+b");
+  if (file != NULL) {
+    if (fseek(file, offsetof(meshCacheHeader, sourceTime), SEEK_SET) == 0) {
+      fwrite(&pTime, sizeof(int64_t), 1, file);
+    };
+    fclose(file);
+  };
+};
+
+// load our meshes from a cache file
+// pSource should have our source size, time and adjustment matrix filled in,
+// if our time doesn't match we hash pSourceName to check if it has changed
+// returns false if our cache is missing or stale, in which case nothing is added to our list
+bool meshCacheRead(const char * pFileName, llist * pAddToMeshList, llist * pMaterials, const char * pSourceName, const meshCacheHeader * pSource) {
+  mcMapping               mapping;
+  const meshCacheHeader * header;
+  const meshCacheEntry *  entries;
+  const vertex *          vertices;
+  const GLuint *          indices;
+  uint64_t                vertexCount, indexCount;
+  int                     i;
+
+  if (!mcMap(&mapping, pFileName)) {
+    return false;
+  };
+
+  header = (const meshCacheHeader *) mapping.data;
+  if (!mcCheckHeader(&mapping, header)) {
+    errorlog(0, "Mesh cache %s is not compatible", pFileName);
+    mcUnmap(&mapping);
+    return false;
+  } else if (header->sourceSize != pSource->sourceSize) {
+    mcUnmap(&mapping);
+    return false;
+  } else if (memcmp(&(header->adjust), &(pSource->adjust), sizeof(mat4)) != 0) {
+    mcUnmap(&mapping);
+    return false;
+  } else if (header->sourceTime != pSource->sourceTime) {
+    // our file may simply have been copied, check our hash
+    char *   text = loadFile("", pSourceName);
+    uint32_t hash;
+
+    if (text == NULL) {
+      mcUnmap(&mapping);
+      return false;
+    };
+    hash = meshCacheHash(text, pSource->sourceSize);
+    free(text);
+
+    if (hash != header->sourceHash) {
+      mcUnmap(&mapping);
+      return false;
+    };
+
+    mcUpdateTime(pFileName, pSource->sourceTime);
+  };
+
+  // check our mesh table before we create anything
+  entries = (const meshCacheEntry *) (mapping.data + sizeof(meshCacheHeader));
+  vertexCount = (header->indexOffset - header->vertexOffset) / sizeof(vertex);
+  indexCount = (header->fileSize - header->indexOffset) / sizeof(GLuint);
+  for (i = 0; i < header->meshCount; i++) {
+    if (((uint64_t) entries[i].firstVertex + entries[i].vertexCount > vertexCount) ||
+        ((uint64_t) entries[i].firstIndex + entries[i].indexCount > indexCount)) {
+      errorlog(0, "Mesh cache %s is corrupt", pFileName);
+      mcUnmap(&mapping);
+      return false;
+    };
+  };
+
+  // and create our meshes, our data goes straight from our mapping into GL
+  vertices = (const vertex *) (mapping.data + header->vertexOffset);
+  indices = (const GLuint *) (mapping.data + header->indexOffset);
+  for (i = 0; i < header->meshCount; i++) {
+    mesh3d * mesh = newMesh(0, 0);
+
+    if (mesh != NULL) {
+      memcpy(mesh->name, entries[i].name, sizeof(mesh->name));
+      mesh->name[sizeof(mesh->name) - 1] = '\0';
+      mesh->verticesPerFace = entries[i].verticesPerFace;
+      mesh->packed = meshPackObj;
+
+      if ((pMaterials != NULL) && (entries[i].material[0] != '\0')) {
+        char matName[50];
+
+        memcpy(matName, entries[i].material, sizeof(matName));
+        matName[sizeof(matName) - 1] = '\0';
+
+        // set our material, if it can't be found NULL is returned which is fine
+        meshSetMaterial(mesh, getMatByName(pMaterials, matName));
+      };
+
+      mesh->hasBounds = true;
+      vec3Copy(&(mesh->minBounds), &(entries[i].minBounds));
+      vec3Copy(&(mesh->maxBounds), &(entries[i].maxBounds));
+
+      if ((entries[i].vertexCount == 0) || (entries[i].indexCount == 0)) {
+        // nothing to render, same as what meshCopyToGL would decide
+        mesh->canRender = false;
+      } else {
+        meshCopyDataToGL(mesh, vertices + entries[i].firstVertex, entries[i].vertexCount, indices + entries[i].firstIndex, entries[i].indexCount);
+      };
+
+      llistAddTo(pAddToMeshList, mesh);
+      meshRelease(mesh);
+    };
+  };
+
+  mcUnmap(&mapping);
+  return true;
+};
+
+// load a wavefront .obj file through our cache
+// if we have a valid cache we load that, else we parse our file and write a new cache
+// returns false on failure
+bool meshLoadObj(const char * pPath, const char * pFileName, llist * pAddToMeshList, llist * pMaterials, mat4 * pAdjust) {
+  char            sourceName[1024];
+  char            cacheName[1024];
+  meshCacheHeader source;
+  struct stat     st;
+  double          start = benchGetTime();
+  char *          text;
+  llist *         meshes;
+  llistNode *     node;
+
+  sprintf(sourceName, "%s%s", pPath, pFileName);
+  sprintf(cacheName, "%s%s.cache", pPath, pFileName);
+
+  if (stat(sourceName, &st) != 0) {
+    errorlog(-100, "Couldn't open %s", sourceName);
+    return false;
+  };
+
+  memset(&source, 0, sizeof(meshCacheHeader));
+  source.sourceSize = (uint64_t) st.st_size;
+  source.sourceTime = (int64_t) st.st_mtime;
+  mat4Copy(&(source.adjust), pAdjust);
+
+  // warm load
+  if (meshCacheRead(cacheName, pAddToMeshList, pMaterials, sourceName, &source)) {
+    errorlog(0, "Loaded %s from cache in %0.3f ms", pFileName, benchGetTime() - start);
+    return true;
+  };
+
+  // cold load, we parse into our own list so we only write what is in this file to our cache
+  text = loadFile(pPath, pFileName);
+  if (text == NULL) {
+    return false;
+  };
+
+  meshes = newMeshList();
+  source.sourceHash = meshCacheHash(text, source.sourceSize);
+  if (!meshParseObj(text, meshes, pMaterials, pAdjust)) {
+    llistFree(meshes);
+    free(text);
+    return false;
+  };
+  free(text);
+
+  // optimize our meshes once so our cache stores them in their optimized order
+  for (node = meshes->first; node != NULL; node = node->next) {
+    meshOptimize((mesh3d *) node->data, true);
+  };
+
+  errorlog(0, "Parsed %s in %0.3f ms", pFileName, benchGetTime() - start);
+
+  meshCacheWrite(cacheName, meshes, &source);
+
+  // and add our meshes to our list
+  for (node = meshes->first; node != NULL; node = node->next) {
+    llistAddTo(pAddToMeshList, node->data);
+  };
+  llistFree(meshes);
+
+  return true;
+};
+
+#endif /* MESH_IMPLEMENTATION */
+
+#endif /* !meshcacheh */
@@ -16,6 +16,27 @@
  * Revision history:
  * 0.1  08-02-2016  First version with basic functions
  * 0.2  13-02-2016  Added copy function
+ * 0.3  16-10-2026  Render repeated meshes instanced
+ * 0.4  16-10-2026  Added bounding volume hierarchy for culling
+ * 0.5  16-10-2026  Cull using bounding boxes instead of our bounds mesh
+ * 0.6  16-10-2026  Sort what we render through a render queue
+ * 0.7  16-10-2026  Added profiler scopes for culling, sorting
+ *                  and drawing
+ * 0.8  16-10-2026  Reuse our per frame arrays through dynArrayClear
+ *                  and skip bounds checks in our culling loops
+ * 0.9  16-10-2026  Render point light shadows to a cube map in
+ *                  one pass
+ * 0.10 16-10-2026  Mark nodes that move as dynamic so our shadow
+ *                  passes can render static and dynamic casters
+ *                  separately
+ * 0.11 16-10-2026  Use the bounds of meshes that only have their
+ *                  vertices in GL memory
+ * 0.12 16-10-2026  Nodes can render a chunked LOD terrain
+ * 0.13 16-10-2026  Cull and sort each view into its own render view
+ *                  so views can be built as jobs
+ * 0.14 16-10-2026  Refit our BVH when nodes with bounds move
+ * 0.15 16-10-2026  Hide meshes whose material fails once no view
+ *                  is being culled
  *
  ********************************************************/
 
@@ -29,11 +50,55 @@
 #include "math3d.h"
 #include "material.h"
 #include "mesh3d.h"
+#include "cull.h"
+#include "renderqueue.h"
+#include "profiler.h"
+#include "jobs.h"
+#include "terrain.h"
+
+// minimum number of consecutive copies of a mesh before we render them instanced
+#define MESHNODE_MININSTANCES 4
+
+// maximum number of leaves in a node of our bounding volume hierarchy and its maximum depth
+// note that we test up to 4 leaves in one go so there is little point in going higher
+#define BVH_MAXLEAVES 4
+#define BVH_MAXDEPTH 64
+
+// which shadow casters we render, our shadow cache renders the casters that never move separately from those that do
+#define MESHNODE_ALLCASTERS     0
+#define MESHNODE_STATICCASTERS  1
+#define MESHNODE_DYNAMICCASTERS 2
+
+// leaf of our bounding volume hierarchy
+typedef struct bvhLeaf {
+  struct meshNode * node;             /* node we're culling, not retained, our node tree takes care of this */
+  mat4          parent;               /* model matrix of the parent of our node relative to the node holding our BVH */
+  aabb          box;                  /* bounding box of our node relative to the node holding our BVH */
+} bvhLeaf;
+
+// node of our bounding volume hierarchy
+typedef struct bvhNode {
+  aabb          box;                  /* bounding box containing all leaves of this node */
+  unsigned int  left;                 /* index of our left child, our right child follows it, 0 if we have no children */
+  unsigned int  firstLeaf;            /* first leaf contained within this node */
+  unsigned int  numLeaves;            /* number of leaves contained within this node */
+  aabb4         leafBoxes;            /* boxes of our leaves so we can test them in one go, only used if we have no children */
+} bvhNode;
+
+// bounding volume hierarchy build over the child nodes of a node
+typedef struct meshNodeBVH {
+  dynarray *    leaves;               /* leaves for the nodes we cull */
+  dynarray *    unbounded;            /* leaves for nodes without bounds, these are always added */
+  dynarray *    nodes;                /* our hierarchy, entry 0 is our root */
+} meshNodeBVH;
 
 // structure for managing instances of mesh data
 typedef struct meshNode {
   unsigned int  retainCount;          /* retain count for this object */
   bool          visible;              /* if true we render the mesh(es) contained within this node */
+  bool          dynamic;              /* if true this node (and everything below it) moves */
+  bool          hasDynamic;           /* if true one of the nodes below this node is dynamic */
+  bool          moved;                /* if true our position changed since the BVH culling us was last refitted */
   char          name[250];            /* name for this node */
   
   // LOD limits
@@ -47,18 +112,43 @@ typedef struct meshNode {
 
   // bounding volume
   mesh3d *      bounds;               /* if set, this is our bounding box that we check against */
+  aabb          boundsBox;            /* our bounds as an axis aligned box in local space */
   
   // children
   llist *       children;             /* child nodes */
   bool          firstVisOnly;         /* render the first visible child only (LOD) */
+
+  // culling
+  meshNodeBVH * bvh;                  /* if set, our child nodes are culled through this BVH */
+
+  // terrain
+  terrain *     terrain;              /* if set, we select and render the chunks of this terrain */
 } meshNode;
 
+// everything we need to render one view of our scene. Building our view culls and sorts our scene without touching GL
+// or anything shared between views so several views can be built as jobs while our GL thread renders
+typedef struct renderView {
+  meshNode *      scene;              /* node we render, not retained, our scene must not change while our view is built */
+  shaderMatrices  matrices;           /* our own copy of our matrices, we cache our view-projection and eye position in here */
+  float           radius;             /* if larger then 0 we cull everything outside of a box of this radius around our view */
+  int             casters;            /* which shadow casters we add */
+  bool            shadow;             /* if true we only queue shadow casters */
+  bool            queued;             /* true if our view was built or queued since we last cleared it */
+  renderQueue *   opaque;             /* our opaque meshes or our shadow casters */
+  renderQueue *   alpha;              /* our meshes with alpha */
+  dynarray *      scratch;            /* indices of the BVH leaves and terrain chunks we're processing, nested queries add to the end */
+  jobCounter      pending;            /* counts our build job */
+} renderView;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void meshNodeSetRenderBounds(bool pSet);
 void meshNodeSetBoundsDebugMaterial(material * pBoundsMat);
+void meshNodeSetInstancing(bool pSet);
+void meshNodeFreeInstancing(void);
+void meshNodeFreeRenderQueues(void);
 
 meshNode * newMeshNode(const char * pName);
 meshNode * newCopyMeshNode(const char *pName, meshNode * pCopy, bool pDeepCopy);
@@ -67,11 +157,33 @@ void meshNodeRetain(meshNode * pNode);
 void meshNodeRelease(meshNode * pNode);
 void meshNodeSetMesh(meshNode * pNode, mesh3d * pMesh);
 void meshNodeSetBounds(meshNode * pNode, mesh3d * pBounds);
+void meshNodeSetTerrain(meshNode * pNode, terrain * pTerrain);
+void meshNodeSetDynamic(meshNode * pNode, bool pDynamic);
+bool meshNodeHasDynamic(const meshNode * pNode);
 void meshNodeMakeBounds(meshNode *pNode);
 void meshNodeAddChild(meshNode * pNode, meshNode * pChild);
 void meshNodeAddChildren(meshNode *pNode, llist * pMeshList);
+void meshNodeSetPosition(meshNode * pNode, const mat4 * pPosition);
+void meshNodeBuildBVH(meshNode * pNode);
+void meshNodeRefitBVH(meshNode * pNode);
+void meshNodeFreeBVH(meshNode * pNode);
+unsigned int meshNodeQueryBVH(const meshNode * pNode, const frustum * pFrustum, dynarray * pVisible);
+
+renderView * newRenderView(void);
+void rviewFree(renderView * pView);
+void rviewClear(renderView * pView);
+void rviewBuild(renderView * pView, meshNode * pScene, const shaderMatrices * pMatrices, float pRadius, int pCasters, bool pShadow);
+void rviewQueue(renderView * pView, meshNode * pScene, const shaderMatrices * pMatrices, float pRadius, int pCasters, bool pShadow);
+unsigned int rviewWait(renderView * pView);
+void meshNodeRenderView(renderView * pView, shaderMatrices * pMatrices, material * pDefaultMaterial);
+void meshNodeShadowRenderView(renderView * pView, shaderMatrices * pMatrices, bool pLayered);
+void meshNodeHideFailed(void);
+
 void meshNodeRender(meshNode * pNode, shaderMatrices * pMatrices, material * pDefaultMaterial);
-void meshNodeShadowMap(meshNode *pNode, shaderMatrices * pMatrices);
+unsigned int meshNodeShadowQueue(meshNode *pNode, shaderMatrices * pMatrices, float pRadius, int pCasters);
+void meshNodeShadowRender(shaderMatrices * pMatrices, bool pLayered);
+void meshNodeShadowMap(meshNode *pNode, shaderMatrices * pMatrices, int pCasters);
+void meshNodeShadowCube(meshNode *pNode, shaderMatrices * pMatrices, float pRadius, int pCasters);
 
 #ifdef __cplusplus
 };
@@ -81,6 +193,12 @@ void meshNodeShadowMap(meshNode *pNode, shaderMatrices * pMatrices);
 
 bool mNrenderBounds = false;
 material * mNboundsMaterial = NULL;
+bool mNinstancing = true;
+GLuint mNinstanceVBO = GL_UNDEF_OBJ;
+dynarray * mNinstanceData = NULL;
+dynarray * mNobjectData = NULL;
+renderView * mNview = NULL;
+dynarray * mNfailed = NULL;
 
 // enable/disable rendering our bounds
 void meshNodeSetRenderBounds(bool pSet) {
@@ -93,12 +211,50 @@ void meshNodeSetBoundsDebugMaterial(material * pBoundsMat) {
   mNboundsMaterial = pBoundsMat;
 };
 
+// enable/disable rendering repeated meshes instanced
+void meshNodeSetInstancing(bool pSet) {
+  mNinstancing = pSet;
+};
+
+// free our instance buffer, call this before our GL context is destroyed
+void meshNodeFreeInstancing(void) {
+  if (mNinstanceVBO != GL_UNDEF_OBJ) {
+    glDeleteBuffers(1, &mNinstanceVBO);
+    mNinstanceVBO = GL_UNDEF_OBJ;
+  };
+
+  if (mNinstanceData != NULL) {
+    dynArrayFree(mNinstanceData);
+    mNinstanceData = NULL;
+  };
+
+  if (mNobjectData != NULL) {
+    dynArrayFree(mNobjectData);
+    mNobjectData = NULL;
+  };
+};
+
+// free the view we reuse for meshNodeRender and our shadow functions
+void meshNodeFreeRenderQueues(void) {
+  if (mNview != NULL) {
+    rviewFree(mNview);
+    mNview = NULL;
+  };
+  if (mNfailed != NULL) {
+    dynArrayFree(mNfailed);
+    mNfailed = NULL;
+  };
+};
+
 // create a new mesh node
 meshNode * newMeshNode(const char * pName) {
   meshNode * newNode = (meshNode *) malloc(sizeof(meshNode));
   if (newNode != NULL) {
     newNode->retainCount = 1;
     newNode->visible = true;
+    newNode->dynamic = false;
+    newNode->hasDynamic = false;
+    newNode->moved = false;
     strcpy(newNode->name, pName);
     newNode->maxDist = 0;
     mat4Identity(&newNode->position);
@@ -106,6 +262,8 @@ meshNode * newMeshNode(const char * pName) {
     newNode->bounds = NULL;
     newNode->children = newMeshNodeList();
     newNode->firstVisOnly = false;
+    newNode->bvh = NULL;
+    newNode->terrain = NULL;
   };
   
   return newNode;
@@ -123,6 +281,9 @@ meshNode * newCopyMeshNode(const char *pName, meshNode * pCopy, bool pDeepCopy)
     llistNode * lnode;
     newNode->retainCount = 1;
     newNode->visible = pCopy->visible;
+    newNode->dynamic = pCopy->dynamic;
+    newNode->hasDynamic = false; /* set again as we add our children */
+    newNode->moved = false;
     strcpy(newNode->name, pName);
     newNode->maxDist = pCopy->maxDist;
     mat4Copy(&newNode->position, &pCopy->position);
@@ -132,6 +293,9 @@ meshNode * newCopyMeshNode(const char *pName, meshNode * pCopy, bool pDeepCopy)
     meshNodeSetBounds(newNode, pCopy->bounds); /* now assign our bounds, note that we're thus retaining the same mesh as the node we're copying */
     newNode->children = newMeshNodeList();
     newNode->firstVisOnly = pCopy->firstVisOnly;
+    newNode->bvh = NULL; /* our copy needs to build its own BVH if required */
+    newNode->terrain = NULL; /* start NULL! */
+    meshNodeSetTerrain(newNode, pCopy->terrain); /* we share our terrain with the node we're copying */
 
     // now copy our children
     lnode = pCopy->children->first;
@@ -185,6 +349,12 @@ void meshNodeRelease(meshNode * pNode) {
 
     // free our bounds if its set
     meshNodeSetBounds(pNode, NULL);
+
+    // free our BVH if its set
+    meshNodeFreeBVH(pNode);
+
+    // free our terrain if its set
+    meshNodeSetTerrain(pNode, NULL);
     
     // free our children
     if (pNode->children != NULL) {
@@ -221,17 +391,88 @@ void meshNodeSetBounds(meshNode * pNode, mesh3d * pBounds) {
     return;
   } else if (pNode->bounds == pBounds) {
     return;
+  } else if ((pBounds != NULL) && ((pBounds->vertices == NULL) || (pBounds->vertices->numEntries == 0))) {
+    errorlog(-1, "Bounds for %s have no vertices", pNode->name);
+    return;
   } else {
     if (pNode->bounds != NULL) {
       meshRelease(pNode->bounds);
     };
     pNode->bounds = pBounds;
     if (pNode->bounds != NULL) {
+      vec3 minVec, maxVec;
+      int  i;
+
       meshRetain(pNode->bounds);
+
+      // and store the box around our bounds, this is what we use to cull
+      vec3Copy(&minVec, (vec3 *) dynArrayDataAtIndex(pBounds->vertices, 0));
+      vec3Copy(&maxVec, &minVec);
+      for (i = 1; i < pBounds->vertices->numEntries; i++) {
+        vec3 * vertice = (vec3 *) dynArrayDataAtIndex(pBounds->vertices, i);
+
+        if (minVec.x > vertice->x) { minVec.x = vertice->x; };
+        if (minVec.y > vertice->y) { minVec.y = vertice->y; };
+        if (minVec.z > vertice->z) { minVec.z = vertice->z; };
+
+        if (maxVec.x < vertice->x) { maxVec.x = vertice->x; };
+        if (maxVec.y < vertice->y) { maxVec.y = vertice->y; };
+        if (maxVec.z < vertice->z) { maxVec.z = vertice->z; };
+      };
+      aabbFromMinMax(&pNode->boundsBox, &minVec, &maxVec);
     };    
   };  
 };
 
+// set (or unset) the terrain our node renders, the terrain will be release/retained as needed
+// note that our terrain only takes the position of our node into account, it can't be rotated or scaled
+void meshNodeSetTerrain(meshNode * pNode, terrain * pTerrain) {
+  if (pNode == NULL) {
+    errorlog(-1, "Attempted to set terrain for a NULL node");
+    return;
+  } else if (pNode->terrain == pTerrain) {
+    return;
+  } else {
+    if (pNode->terrain != NULL) {
+      terrainRelease(pNode->terrain);
+    };
+    pNode->terrain = pTerrain;
+    if (pNode->terrain != NULL) {
+      terrainRetain(pNode->terrain);
+    };
+  };
+};
+
+// change the position of our node, use this instead of changing position directly once our node is culled through a BVH
+// so its box is updated when our BVH is refitted
+void meshNodeSetPosition(meshNode * pNode, const mat4 * pPosition) {
+  if (pNode == NULL) {
+    errorlog(-1, "Attempted to set position for a NULL node");
+  } else {
+    mat4Copy(&pNode->position, pPosition);
+    pNode->moved = true;
+  };
+};
+
+// mark our node as dynamic if it moves, our shadow passes render dynamic nodes separately from our static nodes
+// note that our parent only learns about this when we're added to it so set this before adding our node to our scene
+void meshNodeSetDynamic(meshNode * pNode, bool pDynamic) {
+  if (pNode == NULL) {
+    errorlog(-1, "Attempted to mark a NULL node as dynamic");
+  } else {
+    pNode->dynamic = pDynamic;
+  };
+};
+
+// returns true if our node or any of the nodes below it are dynamic
+bool meshNodeHasDynamic(const meshNode * pNode) {
+  if (pNode == NULL) {
+    return false;
+  } else {
+    return pNode->dynamic || pNode->hasDynamic;
+  };
+};
+
 void meshNodeGetMinMax(meshNode *pNode, vec3 * pMin, vec3 * pMax, const mat4 * pModel) {
   llistNode * child;
   int i;
@@ -272,6 +513,24 @@ void meshNodeGetMinMax(meshNode *pNode, vec3 * pMin, vec3 * pMax, const mat4 * p
           if (pMin->y > vertice.y) { pMin->y = vertice.y; };
           if (pMin->z > vertice.z) { pMin->z = vertice.z; };
 
+          if (pMax->x < vertice.x) { pMax->x = vertice.x; };
+          if (pMax->y < vertice.y) { pMax->y = vertice.y; };
+          if (pMax->z < vertice.z) { pMax->z = vertice.z; };
+        };
+      } else if (pNode->mesh->hasBounds) {
+        // our vertices only live in GL memory, use the corners of our bounds
+        for (i = 0; i < 8; i++) {
+          vec3 vertice, corner;
+
+          corner.x = (i & 1) ? pNode->mesh->maxBounds.x : pNode->mesh->minBounds.x;
+          corner.y = (i & 2) ? pNode->mesh->maxBounds.y : pNode->mesh->minBounds.y;
+          corner.z = (i & 4) ? pNode->mesh->maxBounds.z : pNode->mesh->minBounds.z;
+          mat4ApplyToVec3(&vertice, &corner, pModel);
+
+          if (pMin->x > vertice.x) { pMin->x = vertice.x; };
+          if (pMin->y > vertice.y) { pMin->y = vertice.y; };
+          if (pMin->z > vertice.z) { pMin->z = vertice.z; };
+
           if (pMax->x < vertice.x) { pMax->x = vertice.x; };
           if (pMax->y < vertice.y) { pMax->y = vertice.y; };
           if (pMax->z < vertice.z) { pMax->z = vertice.z; };
@@ -353,6 +612,14 @@ void meshNodeAddChild(meshNode * pNode, meshNode * pChild) {
     return;
   } else {
     llistAddTo(pNode->children, pChild);
+
+    // our BVH doesn't know about our new child and would skip it, free it so we render all our children until it is rebuilt
+    meshNodeFreeBVH(pNode);
+
+    // remember if something below us moves so our shadow passes know where to look for dynamic casters
+    if (meshNodeHasDynamic(pChild)) {
+      pNode->hasDynamic = true;
+    };
   };
 };
 
@@ -381,35 +648,372 @@ void meshNodeAddChildren(meshNode *pNode, llist * pMeshList) {
   };
 };
 
-// structure for storing info about transparent meshes that we render later on
+// calculate the bounding box of the node in our leaf relative to the node holding our BVH
+void meshNodeBVHLeafBox(bvhLeaf * pLeaf) {
+  mat4 model;
+
+  mat4Copy(&model, &pLeaf->parent);
+  mat4Multiply(&model, &pLeaf->node->position);
+  aabbTransform(&pLeaf->box, &pLeaf->node->boundsBox, &model);
+};
+
+// collect the nodes we can cull through our BVH, we look through nodes that are only used for positioning
+void meshNodeBVHCollect(meshNodeBVH * pBVH, meshNode * pNode, const mat4 * pParent) {
+  bvhLeaf leaf;
+
+  leaf.node = pNode;
+  mat4Copy(&leaf.parent, pParent);
+
+  if (pNode->bounds != NULL) {
+    // we can cull this node as a whole
+    meshNodeBVHLeafBox(&leaf);
+    dynArrayPush(pBVH->leaves, &leaf);
+  } else if ((pNode->mesh == NULL) && (pNode->terrain == NULL) && (pNode->maxDist == 0) && (pNode->firstVisOnly == false) && (pNode->visible) && (pNode->bvh == NULL)) {
+    // just a positioning node, check our children
+    llistNode * node = pNode->children->first;
+    mat4 model;
+
+    mat4Copy(&model, pParent);
+    mat4Multiply(&model, &pNode->position);
+
+    while (node != NULL) {
+      meshNodeBVHCollect(pBVH, (meshNode *) node->data, &model);
+      node = node->next;
+    };
+  } else {
+    // we can't cull this so we always add it
+    dynArrayPush(pBVH->unbounded, &leaf);
+  };
+};
+
+// copy the boxes of the leaves of our node so we can test them in one go
+void meshNodeBVHLeafBoxes(meshNodeBVH * pBVH, bvhNode * pNode) {
+  unsigned int i;
+
+  aabb4Clear(&pNode->leafBoxes);
+  for (i = 0; (i < pNode->numLeaves) && (i < 4); i++) {
+    bvhLeaf * leaf = (bvhLeaf *) dynArrayDataAtIndex(pBVH->leaves, pNode->firstLeaf + i);
+
+    aabb4SetBox(&pNode->leafBoxes, i, &leaf->box);
+  };
+};
+
+// get the center of our leaf along one axis
+MATH3D_FLOAT meshNodeBVHCenter(const bvhLeaf * pLeaf, int pAxis) {
+  switch (pAxis) {
+    case 0: return pLeaf->box.center.x;
+    case 1: return pLeaf->box.center.y;
+    default: return pLeaf->box.center.z;
+  };
+};
+
+// recursively split our node until each node holds at most BVH_MAXLEAVES leaves
+void meshNodeBVHSplit(meshNodeBVH * pBVH, unsigned int pIndex, unsigned int pFirst, unsigned int pCount, int pDepth) {
+  bvhNode *     node = (bvhNode *) dynArrayDataAtIndex(pBVH->nodes, pIndex);
+  bvhLeaf *     leaves = (bvhLeaf *) dynArrayDataAtIndex(pBVH->leaves, pFirst);
+  bvhNode       child;
+  vec3          minVec, maxVec;
+  MATH3D_FLOAT  size, split;
+  unsigned int  i, j, left;
+  int           axis;
+
+  // get our bounding box and the bounds of our leaves centers
+  vec3Copy(&node->box.center, &leaves[0].box.center);
+  vec3Copy(&node->box.extent, &leaves[0].box.extent);
+  vec3Copy(&minVec, &leaves[0].box.center);
+  vec3Copy(&maxVec, &leaves[0].box.center);
+  for (i = 1; i < pCount; i++) {
+    aabbMerge(&node->box, &leaves[i].box);
+
+    if (minVec.x > leaves[i].box.center.x) { minVec.x = leaves[i].box.center.x; };
+    if (minVec.y > leaves[i].box.center.y) { minVec.y = leaves[i].box.center.y; };
+    if (minVec.z > leaves[i].box.center.z) { minVec.z = leaves[i].box.center.z; };
+
+    if (maxVec.x < leaves[i].box.center.x) { maxVec.x = leaves[i].box.center.x; };
+    if (maxVec.y < leaves[i].box.center.y) { maxVec.y = leaves[i].box.center.y; };
+    if (maxVec.z < leaves[i].box.center.z) { maxVec.z = leaves[i].box.center.z; };
+  };
+
+  node->left = 0;
+  node->firstLeaf = pFirst;
+  node->numLeaves = pCount;
+
+  if ((pCount <= BVH_MAXLEAVES) || (pDepth >= BVH_MAXDEPTH - 1)) {
+    // small enough
+    meshNodeBVHLeafBoxes(pBVH, node);
+    return;
+  };
+
+  // split along our largest axis
+  axis = 0;
+  size = maxVec.x - minVec.x;
+  split = (minVec.x + maxVec.x) * 0.5;
+  if ((maxVec.y - minVec.y) > size) {
+    axis = 1;
+    size = maxVec.y - minVec.y;
+    split = (minVec.y + maxVec.y) * 0.5;
+  };
+  if ((maxVec.z - minVec.z) > size) {
+    axis = 2;
+    size = maxVec.z - minVec.z;
+    split = (minVec.z + maxVec.z) * 0.5;
+  };
+
+  // partition our leaves around the middle
+  i = 0;
+  j = pCount;
+  while (i < j) {
+    if (meshNodeBVHCenter(&leaves[i], axis) < split) {
+      i++;
+    } else {
+      bvhLeaf swap;
+
+      j--;
+      memcpy(&swap, &leaves[i], sizeof(bvhLeaf));
+      memcpy(&leaves[i], &leaves[j], sizeof(bvhLeaf));
+      memcpy(&leaves[j], &swap, sizeof(bvhLeaf));
+    };
+  };
+
+  if ((i == 0) || (i == pCount)) {
+    // all our centers are in the same spot, just split our list in half
+    i = pCount / 2;
+  };
+
+  // add our two children, note that this may move our node in memory
+  memset(&child, 0, sizeof(bvhNode));
+  left = pBVH->nodes->numEntries;
+  dynArrayPush(pBVH->nodes, &child);
+  dynArrayPush(pBVH->nodes, &child);
+  ((bvhNode *) dynArrayDataAtIndex(pBVH->nodes, pIndex))->left = left;
+
+  meshNodeBVHSplit(pBVH, left, pFirst, i, pDepth + 1);
+  meshNodeBVHSplit(pBVH, left + 1, pFirst + i, pCount - i, pDepth + 1);
+};
+
+// build a bounding volume hierarchy over the child nodes of our node, when rendering we use this to cull our child nodes
+// note that adding a child to our node frees our BVH, we need to rebuild it after that. We also need to rebuild it if
+// nodes are added or removed further down, if nodes that are only used for positioning move or if bounds change.
+// If a node with bounds moves through meshNodeSetPosition, meshNodeRefitBVH updates its box
+void meshNodeBuildBVH(meshNode * pNode) {
+  meshNodeBVH * bvh;
+  llistNode *   node;
+  mat4          model;
+
+  if (pNode == NULL) {
+    errorlog(-1, "Attempted to build a BVH for a NULL node");
+    return;
+  };
+
+  // free what we had
+  meshNodeFreeBVH(pNode);
+
+  bvh = (meshNodeBVH *) malloc(sizeof(meshNodeBVH));
+  if (bvh == NULL) {
+    errorlog(-1, "Couldn't allocate memory for BVH");
+    return;
+  };
+
+  bvh->leaves = newDynArray(sizeof(bvhLeaf));
+  bvh->unbounded = newDynArray(sizeof(bvhLeaf));
+  bvh->nodes = newDynArray(sizeof(bvhNode));
+  if ((bvh->leaves == NULL) || (bvh->unbounded == NULL) || (bvh->nodes == NULL)) {
+    errorlog(-1, "Couldn't allocate memory for BVH");
+    pNode->bvh = bvh;
+    meshNodeFreeBVH(pNode);
+    return;
+  };
+
+  // collect our leaves, these are relative to our node
+  mat4Identity(&model);
+  node = pNode->children->first;
+  while (node != NULL) {
+    meshNodeBVHCollect(bvh, (meshNode *) node->data, &model);
+    node = node->next;
+  };
+
+  // and build our hierarchy
+  if (bvh->leaves->numEntries > 0) {
+    bvhNode root;
+
+    memset(&root, 0, sizeof(bvhNode));
+    dynArrayPush(bvh->nodes, &root);
+    meshNodeBVHSplit(bvh, 0, 0, bvh->leaves->numEntries, 0);
+  };
+
+  pNode->bvh = bvh;
+};
+
+// update the bounding boxes in our BVH for nodes with bounds that moved since our last refit, call this once per frame
+// before we cull. Our hierarchy itself stays the same so it may get less tight, rebuild it if nodes move a lot
+void meshNodeRefitBVH(meshNode * pNode) {
+  meshNodeBVH * bvh;
+  bool          refit = false;
+  unsigned int  i, j;
+
+  if (pNode == NULL) {
+    return;
+  } else if (pNode->bvh == NULL) {
+    return;
+  };
+
+  bvh = pNode->bvh;
+
+  // update the leaves of nodes that moved
+  for (i = 0; i < bvh->leaves->numEntries; i++) {
+    bvhLeaf * leaf = (bvhLeaf *) dynArrayItem(bvh->leaves, i);
+
+    if (leaf->node->moved) {
+      meshNodeBVHLeafBox(leaf);
+      leaf->node->moved = false;
+      refit = true;
+    };
+  };
+
+  if (!refit) {
+    return;
+  };
+
+  // now update our nodes, our children always come after their parent so we work backwards
+  for (i = bvh->nodes->numEntries; i > 0; i--) {
+    bvhNode * node = (bvhNode *) dynArrayItem(bvh->nodes, i - 1);
+
+    if (node->left == 0) {
+      bvhLeaf * leaves = (bvhLeaf *) dynArrayItem(bvh->leaves, node->firstLeaf);
+
+      memcpy(&node->box, &leaves[0].box, sizeof(aabb));
+      for (j = 1; j < node->numLeaves; j++) {
+        aabbMerge(&node->box, &leaves[j].box);
+      };
+
+      meshNodeBVHLeafBoxes(bvh, node);
+    } else {
+      bvhNode * children = (bvhNode *) dynArrayItem(bvh->nodes, node->left);
+
+      memcpy(&node->box, &children[0].box, sizeof(aabb));
+      aabbMerge(&node->box, &children[1].box);
+    };
+  };
+};
+
+// free the BVH of our node
+void meshNodeFreeBVH(meshNode * pNode) {
+  if (pNode == NULL) {
+    return;
+  } else if (pNode->bvh == NULL) {
+    return;
+  };
+
+  if (pNode->bvh->leaves != NULL) {
+    dynArrayFree(pNode->bvh->leaves);
+  };
+  if (pNode->bvh->unbounded != NULL) {
+    dynArrayFree(pNode->bvh->unbounded);
+  };
+  if (pNode->bvh->nodes != NULL) {
+    dynArrayFree(pNode->bvh->nodes);
+  };
+
+  free(pNode->bvh);
+  pNode->bvh = NULL;
+};
+
+// find the leaves of our BVH that are (partially) within our frustum, pFrustum must be relative to our node
+// the indices of these leaves are added to pVisible, we don't change our BVH so several views can query it at the same time.
+// Returns the number of leaves found
+unsigned int meshNodeQueryBVH(const meshNode * pNode, const frustum * pFrustum, dynarray * pVisible) {
+  meshNodeBVH * bvh;
+  unsigned int  stack[BVH_MAXDEPTH * 2];
+  unsigned int  masks[BVH_MAXDEPTH * 2];
+  unsigned int  count;
+  int           top = 0;
+
+  if (pNode == NULL) {
+    return 0;
+  } else if (pNode->bvh == NULL) {
+    return 0;
+  } else if (pVisible == NULL) {
+    return 0;
+  };
+
+  bvh = pNode->bvh;
+  count = pVisible->numEntries;
+  if (bvh->nodes->numEntries == 0) {
+    return 0;
+  };
+
+  // start with our root node
+  stack[0] = 0;
+  masks[0] = CULL_ALLPLANES;
+  top = 1;
+
+  while (top > 0) {
+    bvhNode *     node;
+    unsigned int  mask, i;
+    int           result;
+
+    top--;
+    node = (bvhNode *) dynArrayItem(bvh->nodes, stack[top]);
+    mask = masks[top];
+    result = frustumTestAABB(pFrustum, &node->box, &mask);
+
+    if (result == CULL_OUTSIDE) {
+      // nothing to see here
+    } else if (result == CULL_INSIDE) {
+      // everything below this node is visible, no need to test further
+      for (i = node->firstLeaf; i < node->firstLeaf + node->numLeaves; i++) {
+        dynArrayPush(pVisible, &i);
+      };
+    } else if ((node->left == 0) && (node->numLeaves <= 4)) {
+      // test our leaves against the planes we intersect in one go
+      unsigned int visible = frustumTestAABB4(pFrustum, &node->leafBoxes, mask);
+
+      for (i = 0; i < node->numLeaves; i++) {
+        if (visible & (1 << i)) {
+          unsigned int index = node->firstLeaf + i;
+          dynArrayPush(pVisible, &index);
+        };
+      };
+    } else if (node->left == 0) {
+      // test our leaves against the planes we intersect
+      for (i = node->firstLeaf; i < node->firstLeaf + node->numLeaves; i++) {
+        bvhLeaf *     leaf = (bvhLeaf *) dynArrayItem(bvh->leaves, i);
+        unsigned int  leafMask = mask;
+
+        if (frustumTestAABB(pFrustum, &leaf->box, &leafMask) != CULL_OUTSIDE) {
+          dynArrayPush(pVisible, &i);
+        };
+      };
+    } else {
+      // test our children
+      stack[top] = node->left;
+      masks[top] = mask;
+      top++;
+      stack[top] = node->left + 1;
+      masks[top] = mask;
+      top++;
+    };
+  };
+
+  return pVisible->numEntries - count;
+};
+
+// payload of our render queues
 typedef struct renderMesh {
   mesh3d *  mesh;
   mat4      model;
   GLfloat   z;
 } renderMesh;
 
-// build our no-alpha and alpha render lists based on the contents of our node
-bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, shaderMatrices * pMatrices, dynarray * pNoAlpha, dynarray * pAlpha, bool pCheckBounds) {
-  mat4 model;
-  
-  // is there anything to do?
-  if (pNode == NULL) {
-    return false;
-  } else if (pNode->visible == false) {
-    return false;
-  };
-  
-  // make our model matrix
-  mat4Copy(&model, pModel);
-  mat4Multiply(&model, &pNode->position);
-
+// check if our node is within its maximum distance to our camera
+bool meshNodeInRange(const meshNode * pNode, const mat4 * pModel, shaderMatrices * pMatrices) {
   // check our distance
   if (pNode->maxDist > 0) {
     float distance;
     vec3  pos, eye;
 
     // first get our position from our model matrix
-    vec3Set(&pos, model.m[3][0], model.m[3][1], model.m[3][2]);
+    vec3Set(&pos, pModel->m[3][0], pModel->m[3][1], pModel->m[3][2]);
 
     // then get our eye position
     shdMatGetEyePos(pMatrices, &eye);
@@ -424,37 +1028,97 @@ bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, shader
       return false;
     };
   };
-  
-  if (pNode->bounds != NULL && pCheckBounds) {
-    mat4 mvp;
 
-    mat4Copy(&mvp, shdMatGetViewProjection(pMatrices));
-    mat4Multiply(&mvp, &model);
-    if (meshTestVolume(pNode->bounds, &mvp) == false) {
-      // yes we're not rendering but we did pass our LOD test so we're done...
-      return true;
-    };
+  return true;
+};
 
-    if ((mNrenderBounds) && (pAlpha != NULL)) {
-      renderMesh render;
+// select the chunks of our terrain and add them to the opaque queue of our view, pModel is the model matrix of our node
+// all our chunks share one mesh so they end up next to each other in our queue and are rendered instanced
+void meshNodeAddTerrain(const terrain * pTerrain, const mat4 * pModel, renderView * pView) {
+  material *    mat = pTerrain->mesh == NULL ? NULL : pTerrain->mesh->material;
+  renderMesh    render;
+  frustum       f;
+  vec3          eye;
+  mat4          mv;
+  unsigned int  i, first, count;
+
+  if (mat == NULL) {
+    return;
+  } else if (pTerrain->mesh->visible == false) {
+    return;
+  };
 
-      // make sure we don't loose our buffers
-      if (pNode->bounds->isLoaded == false) {
-        meshCopyToGL(pNode->bounds, false);
-      };
+  // we always cull our chunks, even when our static shadow casters aren't, as our selection changes with our view anyway.
+  // Our frustum and eye need to be relative to our node
+  mat4Copy(&mv, shdMatGetViewProjection(&pView->matrices));
+  mat4Multiply(&mv, pModel);
+  frustumFromMatrix(&f, &mv);
+  shdMatGetEyePos(&pView->matrices, &eye);
+  eye.x -= pModel->m[3][0];
+  eye.y -= pModel->m[3][1];
+  eye.z -= pModel->m[3][2];
+
+  first = pView->scratch->numEntries;
+  count = terrainSelect(pTerrain, &eye, &f, pView->scratch);
+  for (i = first; i < first + count; i++) {
+    render.mesh = pTerrain->mesh;
+    mat4Copy(&render.model, pModel);
+    terrainChunkModel(terrainGetChunk(pTerrain, *((unsigned int *) dynArrayItem(pView->scratch, i))), &render.model);
+
+    // get our Z
+    mat4Copy(&mv, &pView->matrices.view);
+    mat4Multiply(&mv, &render.model);
+    render.z = mv.m[3][2];
 
-      // add our mesh
-      render.mesh = pNode->bounds;
-      mat4Copy(&render.model, &model);
-      render.z = 0.0; // not yet used, need to apply view matrix to calculate
+    rqueueAdd(pView->opaque, rqueueOpaqueKey(mat->priority, mat->matShader == NULL ? 0 : mat->matShader->program, mat->id, pTerrain->mesh->id, -render.z), &render); // this copies our structure
+  };
+
+  // and remove our selection again
+  pView->scratch->numEntries = first;
+};
 
-      dynArrayPush(pAlpha, &render); // this copies our structure
+bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, renderView * pView, const frustum * pFrustum);
+void meshNodeBuildRenderListBVH(const meshNode * pNode, const mat4 * pModel, renderView * pView, const frustum * pFrustum);
+
+// add our node to the render queues of our view, pModel is the model matrix of our node and our node has passed its culling tests
+bool meshNodeAddToRenderList(const meshNode * pNode, const mat4 * pModel, renderView * pView, const frustum * pFrustum) {
+  // our shadow views ignore meshes with alpha
+  renderQueue * alpha = pView->shadow ? NULL : pView->alpha;
+
+  // check if we're rendering this node based on whether it moves
+  if (pView->casters == MESHNODE_STATICCASTERS) {
+    if (pNode->dynamic) {
+      return false;
+    };
+  } else if (pView->casters == MESHNODE_DYNAMICCASTERS) {
+    if (pNode->dynamic) {
+      bool added;
+
+      // everything below a dynamic node moves with it
+      pView->casters = MESHNODE_ALLCASTERS;
+      added = meshNodeAddToRenderList(pNode, pModel, pView, pFrustum);
+      pView->casters = MESHNODE_DYNAMICCASTERS;
+
+      return added;
+    } else if (pNode->hasDynamic == false) {
+      // nothing below us moves
+      return false;
     };
   };
 
-  if (pNode->mesh != NULL) {
+  if ((pNode->bounds != NULL) && (pFrustum != NULL) && mNrenderBounds && (alpha != NULL)) {
+    renderMesh render;
+
+    // add our mesh, note that our bounds are loaded into GL when we render them
+    render.mesh = pNode->bounds;
+    mat4Copy(&render.model, pModel);
+    render.z = 0.0; // not yet used, need to apply view matrix to calculate
+
+    rqueueAdd(alpha, rqueueBackToFrontKey(0.0), &render); // this copies our structure
+  };
+
+  if ((pNode->mesh != NULL) && (pView->casters != MESHNODE_DYNAMICCASTERS)) {
     renderMesh render;
-    vec3 tmpvector;
     mat4 mv;
 
     if (pNode->mesh->visible == false) {
@@ -462,34 +1126,41 @@ bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, shader
     };
 
     // get our Z
-    mat4Copy(&mv, &pMatrices->view);
-    mat4Multiply(&mv, &model);
+    mat4Copy(&mv, &pView->matrices.view);
+    mat4Multiply(&mv, pModel);
 
     // add our mesh
     render.mesh = pNode->mesh;
-    mat4Copy(&render.model, &model);
+    mat4Copy(&render.model, pModel);
     render.z = mv.m[3][2];
 
+    // note that we look down the negative Z axis so -z is our distance to the camera
     if (pNode->mesh->material == NULL) {
-      if (pNoAlpha != NULL) {
-        dynArrayPush(pNoAlpha, &render); // this copies our structure        
-      }
+      rqueueAdd(pView->opaque, rqueueOpaqueKey(0, 0, 0, pNode->mesh->id, -render.z), &render); // this copies our structure
     } else if (pNode->mesh->material->alpha != 1.0) {
-      if (pAlpha != NULL) {
-        dynArrayPush(pAlpha, &render); // this copies our structure
+      if (alpha != NULL) {
+        rqueueAdd(alpha, rqueueBackToFrontKey(-render.z), &render); // this copies our structure
       };
     } else {
-      if (pNoAlpha != NULL) {
-        dynArrayPush(pNoAlpha, &render); // this copies our structure      
-      };
+      material * mat = pNode->mesh->material;
+
+      // we group by the shader of our material, in our shadow pass materials sharing a shader tend to share a shadow shader as well
+      rqueueAdd(pView->opaque, rqueueOpaqueKey(mat->priority, mat->matShader == NULL ? 0 : mat->matShader->program, mat->id, pNode->mesh->id, -render.z), &render); // this copies our structure
     };
   };
   
-  if (pNode->children != NULL) {
+  if ((pNode->terrain != NULL) && (pView->casters != MESHNODE_DYNAMICCASTERS)) {
+    meshNodeAddTerrain(pNode->terrain, pModel, pView);
+  };
+
+  if (pNode->bvh != NULL) {
+    // our children are culled through our BVH
+    meshNodeBuildRenderListBVH(pNode, pModel, pView, pFrustum);
+  } else if (pNode->children != NULL) {
     llistNode * node = pNode->children->first;
     
     while (node != NULL) {
-      bool visible = meshNodeBuildRenderList((meshNode *) node->data, &model, pMatrices, pNoAlpha, pAlpha, pCheckBounds);
+      bool visible = meshNodeBuildRenderList((meshNode *) node->data, pModel, pView, pFrustum);
 
       if (pNode->firstVisOnly && visible) {
         // we've rendered our first visible child, ignore the rest!
@@ -503,102 +1174,458 @@ bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, shader
   return true;
 };
 
-int renderMeshSort(const void * pA, const void * pB) {
-  renderMesh * a = (renderMesh *) pA;
-  renderMesh * b = (renderMesh *) pB;
+// add the child nodes of our node to the render queues of our view using our BVH to cull them, pModel is the model matrix of our node
+void meshNodeBuildRenderListBVH(const meshNode * pNode, const mat4 * pModel, renderView * pView, const frustum * pFrustum) {
+  meshNodeBVH * bvh = pNode->bvh;
+  unsigned int  i;
+  mat4          model;
 
-  // sort by priority of material, then material, then mesh, then distance (closest to furthest)
-  if ((a->mesh == NULL) && (b->mesh == NULL)) {
-    return 0;
-  } else if (a->mesh == NULL) {
-    return -1;
-  } else if (b->mesh == NULL) {
-    return 1;
-  } else if (a->mesh->material->priority < b->mesh->material->priority) {
-    return -1;
-  } else if (a->mesh->material->priority > b->mesh->material->priority) {
-    return 1;
-  } else if (a->mesh->material < b->mesh->material) {
-    return -1;
-  } else if (a->mesh->material > b->mesh->material) {
-    return 1;
-  } else if (a->mesh < b->mesh) {
-    return -1;
-  } else if (a->mesh > b->mesh) {
-    return 1;
-  } else if (a->z < b->z) {
-    return -1;
-  } else if (a->z > b->z) {
-    return 1;
+  // nodes we can't cull are always checked
+  for (i = 0; i < bvh->unbounded->numEntries; i++) {
+    bvhLeaf * leaf = (bvhLeaf *) dynArrayItem(bvh->unbounded, i);
+
+    mat4Copy(&model, pModel);
+    mat4Multiply(&model, &leaf->parent);
+    meshNodeBuildRenderList(leaf->node, &model, pView, pFrustum);
+  };
+
+  if (pFrustum == NULL) {
+    // no culling, check all our leaves
+    for (i = 0; i < bvh->leaves->numEntries; i++) {
+      bvhLeaf * leaf = (bvhLeaf *) dynArrayItem(bvh->leaves, i);
+
+      mat4Copy(&model, pModel);
+      mat4Multiply(&model, &leaf->parent);
+      meshNodeBuildRenderList(leaf->node, &model, pView, pFrustum);
+    };
   } else {
-    return 0;
+    frustum       f;
+    unsigned int  first, count;
+
+    // get our frustum relative to our node and find out what is visible
+    // note that our child nodes are tested against pFrustum as they work with model matrices
+    mat4Copy(&model, shdMatGetViewProjection(&pView->matrices));
+    mat4Multiply(&model, pModel);
+    frustumFromMatrix(&f, &model);
+    first = pView->scratch->numEntries;
+    count = meshNodeQueryBVH(pNode, &f, pView->scratch);
+
+    // nested BVHs add their leaves after ours so we look our index up each time, our scratch array may have moved
+    for (i = first; i < first + count; i++) {
+      unsigned int  index = *((unsigned int *) dynArrayItem(pView->scratch, i));
+      bvhLeaf *     leaf = (bvhLeaf *) dynArrayItem(bvh->leaves, index);
+
+      if (leaf->node->visible) {
+        mat4Copy(&model, pModel);
+        mat4Multiply(&model, &leaf->parent);
+        mat4Multiply(&model, &leaf->node->position);
+
+        // our BVH replaces the bounds check for this node
+        if (meshNodeInRange(leaf->node, &model, &pView->matrices)) {
+          meshNodeAddToRenderList(leaf->node, &model, pView, pFrustum);
+        };
+      };
+    };
+
+    // and remove our leaves again
+    pView->scratch->numEntries = first;
   };
 };
 
-int renderMeshDistSort(const void * pA, const void * pB) {
-  renderMesh * a = (renderMesh *) pA;
-  renderMesh * b = (renderMesh *) pB;
+// add the contents of our node to the render queues of our view
+// if pFrustum is not NULL we cull anything outside of it, pFrustum must be in world space
+bool meshNodeBuildRenderList(const meshNode * pNode, const mat4 * pModel, renderView * pView, const frustum * pFrustum) {
+  mat4 model;
+  
+  // is there anything to do?
+  if (pNode == NULL) {
+    return false;
+  } else if (pNode->visible == false) {
+    return false;
+  };
+  
+  // make our model matrix
+  mat4Copy(&model, pModel);
+  mat4Multiply(&model, &pNode->position);
 
-  // sort only by distance (closest to furthest)
-  if (a->z < b->z) {
-    return -1;
-  } else if (a->z > b->z) {
-    return 1;
-  } else {
-    return 0;
+  // check our distance
+  if (meshNodeInRange(pNode, &model, &pView->matrices) == false) {
+    return false;
   };
+  
+  if (pNode->bounds != NULL && pFrustum != NULL) {
+    aabb box;
+
+    aabbTransform(&box, &pNode->boundsBox, &model);
+    if (frustumTestAABB(pFrustum, &box, NULL) == CULL_OUTSIDE) {
+      // yes we're not rendering but we did pass our LOD test so we're done...
+      return true;
+    };
+  };
+
+  return meshNodeAddToRenderList(pNode, &model, pView, pFrustum);
 };
 
-// render the contents of our node to the current output
-void meshNodeRender(meshNode * pNode, shaderMatrices * pMatrices, material * pDefaultMaterial) {
-  dynarray *      meshesWithoutAlpha  = newDynArray(sizeof(renderMesh));
-  dynarray *      meshesWithAlpha     = newDynArray(sizeof(renderMesh));
-  mat4            model;
-  int             i;
+// returns the number of consecutive entries in our (sorted) list, starting at pStart, that render the same mesh
+unsigned int meshNodeRunLength(renderQueue * pQueue, unsigned int pStart) {
+  renderMesh *  first = (renderMesh *) rqueueItem(pQueue, pStart);
+  unsigned int  count = 1;
 
-  // prepare our array with things to render....
-  mat4Identity(&model);
-  meshNodeBuildRenderList(pNode, &model, pMatrices, meshesWithoutAlpha, meshesWithAlpha, true);
+  while ((pStart + count < rqueueCount(pQueue)) && (((renderMesh *) rqueueItem(pQueue, pStart + count))->mesh == first->mesh)) {
+    count++;
+  };
 
-  // now render no-alpha
-  glDisable(GL_BLEND);
+  return count;
+};
 
-  // we sort our meshesWithoutAlpha list by material here and then only select our material 
-  // if we're switching material
-  dynArraySort(meshesWithoutAlpha, renderMeshSort);
+// returns the instanced shader we use to render pCount copies of a mesh with material pMat in one go,
+// returns NULL if we should render them one by one
+shaderInfo * meshNodeInstancedShader(material * pMat, unsigned int pCount, bool pShadow) {
+  shaderInfo * shader;
 
-  for (i = 0; i < meshesWithoutAlpha->numEntries; i++) {
-    bool selected = true;
-    renderMesh * render = dynArrayDataAtIndex(meshesWithoutAlpha, i);
-  
-    shdMatSetModel(pMatrices, &render->model);
-    if (render->mesh->material == NULL) {
-      selected = matSelectProgram(pDefaultMaterial, pMatrices);
+  if (!mNinstancing) {
+    return NULL;
+  } else if (pCount < MESHNODE_MININSTANCES) {
+    return NULL;
+  } else if (pMat == NULL) {
+    return NULL;
+  };
+
+  shader = pShadow ? matGetShadowShader(pMat) : pMat->matShader;
+  if (shader == NULL) {
+    return NULL;
+  } else if (shader->instanced == NULL) {
+    return NULL;
+  } else if (shader->instanced->program == NO_SHADER) {
+    return NULL;
+  };
+
+  return shader->instanced;
+};
+// remember a mesh whose material we couldn't select, our views may still be culled by our workers which check
+// visible so we can't hide our mesh until meshNodeHideFailed is called
+void meshNodeAddFailed(mesh3d * pMesh) {
+  if (mNfailed == NULL) {
+    mNfailed = newDynArray(sizeof(mesh3d *));
+    if (mNfailed == NULL) {
+      return;
+    };
+  };
+
+  // our queues are sorted so the same mesh tends to fail several times in a row
+  if ((mNfailed->numEntries > 0) && (*((mesh3d **) dynArrayItem(mNfailed, mNfailed->numEntries - 1)) == pMesh)) {
+    return;
+  };
+
+  dynArrayPush(mNfailed, &pMesh);
+};
+
+// hide the meshes whose material we couldn't select so we don't attempt them again,
+// call this once per frame when we've waited for all our views and no new views are queued yet
+void meshNodeHideFailed(void) {
+  unsigned int i;
+
+  if (mNfailed == NULL) {
+    return;
+  };
+
+  for (i = 0; i < mNfailed->numEntries; i++) {
+    (*((mesh3d **) dynArrayItem(mNfailed, i)))->visible = false;
+  };
+  dynArrayClear(mNfailed);
+};
+
+
+// render our sorted list of meshes, consecutive copies of the same mesh are rendered instanced where our shader supports it
+void meshNodeRenderList(renderQueue * pQueue, shaderMatrices * pMatrices, material * pDefaultMaterial, bool pShadow) {
+  unsigned int  i, j, count;
+  GLintptr      offset = 0, objectOffset = 0;
+  GLsizeiptr    objectStride = shaderRingStride(sizeof(shaderObjectBlock));
+
+  if (mNinstanceData == NULL) {
+    mNinstanceData = newDynArray(sizeof(mat4));
+  } else {
+    dynArrayClear(mNinstanceData);
+  };
+
+  if (mNobjectData == NULL) {
+    mNobjectData = newDynArray(sizeof(mat4));
+  } else {
+    dynArrayClear(mNobjectData);
+  };
+
+  // first gather the model matrices of everything we can render instanced and of everything we render one by one
+  for (i = 0; i < rqueueCount(pQueue); i += count) {
+    renderMesh * render = (renderMesh *) rqueueItem(pQueue, i);
+    material * mat = (render->mesh->material == NULL) && !pShadow ? pDefaultMaterial : render->mesh->material;
+
+    count = meshNodeRunLength(pQueue, i);
+    if (meshNodeInstancedShader(mat, count, pShadow) != NULL) {
+      for (j = 0; j < count; j++) {
+        dynArrayPush(mNinstanceData, &((renderMesh *) rqueueItem(pQueue, i + j))->model);
+      };
+    } else if (pShadow && (mat == NULL)) {
+      // no material, no shadow
     } else {
-      selected = matSelectProgram(render->mesh->material, pMatrices);
+      for (j = 0; j < count; j++) {
+        dynArrayPush(mNobjectData, &((renderMesh *) rqueueItem(pQueue, i + j))->model);
+      };
     };
+  };
 
-    if (selected) {
-      // infolog("Render %s at %f", render->mesh->name, render->z);
-      meshRender(render->mesh);
+  // and load them into our instance buffer in one go
+  if (mNinstanceData->numEntries > 0) {
+    if (mNinstanceVBO == GL_UNDEF_OBJ) {
+      glGenBuffers(1, &mNinstanceVBO);
+    };
+
+    // note that this orphans the data we used for our previous pass
+    glBindBuffer(GL_ARRAY_BUFFER, mNinstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * mNinstanceData->numEntries, mNinstanceData->data, GL_STREAM_DRAW);
+  };
+
+  // write the object blocks for the meshes we render one by one into our ring buffer in one go,
+  // after that we only need to bind the right range for each mesh
+  if (mNobjectData->numEntries > 0) {
+    unsigned int gen;
+
+    // we also load our frame block here so nothing else needs to be written to our ring while we render our list,
+    // if writing either made our ring wrap around we need to write both again
+    do {
+      char * data;
+
+      gen = shaderRingGen;
+      data = (char *) shaderRingMap(objectStride * mNobjectData->numEntries, &objectOffset);
+      if (data != NULL) {
+        for (i = 0; i < mNobjectData->numEntries; i++) {
+          shdMatSetModel(pMatrices, (mat4 *) dynArrayItem(mNobjectData, i));
+          shdMatFillObject(pMatrices, (shaderObjectBlock *) (data + (objectStride * i)));
+        };
+        shaderRingUnmap();
+      };
+
+      shdMatBindFrame(pMatrices);
+    } while (gen != shaderRingGen);
+  };
+
+  // now render
+  for (i = 0; i < rqueueCount(pQueue); i += count) {
+    renderMesh * render = (renderMesh *) rqueueItem(pQueue, i);
+    material * mat = (render->mesh->material == NULL) && !pShadow ? pDefaultMaterial : render->mesh->material;
+
+    count = meshNodeRunLength(pQueue, i);
+    if (meshNodeInstancedShader(mat, count, pShadow) != NULL) {
+      bool selected = pShadow ? matSelectShadowInstanced(mat, pMatrices) : matSelectProgramInstanced(mat, pMatrices);
+      if (selected) {
+        meshRenderInstanced(render->mesh, mNinstanceVBO, offset, count);
+      };
+
+      offset += sizeof(mat4) * count;
+    } else if (pShadow && (mat == NULL)) {
+      // no material, no shadow
     } else {
-      // couldn't select our material? don't attemp again
-      render->mesh->visible = false;
+      for (j = 0; j < count; j++) {
+        renderMesh *  entry = (renderMesh *) rqueueItem(pQueue, i + j);
+        bool          selected;
+
+        shdMatSetModel(pMatrices, &entry->model);
+        shdMatUseObject(pMatrices, objectOffset);
+        objectOffset += objectStride;
+
+        selected = pShadow ? matSelectShadow(mat, pMatrices) : matSelectProgram(mat, pMatrices);
+
+        if (selected) {
+          // infolog("Render %s at %f", entry->mesh->name, entry->z);
+          meshRender(entry->mesh);
+        } else if (!pShadow) {
+          // couldn't select our material? don't attemp again
+          meshNodeAddFailed(entry->mesh);
+        };
+      };
     };
-  };    
-  
+  };
+};
+
+// create a new view, our queues keep their storage between frames
+renderView * newRenderView(void) {
+  renderView * newView = (renderView *) malloc(sizeof(renderView));
+  if (newView == NULL) {
+    errorlog(-1, "Couldn't allocate memory for render view");
+    return NULL;
+  };
+
+  memset(newView, 0, sizeof(renderView));
+  newView->casters = MESHNODE_ALLCASTERS;
+  newView->opaque = newRenderQueue(sizeof(renderMesh));
+  newView->alpha = newRenderQueue(sizeof(renderMesh));
+  newView->scratch = newDynArray(sizeof(unsigned int));
+  if ((newView->opaque == NULL) || (newView->alpha == NULL) || (newView->scratch == NULL)) {
+    errorlog(-1, "Couldn't allocate memory for render view");
+    rviewFree(newView);
+    return NULL;
+  };
+
+  return newView;
+};
+
+// free our view, if it is still being built we wait for it to finish
+void rviewFree(renderView * pView) {
+  if (pView == NULL) {
+    return;
+  };
+
+  jobsWait(&pView->pending);
+
+  if (pView->opaque != NULL) {
+    rqueueFree(pView->opaque);
+  };
+  if (pView->alpha != NULL) {
+    rqueueFree(pView->alpha);
+  };
+  if (pView->scratch != NULL) {
+    dynArrayFree(pView->scratch);
+  };
+
+  free(pView);
+};
+
+// empty our view, after this our view is no longer marked as queued
+void rviewClear(renderView * pView) {
+  if (pView == NULL) {
+    return;
+  };
+
+  jobsWait(&pView->pending);
+
+  pView->scene = NULL;
+  pView->queued = false;
+  rqueueClear(pView->opaque);
+  rqueueClear(pView->alpha);
+};
+
+// copy our settings into our view before we build it
+void rviewSetup(renderView * pView, meshNode * pScene, const shaderMatrices * pMatrices, float pRadius, int pCasters, bool pShadow) {
+  // we may still be building our previous frame
+  jobsWait(&pView->pending);
+
+  pView->scene = pScene;
+  memcpy(&pView->matrices, pMatrices, sizeof(shaderMatrices));
+  pView->radius = pRadius;
+  pView->casters = pCasters;
+  pView->shadow = pShadow;
+  pView->queued = true;
+  rqueueClear(pView->opaque);
+  rqueueClear(pView->alpha);
+  dynArrayClear(pView->scratch);
+};
+
+// cull and sort our view, this may run as a job so we can't use GL or our profiler in here
+void rviewBuildJob(void * pData) {
+  renderView *  view = (renderView *) pData;
+  mat4          model, box;
+  frustum       f;
+
+  mat4Identity(&model);
+  if (view->scene == NULL) {
+    // nothing to build
+  } else if (view->radius > 0.0) {
+    // our BVH culls using the view-projection of our matrices so we replace our projection with our box,
+    // our matrices are our own copy so we don't need to restore it
+    mat4Identity(&box);
+    mat4Ortho(&box, -view->radius, view->radius, -view->radius, view->radius, -view->radius, view->radius);
+    shdMatSetProjection(&view->matrices, &box);
+    frustumFromMatrix(&f, shdMatGetViewProjection(&view->matrices));
+
+    meshNodeBuildRenderList(view->scene, &model, view, &f);
+  } else if (view->shadow && (view->casters != MESHNODE_DYNAMICCASTERS)) {
+    // our static casters are rendered into a cache that outlives our frustum
+    meshNodeBuildRenderList(view->scene, &model, view, NULL);
+  } else {
+    frustumFromMatrix(&f, shdMatGetViewProjection(&view->matrices));
+    meshNodeBuildRenderList(view->scene, &model, view, &f);
+  };
+
+  // our keys sort our opaque queue by material so we only select our material if we're switching material,
+  // this also groups copies of the same mesh together so we can instance them and renders those front to back
+  rqueueSort(view->opaque);
+
+  // our alpha queue is sorted back to front just in case there is overlap
+  rqueueSort(view->alpha);
+};
+
+// build our view of pScene right away, our matrices are copied into our view.
+// If pShadow is true we only queue shadow casters, pCasters selects whether we add our static casters, our dynamic casters or both.
+// If pRadius is larger then 0 we cull everything outside of a box of pRadius around our view (see meshNodeShadowCube)
+// else our shadow views only cull our dynamic casters as our static casters are rendered into a cache that outlives our frustum
+void rviewBuild(renderView * pView, meshNode * pScene, const shaderMatrices * pMatrices, float pRadius, int pCasters, bool pShadow) {
+  if (pView == NULL) {
+    return;
+  };
+
+  rviewSetup(pView, pScene, pMatrices, pRadius, pCasters, pShadow);
+  rviewBuildJob(pView);
+};
+
+// same as rviewBuild but our view is built by a job, call rviewWait or render our view to wait for it.
+// Note that our scene must not change until our view is built
+void rviewQueue(renderView * pView, meshNode * pScene, const shaderMatrices * pMatrices, float pRadius, int pCasters, bool pShadow) {
+  if (pView == NULL) {
+    return;
+  };
+
+  rviewSetup(pView, pScene, pMatrices, pRadius, pCasters, pShadow);
+  jobsAdd(rviewBuildJob, pView, &pView->pending);
+};
+
+// wait until our view is built, we help out with other jobs while we wait.
+// Returns the number of opaque meshes or shadow casters in our view
+unsigned int rviewWait(renderView * pView) {
+  if (pView == NULL) {
+    return 0;
+  };
+
+  if (!jobsDone(&pView->pending)) {
+    // time we spend here is time our culling holds up our GL thread
+    profBegin("cull");
+    jobsWait(&pView->pending);
+    profEnd();
+  };
+
+  return rqueueCount(pView->opaque);
+};
+
+// render our view to the current output, pMatrices are the matrices we render with
+void meshNodeRenderView(renderView * pView, shaderMatrices * pMatrices, material * pDefaultMaterial) {
+  int i;
+
+  if (pView == NULL) {
+    return;
+  };
+
+  rviewWait(pView);
+
+  // now render no-alpha
+  glDisable(GL_BLEND);
+
+  profBegin("draw");
+  meshNodeRenderList(pView->opaque, pMatrices, pDefaultMaterial, false);
+  profEnd();
+
   // and render alpha (temporarily disabled, treating as opaque for now...)
 //  glEnable(GL_BLEND);
 //  glBlendEquation(GL_FUNC_ADD);
 //  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  // we should sort our meshesWithAlpha list by distance just in case there is overlap here
-  dynArraySort(meshesWithAlpha, renderMeshDistSort);
-
-  for (i = 0; i < meshesWithAlpha->numEntries; i++) {
+  profBegin("alpha");
+  for (i = 0; i < rqueueCount(pView->alpha); i++) {
     bool selected = true;
-    renderMesh * render = dynArrayDataAtIndex(meshesWithAlpha, i);
-  
+    renderMesh * render = (renderMesh *) rqueueItem(pView->alpha, i);
+
+    // our bounds are loaded into GL here as we can't do so while building our view, make sure we don't loose our buffers
+    if (mNrenderBounds && (render->mesh->material == mNboundsMaterial) && (render->mesh->isLoaded == false)) {
+      meshCopyToGL(render->mesh, false);
+    };
+
     shdMatSetModel(pMatrices, &render->model);
     selected = matSelectProgram(render->mesh->material, pMatrices);
 
@@ -607,42 +1634,94 @@ void meshNodeRender(meshNode * pNode, shaderMatrices * pMatrices, material * pDe
       meshRender(render->mesh);
     } else {
       // couldn't select our material? don't attemp again
-      render->mesh->visible = false;
+      meshNodeAddFailed(render->mesh);
     };
   };
-  
-  dynArrayFree(meshesWithAlpha);
-  dynArrayFree(meshesWithoutAlpha);
+  profEnd();
 };
 
-// render suitable objects to a shadow map
-void meshNodeShadowMap(meshNode *pNode, shaderMatrices * pMatrices) {
-  dynarray *      meshesWithoutAlpha  = newDynArray(sizeof(renderMesh));
-  mat4            model;
-  int             i;
+// render the shadow casters of our view, if pLayered is true we use our layered shadow shaders
+void meshNodeShadowRenderView(renderView * pView, shaderMatrices * pMatrices, bool pLayered) {
+  if (pView == NULL) {
+    return;
+  };
 
-  // prepare our array with things to render, we ignore meshes with alpha....
-  mat4Identity(&model);
-  meshNodeBuildRenderList(pNode, &model, pMatrices, meshesWithoutAlpha, NULL, false);
+  rviewWait(pView);
 
-  // we sort our meshesWithoutAlpha list by material here and then only select our material 
-  // if we're switching material  
-  dynArraySort(meshesWithoutAlpha, renderMeshSort);
+  profBegin("draw");
+  matSetShadowLayered(pLayered);
+  meshNodeRenderList(pView->opaque, pMatrices, NULL, true);
+  matSetShadowLayered(false);
+  profEnd();
+};
 
-  for (i = 0; i < meshesWithoutAlpha->numEntries; i++) {
-    bool selected = true;
-    renderMesh * render = dynArrayDataAtIndex(meshesWithoutAlpha, i);
-  
-    shdMatSetModel(pMatrices, &render->model);
-    if (render->mesh->material != NULL) {
-      selected = matSelectShadow(render->mesh->material, pMatrices);
-      if (selected) {
-        meshRender(render->mesh);
-      };
-    };
+// returns the view we reuse for meshNodeRender and our shadow functions
+renderView * meshNodeDefaultView(void) {
+  if (mNview == NULL) {
+    mNview = newRenderView();
+  };
+
+  return mNview;
+};
+
+// render the contents of our node to the current output
+void meshNodeRender(meshNode * pNode, shaderMatrices * pMatrices, material * pDefaultMaterial) {
+  renderView * view = meshNodeDefaultView();
+
+  if (view == NULL) {
+    return;
   };
 
-  dynArrayFree(meshesWithoutAlpha);
+  // prepare our queues with things to render....
+  profBegin("cull");
+  rviewBuild(view, pNode, pMatrices, 0.0, MESHNODE_ALLCASTERS, false);
+  profEnd();
+
+  meshNodeRenderView(view, pMatrices, pDefaultMaterial);
+};
+
+// build and sort our queue of shadow casters, pCasters selects whether we add our static casters, our dynamic casters or both
+// if pRadius is larger then 0 we cull everything outside of a box of pRadius around our view (see meshNodeShadowCube)
+// else we only cull our dynamic casters, our static casters are rendered into a cache that outlives our frustum
+// returns the number of meshes we've queued
+unsigned int meshNodeShadowQueue(meshNode *pNode, shaderMatrices * pMatrices, float pRadius, int pCasters) {
+  renderView * view = meshNodeDefaultView();
+
+  if (view == NULL) {
+    return 0;
+  };
+
+  // prepare our queue with things to render, we ignore meshes with alpha....
+  profBegin("cull");
+  rviewBuild(view, pNode, pMatrices, pRadius, pCasters, true);
+  profEnd();
+
+  return rqueueCount(view->opaque);
+};
+
+// render the shadow casters queued by meshNodeShadowQueue, if pLayered is true we use our layered shadow shaders
+void meshNodeShadowRender(shaderMatrices * pMatrices, bool pLayered) {
+  if (mNview == NULL) {
+    return;
+  };
+
+  meshNodeShadowRenderView(mNview, pMatrices, pLayered);
+};
+
+// render suitable objects to a shadow map, pCasters selects whether we render our static casters, our dynamic casters or both
+void meshNodeShadowMap(meshNode *pNode, shaderMatrices * pMatrices, int pCasters) {
+  meshNodeShadowQueue(pNode, pMatrices, 0.0, pCasters);
+  meshNodeShadowRender(pMatrices, false);
+};
+
+// render suitable objects to all six faces of a cube map in one pass
+// pMatrices must contain a view matrix that moves our light to the origin and the projection of a single face,
+// we cull everything outside of a box of pRadius around our light which contains all six face frustums
+// and our layered shadow shaders render each triangle to the faces it is visible in
+// pCasters selects whether we render our static casters, our dynamic casters or both
+void meshNodeShadowCube(meshNode *pNode, shaderMatrices * pMatrices, float pRadius, int pCasters) {
+  meshNodeShadowQueue(pNode, pMatrices, pRadius, pCasters);
+  meshNodeShadowRender(pMatrices, true);
 };
 
 #endif /* MESH_IMPLEMENTATION */
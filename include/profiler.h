@@ -0,0 +1,488 @@
+/********************************************************
+ * profiler.h - profiler library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define PROFILER_IMPLEMENTATION
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions.
+ *
+ * Wrap the work you want to time between profBegin and
+ * profEnd, scopes can be nested. Each frame must be
+ * wrapped between profFrameStart and profFrameEnd.
+ * We record the CPU time of each scope and its GPU time
+ * through timestamp queries, these are read back
+ * PROF_FRAMES frames later so we never wait on our GPU.
+ *
+ * Scopes with the same name and parent are combined
+ * into one entry, we keep a rolling average of the time
+ * spent in each entry per frame which can be formatted
+ * for display with profGetOverlay.
+ *
+ * While capturing we also record each scope as an event
+ * which can be written out in Chrome's trace event
+ * format (load it in chrome://tracing).
+ *
+ * Our profiler does nothing until enabled.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef profilerh
+#define profilerh
+
+// our libraries we need
+#include "system.h"
+#include "dynamicarray.h"
+#include "benchmark.h"
+
+// number of frames we buffer before reading back our GPU timers
+#define PROF_FRAMES         3
+
+// maximum nesting of our scopes
+#define PROF_MAXDEPTH       16
+
+// maximum length of a line in our overlay
+#define PROF_LINELEN        80
+
+// weight of our last frame in our rolling average
+#define PROF_AVERAGE        0.05
+
+// an entry in our profile
+typedef struct profStat {
+  const char *  name;                 /* name of our scope, this must be a string constant */
+  int           parent;               /* index of our parent entry, -1 if none */
+  int           depth;                /* nesting depth */
+  double        cpuTime;              /* CPU time spent in this entry in the last resolved frame (ms) */
+  double        gpuTime;              /* GPU time spent in this entry in the last resolved frame (ms) */
+  double        cpuAverage;           /* rolling average of our CPU time (ms) */
+  double        gpuAverage;           /* rolling average of our GPU time (ms) */
+  unsigned int  calls;                /* number of times this scope was entered in the last resolved frame */
+  unsigned int  frames;               /* number of frames included in our averages */
+} profStat;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void profSetEnabled(bool pEnabled);
+bool profIsEnabled(void);
+void profFrameStart(void);
+void profFrameEnd(void);
+void profBegin(const char * pName);
+void profEnd(void);
+void profFlush(void);
+unsigned int profStatCount(void);
+const profStat * profGetStat(unsigned int pIndex);
+unsigned int profGetOverlay(char pLines[][PROF_LINELEN], unsigned int pMaxLines);
+void profStartCapture(void);
+void profStopCapture(void);
+bool profWriteTrace(const char * pFileName);
+void profFree(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef PROFILER_IMPLEMENTATION
+
+// a scope recorded in a frame
+typedef struct profScope {
+  int           stat;                 /* entry this scope belongs to */
+  double        cpuStart;             /* CPU time we entered this scope (ms) */
+  double        cpuEnd;               /* CPU time we left this scope (ms) */
+  unsigned int  query;                /* index of our start query, our end query follows it */
+} profScope;
+
+// the scopes recorded in a frame
+typedef struct profFrame {
+  dynarray *    scopes;               /* scopes recorded in this frame */
+  dynarray *    queries;              /* our timestamp queries, grows as we need more */
+  bool          pending;              /* true if this frame still needs to be resolved */
+} profFrame;
+
+// an event in our trace
+typedef struct profEvent {
+  const char *  name;                 /* name of our scope */
+  bool          gpu;                  /* true if this is a GPU timing */
+  double        start;                /* start of our event in microseconds */
+  double        duration;             /* duration of our event in microseconds */
+} profEvent;
+
+bool          profEnabled = false;
+bool          profRequestEnabled = false;
+bool          profInFrame = false;
+unsigned int  profFrameNo = 0;
+profFrame     profFrames[PROF_FRAMES];
+dynarray *    profStats = NULL;
+int           profStack[PROF_MAXDEPTH];
+int           profDepth = 0;
+bool          profCapturing = false;
+dynarray *    profEvents = NULL;
+double        profCaptureStart = 0.0;
+GLint64       profGPUOffset = 0;
+
+// enable or disable our profiler, this takes effect on our next frame
+void profSetEnabled(bool pEnabled) {
+  profRequestEnabled = pEnabled;
+};
+
+// returns true if our profiler is enabled
+bool profIsEnabled(void) {
+  return profEnabled;
+};
+
+// find the entry for pName within pParent, add it if we don't have it yet
+int profFindStat(const char * pName, int pParent) {
+  profStat      stat;
+  unsigned int  i;
+
+  for (i = 0; i < profStats->numEntries; i++) {
+    profStat * check = (profStat *) dynArrayDataAtIndex(profStats, i);
+    if ((check->parent == pParent) && ((check->name == pName) || (strcmp(check->name, pName) == 0))) {
+      return i;
+    };
+  };
+
+  memset(&stat, 0, sizeof(stat));
+  stat.name = pName;
+  stat.parent = pParent;
+  stat.depth = pParent < 0 ? 0 : ((profStat *) dynArrayDataAtIndex(profStats, pParent))->depth + 1;
+
+  return dynArrayPush(profStats, &stat);
+};
+
+// read back the timers of a frame and add them to our entries
+void profResolveFrame(profFrame * pFrame) {
+  unsigned int  i;
+
+  if (!pFrame->pending) {
+    return;
+  };
+
+  for (i = 0; i < profStats->numEntries; i++) {
+    profStat * stat = (profStat *) dynArrayDataAtIndex(profStats, i);
+
+    stat->cpuTime = 0.0;
+    stat->gpuTime = 0.0;
+    stat->calls = 0;
+  };
+
+  for (i = 0; i < pFrame->scopes->numEntries; i++) {
+    profScope *   scope = (profScope *) dynArrayDataAtIndex(pFrame->scopes, i);
+    profStat *    stat = (profStat *) dynArrayDataAtIndex(profStats, scope->stat);
+    GLuint *      queries = (GLuint *) dynArrayDataAtIndex(pFrame->queries, scope->query);
+    GLuint64      gpuStart, gpuEnd;
+
+    // note that this waits for our GPU if it hasn't finished this frame yet
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &gpuStart);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &gpuEnd);
+
+    stat->cpuTime += scope->cpuEnd - scope->cpuStart;
+    stat->gpuTime += (gpuEnd - gpuStart) / 1000000.0;
+    stat->calls++;
+
+    if (profCapturing) {
+      profEvent event;
+
+      event.name = stat->name;
+      event.gpu = false;
+      event.start = (scope->cpuStart - profCaptureStart) * 1000.0;
+      event.duration = (scope->cpuEnd - scope->cpuStart) * 1000.0;
+      dynArrayPush(profEvents, &event);
+
+      // our GPU clock is converted to our CPU clock using the offset we measured when we started capturing
+      event.gpu = true;
+      event.start = (((GLint64) gpuStart - profGPUOffset) / 1000.0) - (profCaptureStart * 1000.0);
+      event.duration = (gpuEnd - gpuStart) / 1000.0;
+      dynArrayPush(profEvents, &event);
+    };
+  };
+
+  // and update our rolling averages
+  for (i = 0; i < profStats->numEntries; i++) {
+    profStat * stat = (profStat *) dynArrayDataAtIndex(profStats, i);
+
+    // our first frame starts our average
+    if (stat->frames == 0) {
+      stat->cpuAverage = stat->cpuTime;
+      stat->gpuAverage = stat->gpuTime;
+    } else {
+      stat->cpuAverage += (stat->cpuTime - stat->cpuAverage) * PROF_AVERAGE;
+      stat->gpuAverage += (stat->gpuTime - stat->gpuAverage) * PROF_AVERAGE;
+    };
+    stat->frames++;
+  };
+
+  dynArrayClear(pFrame->scopes);
+  pFrame->pending = false;
+};
+
+// start profiling a new frame
+void profFrameStart(void) {
+  profFrame * frame;
+
+  if (profEnabled != profRequestEnabled) {
+    if (profRequestEnabled) {
+      unsigned int i;
+
+      if (profStats == NULL) {
+        profStats = newDynArray(sizeof(profStat));
+      };
+
+      for (i = 0; i < PROF_FRAMES; i++) {
+        if (profFrames[i].scopes == NULL) {
+          profFrames[i].scopes = newDynArray(sizeof(profScope));
+          profFrames[i].queries = newDynArray(sizeof(GLuint));
+          profFrames[i].pending = false;
+        };
+      };
+    } else {
+      profFlush();
+    };
+
+    profEnabled = profRequestEnabled;
+  };
+
+  if (!profEnabled) {
+    return;
+  };
+
+  // make sure the frame we're about to reuse has been read back
+  frame = &profFrames[profFrameNo % PROF_FRAMES];
+  profResolveFrame(frame);
+
+  profInFrame = true;
+  profDepth = 0;
+  profBegin("frame");
+};
+
+// finish profiling our frame
+void profFrameEnd(void) {
+  if (!profInFrame) {
+    return;
+  };
+
+  // close any scopes left open and our frame scope
+  while (profDepth > 0) {
+    profEnd();
+  };
+
+  profFrames[profFrameNo % PROF_FRAMES].pending = true;
+  profInFrame = false;
+  profFrameNo++;
+};
+
+// start a scope, pName must be a string constant
+void profBegin(const char * pName) {
+  profFrame *   frame;
+  profScope     scope;
+  GLuint *      queries;
+
+  if (!profInFrame) {
+    return;
+  } else if (profDepth >= PROF_MAXDEPTH) {
+    // too deep, we still count it so our profEnd matches up
+    profDepth++;
+    return;
+  };
+
+  frame = &profFrames[profFrameNo % PROF_FRAMES];
+
+  // make sure we have queries for this scope
+  scope.query = frame->scopes->numEntries * 2;
+  if (frame->queries->numEntries < scope.query + 2) {
+    GLuint newQueries[2];
+
+    glGenQueries(2, newQueries);
+    dynArrayPush(frame->queries, &newQueries[0]);
+    dynArrayPush(frame->queries, &newQueries[1]);
+  };
+  queries = (GLuint *) dynArrayDataAtIndex(frame->queries, scope.query);
+
+  scope.stat = profFindStat(pName, profDepth > 0 ? ((profScope *) dynArrayDataAtIndex(frame->scopes, profStack[profDepth - 1]))->stat : -1);
+  scope.cpuStart = benchGetTime();
+  scope.cpuEnd = scope.cpuStart;
+  glQueryCounter(queries[0], GL_TIMESTAMP);
+
+  profStack[profDepth++] = dynArrayPush(frame->scopes, &scope);
+};
+
+// end our current scope
+void profEnd(void) {
+  profFrame *   frame;
+  profScope *   scope;
+
+  if (!profInFrame) {
+    return;
+  } else if (profDepth == 0) {
+    return;
+  } else if (profDepth > PROF_MAXDEPTH) {
+    profDepth--;
+    return;
+  };
+
+  frame = &profFrames[profFrameNo % PROF_FRAMES];
+  scope = (profScope *) dynArrayDataAtIndex(frame->scopes, profStack[--profDepth]);
+  scope->cpuEnd = benchGetTime();
+  glQueryCounter(*((GLuint *) dynArrayDataAtIndex(frame->queries, scope->query + 1)), GL_TIMESTAMP);
+};
+
+// read back all our outstanding frames
+void profFlush(void) {
+  unsigned int i;
+
+  // resolve in the order our frames were recorded, profFrameEnd already moved profFrameNo on to our oldest frame
+  for (i = 0; i < PROF_FRAMES; i++) {
+    profFrame * frame = &profFrames[(profFrameNo + i) % PROF_FRAMES];
+    if (frame->scopes != NULL) {
+      profResolveFrame(frame);
+    };
+  };
+};
+
+// number of entries in our profile
+unsigned int profStatCount(void) {
+  return profStats == NULL ? 0 : profStats->numEntries;
+};
+
+// get an entry of our profile
+const profStat * profGetStat(unsigned int pIndex) {
+  return profStats == NULL ? NULL : (const profStat *) dynArrayDataAtIndex(profStats, pIndex);
+};
+
+// add the lines for the children of pParent to our overlay
+unsigned int profAddOverlayLines(int pParent, char pLines[][PROF_LINELEN], unsigned int pLine, unsigned int pMaxLines) {
+  unsigned int i;
+
+  for (i = 0; (i < profStats->numEntries) && (pLine < pMaxLines); i++) {
+    profStat * stat = (profStat *) dynArrayDataAtIndex(profStats, i);
+
+    if (stat->parent == pParent) {
+      char name[32];
+
+      // show how often we entered this scope if more than once
+      if (stat->calls > 1) {
+        snprintf(name, sizeof(name), "%s x%u", stat->name, stat->calls);
+      } else {
+        snprintf(name, sizeof(name), "%s", stat->name);
+      };
+
+      snprintf(pLines[pLine++], PROF_LINELEN, "%*s%-*s cpu %6.2f ms  gpu %6.2f ms", stat->depth * 2, "", 24 - (stat->depth * 2), name, stat->cpuAverage, stat->gpuAverage);
+      pLine = profAddOverlayLines(i, pLines, pLine, pMaxLines);
+    };
+  };
+
+  return pLine;
+};
+
+// format our profile for display, one line per entry with children indented below their parent
+// returns the number of lines
+unsigned int profGetOverlay(char pLines[][PROF_LINELEN], unsigned int pMaxLines) {
+  if (profStats == NULL) {
+    return 0;
+  };
+
+  return profAddOverlayLines(-1, pLines, 0, pMaxLines);
+};
+
+// start capturing events for our trace
+void profStartCapture(void) {
+  GLint64 gpuTime;
+
+  if (profEvents == NULL) {
+    profEvents = newDynArray(sizeof(profEvent));
+  } else {
+    dynArrayClear(profEvents);
+  };
+
+  // measure the offset between our GPU and CPU clocks, in nanoseconds
+  profCaptureStart = benchGetTime();
+  glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+  profGPUOffset = gpuTime - (GLint64) (profCaptureStart * 1000000.0);
+
+  profCapturing = true;
+};
+
+// stop capturing, note that frames still pending are not added to our capture
+void profStopCapture(void) {
+  profCapturing = false;
+};
+
+// write our captured events in Chrome's trace event format, CPU times are shown as thread 1, GPU times as thread 2
+bool profWriteTrace(const char * pFileName) {
+  FILE *        file;
+  unsigned int  i;
+
+  if (profEvents == NULL) {
+    errorlog(-1, "No trace was captured");
+    return false;
+  };
+
+  file = fopen(pFileName, "w");
+  if (file == NULL) {
+    errorlog(-1, "Couldn't open %s for writing", pFileName);
+    return false;
+  };
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+  for (i = 0; i < profEvents->numEntries; i++) {
+    profEvent * event = (profEvent *) dynArrayDataAtIndex(profEvents, i);
+
+    fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}",
+      event->name, event->gpu ? "gpu" : "cpu", event->gpu ? 2 : 1, event->start, event->duration);
+  };
+  fprintf(file, "\n]}\n");
+
+  fclose(file);
+
+  return true;
+};
+
+// free everything our profiler allocated, this must be called with our GL context active
+void profFree(void) {
+  unsigned int i;
+
+  for (i = 0; i < PROF_FRAMES; i++) {
+    if (profFrames[i].scopes != NULL) {
+      dynArrayFree(profFrames[i].scopes);
+      profFrames[i].scopes = NULL;
+    };
+
+    if (profFrames[i].queries != NULL) {
+      if (profFrames[i].queries->numEntries > 0) {
+        glDeleteQueries(profFrames[i].queries->numEntries, (GLuint *) profFrames[i].queries->data);
+      };
+      dynArrayFree(profFrames[i].queries);
+      profFrames[i].queries = NULL;
+    };
+  };
+
+  if (profStats != NULL) {
+    dynArrayFree(profStats);
+    profStats = NULL;
+  };
+
+  if (profEvents != NULL) {
+    dynArrayFree(profEvents);
+    profEvents = NULL;
+  };
+
+  profEnabled = false;
+  profRequestEnabled = false;
+  profCapturing = false;
+};
+
+#endif /* PROFILER_IMPLEMENTATION */
+
+#endif /* !profilerh */
@@ -0,0 +1,249 @@
+/********************************************************
+ * renderqueue.h - render queue library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define RQUEUE_IMPLEMENTATION
+ *
+ * A render queue holds the things we want to render
+ * (our payload) alongside a 64bit sort key. Sorting only
+ * moves the keys and an index into our payload so we
+ * never copy the payload itself. Keys are sorted with
+ * a LSD radix sort so sorting is O(n).
+ *
+ * Our queue keeps its storage when cleared so once it
+ * has grown to the size of our scene no further
+ * allocations are done.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef rqueueh
+#define rqueueh
+
+// include support libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "dynamicarray.h"
+
+// layout of our opaque sort key, from most to least significant:
+// priority (8 bits), shader (10 bits), material (12 bits), mesh (14 bits), depth (20 bits)
+#define RQUEUE_PRIORITY_BITS  8
+#define RQUEUE_SHADER_BITS    10
+#define RQUEUE_MATERIAL_BITS  12
+#define RQUEUE_MESH_BITS      14
+#define RQUEUE_DEPTH_BITS     20
+
+// key and the index of its payload
+typedef struct rqueueKey {
+  uint64_t      key;            /* our sort key */
+  unsigned int  index;          /* index of our payload */
+} rqueueKey;
+
+// our render queue
+typedef struct renderQueue {
+  dynarray *    items;          /* our payload in the order it was added */
+  dynarray *    keys;           /* our keys, sorted after calling rqueueSort */
+  dynarray *    swap;           /* buffer our radix sort swaps with */
+} renderQueue;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+renderQueue * newRenderQueue(unsigned int pItemSize);
+void rqueueFree(renderQueue * pQueue);
+void rqueueClear(renderQueue * pQueue);
+unsigned int rqueueAdd(renderQueue * pQueue, uint64_t pKey, void * pData);
+void rqueueSort(renderQueue * pQueue);
+uint32_t rqueueDepth(float pDistance);
+uint64_t rqueueOpaqueKey(unsigned int pPriority, unsigned int pShader, unsigned int pMaterial, unsigned int pMesh, float pDistance);
+uint64_t rqueueBackToFrontKey(float pDistance);
+
+// number of entries in our queue
+static inline unsigned int rqueueCount(const renderQueue * pQueue) {
+  return pQueue->keys->numEntries;
+};
+
+// returns the payload of the entry at pIndex in sorted order, pIndex must be smaller then rqueueCount
+static inline void * rqueueItem(const renderQueue * pQueue, unsigned int pIndex) {
+  const rqueueKey * key = (const rqueueKey *) pQueue->keys->data + pIndex;
+
+  return (char *) pQueue->items->data + (key->index * pQueue->items->entrySize);
+};
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef RQUEUE_IMPLEMENTATION
+
+// creates a new render queue for payloads of pItemSize bytes
+// renderQueue * myQueue = newRenderQueue(sizeof(mystruct));
+renderQueue * newRenderQueue(unsigned int pItemSize) {
+  renderQueue * queue = (renderQueue *) malloc(sizeof(renderQueue));
+  if (queue != NULL) {
+    queue->items = newDynArray(pItemSize);
+    queue->keys = newDynArray(sizeof(rqueueKey));
+    queue->swap = newDynArray(sizeof(rqueueKey));
+  };
+
+  return queue;
+};
+
+// frees our render queue and its storage
+void rqueueFree(renderQueue * pQueue) {
+  if (pQueue == NULL) {
+    return;
+  };
+
+  dynArrayFree(pQueue->items);
+  dynArrayFree(pQueue->keys);
+  dynArrayFree(pQueue->swap);
+  free(pQueue);
+};
+
+// empties our queue but keeps our storage around for reuse
+void rqueueClear(renderQueue * pQueue) {
+  if (pQueue == NULL) {
+    return;
+  };
+
+  dynArrayClear(pQueue->items);
+  dynArrayClear(pQueue->keys);
+  dynArrayClear(pQueue->swap);
+};
+
+// adds a copy of pData to our queue with the given sort key
+unsigned int rqueueAdd(renderQueue * pQueue, uint64_t pKey, void * pData) {
+  rqueueKey     key;
+
+  if (pQueue == NULL) {
+    return DYNARRAY_NOENTRY;
+  };
+
+  key.key = pKey;
+  key.index = dynArrayPush(pQueue->items, pData);
+  if (key.index >= DYNARRAY_NOMEM) {
+    return key.index;
+  };
+
+  return dynArrayPush(pQueue->keys, &key);
+};
+
+// sort our keys from low to high, entries with equal keys stay in the order they were added
+void rqueueSort(renderQueue * pQueue) {
+  unsigned int  count[8][256];
+  unsigned int  i, pass, n;
+  rqueueKey *   from;
+  rqueueKey *   to;
+  rqueueKey *   tmp;
+
+  if (pQueue == NULL) {
+    return;
+  };
+
+  n = pQueue->keys->numEntries;
+  if (n < 2) {
+    return;
+  } else if (!dynArrayCheckSize(pQueue->swap, n)) {
+    return;
+  };
+
+  // count the occurrences of each byte value for all 8 passes in one go
+  memset(count, 0, sizeof(count));
+  from = (rqueueKey *) pQueue->keys->data;
+  for (i = 0; i < n; i++) {
+    uint64_t key = from[i].key;
+
+    for (pass = 0; pass < 8; pass++) {
+      count[pass][(key >> (pass * 8)) & 0xFF]++;
+    };
+  };
+
+  to = (rqueueKey *) pQueue->swap->data;
+  for (pass = 0; pass < 8; pass++) {
+    unsigned int *  bucket = count[pass];
+    unsigned int    shift = pass * 8;
+    unsigned int    offset = 0;
+
+    // if all our keys have the same value for this byte there is nothing to sort
+    if (bucket[(from[0].key >> shift) & 0xFF] == n) {
+      continue;
+    };
+
+    // turn our counts into offsets
+    for (i = 0; i < 256; i++) {
+      unsigned int c = bucket[i];
+
+      bucket[i] = offset;
+      offset += c;
+    };
+
+    // and scatter our keys
+    for (i = 0; i < n; i++) {
+      to[bucket[(from[i].key >> shift) & 0xFF]++] = from[i];
+    };
+
+    tmp = from;
+    from = to;
+    to = tmp;
+  };
+
+  // make sure our keys array holds the sorted result
+  if (from != (rqueueKey *) pQueue->keys->data) {
+    void *        data = pQueue->keys->data;
+    unsigned int  maxEntries = pQueue->keys->maxEntries;
+
+    pQueue->keys->data = pQueue->swap->data;
+    pQueue->keys->maxEntries = pQueue->swap->maxEntries;
+    pQueue->swap->data = data;
+    pQueue->swap->maxEntries = maxEntries;
+  };
+};
+
+// quantize a distance to our camera to RQUEUE_DEPTH_BITS bits
+// the bits of a positive float sort the same as its value so we simply take the top bits,
+// this gives us more precision close to our camera
+uint32_t rqueueDepth(float pDistance) {
+  union {
+    float     f;
+    uint32_t  u;
+  } bits;
+
+  // anything behind our camera is treated as being right in front of it
+  bits.f = pDistance > 0.0 ? pDistance : 0.0;
+
+  return bits.u >> (31 - RQUEUE_DEPTH_BITS);
+};
+
+// build a key for an opaque entry, we sort on state first to minimise state changes and then render front to back
+// IDs are wrapped to fit, that only affects how well things are grouped
+uint64_t rqueueOpaqueKey(unsigned int pPriority, unsigned int pShader, unsigned int pMaterial, unsigned int pMesh, float pDistance) {
+  uint64_t key;
+
+  key = pPriority > ((1 << RQUEUE_PRIORITY_BITS) - 1) ? ((1 << RQUEUE_PRIORITY_BITS) - 1) : pPriority;
+  key = (key << RQUEUE_SHADER_BITS) | (pShader & ((1 << RQUEUE_SHADER_BITS) - 1));
+  key = (key << RQUEUE_MATERIAL_BITS) | (pMaterial & ((1 << RQUEUE_MATERIAL_BITS) - 1));
+  key = (key << RQUEUE_MESH_BITS) | (pMesh & ((1 << RQUEUE_MESH_BITS) - 1));
+  key = (key << RQUEUE_DEPTH_BITS) | rqueueDepth(pDistance);
+
+  return key;
+};
+
+// build a key that sorts our entries back to front, used for things we blend
+uint64_t rqueueBackToFrontKey(float pDistance) {
+  // invert our depth so our furthest entry comes first, we only use our top bits so our radix sort can skip the rest
+  return ((uint64_t) (((1 << RQUEUE_DEPTH_BITS) - 1) - rqueueDepth(pDistance))) << (64 - RQUEUE_DEPTH_BITS);
+};
+
+#endif /* RQUEUE_IMPLEMENTATION */
+
+#endif /* !rqueueh */
@@ -0,0 +1,341 @@
+/********************************************************
+ * shadercache.h - shader program cache by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * It is included by shaders.h and implemented when
+ * SHADER_IMPLEMENTATION is defined.
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions.
+ *
+ * Compiling and linking all our shader permutations
+ * takes a good chunk of our startup time. Once a program
+ * is linked we ask GL for its binary and write it to
+ * <cache folder>/<name>-<id>.bin where id identifies the
+ * shader files and defines our program was built from.
+ *
+ * The file starts with a header containing a key, a hash
+ * of our GL vendor, renderer and version, our fully
+ * preprocessed sources and our defines. If the key
+ * doesn't match, or GL rejects our binary (i.e. after a
+ * driver update), we compile our program as normal and
+ * overwrite the file.
+ *
+ * Our cache folder is per user:
+ * - %LOCALAPPDATA%\glfw-tutorial\shaders\ on Windows
+ * - ~/Library/Caches/glfw-tutorial/shaders/ on Mac
+ * - $XDG_CACHE_HOME/glfw-tutorial/shaders/ or
+ *   ~/.cache/glfw-tutorial/shaders/ elsewhere
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ * 0.2  16-10-2026  Log the time spent preprocessing
+ *
+ ********************************************************/
+
+#ifndef shadercacheh
+#define shadercacheh
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "system.h"
+#include "benchmark.h"
+
+// increase this whenever the layout of our cache file changes
+#define SHADERCACHE_VERSION   1
+
+// starting value of our FNV-1a hash
+#define SHADERCACHE_SEED      0xcbf29ce484222325ULL
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT  0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH            0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS       0x87FE
+#endif
+
+// header at the start of our cache file
+typedef struct shaderCacheHeader {
+  char          magic[4];             // always "SHPB"
+  uint32_t      version;              // SHADERCACHE_VERSION
+  uint64_t      key;                  // hash of our driver, sources and defines
+  uint32_t      format;               // binary format GL gave us
+  uint32_t      length;               // length of our binary which follows our header
+} shaderCacheHeader;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void shaderCacheInit(bool pEnable);
+bool shaderCacheEnabled(void);
+uint64_t shaderCacheHash(uint64_t pHash, const void * pData, size_t pSize);
+uint64_t shaderCacheKey(void);
+GLuint shaderCacheLoad(const char * pName, uint64_t pId, uint64_t pKey);
+bool shaderCacheSave(const char * pName, uint64_t pId, uint64_t pKey, GLuint pProgram);
+void shaderCacheCount(bool pFromCache, double pPreprocessTime, double pTime);
+void shaderCacheLogStats(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef SHADER_IMPLEMENTATION
+
+#if defined(WIN32) || defined(_WIN32)
+#include <direct.h>
+#endif
+
+// some variables we maintain
+bool          shaderCacheActive = false;
+char          shaderCachePath[1024] = "";
+uint64_t      shaderCacheDriver = SHADERCACHE_SEED;
+unsigned int  shaderCacheLoaded = 0;
+unsigned int  shaderCacheCompiled = 0;
+double        shaderCacheTime = 0.0;
+double        shaderCachePreprocessTime = 0.0;
+
+// create all folders in pPath that don't exist yet, pPath must end with a separator
+void scMakePath(char * pPath) {
+  char *  sep;
+
+  for (sep = pPath + 1; *sep != '\0'; sep++) {
+    if ((*sep == '/') || (*sep == '\\')) {
+      char c = *sep;
+
+      *sep = '\0';
+#if defined(WIN32) || defined(_WIN32)
+      _mkdir(pPath);
+#else
+      mkdir(pPath, 0755);
+#endif
+      *sep = c;
+    };
+  };
+};
+
+// enable or disable our cache, this must be called with our GL context active and before we load our shaders
+void shaderCacheInit(bool pEnable) {
+  GLint         formats = 0;
+  const char *  base;
+
+  shaderCacheActive = false;
+  shaderCachePath[0] = '\0';
+  if (!pEnable) {
+    return;
+  };
+
+  // check if our driver can give us program binaries at all
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats <= 0) {
+    errorlog(0, "Program binaries aren't supported, not caching our shaders");
+    return;
+  };
+
+  // find our per user cache folder
+#if defined(WIN32) || defined(_WIN32)
+  base = getenv("LOCALAPPDATA");
+  if (base != NULL) {
+    sprintf(shaderCachePath, "%s\\glfw-tutorial\\shaders\\", base);
+  };
+#elif defined(__APPLE__)
+  base = getenv("HOME");
+  if (base != NULL) {
+    sprintf(shaderCachePath, "%s/Library/Caches/glfw-tutorial/shaders/", base);
+  };
+#else
+  base = getenv("XDG_CACHE_HOME");
+  if ((base != NULL) && (base[0] != '\0')) {
+    sprintf(shaderCachePath, "%s/glfw-tutorial/shaders/", base);
+  } else {
+    base = getenv("HOME");
+    if (base != NULL) {
+      sprintf(shaderCachePath, "%s/.cache/glfw-tutorial/shaders/", base);
+    };
+  };
+#endif
+
+  if (shaderCachePath[0] == '\0') {
+    errorlog(0, "Couldn't find a cache folder, not caching our shaders");
+    return;
+  };
+  scMakePath(shaderCachePath);
+
+  // a binary is only valid for the driver that created it
+  base = (const char *) glGetString(GL_VENDOR);
+  shaderCacheDriver = shaderCacheHash(SHADERCACHE_SEED, base, base == NULL ? 0 : strlen(base) + 1);
+  base = (const char *) glGetString(GL_RENDERER);
+  shaderCacheDriver = shaderCacheHash(shaderCacheDriver, base, base == NULL ? 0 : strlen(base) + 1);
+  base = (const char *) glGetString(GL_VERSION);
+  shaderCacheDriver = shaderCacheHash(shaderCacheDriver, base, base == NULL ? 0 : strlen(base) + 1);
+
+  shaderCacheActive = true;
+  errorlog(0, "Caching our shader programs in %s", shaderCachePath);
+};
+
+// returns true if we're caching our programs
+bool shaderCacheEnabled(void) {
+  return shaderCacheActive;
+};
+
+// 64 bit FNV-1a hash, continues from pHash so we can hash multiple blocks of data
+uint64_t shaderCacheHash(uint64_t pHash, const void * pData, size_t pSize) {
+  const unsigned char * data = (const unsigned char *) pData;
+  size_t                i;
+
+  for (i = 0; i < pSize; i++) {
+    pHash ^= data[i];
+    pHash *= 0x100000001b3ULL;
+  };
+
+  return pHash;
+};
+
+// returns the start of our key, add our sources and defines to this with shaderCacheHash
+uint64_t shaderCacheKey(void) {
+  return shaderCacheDriver;
+};
+
+// attempt to load the program pName from our cache, returns 0 if we don't have a valid binary
+GLuint shaderCacheLoad(const char * pName, uint64_t pId, uint64_t pKey) {
+  shaderCacheHeader header;
+  char              fileName[1024];
+  FILE *            file;
+  void *            data;
+  GLuint            program = 0;
+  GLint             linked = 0;
+
+  if (!shaderCacheActive) {
+    return 0;
+  };
+
+  sprintf(fileName, "%s%s-%016llx.bin", shaderCachePath, pName, (unsigned long long) pId);
+  file = fopen(fileName, "rb");
+  if (file == NULL) {
+    return 0;
+  };
+
+  if (fread(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    return 0;
+  } else if ((memcmp(header.magic, "SHPB", 4) != 0) || (header.version != SHADERCACHE_VERSION) || (header.key != pKey) || (header.length == 0)) {
+    // out of date, we'll overwrite it
+    fclose(file);
+    return 0;
+  };
+
+  data = malloc(header.length);
+  if (data == NULL) {
+    fclose(file);
+    return 0;
+  } else if (fread(data, 1, header.length, file) != header.length) {
+    free(data);
+    fclose(file);
+    return 0;
+  };
+  fclose(file);
+
+  // and hand it to GL, it may still reject it
+  program = glCreateProgram();
+  glProgramBinary(program, header.format, data, header.length);
+  free(data);
+
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    errorlog(0, "Program binary for %s was rejected, recompiling", pName);
+    glDeleteProgram(program);
+    return 0;
+  };
+
+  return program;
+};
+
+// write the binary of our linked program pProgram to our cache, returns false if this failed in which case we'll simply compile it again next time
+bool shaderCacheSave(const char * pName, uint64_t pId, uint64_t pKey, GLuint pProgram) {
+  shaderCacheHeader header;
+  char              fileName[1024];
+  char              tmpName[1024];
+  FILE *            file;
+  void *            data;
+  GLint             length = 0;
+  GLenum            format = 0;
+  bool              saved;
+
+  if (!shaderCacheActive) {
+    return false;
+  };
+
+  glGetProgramiv(pProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  };
+
+  data = malloc(length);
+  if (data == NULL) {
+    return false;
+  };
+  glGetProgramBinary(pProgram, length, &length, &format, data);
+
+  memcpy(header.magic, "SHPB", 4);
+  header.version = SHADERCACHE_VERSION;
+  header.key = pKey;
+  header.format = format;
+  header.length = length;
+
+  // write to a temporary file first so we never leave half a binary behind
+  sprintf(fileName, "%s%s-%016llx.bin", shaderCachePath, pName, (unsigned long long) pId);
+  sprintf(tmpName, "%s.tmp", fileName);
+  file = fopen(tmpName, "wb");
+  if (file == NULL) {
+    free(data);
+    return false;
+  };
+
+  saved = (fwrite(&header, sizeof(header), 1, file) == 1) && (fwrite(data, 1, length, file) == (size_t) length);
+  fclose(file);
+  free(data);
+
+#if defined(WIN32) || defined(_WIN32)
+  remove(fileName);
+#endif
+  if (!saved || (rename(tmpName, fileName) != 0)) {
+    remove(tmpName);
+    return false;
+  };
+
+  return true;
+};
+
+// count a program we've built, the time it took and how much of that was spent preprocessing our sources
+void shaderCacheCount(bool pFromCache, double pPreprocessTime, double pTime) {
+  if (pFromCache) {
+    shaderCacheLoaded++;
+  } else {
+    shaderCacheCompiled++;
+  };
+  shaderCacheTime += pTime;
+  shaderCachePreprocessTime += pPreprocessTime;
+};
+
+// log how long building our programs took since our last call
+void shaderCacheLogStats(void) {
+  errorlog(0, "Built %u shader programs in %0.3f ms, %u from our program cache and %u compiled", shaderCacheLoaded + shaderCacheCompiled, shaderCacheTime, shaderCacheLoaded, shaderCacheCompiled);
+  errorlog(0, "Preprocessing our shaders took %0.3f ms", shaderCachePreprocessTime);
+
+  shaderCacheLoaded = 0;
+  shaderCacheCompiled = 0;
+  shaderCacheTime = 0.0;
+  shaderCachePreprocessTime = 0.0;
+};
+
+#endif /* SHADER_IMPLEMENTATION */
+
+#endif /* !shadercacheh */
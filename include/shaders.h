@@ -20,6 +20,15 @@
  * 0.1  09-03-2015  First version with basic functions
  * 0.2  06-01-2016  Moved shaderSelectProgram into materials
  * 0.3  26-04-2016  More shader changes
+ * 0.4  16-10-2026  Added instanced shader variants
+ * 0.5  16-10-2026  Moved our matrices and material into
+ *                  std140 uniform blocks
+ * 0.6  16-10-2026  Added layered shader variants
+ * 0.7  16-10-2026  Added global defines
+ * 0.8  16-10-2026  Added eye projections for single pass stereo
+ * 0.9  16-10-2026  Cache our linked programs
+ * 0.10 16-10-2026  New preprocessor with nested conditionals,
+ *                  #if expressions and an include cache
  *
  ********************************************************/
 
@@ -37,15 +46,32 @@
 #include "system.h"
 #include "math3d.h"
 #include "varchar.h"
+#include "shadercache.h"
 
 // and handy defines
 #define NO_SHADER 0xFFFFFFFF
 
+// binding points for our uniform blocks, these are shared by all our shaders
+#define SHADER_FRAMEBLOCK     0
+#define SHADER_OBJECTBLOCK    1
+#define SHADER_MATERIALBLOCK  2
+#define SHADER_LIGHTBLOCK     3
+#define SHADER_CLUSTERBLOCK   4
+
+// limits of our preprocessor
+#define SHADER_MAXDEFINES     128
+#define SHADER_MAXSOURCES     32
+#define SHADER_MAXNESTING     32
+
+// initial size of the ring buffer we write our frame and object blocks into
+#define SHADER_RINGSIZE       (1024 * 1024)
+
 enum shaderErrors {
   SHADER_ERR_UNKNOWN = -1,
   SHADER_ERR_NOCOMPILE = -2,
   SHADER_ERR_NOLINK = -3,
-  SHADER_ERR_NESTED = -4
+  SHADER_ERR_NESTED = -4,
+  SHADER_ERR_PREPROCESS = -5
 };
 
 // structure for encapsulating a shader, note that not all ids need to be present (would be logical to call this struct shader but it's already used in some of the support libraries...)
@@ -53,26 +79,15 @@ typedef struct shaderInfo {
   unsigned int  retainCount;        // retain count for this object
   char    name[50];                 // name of the shader
   GLuint  program;                  // shader program to use
+  struct shaderInfo * instanced;    // variant of this shader that reads its model matrix per instance (if any)
+  struct shaderInfo * layered;      // variant of this shader that renders to all faces of a cube map in one go (if any)
   
-  // camera info
-  GLint   eyePosId;                 // our eye position
-  
-  // matrices
-  GLint   projectionMatrixId;       // our projection matrix
-  GLint   viewMatrixId;             // our view matrix
-  GLint   modelMatrixId;            // our model matrix
-  GLint   modelViewMatrixId;        // our model view matrix
-  GLint   modelViewInverseId;       // inverse of our model view matrix
-  GLint   normalMatrixId;           // matrix to apply to our normals
-  GLint   normalViewId;             // matrix to apply to our normals also adjusted to view
-  GLint   mvpId;                    // our model view projection matrix
+  // uniform blocks
+  GLint   frameBlockId;             // our per frame block (camera info and projection and view matrices)
+  GLint   objectBlockId;            // our per object block (model matrix and everything derived from it)
+  GLint   materialBlockId;          // our material block
 
   // material
-  GLint   alphaId;                  // alpha
-  GLint   ambientId;                // ambient color of our light
-  GLint   matColorId;               // material diffuse color
-  GLint   matSpecColorId;           // material specular color
-  GLint   shininessId;              // shininess
   GLint   textureMapId;             // texture map
   GLint   reflectMapId;             // reflect map
   GLint   bumpMapId;                // bump map (used as normal map or height map)
@@ -83,6 +98,7 @@ typedef struct shaderMatrices {
   mat4    projection;               // projection matrix
   mat4    view;                     // view matrix
   mat4    model;                    // model matrix
+  mat4    eyeProjection[2];         // projection matrices for our left and right eye when rendering both in one pass
 
   // calculated
   bool    updViewProj;              // need to update our view projection matrix?
@@ -108,26 +124,70 @@ typedef struct shaderMatrices {
 
   bool    updNormView;              // need to update our normal view matrix
   mat3    normalView;               // our normal view matrix
+
+  // uniform blocks
+  bool    updFrame;                 // need to update our frame block
+  GLintptr frameOffset;             // offset of our frame block in our ring buffer
+  unsigned int frameRing;           // ring buffer generation our frame block was written to
+
+  bool    updObject;                // need to update our object block
+  GLintptr objectOffset;            // offset of our object block in our ring buffer
+  unsigned int objectRing;          // ring buffer generation our object block was written to
 } shaderMatrices;
 
+// std140 layout of our per frame block, this must match frame.inc
+typedef struct shaderFrameBlock {
+  mat4    projection;               // projection matrix
+  mat4    view;                     // view matrix
+  mat4    viewProjection;           // view projection matrix
+  mat4    invView;                  // inverse of our view
+  vec3    eyePos;                   // our eye position
+  GLfloat padding;                  // std140 pads our vec3 to a vec4
+  mat4    eyeProjection[2];         // projection matrices for our left and right eye
+} shaderFrameBlock;
+
+// std140 layout of our per object block, this must match object.inc
+typedef struct shaderObjectBlock {
+  mat4    model;                    // model matrix
+  mat4    modelView;                // our model view matrix
+  mat4    mvp;                      // our model view projection matrix
+  vec4    normalMatrix[3];          // our normal matrix, std140 pads each column of a mat3 to a vec4
+  vec4    normalView[3];            // our normal view matrix
+} shaderObjectBlock;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
   
 // support functions
 void shaderSetPath(char * pPath);
+void shaderSetGlobalDefines(const char * pDefines);
+void shaderFreeSources(void);
 GLuint shaderCompile(GLenum pShaderType, const GLchar* pShaderText);
 GLuint shaderLoad(GLenum pShaderType, const char *pName, llist * pDefines);
 GLuint shaderLink(GLuint pNumShaders, ...);
+GLuint shaderBuild(const char * pName, int pCount, const GLenum * pTypes, const char ** pFiles, llist * pDefines);
 
 // shader object
 shaderInfo * newShader(const char *pName, const char * pVertexShader, const char * pTessControlShader, const char * pTessEvalShader, const char * pGeoShader, const char * pFragmentShader, const char *pDefines);
 void shaderRetain(shaderInfo * pShader);
 void shaderRelease(shaderInfo * pShader);
 void shaderSetProgram(shaderInfo * pShader, GLuint pProgram);
+void shaderSetInstanced(shaderInfo * pShader, shaderInfo * pInstanced);
+void shaderSetLayered(shaderInfo * pShader, shaderInfo * pLayered);
+GLint shaderBindBlock(GLuint pProgram, const char * pName, GLuint pBinding);
+
+// uniform buffer ring
+GLsizeiptr shaderRingStride(GLsizeiptr pSize);
+GLintptr shaderRingWrite(const void * pData, GLsizeiptr pSize);
+void * shaderRingMap(GLsizeiptr pSize, GLintptr * pOffset);
+void shaderRingUnmap(void);
+void shaderRingBind(GLuint pBinding, GLintptr pOffset, GLsizeiptr pSize);
+void shaderRingFree(void);
 
 // shader matrix structure
 void shdMatSetProjection(shaderMatrices * pShdMat, const mat4 * pProjection);
+void shdMatSetEyeProjections(shaderMatrices * pShdMat, const mat4 * pLeft, const mat4 * pRight);
 void shdMatSetView(shaderMatrices * pShdMat, const mat4 * pView);
 void shdMatSetModel(shaderMatrices * pShdMat, const mat4 * pModel);
 void shdMatSetEyePos(shaderMatrices * pShdMat, const vec3 * pEye);
@@ -139,6 +199,11 @@ mat4 * shdMatGetInvModelView(shaderMatrices * pShdMat);
 mat4 * shdMatGetMvp(shaderMatrices * pShdMat);
 mat3 * shdMatGetNormal(shaderMatrices * pShdMat);
 mat3 * shdMatGetNormalView(shaderMatrices * pShdMat);
+void shdMatFillObject(shaderMatrices * pShdMat, shaderObjectBlock * pBlock);
+void shdMatUseObject(shaderMatrices * pShdMat, GLintptr pOffset);
+void shdMatBindFrame(shaderMatrices * pShdMat);
+void shdMatBindObject(shaderMatrices * pShdMat);
+void shdMatBind(shaderMatrices * pShdMat, bool pFrame, bool pObject);
 
 #ifdef __cplusplus
 };
@@ -148,10 +213,28 @@ mat3 * shdMatGetNormalView(shaderMatrices * pShdMat);
 
 // some variables we maintain
 char shaderPath[1024] = "";
+llist * shaderGlobalDefines = NULL;
 
 // sets the locationf from which we load our texture maps
 void shaderSetPath(char * pPath) {
-  strcpy(shaderPath, pPath);
+  if (strcmp(shaderPath, pPath) != 0) {
+    // files we've already loaded came from our old path
+    shaderFreeSources();
+    strcpy(shaderPath, pPath);
+  };
+};
+
+// sets defines that apply to every shader we load on top of its own defines, i.e. to select our gBuffer layout
+// these need to be set before loading our shaders, call with NULL to clear them
+void shaderSetGlobalDefines(const char * pDefines) {
+  if (shaderGlobalDefines != NULL) {
+    llistFree(shaderGlobalDefines);
+    shaderGlobalDefines = NULL;
+  };
+
+  if (pDefines != NULL) {
+    shaderGlobalDefines = newVCListFromString(pDefines, " \r\n");
+  };
 };
 
 // Compiles the text in pShaderText and returns a shader object
@@ -238,118 +321,695 @@ GLuint shaderCompile(GLenum pShaderType, const GLchar * pShaderText) {
   return shader;
 };
 
-varchar * shaderLoadAndPreprocess(const char *pName, llist * pDefines) {
-  varchar * shaderText = NULL;
+////////////////////////////////////////////////////////////////////////////////////
+// preprocessor
+//
+// We resolve our includes and conditionals ourselves so we can select our shader
+// permutation with a list of defines. Shader files are loaded once and kept in
+// memory, we walk their text in place and write our output into a single arena
+// that we reuse for every shader we build.
+//
+// We support #include "file", #define, #undef, #ifdef, #ifndef, #if, #elif, #else,
+// #endif and #pragma once. Conditionals can be nested and #if and #elif take simple
+// integer expressions with defined(). Defines are passed through to GLSL so it can
+// substitute them, any other directive such as #version is passed through as is.
+//
+// We emit #line directives so errors are reported against the file they're in,
+// GLSL only allows a number as our source string so we number our files in the
+// order they are first included, 0 being our shader file itself.
+
+// a define, our name and value point into the text of our shader file or our list of defines
+typedef struct shaderDefine {
+  const char *  name;                 // name of our define
+  int           nameLen;              // length of our name
+  const char *  value;                // value of our define, may be empty
+  int           valueLen;             // length of our value
+} shaderDefine;
+
+// state of our preprocessor while we process one shader stage
+typedef struct shaderPreprocessor {
+  int           defineCount;                          // number of defines
+  shaderDefine  defines[SHADER_MAXDEFINES];           // our defines
+  int           sourceCount;                          // number of files included
+  int           sources[SHADER_MAXSOURCES];           // index of each file in our include cache
+  unsigned int  stamp;                                // identifies this run for #pragma once
+  int           depth;                                // include depth
+  bool          started;                              // we've written our first line
+  bool          needLine;                             // we need to output a #line directive
+} shaderPreprocessor;
+
+// the files that make up a preprocessed shader, in the order of their source string number
+typedef struct shaderSourceList {
+  int           count;                // number of files
+  int           index[SHADER_MAXSOURCES]; // index of each file in our include cache
+} shaderSourceList;
+
+// an entry in our include cache
+typedef struct shaderSource {
+  char          name[256];            // name of our file
+  char *        text;                 // contents of our file
+  unsigned int  once;                 // stamp of the last run this file was included in with #pragma once
+} shaderSource;
+
+shaderSource *  shaderSources = NULL;
+int             shaderSourceCount = 0;
+int             shaderSourceSize = 0;
+unsigned int    shaderStamp = 0;
+
+char *          shaderArena = NULL;
+size_t          shaderArenaSize = 0;
+size_t          shaderArenaLen = 0;
+
+// returns the index of pName in our include cache, loading it if needed, returns -1 if we can't load it
+int shaderGetSource(const char * pName) {
+  char *  text;
+  int     i;
+
+  for (i = 0; i < shaderSourceCount; i++) {
+    if (strcmp(shaderSources[i].name, pName) == 0) {
+      return i;
+    };
+  };
 
-  // create a new varchar object for our shader text
-  shaderText = newVarchar();
-  if (shaderText != NULL) {
-    // load the contents of our file
-    char * fileText = loadFile(shaderPath, pName);
-
-    if (fileText != NULL) {
-      // now loop through our text line by line (we do this with a copy of our pointer)
-      int    pos = 0;
-      bool   addLines = true;
-      int    ifMode = 0; // 0 is not in if, 1 = true condition not found, 2 = true condition found
-
-      while (fileText[pos] != 0) {
-        // find our next line
-        char * line = delimitText(fileText + pos, "\n\r");
-
-        // found a non-empty line?
-        if (line != NULL) {
-          int len = strlen(line);
-
-          // check for any of our preprocessor checks
-          if (memcmp(line, "#include \"", 10) == 0) {
-            if (addLines) {
-              // include this file
-              char * includeName = delimitText(line + 10, "\"");
-              if (includeName != NULL) {
-                varchar * includeText = shaderLoadAndPreprocess(includeName, pDefines);
-                if (includeText != NULL) {
-                  // and append it....
-                  varcharAppend(shaderText, includeText->text, includeText->len);
-                  varcharRelease(includeText);
-                };
-                free(includeName);
-              };
-            };
-          } else if (memcmp(line, "#ifdef ", 7) == 0) {
-            if (ifMode == 0) {
-              char * ifdefined;
-
-              ifMode = 1; // assume not defined....
-              ifdefined = delimitText(line + 7, " ");
-              if (ifdefined != NULL) {
-                // check if our define is in our list of defines
-                if (vclistContains(pDefines, ifdefined)) {
-                  ifMode = 2;
-                };
-                free(ifdefined);
-              };
-              addLines = (ifMode == 2);              
-            } else {
-              errorlog(SHADER_ERR_NESTED, "Can't nest defines in shaders");
-            };
-          } else if (memcmp(line, "#ifndef ", 8) == 0) {
-            if (ifMode == 0) {
-              char * ifnotdefined;
-
-              ifMode = 1; // assume not defined....
-              ifnotdefined = delimitText(line + 7, " ");
-              if (ifnotdefined != NULL) {
-                // check if our define is not in our list of defines
-                if (vclistContains(pDefines, ifnotdefined) == false) {
-                  ifMode = 2;
-                };
-                free(ifnotdefined);
-              };
-              addLines = (ifMode == 2);              
-            } else {
-              errorlog(SHADER_ERR_NESTED, "Can't nest defines in shaders");
+  if (strlen(pName) >= sizeof(shaderSources[0].name)) {
+    errorlog(SHADER_ERR_PREPROCESS, "Shader file name %s is too long", pName);
+    return -1;
+  };
+
+  text = loadFile(shaderPath, pName);
+  if (text == NULL) {
+    return -1;
+  };
+
+  if (shaderSourceCount == shaderSourceSize) {
+    shaderSource * sources = (shaderSource *) realloc(shaderSources, sizeof(shaderSource) * (shaderSourceSize + 32));
+    if (sources == NULL) {
+      errorlog(SHADER_ERR_PREPROCESS, "Couldn't allocate memory for our include cache");
+      free(text);
+      return -1;
+    };
+    shaderSources = sources;
+    shaderSourceSize += 32;
+  };
+
+  strcpy(shaderSources[shaderSourceCount].name, pName);
+  shaderSources[shaderSourceCount].text = text;
+  shaderSources[shaderSourceCount].once = 0;
+
+  return shaderSourceCount++;
+};
+
+// frees our include cache, call this when our shader files have changed or when we're done loading shaders
+void shaderFreeSources(void) {
+  int i;
+
+  for (i = 0; i < shaderSourceCount; i++) {
+    free(shaderSources[i].text);
+  };
+  if (shaderSources != NULL) {
+    free(shaderSources);
+    shaderSources = NULL;
+  };
+  shaderSourceCount = 0;
+  shaderSourceSize = 0;
+
+  if (shaderArena != NULL) {
+    free(shaderArena);
+    shaderArena = NULL;
+  };
+  shaderArenaSize = 0;
+  shaderArenaLen = 0;
+};
+
+// appends pLen characters to our arena, we always keep room for a trailing zero
+bool shaderArenaAppend(const char * pText, size_t pLen) {
+  if (shaderArenaLen + pLen + 1 > shaderArenaSize) {
+    size_t  size = shaderArenaSize == 0 ? 65536 : shaderArenaSize;
+    char *  arena;
+
+    while (shaderArenaLen + pLen + 1 > size) {
+      size *= 2;
+    };
+
+    arena = (char *) realloc(shaderArena, size);
+    if (arena == NULL) {
+      errorlog(SHADER_ERR_PREPROCESS, "Couldn't allocate memory for our shader text");
+      return false;
+    };
+    shaderArena = arena;
+    shaderArenaSize = size;
+  };
+
+  memcpy(shaderArena + shaderArenaLen, pText, pLen);
+  shaderArenaLen += pLen;
+  shaderArena[shaderArenaLen] = '\0';
+
+  return true;
+};
+
+// returns true if pChar can be part of an identifier
+bool shaderIsIdent(char pChar) {
+  return ((pChar >= 'a') && (pChar <= 'z')) || ((pChar >= 'A') && (pChar <= 'Z')) || ((pChar >= '0') && (pChar <= '9')) || (pChar == '_');
+};
+
+// skips spaces and tabs
+const char * shaderSkipSpace(const char * pText, const char * pEnd) {
+  while ((pText < pEnd) && ((*pText == ' ') || (*pText == '\t'))) {
+    pText++;
+  };
+  return pText;
+};
+
+// returns the index of our define or -1 if it isn't defined
+int shaderFindDefine(shaderPreprocessor * pState, const char * pName, int pLen) {
+  int i;
+
+  for (i = 0; i < pState->defineCount; i++) {
+    if ((pState->defines[i].nameLen == pLen) && (memcmp(pState->defines[i].name, pName, pLen) == 0)) {
+      return i;
+    };
+  };
+
+  return -1;
+};
+
+// adds or replaces a define
+void shaderAddDefine(shaderPreprocessor * pState, const char * pName, int pNameLen, const char * pValue, int pValueLen) {
+  int i = shaderFindDefine(pState, pName, pNameLen);
+
+  if (i < 0) {
+    if (pState->defineCount == SHADER_MAXDEFINES) {
+      errorlog(SHADER_ERR_PREPROCESS, "Too many defines in shader");
+      return;
+    };
+    i = pState->defineCount++;
+  };
+
+  pState->defines[i].name = pName;
+  pState->defines[i].nameLen = pNameLen;
+  pState->defines[i].value = pValue;
+  pState->defines[i].valueLen = pValueLen;
+};
+
+// adds the defines in our list of defines, these have no value
+void shaderAddDefineList(shaderPreprocessor * pState, llist * pDefines) {
+  if (pDefines != NULL) {
+    llistNode * node = pDefines->first;
+
+    while (node != NULL) {
+      varchar * define = (varchar *) node->data;
+
+      shaderAddDefine(pState, define->text, define->len, "", 0);
+      node = node->next;
+    };
+  };
+};
+
+// state of an expression we're evaluating
+typedef struct shaderExpr {
+  shaderPreprocessor *  state;
+  const char *          pos;
+  const char *          end;
+  int                   depth;        // we evaluate the value of our defines as expressions, this prevents endless recursion
+  bool                  error;
+} shaderExpr;
+
+// binary operators in our expressions, longer operators must come first
+typedef struct shaderOperator {
+  char  text[3];
+  int   precedence;
+} shaderOperator;
+
+shaderOperator shaderOperators[] = {
+  { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 },
+  { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 }, { ">", 7 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 }
+};
+
+long shaderExprEval(shaderPreprocessor * pState, const char * pText, const char * pEnd, int pDepth, bool * pError);
+long shaderExprBinary(shaderExpr * pExpr, int pPrecedence);
+
+// reads an identifier, returns its length
+int shaderExprIdent(shaderExpr * pExpr, const char ** pName) {
+  int len = 0;
+
+  pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+  *pName = pExpr->pos;
+  while ((pExpr->pos < pExpr->end) && shaderIsIdent(*pExpr->pos)) {
+    pExpr->pos++;
+    len++;
+  };
+
+  return len;
+};
+
+// evaluates a number, identifier, defined(), unary operator or expression between brackets
+long shaderExprUnary(shaderExpr * pExpr) {
+  const char *  name;
+  int           len;
+  char          c;
+
+  pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+  if ((pExpr->error) || (pExpr->pos >= pExpr->end)) {
+    pExpr->error = true;
+    return 0;
+  };
+
+  c = *pExpr->pos;
+  if ((c == '!') || (c == '-') || (c == '+') || (c == '~')) {
+    long value;
+
+    pExpr->pos++;
+    value = shaderExprUnary(pExpr);
+    return c == '!' ? !value : c == '-' ? -value : c == '~' ? ~value : value;
+  } else if (c == '(') {
+    long value;
+
+    pExpr->pos++;
+    value = shaderExprBinary(pExpr, 1);
+    pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+    if ((pExpr->pos < pExpr->end) && (*pExpr->pos == ')')) {
+      pExpr->pos++;
+    } else {
+      pExpr->error = true;
+    };
+    return value;
+  } else if ((c >= '0') && (c <= '9')) {
+    char *  numEnd;
+    long    value = strtol(pExpr->pos, &numEnd, 0);
+
+    // skip any suffix such as u
+    pExpr->pos = numEnd;
+    while ((pExpr->pos < pExpr->end) && shaderIsIdent(*pExpr->pos)) {
+      pExpr->pos++;
+    };
+    return value;
+  };
+
+  len = shaderExprIdent(pExpr, &name);
+  if (len == 0) {
+    pExpr->error = true;
+    return 0;
+  } else if ((len == 7) && (memcmp(name, "defined", 7) == 0)) {
+    bool bracket;
+
+    pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+    bracket = (pExpr->pos < pExpr->end) && (*pExpr->pos == '(');
+    if (bracket) {
+      pExpr->pos++;
+    };
+    len = shaderExprIdent(pExpr, &name);
+    if (bracket) {
+      pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+      if ((pExpr->pos < pExpr->end) && (*pExpr->pos == ')')) {
+        pExpr->pos++;
+      } else {
+        pExpr->error = true;
+      };
+    };
+    if (len == 0) {
+      pExpr->error = true;
+      return 0;
+    };
+    return shaderFindDefine(pExpr->state, name, len) >= 0 ? 1 : 0;
+  } else {
+    int i = shaderFindDefine(pExpr->state, name, len);
+
+    if (i < 0) {
+      // undefined identifiers are 0
+      return 0;
+    } else if (pExpr->state->defines[i].valueLen == 0) {
+      // and defines without a value 1 so #if textured works
+      return 1;
+    } else if (pExpr->depth >= 16) {
+      pExpr->error = true;
+      return 0;
+    } else {
+      shaderDefine * define = &pExpr->state->defines[i];
+      return shaderExprEval(pExpr->state, define->value, define->value + define->valueLen, pExpr->depth + 1, &pExpr->error);
+    };
+  };
+};
+
+// evaluates binary operators of at least pPrecedence
+long shaderExprBinary(shaderExpr * pExpr, int pPrecedence) {
+  long value = shaderExprUnary(pExpr);
+
+  while (!pExpr->error) {
+    shaderOperator *  op = NULL;
+    long              right;
+    int               i, len;
+
+    pExpr->pos = shaderSkipSpace(pExpr->pos, pExpr->end);
+    for (i = 0; (op == NULL) && (i < sizeof(shaderOperators) / sizeof(shaderOperator)); i++) {
+      len = strlen(shaderOperators[i].text);
+      if ((pExpr->pos + len <= pExpr->end) && (memcmp(pExpr->pos, shaderOperators[i].text, len) == 0)) {
+        op = &shaderOperators[i];
+      };
+    };
+
+    if ((op == NULL) || (op->precedence < pPrecedence)) {
+      return value;
+    };
+
+    pExpr->pos += len;
+    right = shaderExprBinary(pExpr, op->precedence + 1);
+
+    switch (op->text[0]) {
+      case '|': value = op->text[1] == '|' ? (value || right) : (value | right); break;
+      case '&': value = op->text[1] == '&' ? (value && right) : (value & right); break;
+      case '^': value = value ^ right; break;
+      case '=': value = value == right; break;
+      case '!': value = value != right; break;
+      case '<': value = op->text[1] == '=' ? (value <= right) : op->text[1] == '<' ? (value << right) : (value < right); break;
+      case '>': value = op->text[1] == '=' ? (value >= right) : op->text[1] == '>' ? (value >> right) : (value > right); break;
+      case '+': value = value + right; break;
+      case '-': value = value - right; break;
+      case '*': value = value * right; break;
+      case '/':
+      case '%': {
+        if (right == 0) {
+          pExpr->error = true;
+        } else {
+          value = op->text[0] == '/' ? value / right : value % right;
+        };
+      } break;
+    };
+  };
+
+  return value;
+};
+
+// evaluates the expression between pText and pEnd
+long shaderExprEval(shaderPreprocessor * pState, const char * pText, const char * pEnd, int pDepth, bool * pError) {
+  shaderExpr  expr;
+  long        value;
+
+  expr.state = pState;
+  expr.pos = pText;
+  expr.end = pEnd;
+  expr.depth = pDepth;
+  expr.error = false;
+
+  value = shaderExprBinary(&expr, 1);
+  if (shaderSkipSpace(expr.pos, expr.end) != expr.end) {
+    // trailing garbage
+    expr.error = true;
+  };
+  if (expr.error) {
+    *pError = true;
+  };
+
+  return value;
+};
+
+// writes a #line directive if needed before we write our next line
+bool shaderWriteLine(shaderPreprocessor * pState, int pLine, int pSource) {
+  if (pState->needLine && pState->started) {
+    char line[50];
+
+    sprintf(line, "#line %i %i\n", pLine, pSource);
+    if (!shaderArenaAppend(line, strlen(line))) {
+      return false;
+    };
+  };
+
+  pState->started = true;
+  pState->needLine = false;
+  return true;
+};
+
+// a conditional block we're in
+typedef struct shaderCondition {
+  bool  parentActive;                 // were we outputting lines when we entered this block?
+  bool  taken;                        // have we found a branch that is true?
+  bool  seenElse;                     // have we seen our #else?
+} shaderCondition;
+
+// preprocess the file at pIndex in our include cache and append the result to our arena
+bool shaderPreprocessFile(shaderPreprocessor * pState, int pIndex) {
+  shaderCondition conditions[SHADER_MAXNESTING];
+  int             conditionCount = 0;
+  bool            active = true;
+  const char *    name = shaderSources[pIndex].name;
+  const char *    text = shaderSources[pIndex].text;
+  int             lineNo = 0;
+  int             source;
+
+  // find our source string number, this file may have been included before
+  for (source = 0; (source < pState->sourceCount) && (pState->sources[source] != pIndex); source++);
+  if (source == pState->sourceCount) {
+    if (pState->sourceCount == SHADER_MAXSOURCES) {
+      errorlog(SHADER_ERR_PREPROCESS, "Too many files included in %s", shaderSources[pState->sources[0]].name);
+      return false;
+    };
+    pState->sources[pState->sourceCount++] = pIndex;
+  };
+  pState->needLine = true;
+
+  while (*text != '\0') {
+    const char *  lineEnd = text;
+    const char *  next;
+    const char *  pos;
+
+    // find the end of our line
+    while ((*lineEnd != '\0') && (*lineEnd != '\n') && (*lineEnd != '\r')) {
+      lineEnd++;
+    };
+    next = lineEnd;
+    if (*next == '\r') next++;
+    if (*next == '\n') next++;
+    lineNo++;
+
+    pos = shaderSkipSpace(text, lineEnd);
+    if ((pos < lineEnd) && (*pos == '#')) {
+      const char *  directive;
+      int           len;
+
+      pos = shaderSkipSpace(pos + 1, lineEnd);
+      directive = pos;
+      while ((pos < lineEnd) && shaderIsIdent(*pos)) {
+        pos++;
+      };
+      len = pos - directive;
+      pos = shaderSkipSpace(pos, lineEnd);
+
+      if (((len == 5) && (memcmp(directive, "ifdef", 5) == 0)) || ((len == 6) && (memcmp(directive, "ifndef", 6) == 0)) || ((len == 2) && (memcmp(directive, "if", 2) == 0))) {
+        if (conditionCount == SHADER_MAXNESTING) {
+          errorlog(SHADER_ERR_NESTED, "Conditionals nested too deep in %s:%i", name, lineNo);
+          return false;
+        };
+
+        conditions[conditionCount].parentActive = active;
+        conditions[conditionCount].seenElse = false;
+        if (active) {
+          if (len == 2) {
+            bool error = false;
+
+            active = shaderExprEval(pState, pos, lineEnd, 0, &error) != 0;
+            if (error) {
+              errorlog(SHADER_ERR_PREPROCESS, "Invalid expression in %s:%i", name, lineNo);
+              return false;
             };
-          } else if (memcmp(line, "#else", 5) == 0) {
-            if (ifMode == 1) {
-              ifMode = 2;
-              addLines = true;
-            } else {
-              addLines = false;
+          } else {
+            const char *  define = pos;
+
+            while ((pos < lineEnd) && shaderIsIdent(*pos)) {
+              pos++;
             };
-          } else if (memcmp(line, "#endif", 6) == 0) {
-            addLines = true;
-            ifMode = 0;
-          } else if (addLines) {
-            // add our line
-            varcharAppend(shaderText, line, len);
-            // add our line delimiter
-            varcharAppend(shaderText, "\n", 1);
+            active = (shaderFindDefine(pState, define, pos - define) >= 0) == (len == 5);
           };
+          conditions[conditionCount].taken = active;
+        } else {
+          // never take any branch within a block we're skipping
+          conditions[conditionCount].taken = true;
+        };
+        conditionCount++;
+        pState->needLine = true;
+      } else if ((len == 4) && (memcmp(directive, "elif", 4) == 0)) {
+        if ((conditionCount == 0) || conditions[conditionCount - 1].seenElse) {
+          errorlog(SHADER_ERR_PREPROCESS, "Unexpected #elif in %s:%i", name, lineNo);
+          return false;
+        } else if (conditions[conditionCount - 1].taken) {
+          active = false;
+        } else {
+          bool error = false;
 
-          if (fileText[pos + len] != 0) {
-            // skip our newline character
-            pos += len + 1;
-          } else {
-            // we found our ending
-            pos += len;
+          active = shaderExprEval(pState, pos, lineEnd, 0, &error) != 0;
+          if (error) {
+            errorlog(SHADER_ERR_PREPROCESS, "Invalid expression in %s:%i", name, lineNo);
+            return false;
+          };
+          conditions[conditionCount - 1].taken = active;
+        };
+        pState->needLine = true;
+      } else if ((len == 4) && (memcmp(directive, "else", 4) == 0)) {
+        if ((conditionCount == 0) || conditions[conditionCount - 1].seenElse) {
+          errorlog(SHADER_ERR_PREPROCESS, "Unexpected #else in %s:%i", name, lineNo);
+          return false;
+        };
+        conditions[conditionCount - 1].seenElse = true;
+        active = !conditions[conditionCount - 1].taken;
+        conditions[conditionCount - 1].taken = true;
+        pState->needLine = true;
+      } else if ((len == 5) && (memcmp(directive, "endif", 5) == 0)) {
+        if (conditionCount == 0) {
+          errorlog(SHADER_ERR_PREPROCESS, "Unexpected #endif in %s:%i", name, lineNo);
+          return false;
+        };
+        conditionCount--;
+        active = conditions[conditionCount].parentActive;
+        pState->needLine = true;
+      } else if (!active) {
+        // skip any other directive in a block we're skipping
+        pState->needLine = true;
+      } else if ((len == 7) && (memcmp(directive, "include", 7) == 0)) {
+        const char *  includeEnd;
+        char          includeName[256];
+        int           include;
+
+        includeEnd = pos + 1;
+        while ((includeEnd < lineEnd) && (*includeEnd != '"')) {
+          includeEnd++;
+        };
+        if ((*pos != '"') || (includeEnd == lineEnd) || (includeEnd - pos - 1 >= sizeof(includeName)) || (includeEnd - pos == 1)) {
+          errorlog(SHADER_ERR_PREPROCESS, "Invalid #include in %s:%i", name, lineNo);
+          return false;
+        } else if (pState->depth == SHADER_MAXNESTING) {
+          errorlog(SHADER_ERR_PREPROCESS, "Includes nested too deep in %s:%i", name, lineNo);
+          return false;
+        };
+        memcpy(includeName, pos + 1, includeEnd - pos - 1);
+        includeName[includeEnd - pos - 1] = '\0';
+
+        include = shaderGetSource(includeName);
+        if ((include >= 0) && (shaderSources[include].once != pState->stamp)) {
+          pState->depth++;
+          if (!shaderPreprocessFile(pState, include)) {
+            return false;
           };
+          pState->depth--;
 
-          // don't forget to free our line!!!
-          free (line);
-        } else {
-          // skip empty lines...
-          pos++;
+          // our include may have moved our cache around
+          name = shaderSources[pIndex].name;
         };
-      };
+        pState->needLine = true;
+      } else if ((len == 6) && (memcmp(directive, "pragma", 6) == 0) && (lineEnd - pos >= 4) && (memcmp(pos, "once", 4) == 0)) {
+        shaderSources[pIndex].once = pState->stamp;
+        pState->needLine = true;
+      } else {
+        if ((len == 6) && (memcmp(directive, "define", 6) == 0)) {
+          const char *  define = pos;
+          const char *  value;
 
-      // free the text we've loaded, what we need has now been copied into shaderText
-      free(fileText);
+          while ((pos < lineEnd) && shaderIsIdent(*pos)) {
+            pos++;
+          };
+          value = shaderSkipSpace(pos, lineEnd);
+          shaderAddDefine(pState, define, pos - define, value, lineEnd - value);
+        } else if ((len == 5) && (memcmp(directive, "undef", 5) == 0)) {
+          const char *  define = pos;
+          int           i;
+
+          while ((pos < lineEnd) && shaderIsIdent(*pos)) {
+            pos++;
+          };
+          i = shaderFindDefine(pState, define, pos - define);
+          if (i >= 0) {
+            pState->defines[i] = pState->defines[--pState->defineCount];
+          };
+        };
+
+        // pass our directive on to GLSL, #version must be our first line so we can only start adding #line directives after it
+        if ((len == 7) && (memcmp(directive, "version", 7) == 0)) {
+          pState->started = true;
+          if (!shaderArenaAppend(text, lineEnd - text) || !shaderArenaAppend("\n", 1)) {
+            return false;
+          };
+          pState->needLine = true;
+        } else if (!shaderWriteLine(pState, lineNo, source) || !shaderArenaAppend(text, lineEnd - text) || !shaderArenaAppend("\n", 1)) {
+          return false;
+        };
+      };
+    } else if (active) {
+      // add our line
+      if (!shaderWriteLine(pState, lineNo, source) || !shaderArenaAppend(text, lineEnd - text) || !shaderArenaAppend("\n", 1)) {
+        return false;
+      };
+    } else {
+      pState->needLine = true;
     };
 
-    if (shaderText->text == NULL) {
-      varcharRelease(shaderText);
-      shaderText = NULL;
+    text = next;
+  };
+
+  if (conditionCount > 0) {
+    errorlog(SHADER_ERR_PREPROCESS, "Missing #endif in %s", name);
+    return false;
+  };
+
+  // we're back in our parent file
+  pState->needLine = true;
+  return true;
+};
+
+// preprocesses our shader file pName and appends the result to our arena, pStart is set to where our text starts
+// if pSources is not NULL it is filled with the include cache index of each source string number we used
+bool shaderPreprocess(const char * pName, llist * pDefines, size_t * pStart, shaderSourceList * pSources) {
+  shaderPreprocessor  state;
+  int                 index;
+  bool                success;
+
+  index = shaderGetSource(pName);
+  if (index < 0) {
+    return false;
+  };
+
+  state.defineCount = 0;
+  state.sourceCount = 0;
+  state.stamp = ++shaderStamp;
+  state.depth = 0;
+  state.started = false;
+  state.needLine = false;
+  shaderAddDefineList(&state, shaderGlobalDefines);
+  shaderAddDefineList(&state, pDefines);
+
+  *pStart = shaderArenaLen;
+  success = shaderPreprocessFile(&state, index);
+  if (success) {
+    // keep our zero terminator, the next stage we preprocess is appended after it
+    success = shaderArenaAppend("", 1);
+  };
+  if (!success) {
+    shaderArenaLen = *pStart;
+  } else if (pSources != NULL) {
+    pSources->count = state.sourceCount;
+    memcpy(pSources->index, state.sources, sizeof(int) * state.sourceCount);
+  };
+
+  return success;
+};
+
+// logs which file each source string number in our error messages refers to
+void shaderLogSources(const char * pName, shaderSourceList * pSources) {
+  char  text[1024];
+  int   i, len = 0;
+
+  for (i = 0; (i < pSources->count) && (len < sizeof(text) - 300); i++) {
+    len += sprintf(text + len, "%s%i = %s", i == 0 ? "" : ", ", i, shaderSources[pSources->index[i]].name);
+  };
+  text[len] = '\0';
+  errorlog(0, "Source strings for %s: %s", pName, text);
+};
+
+varchar * shaderLoadAndPreprocess(const char *pName, llist * pDefines) {
+  varchar * shaderText = NULL;
+  size_t    start;
+
+  shaderArenaLen = 0;
+  if (shaderPreprocess(pName, pDefines, &start, NULL)) {
+    shaderText = newVarchar();
+    if (shaderText != NULL) {
+      varcharAppend(shaderText, shaderArena + start, shaderArenaLen - start);
     };
   };
 
@@ -415,6 +1075,11 @@ GLuint shaderLink(GLuint pNumShaders, ...) {
   if (program != NO_SHADER) {
     GLint linked = 0;
 
+    if (shaderCacheEnabled()) {
+      // let GL know we'll want the binary of this program
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    };
+
     glLinkProgram(program);
 
     // and check whether it all went OK..
@@ -453,62 +1118,158 @@ GLuint shaderLink(GLuint pNumShaders, ...) {
   return program;
 };
 
+// adds the names in our list of defines to our hash
+uint64_t shaderHashDefines(uint64_t pHash, llist * pDefines) {
+  if (pDefines != NULL) {
+    llistNode * node = pDefines->first;
+
+    while (node != NULL) {
+      varchar * define = (varchar *) node->data;
+
+      pHash = shaderCacheHash(pHash, define->text, define->len + 1);
+      node = node->next;
+    };
+  };
+
+  return pHash;
+};
+
+// Builds a program from pCount shader files, pTypes contains the shader type of each file
+// We first preprocess our files, if our program cache has a binary for these sources we use
+// that, else we compile and link our program and add it to our cache
+// Returns NO_SHADER on failure
+GLuint shaderBuild(const char * pName, int pCount, const GLenum * pTypes, const char ** pFiles, llist * pDefines) {
+  GLuint            program = NO_SHADER;
+  GLuint            shaders[5];
+  size_t            starts[5];
+  bool              loaded[5];
+  shaderSourceList  sources[5];
+  uint64_t          key = shaderCacheKey();
+  uint64_t          id = SHADERCACHE_SEED;
+  double            start = benchGetTime();
+  double            preprocess;
+  double            elapsed;
+  int               i, count = 0;
+
+  if ((pCount <= 0) || (pCount > 5)) {
+    return NO_SHADER;
+  };
+
+  // preprocess all our stages into our arena
+  shaderArenaLen = 0;
+  for (i = 0; i < pCount; i++) {
+    loaded[i] = shaderPreprocess(pFiles[i], pDefines, &starts[i], &sources[i]);
+  };
+  preprocess = benchGetTime() - start;
+
+  // our key covers everything that ends up in our program
+  for (i = 0; i < pCount; i++) {
+    if (loaded[i]) {
+      key = shaderCacheHash(key, &pTypes[i], sizeof(GLenum));
+      key = shaderCacheHash(key, shaderArena + starts[i], strlen(shaderArena + starts[i]) + 1);
+    };
+    id = shaderCacheHash(id, pFiles[i], strlen(pFiles[i]) + 1);
+  };
+  key = shaderHashDefines(key, pDefines);
+  key = shaderHashDefines(key, shaderGlobalDefines);
+
+  // while our id only identifies our permutation so we overwrite our old binary when a source changes
+  id = shaderHashDefines(id, pDefines);
+  id = shaderHashDefines(id, shaderGlobalDefines);
+
+  program = shaderCacheLoad(pName, id, key);
+  if (program != 0) {
+    elapsed = benchGetTime() - start;
+    shaderCacheCount(true, preprocess, elapsed);
+    errorlog(0, "Loaded %s from our program cache in %0.3f ms", pName, elapsed);
+  } else {
+    // compile what we can
+    for (i = 0; i < pCount; i++) {
+      if (loaded[i]) {
+        shaders[count] = shaderCompile(pTypes[i], shaderArena + starts[i]);
+        if (shaders[count] != NO_SHADER) {
+          count++;
+        } else {
+          // our errors refer to our files by number
+          shaderLogSources(pFiles[i], &sources[i]);
+        };
+      };
+    };
+
+    program = NO_SHADER;
+    if (count > 0) {
+      program = shaderLink(count, shaders[0], shaders[1], shaders[2], shaders[3], shaders[4]);
+
+      // and cleanup..
+      while (count > 0) {
+        count--;
+        glDeleteShader(shaders[count]);
+      };
+    };
+
+    if (program != NO_SHADER) {
+      shaderCacheSave(pName, id, key, program);
+      elapsed = benchGetTime() - start;
+      shaderCacheCount(false, preprocess, elapsed);
+      errorlog(0, "Compiled %s in %0.3f ms", pName, elapsed);
+    };
+  };
+
+  return program;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // shader
 
 shaderInfo * newShader(const char *pName, const char * pVertexShader, const char * pTessControlShader, const char * pTessEvalShader, const char * pGeoShader, const char * pFragmentShader, const char *pDefines) {
   shaderInfo * newshader = (shaderInfo *)malloc(sizeof(shaderInfo));
   if (newshader != NULL) {
-    llist * defines = NULL;
-    char    filename[1024];
-    int     count = 0;
-    GLuint  shaders[5];
+    llist *       defines = NULL;
+    int           count = 0;
+    GLenum        types[5];
+    const char *  files[5];
 
     memset(newshader, 255, sizeof(shaderInfo));
     newshader->retainCount = 1;
     newshader->program = NO_SHADER;
+    newshader->instanced = NULL;
+    newshader->layered = NULL;
     strcpy(newshader->name, pName);
 
     // convert our defines
     defines = newVCListFromString(pDefines, " \r\n");
 
-    // attempt to load our shader by name
+    // collect our stages
     if (pVertexShader != NULL) {
-      shaders[count] = shaderLoad(GL_VERTEX_SHADER, pVertexShader, defines);
-      if (shaders[count] != NO_SHADER) count++;      
+      types[count] = GL_VERTEX_SHADER;
+      files[count++] = pVertexShader;
     };
     if (pTessControlShader != NULL) {
-      shaders[count] = shaderLoad(GL_TESS_CONTROL_SHADER, pTessControlShader, defines);
-      if (shaders[count] != NO_SHADER) count++;
+      types[count] = GL_TESS_CONTROL_SHADER;
+      files[count++] = pTessControlShader;
     };
     if (pTessEvalShader != NULL) {
-      shaders[count] = shaderLoad(GL_TESS_EVALUATION_SHADER, pTessEvalShader, defines);
-      if (shaders[count] != NO_SHADER) count++;
+      types[count] = GL_TESS_EVALUATION_SHADER;
+      files[count++] = pTessEvalShader;
     };
     if (pGeoShader != NULL) {
-      shaders[count] = shaderLoad(GL_GEOMETRY_SHADER, pGeoShader, defines);
-      if (shaders[count] != NO_SHADER) count++;
+      types[count] = GL_GEOMETRY_SHADER;
+      files[count++] = pGeoShader;
     };
     if (pFragmentShader != NULL) {
-      shaders[count] = shaderLoad(GL_FRAGMENT_SHADER, pFragmentShader, defines);
-      if (shaders[count] != NO_SHADER) count++;
+      types[count] = GL_FRAGMENT_SHADER;
+      files[count++] = pFragmentShader;
+    };
+
+    // attempt to load or compile our program
+    if (count > 0) {
+      shaderSetProgram(newshader, shaderBuild(pName, count, types, files, defines));
     };
 
     // no longer need our defines
     if (defines != NULL) {
       llistFree(defines);
     };
-
-    // attempt to compile our shader
-    if (count>0) {
-      shaderSetProgram(newshader, shaderLink(count, shaders[0], shaders[1], shaders[2], shaders[3], shaders[4]));
-
-      // and cleanup..
-      while (count>0) {
-        count--;
-        glDeleteShader(shaders[count]);
-      };
-    };
   };
   return newshader;
 };
@@ -534,103 +1295,198 @@ void shaderRelease(shaderInfo * pShader) {
     glDeleteProgram(pShader->program);
   };
 
+  // release our variants
+  shaderSetInstanced(pShader, NULL);
+  shaderSetLayered(pShader, NULL);
+
   free(pShader);
 };
 
-void shaderSetProgram(shaderInfo * pShader, GLuint pProgram) {
-  int i;
-  char uName[250];
+// set (or unset) the instanced variant of our shader, the shader will be release/retained as needed
+// the instanced variant is used when we render multiple copies of the same mesh in one go
+void shaderSetInstanced(shaderInfo * pShader, shaderInfo * pInstanced) {
+  if (pShader == NULL) {
+    errorlog(-1, "Attempted to set an instanced shader to a NULL shader");
+    return;
+  } else if (pShader->instanced == pInstanced) {
+    return;
+  } else {
+    if (pShader->instanced != NULL) {
+      shaderRelease(pShader->instanced);
+    };
+    pShader->instanced = pInstanced;
+    if (pShader->instanced != NULL) {
+      shaderRetain(pShader->instanced);
+    };
+  };
+};
+
+// set (or unset) the layered variant of our shader, the shader will be release/retained as needed
+// the layered variant is used when we render into all six faces of a cube map in one pass
+void shaderSetLayered(shaderInfo * pShader, shaderInfo * pLayered) {
+  if (pShader == NULL) {
+    errorlog(-1, "Attempted to set a layered shader to a NULL shader");
+    return;
+  } else if (pShader->layered == pLayered) {
+    return;
+  } else {
+    if (pShader->layered != NULL) {
+      shaderRelease(pShader->layered);
+    };
+    pShader->layered = pLayered;
+    if (pShader->layered != NULL) {
+      shaderRetain(pShader->layered);
+    };
+  };
+};
 
+void shaderSetProgram(shaderInfo * pShader, GLuint pProgram) {
   pShader->program = pProgram;
   
-  // camera info
-  pShader->eyePosId = glGetUniformLocation(pShader->program, "eyePos");
-  if (pShader->eyePosId < 0) {
-    infolog("Unknown uniform %s:eyePos", pShader->name);  // just log it, may not be a problem
+  // uniform blocks
+  pShader->frameBlockId = shaderBindBlock(pShader->program, "frameData", SHADER_FRAMEBLOCK);
+  pShader->objectBlockId = shaderBindBlock(pShader->program, "objectData", SHADER_OBJECTBLOCK);
+  pShader->materialBlockId = shaderBindBlock(pShader->program, "materialData", SHADER_MATERIALBLOCK);
+  
+  // material
+  pShader->textureMapId = glGetUniformLocation(pShader->program, "textureMap");
+  if (pShader->textureMapId < 0) {
+    infolog("Unknown uniform %s:textureMap", pShader->name);
   };
   
-  // matrix info
-
-  pShader->projectionMatrixId = glGetUniformLocation(pShader->program, "projection");
-  if (pShader->projectionMatrixId < 0) {
-    infolog("Unknown uniform %s:projection", pShader->name);  // just log it, may not be a problem
+  pShader->reflectMapId = glGetUniformLocation(pShader->program, "reflectMap");
+  if (pShader->reflectMapId < 0) {
+    infolog("Unknown uniform %s:reflectMap", pShader->name);
   };
 
-  pShader->viewMatrixId = glGetUniformLocation(pShader->program, "view");
-  if (pShader->viewMatrixId < 0) {
-    infolog("Unknown uniform %s:view", pShader->name);  // just log it, may not be a problem
+  pShader->bumpMapId = glGetUniformLocation(pShader->program, "bumpMap");
+  if (pShader->bumpMapId < 0) {
+    infolog("Unknown uniform %s:bumpMap", pShader->name);
   };
+};
 
-  pShader->modelMatrixId = glGetUniformLocation(pShader->program, "model");
-  if (pShader->modelMatrixId < 0) {
-    infolog("Unknown uniform %s:model", pShader->name);  // just log it, may not be a problem
-  };
+// binds the uniform block pName in our program to our binding point, returns -1 if our program doesn't use this block
+// note that GLSL 3.30 doesn't support setting our binding in our shader so we need to do this after linking
+GLint shaderBindBlock(GLuint pProgram, const char * pName, GLuint pBinding) {
+  GLuint blockIndex;
 
-  pShader->modelViewMatrixId = glGetUniformLocation(pShader->program, "modelView");
-  if (pShader->modelViewMatrixId < 0) {
-    infolog("Unknown uniform %s:modelView", pShader->name);  // just log it, may not be a problem
+  if (pProgram == NO_SHADER) {
+    return -1;
   };
 
-  pShader->modelViewInverseId = glGetUniformLocation(pShader->program, "modelViewInverse");
-  if (pShader->modelViewInverseId < 0) {
-    infolog("Unknown uniform %s:modelViewInverse", pShader->name);  // just log it, may not be a problem
+  blockIndex = glGetUniformBlockIndex(pProgram, pName);
+  if (blockIndex == GL_INVALID_INDEX) {
+    // just ignore, not all shaders use all blocks
+    return -1;
   };
 
-  pShader->normalMatrixId = glGetUniformLocation(pShader->program, "normalMatrix");
-  if (pShader->normalMatrixId < 0) {
-    infolog("Unknown uniform %s:normalMatrix", pShader->name);  // just log it, may not be a problem
-  };
+  glUniformBlockBinding(pProgram, blockIndex, pBinding);
+  return blockIndex;
+};
 
-  pShader->normalViewId = glGetUniformLocation(pShader->program, "normalView");
-  if (pShader->normalViewId < 0) {
-    infolog("Unknown uniform %s:normalView", pShader->name);  // just log it, may not be a problem
+////////////////////////////////////////////////////////////////////////////////////
+// uniform buffer ring
+//
+// Our frame and object blocks change often so instead of giving each its own buffer
+// we write them one after the other into a single ring buffer and bind the range we need.
+// Once our ring buffer is full we orphan it and start at the beginning again,
+// anything still queued up keeps using the old storage.
+// Data in our ring is only valid for as long as shaderRingGen doesn't change.
+
+GLuint        shaderRingUBO = GL_UNDEF_OBJ;
+GLsizeiptr    shaderRingSize = 0;
+GLintptr      shaderRingPos = 0;
+GLint         shaderRingAlign = 256;
+unsigned int  shaderRingGen = 1;
+shaderMatrices * shaderBoundFrame = NULL;
+
+// create our ring buffer if we haven't already
+void shaderRingInit(void) {
+  if (shaderRingUBO == GL_UNDEF_OBJ) {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &shaderRingAlign);
+    glGenBuffers(1, &shaderRingUBO);
+    shaderRingSize = 0;
+    shaderRingPos = 0;
   };
+};
 
-  pShader->mvpId = glGetUniformLocation(pShader->program, "mvp");
-  if (pShader->mvpId < 0) {
-    infolog("Unknown uniform %s:mvp", pShader->name);  // just log it, may not be a problem
-  };
-  
-  // material
-  pShader->alphaId = glGetUniformLocation(pShader->program, "alpha");
-  if (pShader->alphaId < 0) {
-    infolog("Unknown uniform %s:alpha", pShader->name);    
-  };
+// returns pSize rounded up to the offset alignment our uniform buffers require
+GLsizeiptr shaderRingStride(GLsizeiptr pSize) {
+  shaderRingInit();
 
-  pShader->ambientId = glGetUniformLocation(pShader->program, "ambient");
-  if (pShader->ambientId < 0) {
-    infolog("Unknown uniform %s:ambient", pShader->name);
-  };
+  return ((pSize + shaderRingAlign - 1) / shaderRingAlign) * shaderRingAlign;
+};
 
-  pShader->matColorId = glGetUniformLocation(pShader->program, "matColor");
-  if (pShader->matColorId < 0) {
-    infolog("Unknown uniform %s:matColor", pShader->name);    
-  };
+// reserves pSize bytes in our ring buffer and returns the offset at which they start
+GLintptr shaderRingAlloc(GLsizeiptr pSize) {
+  GLintptr offset = shaderRingStride(shaderRingPos);
 
-  pShader->matSpecColorId = glGetUniformLocation(pShader->program, "matSpecColor");
-  if (pShader->matSpecColorId < 0) {
-    infolog("Unknown uniform %s:matSpecColor", pShader->name);    
-  };
-  
-  pShader->shininessId = glGetUniformLocation(pShader->program, "shininess");
-  if (pShader->shininessId < 0) {
-    infolog("Unknown uniform %s:shininess", pShader->name);    
-  };
-  
-  pShader->textureMapId = glGetUniformLocation(pShader->program, "textureMap");
-  if (pShader->textureMapId < 0) {
-    infolog("Unknown uniform %s:textureMap", pShader->name);
+  glBindBuffer(GL_UNIFORM_BUFFER, shaderRingUBO);
+
+  if (offset + pSize > shaderRingSize) {
+    // make sure larger requests leave room for a few more blocks after wrapping around
+    if (shaderRingSize < SHADER_RINGSIZE) {
+      shaderRingSize = SHADER_RINGSIZE;
+    };
+    while (shaderRingSize < pSize * 2) {
+      shaderRingSize *= 2;
+    };
+
+    // orphan our buffer and start again
+    glBufferData(GL_UNIFORM_BUFFER, shaderRingSize, NULL, GL_STREAM_DRAW);
+    shaderRingGen++;
+    offset = 0;
   };
-  
-  pShader->reflectMapId = glGetUniformLocation(pShader->program, "reflectMap");
-  if (pShader->reflectMapId < 0) {
-    infolog("Unknown uniform %s:reflectMap", pShader->name);
+
+  shaderRingPos = offset + pSize;
+  return offset;
+};
+
+// maps pSize bytes of our ring buffer so we can write a batch of blocks in one go, call shaderRingUnmap when done
+// note that nothing else should be written to our ring until we unmap
+void * shaderRingMap(GLsizeiptr pSize, GLintptr * pOffset) {
+  *pOffset = shaderRingAlloc(pSize);
+
+  // we never overwrite anything the GPU may still be using so we don't need to synchronise
+  return glMapBufferRange(GL_UNIFORM_BUFFER, *pOffset, pSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+};
+
+// copies pData into our ring buffer and returns its offset
+// we map our buffer instead of using glBufferSubData as the latter makes some drivers wait for the GPU to finish with our buffer
+GLintptr shaderRingWrite(const void * pData, GLsizeiptr pSize) {
+  GLintptr  offset;
+  void *    data = shaderRingMap(pSize, &offset);
+
+  if (data != NULL) {
+    memcpy(data, pData, pSize);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
   };
 
-  pShader->bumpMapId = glGetUniformLocation(pShader->program, "bumpMap");
-  if (pShader->bumpMapId < 0) {
-    infolog("Unknown uniform %s:bumpMap", pShader->name);
+  return offset;
+};
+
+void shaderRingUnmap(void) {
+  glBindBuffer(GL_UNIFORM_BUFFER, shaderRingUBO);
+  glUnmapBuffer(GL_UNIFORM_BUFFER);
+};
+
+// binds part of our ring buffer to one of our binding points
+void shaderRingBind(GLuint pBinding, GLintptr pOffset, GLsizeiptr pSize) {
+  glBindBufferRange(GL_UNIFORM_BUFFER, pBinding, shaderRingUBO, pOffset, pSize);
+};
+
+// free our ring buffer, call this before our GL context is destroyed
+void shaderRingFree(void) {
+  if (shaderRingUBO != GL_UNDEF_OBJ) {
+    glDeleteBuffers(1, &shaderRingUBO);
+    shaderRingUBO = GL_UNDEF_OBJ;
   };
+
+  // anything we wrote is no longer valid
+  shaderRingSize = 0;
+  shaderRingPos = 0;
+  shaderRingGen++;
+  shaderBoundFrame = NULL;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -639,8 +1495,20 @@ void shaderSetProgram(shaderInfo * pShader, GLuint pProgram) {
 void shdMatSetProjection(shaderMatrices * pShdMat, const mat4 * pProjection) {
   // need to improve this to skip if our matrix isn't changing
   mat4Copy(&pShdMat->projection, pProjection);
+  mat4Copy(&pShdMat->eyeProjection[0], pProjection);
+  mat4Copy(&pShdMat->eyeProjection[1], pProjection);
   pShdMat->updMvp = true;
   pShdMat->updViewProj = true;
+  pShdMat->updFrame = true;
+  pShdMat->updObject = true;
+};
+
+// set the projections for each eye when we render both eyes in one pass, call this after shdMatSetProjection
+// which should then be given a projection that contains both eyes (see mat4StereoUnion) as we cull with it
+void shdMatSetEyeProjections(shaderMatrices * pShdMat, const mat4 * pLeft, const mat4 * pRight) {
+  mat4Copy(&pShdMat->eyeProjection[0], pLeft);
+  mat4Copy(&pShdMat->eyeProjection[1], pRight);
+  pShdMat->updFrame = true;
 };
 
 void shdMatSetView(shaderMatrices * pShdMat, const mat4 * pView) {
@@ -653,6 +1521,8 @@ void shdMatSetView(shaderMatrices * pShdMat, const mat4 * pView) {
   pShdMat->updInvModelView = true;
   pShdMat->updMvp = true;
   pShdMat->updNormView = true;
+  pShdMat->updFrame = true;
+  pShdMat->updObject = true;
 };
 
 void shdMatSetModel(shaderMatrices * pShdMat, const mat4 * pModel) {
@@ -663,6 +1533,7 @@ void shdMatSetModel(shaderMatrices * pShdMat, const mat4 * pModel) {
   pShdMat->updMvp = true;
   pShdMat->updNormal = true;
   pShdMat->updNormView = true;
+  pShdMat->updObject = true;
 };
 
 // allows us to set an alternative eye position, note that if the view
@@ -670,6 +1541,7 @@ void shdMatSetModel(shaderMatrices * pShdMat, const mat4 * pModel) {
 void shdMatSetEyePos(shaderMatrices * pShdMat, const vec3 * pEye) {
   vec3Copy(&pShdMat->eyePos, pEye);
   pShdMat->updEyePos = false;
+  pShdMat->updFrame = true;
 };
 
 mat4 * shdMatGetViewProjection(shaderMatrices * pShdMat) {
@@ -709,7 +1581,7 @@ mat4 * shdMatGetModelView(shaderMatrices * pShdMat) {
     mat4Copy(&pShdMat->modelView, &pShdMat->view);
     mat4Multiply(&pShdMat->modelView, &pShdMat->model);
 
-    pShdMat->updModelView = true;
+    pShdMat->updModelView = false;
   };
   return &pShdMat->modelView;
 };
@@ -753,6 +1625,88 @@ mat3 * shdMatGetNormalView(shaderMatrices * pShdMat) {
   return &pShdMat->normalView;
 };
 
+// fill pBlock with the data for our current model, pBlock may point to mapped memory
+void shdMatFillObject(shaderMatrices * pShdMat, shaderObjectBlock * pBlock) {
+  mat3 *  normal = shdMatGetNormal(pShdMat);
+  mat3 *  normalView = shdMatGetNormalView(pShdMat);
+  int     i;
+
+  mat4Copy(&pBlock->model, &pShdMat->model);
+  mat4Copy(&pBlock->modelView, shdMatGetModelView(pShdMat));
+  mat4Copy(&pBlock->mvp, shdMatGetMvp(pShdMat));
+  for (i = 0; i < 3; i++) {
+    vec4Set(&pBlock->normalMatrix[i], normal->m[i][0], normal->m[i][1], normal->m[i][2], 0.0);
+    vec4Set(&pBlock->normalView[i], normalView->m[i][0], normalView->m[i][1], normalView->m[i][2], 0.0);
+  };
+};
+
+// use an object block we've already written into our ring buffer (see shaderRingMap) for our current model
+void shdMatUseObject(shaderMatrices * pShdMat, GLintptr pOffset) {
+  pShdMat->objectOffset = pOffset;
+  pShdMat->objectRing = shaderRingGen;
+  pShdMat->updObject = false;
+};
+
+// make sure our frame block is up to date and bound
+void shdMatBindFrame(shaderMatrices * pShdMat) {
+  if (pShdMat->updFrame || (pShdMat->frameRing != shaderRingGen)) {
+    shaderFrameBlock block;
+
+    mat4Copy(&block.projection, &pShdMat->projection);
+    mat4Copy(&block.view, &pShdMat->view);
+    mat4Copy(&block.viewProjection, shdMatGetViewProjection(pShdMat));
+    mat4Copy(&block.invView, shdMatGetInvView(pShdMat));
+    shdMatGetEyePos(pShdMat, &block.eyePos);
+    block.padding = 0.0;
+    mat4Copy(&block.eyeProjection[0], &pShdMat->eyeProjection[0]);
+    mat4Copy(&block.eyeProjection[1], &pShdMat->eyeProjection[1]);
+
+    pShdMat->frameOffset = shaderRingWrite(&block, sizeof(shaderFrameBlock));
+    pShdMat->frameRing = shaderRingGen;
+    pShdMat->updFrame = false;
+
+    // make sure we bind it
+    shaderBoundFrame = NULL;
+  };
+
+  if (shaderBoundFrame != pShdMat) {
+    shaderRingBind(SHADER_FRAMEBLOCK, pShdMat->frameOffset, sizeof(shaderFrameBlock));
+    shaderBoundFrame = pShdMat;
+  };
+};
+
+// make sure our object block is up to date and bound
+void shdMatBindObject(shaderMatrices * pShdMat) {
+  if (pShdMat->updObject || (pShdMat->objectRing != shaderRingGen)) {
+    shaderObjectBlock block;
+
+    shdMatFillObject(pShdMat, &block);
+
+    pShdMat->objectOffset = shaderRingWrite(&block, sizeof(shaderObjectBlock));
+    pShdMat->objectRing = shaderRingGen;
+    pShdMat->updObject = false;
+  };
+
+  shaderRingBind(SHADER_OBJECTBLOCK, pShdMat->objectOffset, sizeof(shaderObjectBlock));
+};
+
+// make sure both our frame and object block are up to date and bound
+void shdMatBind(shaderMatrices * pShdMat, bool pFrame, bool pObject) {
+  unsigned int gen;
+
+  // if writing one block made our ring wrap around, the other needs to be written again
+  do {
+    gen = shaderRingGen;
+
+    if (pObject) {
+      shdMatBindObject(pShdMat);
+    };
+    if (pFrame) {
+      shdMatBindFrame(pShdMat);
+    };
+  } while (gen != shaderRingGen);
+};
+
 
 #endif /* SHADER_IMPLEMENTATION */
 
@@ -44,7 +44,7 @@ typedef struct sprite {
 typedef struct spritesheet {
   GLuint        vao;
   GLuint        program;          // our shader program
-  GLint         mvpId;            // our model-view-projection matrix uniform ID
+  GLint         objectBlockId;    // our object block (model-view-projection matrix)
   GLint         textureId;        // our sprite texture sampler ID
   GLint         textureSizeId;    // our texture size uniform ID
   texturemap *  texture;          // our sprite texture
@@ -84,9 +84,9 @@ void spLoadShader(spritesheet* pSP) {
     if (pSP->program == NO_SHADER) {
       errorlog(-1, "Unable to init sprite shader");
     } else {
-      pSP->mvpId = glGetUniformLocation(pSP->program, "mvp");
-      if (pSP->mvpId < 0) {
-        errorlog(pSP->mvpId, "Unknown uniform mvp");
+      pSP->objectBlockId = shaderBindBlock(pSP->program, "objectData", SHADER_OBJECTBLOCK);
+      if (pSP->objectBlockId < 0) {
+        errorlog(pSP->objectBlockId, "Unknown uniform block objectData");
       };
       pSP->textureId = glGetUniformLocation(pSP->program, "spriteTexture");
       if (pSP->textureId < 0) {
@@ -127,7 +127,7 @@ spritesheet * newSpriteSheet(void) {
   if (newsp != NULL) {
     glGenVertexArrays(1, &newsp->vao);
     newsp->program          = NO_SHADER;
-    newsp->mvpId            = -1;
+    newsp->objectBlockId    = -1;
     newsp->textureId        = -1;
     newsp->textureSizeId    = -1;
     newsp->texture          = NULL;
@@ -250,8 +250,8 @@ void spRender(spritesheet* pSP, shaderMatrices * pMatrices, GLuint pIndex, bool
     mat4Translate(&model, vec3Set(&tmpvector, tmpsprite.offsetx, tmpsprite.offsety, 0.0));
     shdMatSetModel(pMatrices, &model);
     
-    if (pSP->mvpId >= 0) {
-      glUniformMatrix4fv(pSP->mvpId, 1, false, (const GLfloat *) shdMatGetMvp(pMatrices)->m);      
+    if (pSP->objectBlockId >= 0) {
+      shdMatBindObject(pMatrices);
     };
     
     // now tell it which textures to use
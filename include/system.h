@@ -17,6 +17,7 @@
  * 0.1  17-01-2016  First version with basic functions
  * 0.2  17-02-2016  Added our load function and renamed
  *                  our library
+ * 0.3  16-10-2026  Log errors to stderr on Linux
  *
  ********************************************************/
 
@@ -122,6 +123,9 @@ void errorlog(int error, const char * description, ...) {
     fprintf(log, "%i: %s\n", error, fulldesc);
 	fclose(log);
   };
+#elif defined(__linux__)
+  // output to stderr
+  fprintf(stderr, "%i: %s\n", error, fulldesc);
 #else
   // not sure what we're doing on other platforms yet
 #endif
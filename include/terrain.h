@@ -0,0 +1,566 @@
+/********************************************************
+ * terrain.h - chunked LOD terrain library by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define TERRAIN_IMPLEMENTATION
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions.
+ *
+ * Our terrain is a quadtree of square chunks centered
+ * on our origin. Every chunk, whatever its level, is
+ * drawn with the same grid mesh scaled to the size of
+ * the chunk, our vertex shader (hmap.vs) looks up the
+ * heights in our height map. This means all visible
+ * chunks can be rendered instanced.
+ *
+ * When loading we measure how far each level deviates
+ * from our height map. Each frame we turn that into the
+ * distance at which a level would exceed our screen
+ * space error and split chunks that are closer. Chunks
+ * morph into the grid of their parent as they approach
+ * that distance so levels blend without popping, skirts
+ * hang down from each chunk to hide any remaining cracks.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ * 0.2  16-10-2026  Sample our heights from a height field
+ * 0.3  16-10-2026  Select chunks into an array of the caller
+ *                  so several views can select at the same time
+ *
+ ********************************************************/
+
+#ifndef terrainh
+#define terrainh
+
+// include support libraries
+#include "system.h"
+#include "dynamicarray.h"
+#include "math3d.h"
+#include "cull.h"
+#include "shaders.h"
+#include "heightfield.h"
+#include "mesh3d.h"
+
+// maximum number of levels in our quadtree, this must match the size of lodInfo in hmap.vs
+#define TERRAIN_MAXLEVELS 8
+
+// chunk of our terrain
+typedef struct terrainChunk {
+  aabb          box;                  /* bounds of our chunk including the heights within it and our skirt */
+  float         x;                    /* x of the corner of our chunk */
+  float         z;                    /* z of the corner of our chunk */
+  float         size;                 /* size of our chunk */
+  int           level;                /* level of our chunk, 0 is our root */
+  unsigned int  children;             /* index of our first child, our other 3 children follow it, 0 if we have no children */
+} terrainChunk;
+
+// our terrain
+typedef struct terrain {
+  unsigned int  retainCount;          /* retain count for this object */
+  heightField * field;                /* heights we build our chunks from, this must match the height map our shaders use */
+  float         mapScale;             /* our height map repeats every mapScale units */
+  float         mapHeight;            /* height of a white pixel in our height map */
+  float         size;                 /* size of our root chunk */
+  int           levels;               /* number of levels in our quadtree */
+  int           gridSize;             /* number of quads along the edge of our chunk mesh */
+  float         tolerance;            /* maximum screen space error in pixels */
+  float         pixelScale;           /* pixels covered by one unit at a distance of one unit from our camera */
+  float         errors[TERRAIN_MAXLEVELS]; /* maximum height error of the chunks on each level */
+  float         ranges[TERRAIN_MAXLEVELS]; /* chunks closer to our camera then this are split */
+  vec3          lodInfo[TERRAIN_MAXLEVELS]; /* morph start, morph end and skirt depth for each level, loaded into our shaders */
+  dynarray *    chunks;               /* our quadtree, entry 0 is our root */
+  mesh3d *      mesh;                 /* our chunk mesh */
+} terrain;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+terrain * newTerrain(heightField * pField, float pSize, int pLevels, int pGridSize);
+void terrainRetain(terrain * pTerrain);
+void terrainRelease(terrain * pTerrain);
+float terrainGetHeight(const terrain * pTerrain, float pX, float pZ);
+void terrainSetTolerance(terrain * pTerrain, float pPixels);
+bool terrainSetScreen(terrain * pTerrain, float pHeight, float pFOV);
+void terrainLoadUniforms(const terrain * pTerrain, shaderInfo * pShader);
+unsigned int terrainSelect(const terrain * pTerrain, const vec3 * pEye, const frustum * pFrustum, dynarray * pSelected);
+terrainChunk * terrainGetChunk(const terrain * pTerrain, unsigned int pIndex);
+mat4 * terrainChunkModel(const terrainChunk * pChunk, mat4 * pModel);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef TERRAIN_IMPLEMENTATION
+
+// get the height from our height field, note that this is the same lookup our shader does
+float terrainGetHeight(const terrain * pTerrain, float pX, float pZ) {
+  return hfieldGetHeight(pTerrain->field, pX, pZ);
+};
+
+// build the grid we render each chunk with, this covers 0.0 to 1.0 along x and z
+// our skirt vertices have a y of -1.0, our shader lowers these by the skirt depth of the level we're rendering
+void terrainMakeMesh(terrain * pTerrain) {
+  int     grid = pTerrain->gridSize;
+  int     x, z, i, loop = grid * 4;
+  vec3    pos;
+  GLuint  edge[4];
+
+  pTerrain->mesh = newMesh(((grid + 1) * (grid + 1)) + loop, ((grid * grid) + loop) * 6);
+  if (pTerrain->mesh == NULL) {
+    return;
+  };
+  strcpy(pTerrain->mesh->name, "terrain");
+
+  // our grid, this is triangulated the same way meshMakePlane does
+  for (z = 0; z <= grid; z++) {
+    for (x = 0; x <= grid; x++) {
+      meshAddVNT(pTerrain->mesh, vec3Set(&pos, (float) x / grid, 0.0, (float) z / grid), NULL, NULL);
+
+      if ((x > 0) && (z > 0)) {
+        GLuint idx = (z * (grid + 1)) + x;
+
+        meshAddFace(pTerrain->mesh, idx - grid - 2, idx - grid - 1, idx);
+        meshAddFace(pTerrain->mesh, idx - grid - 2, idx, idx - 1);
+      };
+    };
+  };
+
+  // our skirt, we walk around our edge so each quad faces outwards
+  for (i = 0; i < loop; i++) {
+    int side = i / grid, step = i % grid;
+
+    switch (side) {
+      case 0: x = step; z = 0; break;               // x increasing along our north edge
+      case 1: x = grid; z = step; break;            // z increasing along our east edge
+      case 2: x = grid - step; z = grid; break;     // x decreasing along our south edge
+      default: x = 0; z = grid - step; break;       // z decreasing along our west edge
+    };
+
+    meshAddVNT(pTerrain->mesh, vec3Set(&pos, (float) x / grid, -1.0, (float) z / grid), NULL, NULL);
+  };
+
+  for (i = 0; i < loop; i++) {
+    int side = i / grid, step = i % grid, next = (i + 1) % loop;
+
+    // our edge vertices and the skirt vertices below them
+    edge[2] = ((grid + 1) * (grid + 1)) + i;
+    edge[3] = ((grid + 1) * (grid + 1)) + next;
+    switch (side) {
+      case 0: edge[0] = step; edge[1] = step + 1; break;
+      case 1: edge[0] = (step * (grid + 1)) + grid; edge[1] = ((step + 1) * (grid + 1)) + grid; break;
+      case 2: edge[0] = (grid * (grid + 1)) + grid - step; edge[1] = edge[0] - 1; break;
+      default: edge[0] = (grid - step) * (grid + 1); edge[1] = edge[0] - grid - 1; break;
+    };
+
+    meshAddFace(pTerrain->mesh, edge[0], edge[3], edge[1]);
+    meshAddFace(pTerrain->mesh, edge[0], edge[2], edge[3]);
+  };
+
+  meshCopyToGL(pTerrain->mesh, true);
+};
+
+// height at sample pSX, pSY as rendered by a chunk with its corner at sample pX, pY whose quads are pStep samples wide
+float terrainChunkHeight(const float * pSamples, int pStride, int pX, int pY, int pStep, int pQuads, int pSX, int pSY) {
+  int   qx = (pSX - pX) / pStep;
+  int   qy = (pSY - pY) / pStep;
+  int   cx, cy;
+  float u, v, tl, tr, bl, br;
+
+  // samples on our far edges belong to our last quad
+  if (qx >= pQuads) { qx = pQuads - 1; };
+  if (qy >= pQuads) { qy = pQuads - 1; };
+  cx = pX + (qx * pStep);
+  cy = pY + (qy * pStep);
+  u = (float) (pSX - cx) / pStep;
+  v = (float) (pSY - cy) / pStep;
+
+  tl = pSamples[(cy * pStride) + cx];
+  tr = pSamples[(cy * pStride) + cx + pStep];
+  bl = pSamples[((cy + pStep) * pStride) + cx];
+  br = pSamples[((cy + pStep) * pStride) + cx + pStep];
+
+  // our quads are split from their top left to their bottom right corner
+  if (u >= v) {
+    return tl + (u * (tr - tl)) + (v * (br - tr));
+  } else {
+    return tl + (v * (bl - tl)) + (u * (br - bl));
+  };
+};
+
+// build the chunk at pIndex and its children, pX and pY are the corner of our chunk in samples
+void terrainBuildChunk(terrain * pTerrain, const float * pSamples, int pStride, unsigned int pIndex, int pX, int pY, int pLevel) {
+  terrainChunk  chunk;
+  int           samples = pTerrain->gridSize << (pTerrain->levels - 1 - pLevel);
+  int           step = 1 << (pTerrain->levels - 1 - pLevel);
+  float         spacing = pTerrain->size / (pStride - 1);
+  float         minH, maxH, error = 0.0;
+  vec3          minVec, maxVec;
+  int           x, y;
+
+  // find the heights within our chunk and how far our chunk mesh deviates from them,
+  // our last level renders our samples as they are
+  minH = pSamples[(pY * pStride) + pX];
+  maxH = minH;
+  for (y = pY; y <= pY + samples; y++) {
+    for (x = pX; x <= pX + samples; x++) {
+      float h = pSamples[(y * pStride) + x];
+
+      if (minH > h) { minH = h; };
+      if (maxH < h) { maxH = h; };
+
+      if (pLevel < pTerrain->levels - 1) {
+        float diff = fabs(h - terrainChunkHeight(pSamples, pStride, pX, pY, step, pTerrain->gridSize, x, y));
+        if (error < diff) { error = diff; };
+      };
+    };
+  };
+
+  if (pTerrain->errors[pLevel] < error) {
+    pTerrain->errors[pLevel] = error;
+  };
+
+  memset(&chunk, 0, sizeof(terrainChunk));
+  chunk.x = (pX * spacing) - (pTerrain->size * 0.5);
+  chunk.z = (pY * spacing) - (pTerrain->size * 0.5);
+  chunk.size = samples * spacing;
+  chunk.level = pLevel;
+  vec3Set(&minVec, chunk.x, minH, chunk.z);
+  vec3Set(&maxVec, chunk.x + chunk.size, maxH, chunk.z + chunk.size);
+  aabbFromMinMax(&chunk.box, &minVec, &maxVec);
+  memcpy(dynArrayDataAtIndex(pTerrain->chunks, pIndex), &chunk, sizeof(terrainChunk));
+
+  if (pLevel < pTerrain->levels - 1) {
+    unsigned int  children = pTerrain->chunks->numEntries;
+    int           half = samples / 2;
+
+    // add our children, note that this may move our chunk in memory
+    memset(&chunk, 0, sizeof(terrainChunk));
+    for (x = 0; x < 4; x++) {
+      dynArrayPush(pTerrain->chunks, &chunk);
+    };
+    ((terrainChunk *) dynArrayDataAtIndex(pTerrain->chunks, pIndex))->children = children;
+
+    terrainBuildChunk(pTerrain, pSamples, pStride, children, pX, pY, pLevel + 1);
+    terrainBuildChunk(pTerrain, pSamples, pStride, children + 1, pX + half, pY, pLevel + 1);
+    terrainBuildChunk(pTerrain, pSamples, pStride, children + 2, pX, pY + half, pLevel + 1);
+    terrainBuildChunk(pTerrain, pSamples, pStride, children + 3, pX + half, pY + half, pLevel + 1);
+  };
+};
+
+// lower the bottom of our chunk boxes by the depth of our skirts, call this after our errors are known
+void terrainAddSkirts(terrain * pTerrain) {
+  unsigned int i;
+
+  for (i = 0; i < pTerrain->chunks->numEntries; i++) {
+    terrainChunk * chunk = (terrainChunk *) dynArrayItem(pTerrain->chunks, i);
+    float skirt = pTerrain->lodInfo[chunk->level].z;
+
+    chunk->box.center.y -= skirt * 0.5;
+    chunk->box.extent.y += skirt * 0.5;
+  };
+};
+
+// create a new terrain covering pSize by pSize units around our origin with a quadtree of pLevels levels,
+// each chunk is rendered with a grid of pGridSize by pGridSize quads. Our shaders must use the height map pField was created from
+terrain * newTerrain(heightField * pField, float pSize, int pLevels, int pGridSize) {
+  terrain *     newTerrain;
+  float *       samples;
+  float *       posX;
+  float *       posZ;
+  int           stride, x, y, i;
+  terrainChunk  root;
+
+  if (pField == NULL) {
+    errorlog(-1, "Attempted to create terrain without a height field");
+    return NULL;
+  } else if ((pLevels < 1) || (pLevels > TERRAIN_MAXLEVELS)) {
+    errorlog(-1, "Terrain must have between 1 and %d levels", TERRAIN_MAXLEVELS);
+    return NULL;
+  };
+
+  newTerrain = (terrain *) malloc(sizeof(terrain));
+  if (newTerrain == NULL) {
+    errorlog(-1, "Couldn't allocate memory for terrain");
+    return NULL;
+  };
+
+  newTerrain->retainCount = 1;
+  newTerrain->field = pField;
+  hfieldRetain(pField);
+  newTerrain->mapScale = pField->mapScale;
+  newTerrain->mapHeight = pField->mapHeight;
+  newTerrain->size = pSize;
+  newTerrain->levels = pLevels;
+  newTerrain->gridSize = pGridSize;
+  newTerrain->tolerance = 2.0;
+  newTerrain->pixelScale = 0.0;
+  memset(newTerrain->errors, 0, sizeof(newTerrain->errors));
+  memset(newTerrain->ranges, 0, sizeof(newTerrain->ranges));
+  memset(newTerrain->lodInfo, 0, sizeof(newTerrain->lodInfo));
+  newTerrain->chunks = newDynArray(sizeof(terrainChunk));
+  newTerrain->mesh = NULL;
+
+  // sample our height field at the vertices of our last level
+  stride = (pGridSize << (pLevels - 1)) + 1;
+  samples = (float *) malloc(sizeof(float) * stride * (stride + 2));
+  if ((samples == NULL) || (newTerrain->chunks == NULL)) {
+    errorlog(-1, "Couldn't allocate memory for terrain");
+    if (samples != NULL) {
+      free(samples);
+    };
+    terrainRelease(newTerrain);
+    return NULL;
+  };
+
+  // we look up a row at a time, the two rows after our samples hold our positions
+  posX = samples + (stride * stride);
+  posZ = posX + stride;
+  for (x = 0; x < stride; x++) {
+    posX[x] = ((x * pSize) / (stride - 1)) - (pSize * 0.5);
+  };
+  for (y = 0; y < stride; y++) {
+    for (x = 0; x < stride; x++) {
+      posZ[x] = ((y * pSize) / (stride - 1)) - (pSize * 0.5);
+    };
+    hfieldGetHeights(pField, posX, posZ, samples + (y * stride), stride);
+  };
+
+  // build our quadtree
+  memset(&root, 0, sizeof(terrainChunk));
+  dynArrayReserve(newTerrain->chunks, ((1 << (2 * pLevels)) - 1) / 3);
+  dynArrayPush(newTerrain->chunks, &root);
+  terrainBuildChunk(newTerrain, samples, stride, 0, 0, 0, 0);
+  free(samples);
+
+  // a coarser level can't be more accurate then a finer one
+  for (i = pLevels - 2; i >= 0; i--) {
+    if (newTerrain->errors[i] < newTerrain->errors[i + 1]) {
+      newTerrain->errors[i] = newTerrain->errors[i + 1];
+    };
+  };
+
+  // our skirts need to cover the largest gap we can get with the level above us
+  for (i = 0; i < pLevels; i++) {
+    newTerrain->lodInfo[i].z = newTerrain->errors[i > 0 ? i - 1 : 0] + (pSize / (pGridSize << i));
+    infolog("Terrain level %d, chunk size %0.1f, error %0.2f", i, pSize / (1 << i), newTerrain->errors[i]);
+  };
+  terrainAddSkirts(newTerrain);
+
+  // and create the mesh we render our chunks with
+  terrainMakeMesh(newTerrain);
+
+  // set our initial ranges
+  terrainSetScreen(newTerrain, 720.0, 45.0);
+
+  return newTerrain;
+};
+
+// retain our terrain
+void terrainRetain(terrain * pTerrain) {
+  if (pTerrain == NULL) {
+    errorlog(-1, "Attempted to retain NULL terrain");
+  } else {
+    pTerrain->retainCount++;
+  };
+};
+
+// release our terrain and free it if it reaches a retain count of 0
+void terrainRelease(terrain * pTerrain) {
+  if (pTerrain == NULL) {
+    errorlog(-1, "Attempted to release NULL terrain");
+    return;
+  } else if (pTerrain->retainCount > 1) {
+    pTerrain->retainCount--;
+
+    return;
+  } else {
+    if (pTerrain->field != NULL) {
+      hfieldRelease(pTerrain->field);
+    };
+
+    if (pTerrain->chunks != NULL) {
+      dynArrayFree(pTerrain->chunks);
+    };
+
+    if (pTerrain->mesh != NULL) {
+      meshRelease(pTerrain->mesh);
+    };
+
+    free(pTerrain);
+  };
+};
+
+// recalculate at what distance we split the chunks of each level and over what distance they morph
+void terrainUpdateRanges(terrain * pTerrain) {
+  int i;
+
+  for (i = pTerrain->levels - 1; i >= 0; i--) {
+    float size = pTerrain->size / (1 << i);
+
+    if (i == pTerrain->levels - 1) {
+      // our last level is never split
+      pTerrain->ranges[i] = 0.0;
+    } else {
+      // split when our error would exceed our tolerance
+      pTerrain->ranges[i] = pTerrain->errors[i] * pTerrain->pixelScale / pTerrain->tolerance;
+
+      // we morph over the range of the level below us so we need to be at least twice as far,
+      // and we need to be far enough out that our neighbours are never more then one level apart
+      if (pTerrain->ranges[i] < 2.0 * pTerrain->ranges[i + 1]) {
+        pTerrain->ranges[i] = 2.0 * pTerrain->ranges[i + 1];
+      };
+      if (pTerrain->ranges[i] < pTerrain->ranges[i + 1] + size) {
+        pTerrain->ranges[i] = pTerrain->ranges[i + 1] + size;
+      };
+    };
+  };
+
+  // chunks morph into the grid of their parent as they get close to the distance at which our parent is no longer split
+  pTerrain->lodInfo[0].x = 0.0;
+  pTerrain->lodInfo[0].y = 0.0;
+  for (i = 1; i < pTerrain->levels; i++) {
+    pTerrain->lodInfo[i].x = pTerrain->ranges[i - 1] * 0.7;
+    pTerrain->lodInfo[i].y = pTerrain->ranges[i - 1];
+  };
+};
+
+// set the maximum error, in pixels, our terrain may have on screen
+void terrainSetTolerance(terrain * pTerrain, float pPixels) {
+  if (pTerrain == NULL) {
+    return;
+  };
+
+  pTerrain->tolerance = pPixels < 0.1 ? 0.1 : pPixels;
+  terrainUpdateRanges(pTerrain);
+};
+
+// tell our terrain the height in pixels and the vertical field of view of our camera,
+// returns true if our ranges changed and our uniforms need to be reloaded
+bool terrainSetScreen(terrain * pTerrain, float pHeight, float pFOV) {
+  float scale = pHeight / (2.0 * tan(pFOV * PI / 360.0));
+
+  if (pTerrain == NULL) {
+    return false;
+  } else if (pTerrain->pixelScale == scale) {
+    return false;
+  };
+
+  pTerrain->pixelScale = scale;
+  terrainUpdateRanges(pTerrain);
+
+  return true;
+};
+
+// load our terrain settings into our shader and its instanced variant
+// note that this changes our current program so call matResetLastUsed afterwards
+void terrainLoadUniforms(const terrain * pTerrain, shaderInfo * pShader) {
+  GLint id;
+
+  if ((pTerrain == NULL) || (pShader == NULL)) {
+    return;
+  } else if (pShader->program == NO_SHADER) {
+    return;
+  };
+
+  glUseProgram(pShader->program);
+
+  id = glGetUniformLocation(pShader->program, "mapscale");
+  if (id >= 0) {
+    glUniform1f(id, pTerrain->mapScale);
+  };
+  id = glGetUniformLocation(pShader->program, "mapheight");
+  if (id >= 0) {
+    glUniform1f(id, pTerrain->mapHeight);
+  };
+  id = glGetUniformLocation(pShader->program, "gridsize");
+  if (id >= 0) {
+    glUniform1f(id, pTerrain->gridSize);
+  };
+  id = glGetUniformLocation(pShader->program, "terrainsize");
+  if (id >= 0) {
+    glUniform1f(id, pTerrain->size);
+  };
+  id = glGetUniformLocation(pShader->program, "lodInfo");
+  if (id >= 0) {
+    glUniform3fv(id, TERRAIN_MAXLEVELS, (const GLfloat *) pTerrain->lodInfo);
+  };
+
+  terrainLoadUniforms(pTerrain, pShader->instanced);
+};
+
+// distance from pEye to the nearest point of pBox, 0.0 if pEye is inside of pBox
+float terrainBoxDistance(const aabb * pBox, const vec3 * pEye) {
+  float dx = fmax(fabs(pEye->x - pBox->center.x) - pBox->extent.x, 0.0);
+  float dy = fmax(fabs(pEye->y - pBox->center.y) - pBox->extent.y, 0.0);
+  float dz = fmax(fabs(pEye->z - pBox->center.z) - pBox->extent.z, 0.0);
+
+  return sqrt((dx * dx) + (dy * dy) + (dz * dz));
+};
+
+// select the chunk at pIndex or its children, pMask contains the planes of our frustum our parent intersects
+void terrainSelectChunk(const terrain * pTerrain, unsigned int pIndex, const vec3 * pEye, const frustum * pFrustum, unsigned int pMask, dynarray * pSelected) {
+  terrainChunk * chunk = (terrainChunk *) dynArrayItem(pTerrain->chunks, pIndex);
+
+  if (pMask != 0) {
+    if (frustumTestAABB(pFrustum, &chunk->box, &pMask) == CULL_OUTSIDE) {
+      return;
+    };
+  };
+
+  if ((chunk->children != 0) && (terrainBoxDistance(&chunk->box, pEye) < pTerrain->ranges[chunk->level])) {
+    unsigned int i, children = chunk->children;
+
+    for (i = 0; i < 4; i++) {
+      terrainSelectChunk(pTerrain, children + i, pEye, pFrustum, pMask, pSelected);
+    };
+  } else {
+    dynArrayPush(pSelected, &pIndex);
+  };
+};
+
+// select the chunks we need to render for a camera at pEye, chunks outside of pFrustum are culled.
+// Both must be relative to our terrain. Note that for shadow maps pEye should still be our camera position
+// so our shadows use the same chunks as what we see. The indices of our chunks are added to pSelected,
+// we don't change our terrain so views can select their chunks at the same time.
+// Returns the number of chunks selected
+unsigned int terrainSelect(const terrain * pTerrain, const vec3 * pEye, const frustum * pFrustum, dynarray * pSelected) {
+  unsigned int count;
+
+  if ((pTerrain == NULL) || (pSelected == NULL)) {
+    return 0;
+  };
+
+  count = pSelected->numEntries;
+  if (pTerrain->chunks->numEntries > 0) {
+    terrainSelectChunk(pTerrain, 0, pEye, pFrustum, pFrustum == NULL ? 0 : CULL_ALLPLANES, pSelected);
+  };
+
+  return pSelected->numEntries - count;
+};
+
+// returns the chunk at pIndex, use this with the indices terrainSelect returns
+terrainChunk * terrainGetChunk(const terrain * pTerrain, unsigned int pIndex) {
+  return (terrainChunk *) dynArrayItem(pTerrain->chunks, pIndex);
+};
+
+// apply the matrix that places our chunk mesh for pChunk to pModel
+mat4 * terrainChunkModel(const terrainChunk * pChunk, mat4 * pModel) {
+  vec3 tmpvector;
+
+  mat4Translate(pModel, vec3Set(&tmpvector, pChunk->x, 0.0, pChunk->z));
+  mat4Scale(pModel, vec3Set(&tmpvector, pChunk->size, 1.0, pChunk->size));
+
+  return pModel;
+};
+
+#endif /* TERRAIN_IMPLEMENTATION */
+
+#endif /* !terrainh */
@@ -0,0 +1,724 @@
+/********************************************************
+ * texturecache.h - compressed texture cache by agent 2026
+ *
+ * Public domain, use as you say fit, disect, change,
+ * or otherwise, all at your own risk
+ *
+ * This library is given as a single file implementation.
+ * Include this in any file that requires it but in one
+ * file, and one file only, proceed it with:
+ * #define TEXTURE_IMPLEMENTATION
+ *
+ * Note that OpenGL headers need to be included before
+ * this file is included as it uses several of its
+ * functions. We also need stb_image.h which is included
+ * through texturemap.h.
+ *
+ * Uploading our images as RGBA costs us 4 bytes per texel
+ * and we generate our mipmaps each time we load them. The
+ * first time we load an image we cook it instead:
+ * - we build a full mip chain, color is averaged in linear
+ *   space, normals are averaged and renormalized
+ * - we block compress each level, opaque images become BC1,
+ *   images with alpha become BC3 and normal maps BC5 which
+ *   only keeps the x and y of our normal
+ * - we write the result as a DDS file into a Cache folder
+ *   next to our image, <file>.dds or <file>.normal.dds,
+ *   we write into a temporary file first and rename it into
+ *   place so workers cooking the same image can't clash
+ *
+ * On the next run we read our DDS file and hand our levels
+ * straight to glCompressedTexImage2D. The size and time of
+ * our source image are stored in the reserved fields of
+ * our DDS header, if they don't match we cook it again.
+ *
+ * Revision history:
+ * 0.1  16-10-2026  First version with basic functions
+ *
+ ********************************************************/
+
+#ifndef texturecacheh
+#define texturecacheh
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "system.h"
+#include "math3d.h"
+
+// increase this whenever our layout or the way we cook our images changes
+#define TEXCACHE_VERSION      1
+#define TEXCACHE_MAXLEVELS    16
+
+// block compressed formats, these match the GL enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2            0x8DBD
+#endif
+
+// DDS pixel format
+typedef struct texCachePixelFormat {
+  uint32_t      size;                 // always 32
+  uint32_t      flags;                // TEXCACHE_DDPF_FOURCC
+  uint32_t      fourCC;               // DXT1, DXT5 or ATI2
+  uint32_t      rgbBitCount;          // unused
+  uint32_t      rMask;                // unused
+  uint32_t      gMask;                // unused
+  uint32_t      bMask;                // unused
+  uint32_t      aMask;                // unused
+} texCachePixelFormat;
+
+// header at the start of our cache file, this is a standard DDS header, we use its reserved fields
+typedef struct texCacheHeader {
+  char                magic[4];       // always "DDS "
+  uint32_t            size;           // always 124
+  uint32_t            flags;          // which fields are set
+  uint32_t            height;         // height of our image
+  uint32_t            width;          // width of our image
+  uint32_t            linearSize;     // size of our first level
+  uint32_t            depth;          // unused
+  uint32_t            mipMapCount;    // number of levels
+  uint32_t            tag;            // always "GTTC", our fields are valid
+  uint32_t            version;        // TEXCACHE_VERSION
+  uint32_t            sourceSize;     // size of our source image
+  uint32_t            sourceTimeLo;   // modification time of our source image
+  uint32_t            sourceTimeHi;
+  uint32_t            reserved1[6];   // unused
+  texCachePixelFormat pixelFormat;    // our format
+  uint32_t            caps;           // texture, complex and mipmap
+  uint32_t            caps2;          // unused
+  uint32_t            caps3;          // unused
+  uint32_t            caps4;          // unused
+  uint32_t            reserved2;      // unused
+} texCacheHeader;
+
+// an image with all its levels
+typedef struct texCacheImage {
+  GLenum          format;             // one of our block compressed formats
+  int             width;              // width of our first level
+  int             height;             // height of our first level
+  int             levels;             // number of levels
+  unsigned int    offsets[TEXCACHE_MAXLEVELS + 1]; // start of each level in data, the last entry is our total size
+  unsigned char * data;               // all our levels
+  bool            cooked;             // true if we cooked our image, false if we read it from our cache
+} texCacheImage;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void texCacheInit(void);
+unsigned int texCacheLevelSize(GLenum pFormat, int pWidth, int pHeight);
+const char * texCacheFormatName(GLenum pFormat);
+bool texCacheCook(const unsigned char * pData, int pWidth, int pHeight, bool pNormalMap, texCacheImage * pImage);
+bool texCacheWrite(const char * pFileName, const texCacheImage * pImage, const struct stat * pSource);
+bool texCacheRead(const char * pFileName, texCacheImage * pImage, const struct stat * pSource);
+bool texCacheLoad(const char * pPath, const char * pFileName, bool pNormalMap, texCacheImage * pImage);
+void texCacheFree(texCacheImage * pImage);
+
+#ifdef __cplusplus
+};
+#endif
+
+#ifdef TEXTURE_IMPLEMENTATION
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#define texCacheNextTempNo()  InterlockedIncrement(&texCacheTempNo)
+#define texCacheProcessId()   _getpid()
+#else
+#include <unistd.h>
+#define texCacheNextTempNo()  __atomic_add_fetch(&texCacheTempNo, 1, __ATOMIC_RELAXED)
+#define texCacheProcessId()   getpid()
+#endif
+
+// counter used to give each cache file we write its own temporary file
+volatile long texCacheTempNo = 0;
+
+#define TEXCACHE_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#define TEXCACHE_DDSD_FLAGS   0x000A1007  // caps, height, width, pixelformat, mipmapcount and linearsize
+#define TEXCACHE_DDPF_FOURCC  0x00000004
+#define TEXCACHE_DDSCAPS      0x00401008  // complex, texture and mipmap
+
+// lookup table to convert our sRGB color values to linear
+float texCacheLinear[256];
+
+// builds our lookup table, call this once before we start cooking
+void texCacheInit(void) {
+  int i;
+
+  for (i = 0; i < 256; i++) {
+    float c = i / 255.0;
+    texCacheLinear[i] = c <= 0.04045 ? c / 12.92 : powf((c + 0.055) / 1.055, 2.4);
+  };
+};
+
+// convert a linear value back to an sRGB color value
+unsigned char tcToSRGB(float pValue) {
+  float c = pValue <= 0.0031308 ? pValue * 12.92 : 1.055 * powf(pValue, 1.0 / 2.4) - 0.055;
+  int   v = (int) (c * 255.0 + 0.5);
+
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+};
+
+// returns the number of bytes for a level
+unsigned int texCacheLevelSize(GLenum pFormat, int pWidth, int pHeight) {
+  unsigned int blocks = ((pWidth + 3) / 4) * ((pHeight + 3) / 4);
+
+  return pFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? blocks * 8 : blocks * 16;
+};
+
+// returns a readable name for our format
+const char * texCacheFormatName(GLenum pFormat) {
+  switch (pFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+    case GL_COMPRESSED_RG_RGTC2: return "BC5";
+    default: return "unknown";
+  };
+};
+
+// halve our image, pDest must be large enough to hold it
+void tcDownsample(const unsigned char * pSrc, int pWidth, int pHeight, unsigned char * pDest, bool pNormalMap) {
+  int newWidth = pWidth > 1 ? pWidth / 2 : 1;
+  int newHeight = pHeight > 1 ? pHeight / 2 : 1;
+  int x, y, i, c;
+
+  for (y = 0; y < newHeight; y++) {
+    for (x = 0; x < newWidth; x++) {
+      const unsigned char * p[4];
+      int   x0 = x * 2, y0 = y * 2;
+      int   x1 = x0 + 1 < pWidth ? x0 + 1 : x0;
+      int   y1 = y0 + 1 < pHeight ? y0 + 1 : y0;
+      unsigned char * dest = pDest + ((y * newWidth) + x) * 4;
+
+      p[0] = pSrc + ((y0 * pWidth) + x0) * 4;
+      p[1] = pSrc + ((y0 * pWidth) + x1) * 4;
+      p[2] = pSrc + ((y1 * pWidth) + x0) * 4;
+      p[3] = pSrc + ((y1 * pWidth) + x1) * 4;
+
+      if (pNormalMap) {
+        // average our normals and renormalize
+        vec3  n;
+        float l;
+
+        vec3Set(&n, 0.0, 0.0, 0.0);
+        for (i = 0; i < 4; i++) {
+          n.x += (p[i][0] / 127.5) - 1.0;
+          n.y += (p[i][1] / 127.5) - 1.0;
+          n.z += (p[i][2] / 127.5) - 1.0;
+        };
+        l = sqrtf((n.x * n.x) + (n.y * n.y) + (n.z * n.z));
+        if (l > 0.0) {
+          vec3Div(&n, l);
+        } else {
+          vec3Set(&n, 0.0, 0.0, 1.0);
+        };
+        dest[0] = (unsigned char) ((n.x + 1.0) * 127.5 + 0.5);
+        dest[1] = (unsigned char) ((n.y + 1.0) * 127.5 + 0.5);
+        dest[2] = (unsigned char) ((n.z + 1.0) * 127.5 + 0.5);
+        dest[3] = 255;
+      } else {
+        // average our color in linear space, our alpha is already linear
+        for (c = 0; c < 3; c++) {
+          float sum = 0.0;
+          for (i = 0; i < 4; i++) {
+            sum += texCacheLinear[p[i][c]];
+          };
+          dest[c] = tcToSRGB(sum / 4.0);
+        };
+        dest[3] = (p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4;
+      };
+    };
+  };
+};
+
+// get the 4x4 block at pX, pY, we repeat our edge pixels if our image is smaller
+void tcFetchBlock(const unsigned char * pData, int pWidth, int pHeight, int pX, int pY, unsigned char * pBlock) {
+  int x, y;
+
+  for (y = 0; y < 4; y++) {
+    int sy = pY + y < pHeight ? pY + y : pHeight - 1;
+    for (x = 0; x < 4; x++) {
+      int sx = pX + x < pWidth ? pX + x : pWidth - 1;
+      memcpy(pBlock + ((y * 4) + x) * 4, pData + ((sy * pWidth) + sx) * 4, 4);
+    };
+  };
+};
+
+// convert a color to 565
+uint16_t tcPack565(const float * pColor) {
+  int r = (int) (pColor[0] * 31.0 / 255.0 + 0.5);
+  int g = (int) (pColor[1] * 63.0 / 255.0 + 0.5);
+  int b = (int) (pColor[2] * 31.0 / 255.0 + 0.5);
+
+  r = r < 0 ? 0 : (r > 31 ? 31 : r);
+  g = g < 0 ? 0 : (g > 63 ? 63 : g);
+  b = b < 0 ? 0 : (b > 31 ? 31 : b);
+
+  return (uint16_t) ((r << 11) | (g << 5) | b);
+};
+
+// convert a 565 color back to 888
+void tcUnpack565(uint16_t pColor, int * pRGB) {
+  int r = (pColor >> 11) & 31;
+  int g = (pColor >> 5) & 63;
+  int b = pColor & 31;
+
+  pRGB[0] = (r << 3) | (r >> 2);
+  pRGB[1] = (g << 2) | (g >> 4);
+  pRGB[2] = (b << 3) | (b >> 2);
+};
+
+// encode the color of our block as BC1, we fit a line through our colors along their principal axis
+void tcEncodeBC1(const unsigned char * pBlock, unsigned char * pOut) {
+  float     mean[3] = { 0.0, 0.0, 0.0 };
+  float     cov[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  float     axis[3], minT = 1.0e10, maxT = -1.0e10, inset;
+  float     c0[3], c1[3];
+  int       palette[4][3];
+  uint16_t  p0, p1;
+  uint32_t  indices = 0;
+  int       i, j, c;
+
+  for (i = 0; i < 16; i++) {
+    for (c = 0; c < 3; c++) {
+      mean[c] += pBlock[(i * 4) + c] / 16.0;
+    };
+  };
+
+  for (i = 0; i < 16; i++) {
+    float r = pBlock[(i * 4)] - mean[0];
+    float g = pBlock[(i * 4) + 1] - mean[1];
+    float b = pBlock[(i * 4) + 2] - mean[2];
+
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  };
+
+  // a few iterations of the power method give us our principal axis
+  axis[0] = 1.0;
+  axis[1] = 1.0;
+  axis[2] = 1.0;
+  for (j = 0; j < 4; j++) {
+    float x = (cov[0] * axis[0]) + (cov[1] * axis[1]) + (cov[2] * axis[2]);
+    float y = (cov[1] * axis[0]) + (cov[3] * axis[1]) + (cov[4] * axis[2]);
+    float z = (cov[2] * axis[0]) + (cov[4] * axis[1]) + (cov[5] * axis[2]);
+    float l = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+
+    if (l < 1.0e-6) {
+      // our block has a single color
+      break;
+    };
+    axis[0] = x / l;
+    axis[1] = y / l;
+    axis[2] = z / l;
+  };
+
+  // project our colors onto our axis
+  for (i = 0; i < 16; i++) {
+    float t = ((pBlock[(i * 4)] - mean[0]) * axis[0]) + ((pBlock[(i * 4) + 1] - mean[1]) * axis[1]) + ((pBlock[(i * 4) + 2] - mean[2]) * axis[2]);
+    minT = fminf(minT, t);
+    maxT = fmaxf(maxT, t);
+  };
+
+  // pull our end points in slightly, this reduces our error for the colors in between
+  inset = (maxT - minT) / 32.0;
+  for (c = 0; c < 3; c++) {
+    c0[c] = mean[c] + (axis[c] * (maxT - inset));
+    c1[c] = mean[c] + (axis[c] * (minT + inset));
+  };
+
+  p0 = tcPack565(c0);
+  p1 = tcPack565(c1);
+  if (p0 < p1) {
+    uint16_t swap = p0;
+    p0 = p1;
+    p1 = swap;
+  };
+
+  if (p0 != p1) {
+    tcUnpack565(p0, palette[0]);
+    tcUnpack565(p1, palette[1]);
+    for (c = 0; c < 3; c++) {
+      palette[2][c] = ((2 * palette[0][c]) + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + (2 * palette[1][c])) / 3;
+    };
+
+    // and pick the nearest entry for each pixel
+    for (i = 0; i < 16; i++) {
+      int best = 0, bestDist = 0x7FFFFFFF;
+
+      for (j = 0; j < 4; j++) {
+        int dr = pBlock[(i * 4)] - palette[j][0];
+        int dg = pBlock[(i * 4) + 1] - palette[j][1];
+        int db = pBlock[(i * 4) + 2] - palette[j][2];
+        int dist = (dr * dr) + (dg * dg) + (db * db);
+
+        if (dist < bestDist) {
+          best = j;
+          bestDist = dist;
+        };
+      };
+
+      indices |= (uint32_t) best << (i * 2);
+    };
+  };
+
+  pOut[0] = p0 & 0xFF;
+  pOut[1] = p0 >> 8;
+  pOut[2] = p1 & 0xFF;
+  pOut[3] = p1 >> 8;
+  pOut[4] = indices & 0xFF;
+  pOut[5] = (indices >> 8) & 0xFF;
+  pOut[6] = (indices >> 16) & 0xFF;
+  pOut[7] = indices >> 24;
+};
+
+// encode one channel of our block as BC4, used for the alpha of BC3 and both channels of BC5
+void tcEncodeBC4(const unsigned char * pBlock, int pChannel, unsigned char * pOut) {
+  int       a0 = 0, a1 = 255;
+  int       palette[8];
+  uint64_t  indices = 0;
+  int       i, j;
+
+  for (i = 0; i < 16; i++) {
+    int v = pBlock[(i * 4) + pChannel];
+    a0 = v > a0 ? v : a0;
+    a1 = v < a1 ? v : a1;
+  };
+
+  if (a0 != a1) {
+    // a0 > a1 gives us 6 interpolated values
+    palette[0] = a0;
+    palette[1] = a1;
+    for (j = 2; j < 8; j++) {
+      palette[j] = (((8 - j) * a0) + ((j - 1) * a1) + 3) / 7;
+    };
+
+    for (i = 0; i < 16; i++) {
+      int v = pBlock[(i * 4) + pChannel];
+      int best = 0, bestDist = 256;
+
+      for (j = 0; j < 8; j++) {
+        int dist = abs(v - palette[j]);
+        if (dist < bestDist) {
+          best = j;
+          bestDist = dist;
+        };
+      };
+
+      indices |= (uint64_t) best << (i * 3);
+    };
+  };
+
+  pOut[0] = a0;
+  pOut[1] = a1;
+  for (i = 0; i < 6; i++) {
+    pOut[2 + i] = (indices >> (i * 8)) & 0xFF;
+  };
+};
+
+// cook our RGBA image into a block compressed image with a full mip chain
+bool texCacheCook(const unsigned char * pData, int pWidth, int pHeight, bool pNormalMap, texCacheImage * pImage) {
+  unsigned char * level;
+  unsigned char * next;
+  unsigned char   block[64];
+  unsigned int    total = 0;
+  int             width = pWidth, height = pHeight;
+  int             i, l, x, y;
+
+  memset(pImage, 0, sizeof(texCacheImage));
+
+  if ((pData == NULL) || (pWidth <= 0) || (pHeight <= 0)) {
+    return false;
+  };
+
+  // pick our format
+  if (pNormalMap) {
+    pImage->format = GL_COMPRESSED_RG_RGTC2;
+  } else {
+    pImage->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    for (i = 0; i < pWidth * pHeight; i++) {
+      if (pData[(i * 4) + 3] != 255) {
+        pImage->format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+      };
+    };
+  };
+
+  // work out our levels
+  pImage->width = pWidth;
+  pImage->height = pHeight;
+  while (pImage->levels < TEXCACHE_MAXLEVELS) {
+    pImage->offsets[pImage->levels++] = total;
+    total += texCacheLevelSize(pImage->format, width, height);
+    if ((width == 1) && (height == 1)) {
+      break;
+    };
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  };
+  pImage->offsets[pImage->levels] = total;
+
+  pImage->data = (unsigned char *) malloc(total);
+  level = (unsigned char *) malloc(pWidth * pHeight * 4);
+  next = (unsigned char *) malloc(((pWidth + 1) / 2) * ((pHeight + 1) / 2) * 4);
+  if ((pImage->data == NULL) || (level == NULL) || (next == NULL)) {
+    free(pImage->data);
+    free(level);
+    free(next);
+    memset(pImage, 0, sizeof(texCacheImage));
+    return false;
+  };
+  memcpy(level, pData, pWidth * pHeight * 4);
+
+  width = pWidth;
+  height = pHeight;
+  for (l = 0; l < pImage->levels; l++) {
+    unsigned char * out = pImage->data + pImage->offsets[l];
+
+    if (l > 0) {
+      unsigned char * swap;
+
+      tcDownsample(level, width, height, next, pNormalMap);
+      width = width > 1 ? width / 2 : 1;
+      height = height > 1 ? height / 2 : 1;
+
+      swap = level;
+      level = next;
+      next = swap;
+    };
+
+    for (y = 0; y < height; y += 4) {
+      for (x = 0; x < width; x += 4) {
+        tcFetchBlock(level, width, height, x, y, block);
+
+        if (pImage->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+          tcEncodeBC1(block, out);
+          out += 8;
+        } else if (pImage->format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+          tcEncodeBC4(block, 3, out);
+          tcEncodeBC1(block, out + 8);
+          out += 16;
+        } else {
+          tcEncodeBC4(block, 0, out);
+          tcEncodeBC4(block, 1, out + 8);
+          out += 16;
+        };
+      };
+    };
+  };
+
+  free(level);
+  free(next);
+
+  pImage->cooked = true;
+  return true;
+};
+
+// write our image to our cache file
+bool texCacheWrite(const char * pFileName, const texCacheImage * pImage, const struct stat * pSource) {
+  texCacheHeader  header;
+  FILE *          file;
+  bool            written;
+
+  memset(&header, 0, sizeof(texCacheHeader));
+  memcpy(header.magic, "DDS ", 4);
+  header.size = 124;
+  header.flags = TEXCACHE_DDSD_FLAGS;
+  header.height = pImage->height;
+  header.width = pImage->width;
+  header.linearSize = pImage->offsets[1];
+  header.mipMapCount = pImage->levels;
+  header.tag = TEXCACHE_FOURCC('G', 'T', 'T', 'C');
+  header.version = TEXCACHE_VERSION;
+  header.sourceSize = (uint32_t) pSource->st_size;
+  header.sourceTimeLo = (uint32_t) ((uint64_t) pSource->st_mtime & 0xFFFFFFFF);
+  header.sourceTimeHi = (uint32_t) ((uint64_t) pSource->st_mtime >> 32);
+  header.pixelFormat.size = 32;
+  header.pixelFormat.flags = TEXCACHE_DDPF_FOURCC;
+  if (pImage->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+    header.pixelFormat.fourCC = TEXCACHE_FOURCC('D', 'X', 'T', '1');
+  } else if (pImage->format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+    header.pixelFormat.fourCC = TEXCACHE_FOURCC('D', 'X', 'T', '5');
+  } else {
+    header.pixelFormat.fourCC = TEXCACHE_FOURCC('A', 'T', 'I', '2');
+  };
+  header.caps = TEXCACHE_DDSCAPS;
+
+  file = fopen(pFileName, "wb");
+  if (file == NULL) {
+    return false;
+  };
+  written = (fwrite(&header, sizeof(texCacheHeader), 1, file) == 1) && (fwrite(pImage->data, pImage->offsets[pImage->levels], 1, file) == 1);
+  fclose(file);
+
+  if (!written) {
+    // don't leave a broken cache behind
+    remove(pFileName);
+  };
+
+  return written;
+};
+
+// read our image from our cache file, returns false if our cache is missing or out of date
+bool texCacheRead(const char * pFileName, texCacheImage * pImage, const struct stat * pSource) {
+  texCacheHeader  header;
+  FILE *          file;
+  int             width, height, l;
+  unsigned int    total = 0;
+
+  memset(pImage, 0, sizeof(texCacheImage));
+
+  file = fopen(pFileName, "rb");
+  if (file == NULL) {
+    return false;
+  } else if (fread(&header, sizeof(texCacheHeader), 1, file) != 1) {
+    fclose(file);
+    return false;
+  };
+
+  // check if our cache is still valid
+  if ((memcmp(header.magic, "DDS ", 4) != 0) || (header.size != 124) || (header.tag != TEXCACHE_FOURCC('G', 'T', 'T', 'C')) || (header.version != TEXCACHE_VERSION)) {
+    fclose(file);
+    return false;
+  } else if ((header.sourceSize != (uint32_t) pSource->st_size) || (header.sourceTimeLo != (uint32_t) ((uint64_t) pSource->st_mtime & 0xFFFFFFFF)) || (header.sourceTimeHi != (uint32_t) ((uint64_t) pSource->st_mtime >> 32))) {
+    fclose(file);
+    return false;
+  } else if ((header.width == 0) || (header.height == 0) || (header.mipMapCount == 0) || (header.mipMapCount > TEXCACHE_MAXLEVELS)) {
+    fclose(file);
+    return false;
+  };
+
+  if (header.pixelFormat.fourCC == TEXCACHE_FOURCC('D', 'X', 'T', '1')) {
+    pImage->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  } else if (header.pixelFormat.fourCC == TEXCACHE_FOURCC('D', 'X', 'T', '5')) {
+    pImage->format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  } else if (header.pixelFormat.fourCC == TEXCACHE_FOURCC('A', 'T', 'I', '2')) {
+    pImage->format = GL_COMPRESSED_RG_RGTC2;
+  } else {
+    fclose(file);
+    return false;
+  };
+
+  pImage->width = header.width;
+  pImage->height = header.height;
+  pImage->levels = header.mipMapCount;
+  width = pImage->width;
+  height = pImage->height;
+  for (l = 0; l < pImage->levels; l++) {
+    pImage->offsets[l] = total;
+    total += texCacheLevelSize(pImage->format, width, height);
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  };
+  pImage->offsets[pImage->levels] = total;
+
+  pImage->data = (unsigned char *) malloc(total);
+  if ((pImage->data == NULL) || (fread(pImage->data, total, 1, file) != 1)) {
+    fclose(file);
+    texCacheFree(pImage);
+    return false;
+  };
+
+  fclose(file);
+  return true;
+};
+
+// load our image from our cache, if our cache is missing or out of date we cook our image and write our cache
+// note that this does not use GL so it can be called from any thread
+bool texCacheLoad(const char * pPath, const char * pFileName, bool pNormalMap, texCacheImage * pImage) {
+  char            sourceName[1024];
+  char            cacheName[1024];
+  char            tempName[1024];
+  char            separator = '/';
+  struct stat     st;
+  unsigned char * data;
+  int             x, y, comp;
+  size_t          len = strlen(pPath);
+
+  if (snprintf(sourceName, sizeof(sourceName), "%s%s", pPath, pFileName) >= (int) sizeof(sourceName)) {
+    memset(pImage, 0, sizeof(texCacheImage));
+    return false;
+  };
+  if (stat(sourceName, &st) != 0) {
+    memset(pImage, 0, sizeof(texCacheImage));
+    return false;
+  };
+
+  // our cache lives in a Cache folder next to our images
+  if ((len > 0) && (pPath[len - 1] == '\\')) {
+    separator = '\\';
+  };
+  if (snprintf(cacheName, sizeof(cacheName), "%sCache%c%s%s", pPath, separator, pFileName, pNormalMap ? ".normal.dds" : ".dds") >= (int) sizeof(cacheName)) {
+    // no room for our cache name, just cook our image
+    cacheName[0] = '\0';
+  } else if (texCacheRead(cacheName, pImage, &st)) {
+    return true;
+  };
+
+  // no (valid) cache, cook our image
+  data = stbi_load(sourceName, &x, &y, &comp, 4);
+  if (data == NULL) {
+    return false;
+  } else if (!texCacheCook(data, x, y, pNormalMap, pImage)) {
+    stbi_image_free(data);
+    return false;
+  };
+  stbi_image_free(data);
+
+  // and write our cache, if this fails we simply cook our image again next time
+  if (cacheName[0] == '\0') {
+    return true;
+  };
+  snprintf(sourceName, sizeof(sourceName), "%sCache", pPath);
+#if defined(WIN32) || defined(_WIN32)
+  _mkdir(sourceName);
+#else
+  mkdir(sourceName, 0755);
+#endif
+
+  // another worker (or another instance of our application) may be cooking the same image, so we write
+  // into our own temporary file and move it into place once it is complete, readers never see half a file
+  if (snprintf(tempName, sizeof(tempName), "%s.%d.%ld.tmp", cacheName, (int) texCacheProcessId(), (long) texCacheNextTempNo()) >= (int) sizeof(tempName)) {
+    return true;
+  } else if (texCacheWrite(tempName, pImage, &st)) {
+#if defined(WIN32) || defined(_WIN32)
+    // rename won't replace an existing file on Windows
+    if (!MoveFileExA(tempName, cacheName, MOVEFILE_REPLACE_EXISTING)) {
+      remove(tempName);
+    };
+#else
+    if (rename(tempName, cacheName) != 0) {
+      remove(tempName);
+    };
+#endif
+  };
+
+  return true;
+};
+
+// free the data of our image
+void texCacheFree(texCacheImage * pImage) {
+  if (pImage->data != NULL) {
+    free(pImage->data);
+  };
+  memset(pImage, 0, sizeof(texCacheImage));
+};
+
+#endif /* TEXTURE_IMPLEMENTATION */
+
+#endif /* !texturecacheh */
@@ -15,6 +15,10 @@
  *
  * Revision history:
  * 0.1  07-02-2016  First version with basic functions
+ * 0.2  16-10-2026  Added depth cube maps for point light shadows
+ * 0.3  16-10-2026  Added copying shadow maps
+ * 0.4  16-10-2026  Added streaming textures in through worker threads
+ * 0.5  16-10-2026  Stream block compressed textures from our cache
  *
  ********************************************************/
 
@@ -25,6 +29,16 @@
 #include <stb/stb_image.h>
 #include "system.h"
 #include "linkedlist.h"
+#include "benchmark.h"
+#include "texturecache.h"
+
+#define TMAP_MAX_WORKERS          16
+
+// placeholders we show while a texture streams in
+#define TMAP_PLACEHOLDER_GRAY     0
+#define TMAP_PLACEHOLDER_WHITE    1
+#define TMAP_PLACEHOLDER_BLACK    2
+#define TMAP_PLACEHOLDER_NORMAL   3
 
 typedef struct texturemap {
   unsigned int      retainCount;      // retain count for this object
@@ -37,6 +51,8 @@ typedef struct texturemap {
   GLuint            textureId;        // ID of our texture object
   GLuint            depthBufferId;    // ID of our depth texture (if we needed one)
   GLuint            frameBufferId;    // ID of our framebuffer for render to texture
+  bool              streaming;        // true while our image is being streamed in
+  bool              mipmap;           // true if we need to generate mipmaps
 } texturemap;
 
 #ifdef __cplusplus
@@ -56,16 +72,33 @@ bool tmapLoadData(texturemap * pTMap, const unsigned char * pData, int pWidth, i
 vec4 tmapGetPixel(texturemap * pTMap, float pS, float pT);
 bool tmapRenderToTexture(texturemap * pTMap, bool pNeedDepthBuffer);
 bool tmapRenderToShadowMap(texturemap * pTMap, int pWidth, int pHeight);
+bool tmapRenderToShadowCube(texturemap * pTMap, int pResolution);
+bool tmapCopyShadowMap(texturemap * pTMap, texturemap * pSource);
+bool tmapCopyShadowCube(texturemap * pTMap, texturemap * pSource);
 void tmapFreeFrameBuffers(texturemap * pTMap);
 
 void tmapReleaseCachedTextureMaps();
 
+bool tmapStartStreaming(int pWorkers, unsigned int pBudget);
+void tmapStopStreaming(void);
+unsigned int tmapStreamUpdate(unsigned int pBudget);
+void tmapStreamFlush(void);
+void tmapSetCompression(bool pCompress);
+texturemap * getStreamedTextureMap(const char * pFileName, GLint pFilter, GLint pWrap, int pPlaceholder);
+
 #ifdef __cplusplus
 };
 #endif  
 
 #ifdef TEXTURE_IMPLEMENTATION
 
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 // some variables we maintain
 llist * tmapTextureCache = NULL;
 char tmapTexturePath[1024] = "";
@@ -89,6 +122,8 @@ texturemap * newTextureMap(const char * pName) {
     glGenTextures(1, &(newTmap->textureId));
     newTmap->frameBufferId = 0;
     newTmap->depthBufferId = 0;
+    newTmap->streaming = false;
+    newTmap->mipmap = false;
 
     // errorlog(0, "Created texture map %s", pName);
   };
@@ -262,6 +297,12 @@ bool tmapMakeMipMap(texturemap * pTMap) {
   } else if (pTMap->filter == GL_LINEAR) {
     pTMap->filter = GL_LINEAR_MIPMAP_LINEAR;
   };
+  pTMap->mipmap = true;
+
+  if (pTMap->streaming) {
+    // we generate our mipmap once our image is uploaded
+    return true;
+  };
 
   // generate mipmap, we assume image has been loaded
   glActiveTexture(GL_TEXTURE0);
@@ -460,6 +501,122 @@ bool tmapRenderToShadowMap(texturemap * pTMap, int pWidth, int pHeight) {
   return true;
 };
 
+// Prepare our texture as a depth cube map (if needed) and makes our
+// shadow map frame buffer active, all six faces are attached as layers
+// so a geometry shader can select the face it renders to with gl_Layer
+bool tmapRenderToShadowCube(texturemap * pTMap, int pResolution) {
+  if (pTMap == NULL) {
+    return false;
+  };
+
+  // check if we can reuse what we have...
+  if ((pTMap->width != pResolution) || (pTMap->height != pResolution)) {
+    // chuck our current frame buffer JIC.
+    tmapFreeFrameBuffers(pTMap);
+  };
+
+  // create our frame buffer if we haven't already
+  if (pTMap->frameBufferId == 0) {
+    GLenum  status;
+    int     i;
+
+    pTMap->filter = GL_LINEAR;
+    pTMap->wrap = GL_CLAMP_TO_EDGE;
+    pTMap->width = pResolution;
+    pTMap->height = pResolution;
+
+    glGenFramebuffers(1, &pTMap->frameBufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, pTMap->frameBufferId);
+
+    // init our depth cube map
+    glBindTexture(GL_TEXTURE_CUBE_MAP, pTMap->textureId);
+    for (i = 0; i < 6; i++) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT32F, pTMap->width, pTMap->height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    };
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, pTMap->filter);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, pTMap->filter);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, pTMap->wrap);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, pTMap->wrap);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, pTMap->wrap);
+
+    // bind all faces of our cube map to our frame buffer
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pTMap->textureId, 0);
+
+    // and make sure our framebuffer knows we draw nothing else...
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    // and check if all went well
+    status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      errorlog(status, "Couldn't init cube map framebuffer (errno = %i)", status);
+      tmapFreeFrameBuffers(pTMap);
+      return false;
+    };
+  } else {
+    // reactivate our framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, pTMap->frameBufferId);
+  };
+
+  return true;
+};
+
+// Copy the depth of our source shadow map into our shadow map, both
+// need to have been prepared with tmapRenderToShadowMap at the same size.
+// Our shadow map frame buffer is active afterwards.
+bool tmapCopyShadowMap(texturemap * pTMap, texturemap * pSource) {
+  if ((pTMap == NULL) || (pSource == NULL)) {
+    return false;
+  } else if ((pTMap->frameBufferId == 0) || (pSource->frameBufferId == 0)) {
+    return false;
+  } else if ((pTMap->width != pSource->width) || (pTMap->height != pSource->height)) {
+    return false;
+  };
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, pSource->frameBufferId);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pTMap->frameBufferId);
+  glBlitFramebuffer(0, 0, pSource->width, pSource->height, 0, 0, pTMap->width, pTMap->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+  // and reactivate our framebuffer
+  glBindFramebuffer(GL_FRAMEBUFFER, pTMap->frameBufferId);
+
+  return true;
+};
+
+// Copy all six faces of our source cube map into our cube map, both
+// need to have been prepared with tmapRenderToShadowCube at the same size.
+// Blitting a layered frame buffer only copies its first layer so we
+// temporarily attach each face on its own.
+// Our cube map frame buffer is active afterwards.
+bool tmapCopyShadowCube(texturemap * pTMap, texturemap * pSource) {
+  int i;
+
+  if ((pTMap == NULL) || (pSource == NULL)) {
+    return false;
+  } else if ((pTMap->frameBufferId == 0) || (pSource->frameBufferId == 0)) {
+    return false;
+  } else if ((pTMap->width != pSource->width) || (pTMap->height != pSource->height)) {
+    return false;
+  };
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, pSource->frameBufferId);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pTMap->frameBufferId);
+  for (i = 0; i < 6; i++) {
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, pSource->textureId, 0);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, pTMap->textureId, 0);
+    glBlitFramebuffer(0, 0, pSource->width, pSource->height, 0, 0, pTMap->width, pTMap->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  };
+
+  // attach all our faces again
+  glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pSource->textureId, 0);
+  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pTMap->textureId, 0);
+
+  // and reactivate our framebuffer
+  glBindFramebuffer(GL_FRAMEBUFFER, pTMap->frameBufferId);
+
+  return true;
+};
+
 // free up frame buffers if we no longer need them
 void tmapFreeFrameBuffers(texturemap * pTMap) {
   if (pTMap->frameBufferId != 0) {
@@ -481,6 +638,586 @@ void tmapReleaseCachedTextureMaps() {
   };
 };
 
+//////////////////////////////////////////////////////////
+// texture streaming
+//
+// Our workers decode our images and push them onto a lock free stack, once per frame our GL thread takes
+// everything off this stack and uploads up to tmapStreamBudget bytes through a pixel buffer object.
+// We upload into a new texture object and only swap it with our 1x1 placeholder once it is complete.
+// If compression is enabled our workers load block compressed images with a full mip chain from our cache
+// (see texturecache.h) and we upload these one level at a time.
+
+// a texture we're streaming
+typedef struct tmapStreamJob {
+  struct tmapStreamJob *  next;       // next job in our queue
+  texturemap *            tmap;       // texture we're loading into, retained until we're done
+  char                    fileName[1024]; // file name of our image
+  bool                    normalMap;  // true if our image is a normal map
+  unsigned char *         data;       // our decoded image, NULL if we couldn't decode it or if we load it compressed
+  int                     width;      // width of our image
+  int                     height;     // height of our image
+  texCacheImage           image;      // our block compressed image, data is NULL if we're not compressing
+  double                  loadTime;   // time our worker spent loading our image
+  int                     uploaded;   // number of rows (or levels if compressed) we've uploaded so far
+  GLuint                  textureId;  // texture we're uploading into, 0 until we start
+} tmapStreamJob;
+
+#if defined(WIN32) || defined(_WIN32)
+typedef HANDLE              tmapThread;
+typedef CRITICAL_SECTION    tmapMutex;
+typedef CONDITION_VARIABLE  tmapCond;
+#define tmapMutexInit(m)    InitializeCriticalSection(m)
+#define tmapMutexFree(m)    DeleteCriticalSection(m)
+#define tmapMutexLock(m)    EnterCriticalSection(m)
+#define tmapMutexUnlock(m)  LeaveCriticalSection(m)
+#define tmapCondInit(c)     InitializeConditionVariable(c)
+#define tmapCondFree(c)
+#define tmapCondWait(c, m)  SleepConditionVariableCS(c, m, INFINITE)
+#define tmapCondWakeAll(c)  WakeAllConditionVariable(c)
+#define tmapSleep()         Sleep(1)
+#else
+typedef pthread_t           tmapThread;
+typedef pthread_mutex_t     tmapMutex;
+typedef pthread_cond_t      tmapCond;
+#define tmapMutexInit(m)    pthread_mutex_init(m, NULL)
+#define tmapMutexFree(m)    pthread_mutex_destroy(m)
+#define tmapMutexLock(m)    pthread_mutex_lock(m)
+#define tmapMutexUnlock(m)  pthread_mutex_unlock(m)
+#define tmapCondInit(c)     pthread_cond_init(c, NULL)
+#define tmapCondFree(c)     pthread_cond_destroy(c)
+#define tmapCondWait(c, m)  pthread_cond_wait(c, m)
+#define tmapCondWakeAll(c)  pthread_cond_broadcast(c)
+#define tmapSleep()         usleep(1000)
+#endif
+
+bool              tmapStreaming = false;            // true if our workers are running
+int               tmapStreamNumWorkers = 0;         // number of workers we've started
+tmapThread        tmapStreamWorkers[TMAP_MAX_WORKERS]; // our worker threads
+tmapMutex         tmapStreamMutex;                  // protects our decode queue
+tmapCond          tmapStreamCond;                   // signals our workers there is work or that they should quit
+tmapStreamJob *   tmapStreamDecodeFirst = NULL;     // first image our workers need to decode
+tmapStreamJob *   tmapStreamDecodeLast = NULL;      // last image our workers need to decode
+bool              tmapStreamQuit = false;           // if true our workers exit
+tmapStreamJob *   tmapStreamDecoded = NULL;         // lock free stack of decoded images, pushed by our workers
+tmapStreamJob *   tmapStreamUploadFirst = NULL;     // first decoded image our GL thread is uploading
+tmapStreamJob *   tmapStreamUploadLast = NULL;      // last decoded image our GL thread needs to upload
+unsigned int      tmapStreamPending = 0;            // number of textures that are not yet resident
+unsigned int      tmapStreamBudget = 0;             // number of bytes we upload each frame
+GLuint            tmapStreamPBO = 0;                // pixel buffer object we upload through
+bool              tmapCompress = false;             // if true we load block compressed images from our cache
+bool              tmapCompressColor = false;        // true if we can use BC1 and BC3, BC5 is part of core GL
+
+// push a decoded image onto our lock free stack, called from our workers
+void tmapStreamPushDecoded(tmapStreamJob * pJob) {
+#if defined(WIN32) || defined(_WIN32)
+  PVOID head;
+  do {
+    head = tmapStreamDecoded;
+    pJob->next = (tmapStreamJob *) head;
+  } while (InterlockedCompareExchangePointer((PVOID volatile *) &tmapStreamDecoded, pJob, head) != head);
+#else
+  tmapStreamJob * head = __atomic_load_n(&tmapStreamDecoded, __ATOMIC_RELAXED);
+  do {
+    pJob->next = head;
+  } while (!__atomic_compare_exchange_n(&tmapStreamDecoded, &head, pJob, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+};
+
+// take everything off our lock free stack, called from our GL thread
+tmapStreamJob * tmapStreamTakeDecoded(void) {
+#if defined(WIN32) || defined(_WIN32)
+  return (tmapStreamJob *) InterlockedExchangePointer((PVOID volatile *) &tmapStreamDecoded, NULL);
+#else
+  return __atomic_exchange_n(&tmapStreamDecoded, NULL, __ATOMIC_ACQUIRE);
+#endif
+};
+
+// our worker, decodes images until we're told to quit
+#if defined(WIN32) || defined(_WIN32)
+DWORD WINAPI tmapStreamWorker(LPVOID pParam) {
+#else
+void * tmapStreamWorker(void * pParam) {
+#endif
+  while (true) {
+    tmapStreamJob * job;
+    char            fileName[1024];
+    double          start;
+    int             comp;
+
+    tmapMutexLock(&tmapStreamMutex);
+    while (!tmapStreamQuit && (tmapStreamDecodeFirst == NULL)) {
+      tmapCondWait(&tmapStreamCond, &tmapStreamMutex);
+    };
+    if (tmapStreamQuit) {
+      tmapMutexUnlock(&tmapStreamMutex);
+      break;
+    };
+    job = tmapStreamDecodeFirst;
+    tmapStreamDecodeFirst = job->next;
+    if (tmapStreamDecodeFirst == NULL) {
+      tmapStreamDecodeLast = NULL;
+    };
+    tmapMutexUnlock(&tmapStreamMutex);
+
+    // this is the slow bit
+    start = benchGetTime();
+    if (tmapCompress && (job->normalMap || tmapCompressColor)) {
+      texCacheLoad(tmapTexturePath, job->fileName, job->normalMap, &job->image);
+    } else {
+      snprintf(fileName, sizeof(fileName), "%s%s", tmapTexturePath, job->fileName);
+      job->data = stbi_load(fileName, &job->width, &job->height, &comp, 4);
+    };
+    job->loadTime = benchGetTime() - start;
+
+    tmapStreamPushDecoded(job);
+  };
+
+  return 0;
+};
+
+// load block compressed images from our cache when streaming, this must be called before tmapStartStreaming
+// note that our normal maps are then stored as BC5 and our shaders need to reconstruct their z
+void tmapSetCompression(bool pCompress) {
+  tmapCompress = pCompress;
+};
+
+// start our texture streaming, from now on getStreamedTextureMap loads textures in the background
+// if pWorkers is 0 we start a worker for each CPU core, pBudget is the number of bytes we upload each frame
+bool tmapStartStreaming(int pWorkers, unsigned int pBudget) {
+  int i;
+
+  if (tmapStreaming) {
+    return true;
+  };
+
+  if (pWorkers <= 0) {
+#if defined(WIN32) || defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pWorkers = info.dwNumberOfProcessors;
+#else
+    pWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  };
+  if (pWorkers < 1) {
+    pWorkers = 1;
+  } else if (pWorkers > TMAP_MAX_WORKERS) {
+    pWorkers = TMAP_MAX_WORKERS;
+  };
+
+  tmapMutexInit(&tmapStreamMutex);
+  tmapCondInit(&tmapStreamCond);
+  tmapStreamQuit = false;
+  tmapStreamBudget = pBudget > 0 ? pBudget : 4 * 1024 * 1024;
+
+  tmapStreamNumWorkers = 0;
+  for (i = 0; i < pWorkers; i++) {
+#if defined(WIN32) || defined(_WIN32)
+    tmapStreamWorkers[i] = CreateThread(NULL, 0, tmapStreamWorker, NULL, 0, NULL);
+    if (tmapStreamWorkers[i] == NULL) {
+      break;
+    };
+#else
+    if (pthread_create(&tmapStreamWorkers[i], NULL, tmapStreamWorker, NULL) != 0) {
+      break;
+    };
+#endif
+    tmapStreamNumWorkers++;
+  };
+
+  if (tmapStreamNumWorkers == 0) {
+    errorlog(-1, "Couldn't start our texture streaming workers");
+    tmapCondFree(&tmapStreamCond);
+    tmapMutexFree(&tmapStreamMutex);
+    return false;
+  };
+
+  glGenBuffers(1, &tmapStreamPBO);
+
+  if (tmapCompress) {
+    GLint count = 0;
+
+    // BC5 is part of core GL but BC1 and BC3 need an extension
+    tmapCompressColor = false;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (i = 0; i < count; i++) {
+      if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0) {
+        tmapCompressColor = true;
+      };
+    };
+    if (!tmapCompressColor) {
+      errorlog(0, "No S3TC support, only our normal maps will be compressed");
+    };
+
+    texCacheInit();
+  };
+
+  errorlog(0, "Streaming textures with %i workers", tmapStreamNumWorkers);
+  tmapStreaming = true;
+  return true;
+};
+
+// we're done with a texture, called from our GL thread
+void tmapStreamFinish(tmapStreamJob * pJob) {
+  if (pJob->data != NULL) {
+    stbi_image_free(pJob->data);
+  };
+  texCacheFree(&pJob->image);
+  if (pJob->textureId != 0) {
+    glDeleteTextures(1, &pJob->textureId);
+  };
+  pJob->tmap->streaming = false;
+  tmapRelease(pJob->tmap);
+  free(pJob);
+  tmapStreamPending--;
+};
+
+// stop our workers and free what we haven't loaded yet, this must be called before our GL context is destroyed
+void tmapStopStreaming(void) {
+  tmapStreamJob * job;
+  int             i;
+
+  if (!tmapStreaming) {
+    return;
+  };
+
+  tmapMutexLock(&tmapStreamMutex);
+  tmapStreamQuit = true;
+  tmapCondWakeAll(&tmapStreamCond);
+  tmapMutexUnlock(&tmapStreamMutex);
+
+  for (i = 0; i < tmapStreamNumWorkers; i++) {
+#if defined(WIN32) || defined(_WIN32)
+    WaitForSingleObject(tmapStreamWorkers[i], INFINITE);
+    CloseHandle(tmapStreamWorkers[i]);
+#else
+    pthread_join(tmapStreamWorkers[i], NULL);
+#endif
+  };
+  tmapStreamNumWorkers = 0;
+
+  // our workers are gone so we can clean up without worry
+  while (tmapStreamDecodeFirst != NULL) {
+    job = tmapStreamDecodeFirst;
+    tmapStreamDecodeFirst = job->next;
+    tmapStreamFinish(job);
+  };
+  tmapStreamDecodeLast = NULL;
+
+  job = tmapStreamTakeDecoded();
+  while (job != NULL) {
+    tmapStreamJob * next = job->next;
+    tmapStreamFinish(job);
+    job = next;
+  };
+
+  while (tmapStreamUploadFirst != NULL) {
+    job = tmapStreamUploadFirst;
+    tmapStreamUploadFirst = job->next;
+    tmapStreamFinish(job);
+  };
+  tmapStreamUploadLast = NULL;
+
+  glDeleteBuffers(1, &tmapStreamPBO);
+  tmapStreamPBO = 0;
+
+  tmapCondFree(&tmapStreamCond);
+  tmapMutexFree(&tmapStreamMutex);
+  tmapStreaming = false;
+};
+
+// queue a texture to be decoded by our workers
+void tmapStreamQueue(texturemap * pTMap, const char * pFileName, bool pNormalMap) {
+  tmapStreamJob * job;
+
+  // our worker prefixes our texture path, reject names that won't fit before we queue anything
+  if (strlen(tmapTexturePath) + strlen(pFileName) >= sizeof(tmapTexturePath)) {
+    errorlog(-1, "File name too long to stream %s", pFileName);
+    return;
+  };
+
+  job = (tmapStreamJob *) malloc(sizeof(tmapStreamJob));
+  if (job == NULL) {
+    errorlog(1, "Couldn't allocate memory for streaming %s", pFileName);
+    return;
+  };
+
+  tmapRetain(pTMap);
+  pTMap->streaming = true;
+  job->next = NULL;
+  job->tmap = pTMap;
+  snprintf(job->fileName, sizeof(job->fileName), "%s", pFileName);
+  job->normalMap = pNormalMap;
+  job->data = NULL;
+  job->width = 0;
+  job->height = 0;
+  memset(&job->image, 0, sizeof(texCacheImage));
+  job->loadTime = 0.0;
+  job->uploaded = 0;
+  job->textureId = 0;
+  tmapStreamPending++;
+
+  tmapMutexLock(&tmapStreamMutex);
+  if (tmapStreamDecodeLast == NULL) {
+    tmapStreamDecodeFirst = job;
+  } else {
+    tmapStreamDecodeLast->next = job;
+  };
+  tmapStreamDecodeLast = job;
+  tmapCondWakeAll(&tmapStreamCond);
+  tmapMutexUnlock(&tmapStreamMutex);
+};
+
+// copy pSize bytes into our PBO, we orphan our previous buffer so we don't wait for the GPU to finish with it
+// returns what we need to pass to GL, if we couldn't map our buffer we unbind it and let GL copy pData itself
+const GLvoid * tmapStreamStage(const unsigned char * pData, unsigned int pSize) {
+  void * buffer;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tmapStreamPBO);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, pSize, NULL, GL_STREAM_DRAW);
+  buffer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (buffer == NULL) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return pData;
+  };
+
+  memcpy(buffer, pData, pSize);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  return (const GLvoid *) 0;
+};
+
+// upload the next rows of our RGBA image into our bound texture, we always upload at least one row
+// returns the number of bytes we've uploaded
+unsigned int tmapStreamUploadRows(tmapStreamJob * pJob, unsigned int pBudget) {
+  unsigned int  rowSize = pJob->width * 4;
+  int           rows = pBudget / rowSize;
+
+  if (rows < 1) {
+    rows = 1;
+  };
+  if (rows > pJob->height - pJob->uploaded) {
+    rows = pJob->height - pJob->uploaded;
+  };
+
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, pJob->uploaded, pJob->width, rows, GL_RGBA, GL_UNSIGNED_BYTE, tmapStreamStage(pJob->data + (pJob->uploaded * rowSize), rows * rowSize));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  pJob->uploaded += rows;
+  return rows * rowSize;
+};
+
+// upload the next levels of our compressed image into our bound texture, we always upload at least one level
+// returns the number of bytes we've uploaded
+unsigned int tmapStreamUploadLevels(tmapStreamJob * pJob, unsigned int pBudget) {
+  unsigned int  total = 0;
+  int           levels = pJob->tmap->mipmap ? pJob->image.levels : 1;
+
+  while ((pJob->uploaded < levels) && ((total == 0) || (total < pBudget))) {
+    int           level = pJob->uploaded;
+    int           width = pJob->image.width >> level;
+    int           height = pJob->image.height >> level;
+    unsigned int  size = pJob->image.offsets[level + 1] - pJob->image.offsets[level];
+
+    width = width > 0 ? width : 1;
+    height = height > 0 ? height : 1;
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, pJob->image.format, width, height, 0, size, tmapStreamStage(pJob->image.data + pJob->image.offsets[level], size));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    pJob->uploaded++;
+    total += size;
+  };
+
+  return total;
+};
+
+// upload up to pBudget bytes of the images our workers have decoded, call this once per frame from our GL thread
+// returns the number of textures that are not yet resident
+unsigned int tmapStreamUpdate(unsigned int pBudget) {
+  tmapStreamJob * decoded;
+  tmapStreamJob * reversed = NULL;
+
+  if (!tmapStreaming) {
+    return 0;
+  };
+
+  if (pBudget == 0) {
+    pBudget = tmapStreamBudget;
+  };
+
+  // take what our workers have decoded, our stack is in reverse order
+  decoded = tmapStreamTakeDecoded();
+  while (decoded != NULL) {
+    tmapStreamJob * next = decoded->next;
+    decoded->next = reversed;
+    reversed = decoded;
+    decoded = next;
+  };
+  if (reversed != NULL) {
+    if (tmapStreamUploadLast == NULL) {
+      tmapStreamUploadFirst = reversed;
+    } else {
+      tmapStreamUploadLast->next = reversed;
+    };
+    tmapStreamUploadLast = reversed;
+    while (tmapStreamUploadLast->next != NULL) {
+      tmapStreamUploadLast = tmapStreamUploadLast->next;
+    };
+  };
+
+  if (tmapStreamUploadFirst != NULL) {
+    // other code (like our font renderer) may have changed how we unpack our pixels
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+  };
+
+  while ((tmapStreamUploadFirst != NULL) && (pBudget > 0)) {
+    tmapStreamJob * job = tmapStreamUploadFirst;
+    texturemap *    tmap = job->tmap;
+    GLuint          placeholder;
+
+    if ((job->data == NULL) && (job->image.data == NULL)) {
+      errorlog(-1, "Couldn't load %s", job->fileName);
+    } else {
+      unsigned int  uploaded;
+
+      glActiveTexture(GL_TEXTURE0);
+      if (job->textureId == 0) {
+        // allocate our texture, our placeholder remains in use until we're done
+        glGenTextures(1, &job->textureId);
+        glBindTexture(GL_TEXTURE_2D, job->textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, tmap->filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, tmap->mipmap ? GL_LINEAR : tmap->filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, tmap->wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, tmap->wrap);
+        if (job->image.data == NULL) {
+          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, job->width, job->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        } else if (!tmap->mipmap) {
+          // we only upload our first level
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        };
+      } else {
+        glBindTexture(GL_TEXTURE_2D, job->textureId);
+      };
+
+      if (job->image.data != NULL) {
+        uploaded = tmapStreamUploadLevels(job, pBudget);
+      } else {
+        uploaded = tmapStreamUploadRows(job, pBudget);
+      };
+      pBudget = uploaded < pBudget ? pBudget - uploaded : 0;
+
+      if (job->image.data != NULL) {
+        if (job->uploaded < (tmap->mipmap ? job->image.levels : 1)) {
+          // continue next frame
+          break;
+        };
+
+        if (job->image.cooked) {
+          errorlog(0, "Cooked %s to %s, %i levels, %u KB in %0.3f ms", job->fileName, texCacheFormatName(job->image.format), job->image.levels, job->image.offsets[job->image.levels] / 1024, job->loadTime);
+        } else {
+          errorlog(0, "Loaded %s as %s from cache in %0.3f ms", job->fileName, texCacheFormatName(job->image.format), job->loadTime);
+        };
+
+        tmap->width = job->image.width;
+        tmap->height = job->image.height;
+      } else {
+        if (job->uploaded < job->height) {
+          // continue next frame
+          break;
+        };
+
+        if (tmap->mipmap) {
+          glGenerateMipmap(GL_TEXTURE_2D);
+        };
+
+        tmap->width = job->width;
+        tmap->height = job->height;
+      };
+
+      // our texture is now resident, swap it with our placeholder which we free in tmapStreamFinish
+      placeholder = tmap->textureId;
+      tmap->textureId = job->textureId;
+      job->textureId = placeholder;
+    };
+
+    tmapStreamUploadFirst = job->next;
+    if (tmapStreamUploadFirst == NULL) {
+      tmapStreamUploadLast = NULL;
+    };
+    tmapStreamFinish(job);
+  };
+
+  return tmapStreamPending;
+};
+
+// wait until all our textures are resident, use this when we need all our textures before we render
+void tmapStreamFlush(void) {
+  double  start = benchGetTime();
+  bool    waited = tmapStreamPending > 0;
+
+  while (tmapStreamUpdate(0xFFFFFFFF) > 0) {
+    if (tmapStreamUploadFirst == NULL) {
+      // wait for our workers
+      tmapSleep();
+    };
+  };
+
+  if (waited) {
+    errorlog(0, "Waited %0.3f ms for our textures to stream in", benchGetTime() - start);
+  };
+};
+
+// Finds if we have already loaded our texture map, if not we create it with a 1x1 placeholder and stream it in
+// if we're not streaming we simply load it
+// Note that the calling method should retain the object!!
+texturemap * getStreamedTextureMap(const char * pFileName, GLint pFilter, GLint pWrap, int pPlaceholder) {
+  static const unsigned char placeholders[][4] = {
+    { 128, 128, 128, 255 },   // TMAP_PLACEHOLDER_GRAY
+    { 255, 255, 255, 255 },   // TMAP_PLACEHOLDER_WHITE
+    {   0,   0,   0, 255 },   // TMAP_PLACEHOLDER_BLACK
+    { 128, 128, 255, 255 },   // TMAP_PLACEHOLDER_NORMAL
+  };
+  texturemap * newTMap = NULL;
+
+  if (!tmapStreaming) {
+    return getTextureMapByFileName(pFileName, pFilter, pWrap, false);
+  };
+
+  if (tmapTextureCache == NULL) {
+    // create a new linked list for our cache
+    tmapTextureCache = newTMapList();
+  } else {
+    // first search our node to see if we already have our object
+    llistNode * node = tmapTextureCache->first;
+    while (node != NULL) {
+      texturemap * tmap = (texturemap *) node->data;
+      if ((strcmp(tmap->name,pFileName) == 0) && (tmap->filter == pFilter) && (tmap->wrap == pWrap)) {
+        // already loaded (or loading) :)
+        return tmap;
+      };
+      node = node->next;
+    };
+  };
+
+  if ((pPlaceholder < 0) || (pPlaceholder > TMAP_PLACEHOLDER_NORMAL)) {
+    pPlaceholder = TMAP_PLACEHOLDER_GRAY;
+  };
+
+  newTMap = newTextureMap(pFileName);
+  if (newTMap != NULL) {
+    tmapLoadData(newTMap, placeholders[pPlaceholder], 1, 1, pFilter, pWrap, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+    tmapStreamQueue(newTMap, pFileName, pPlaceholder == TMAP_PLACEHOLDER_NORMAL);
+
+    // add to our linked list, it is retained there
+    llistAddTo(tmapTextureCache, newTMap);
+    tmapRelease(newTMap);
+  };
+
+  return newTMap;
+};
+
 #endif /* TEXTURE_IMPLEMENTATION */
 
 #endif /* !texturemaph */
@@ -31,7 +31,7 @@ extern "C" {
 typedef struct tileshader {
   GLuint          vao;
   GLuint          program;
-  GLint           mvpId;
+  GLint           objectBlockId;
   GLint           mapdataId;
   GLint           mapSizeId;
   texturemap *    mapData;
@@ -72,9 +72,9 @@ void tsLoadShader(tileshader* pTS) {
     if (pTS->program == NO_SHADER) {
       errorlog(-1, "Unable to init tile shader");
     } else {
-      pTS->mvpId = glGetUniformLocation(pTS->program, "mvp");
-      if (pTS->mvpId < 0) {
-        errorlog(pTS->mvpId, "Unknown uniform mvp");
+      pTS->objectBlockId = shaderBindBlock(pTS->program, "objectData", SHADER_OBJECTBLOCK);
+      if (pTS->objectBlockId < 0) {
+        errorlog(pTS->objectBlockId, "Unknown uniform block objectData");
       };
       pTS->mapdataId = glGetUniformLocation(pTS->program, "mapdata");
       if (pTS->mapdataId < 0) {
@@ -121,7 +121,7 @@ tileshader * newTileShader(void) {
   if (newts != NULL) {
     glGenVertexArrays(1, &newts->vao);
     newts->program          = NO_SHADER;
-    newts->mvpId            = -1;
+    newts->objectBlockId    = -1;
     newts->mapdataId        = -1;
     newts->mapSizeId        = -1;
     newts->mapData          = NULL;
@@ -209,9 +209,8 @@ void tsRender(tileshader* pTS, shaderMatrices * pMatrices) {
     // and lastly scale our x and y as they are unified
 //    mat4Scale(&mvp, vec3Set(&tmpvector, pTS->mapScale, pTS->mapScale, 1.0));
 
-    if (pTS->mvpId >= 0) {
-      // glUniformMatrix4fv(pTS->mvpId, 1, false, (const GLfloat *) mvp.m);      
-      glUniformMatrix4fv(pTS->mvpId, 1, false, (const GLfloat *) shdMatGetMvp(pMatrices)->m);      
+    if (pTS->objectBlockId >= 0) {
+      shdMatBindObject(pMatrices);
     };
     
     // now tell it which textures to use and some more info about it
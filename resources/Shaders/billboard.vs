@@ -4,9 +4,9 @@ layout (location=0) in vec3 positions;
 layout (location=1) in vec3 normals;
 layout (location=2) in vec2 texcoords;
 
-uniform mat4      projection;     // our projection matrix
-uniform mat4      modelView;      // our model-view matrix
-uniform mat3      normalView;     // our normalView matrix
+#include "frame.inc"
+#include "object.inc"
+#include "stereo.inc"
 
 // these are in view
 out vec4          V;              // position of fragment after modelView matrix was applied
@@ -37,7 +37,11 @@ void main(void) {
   adjNormalView[2][2] = 1.0;
   
   // our on screen position by applying our model-view-projection matrix
+#ifdef stereo
+  gl_Position = eyeProject(adjModelView * V, gl_InstanceID % 2);
+#else
   gl_Position = projection * adjModelView * V;
+#endif
   
   // V after our model-view matrix is applied
   V = adjModelView * V;
@@ -0,0 +1,107 @@
+#version 330
+
+#include "inputs.fs"
+
+#include "light.inc"
+#include "cluster.inc"
+
+#include "shadowmap.fs"
+#include "barrel.inc"
+
+in vec2 V;
+out vec4 fragcolor;
+
+// get the shadow factor for a light, we can only index our shadow cube maps with a constant
+float clusterShadow(int pSlot, vec3 pD, vec2 pDepth) {
+  if (pSlot == 0) {
+    return sampleCube(shadowCubes[0], pD, pDepth);
+  } else if (pSlot == 1) {
+    return sampleCube(shadowCubes[1], pD, pDepth);
+  } else if (pSlot == 2) {
+    return sampleCube(shadowCubes[2], pD, pDepth);
+  } else if (pSlot == 3) {
+    return sampleCube(shadowCubes[3], pD, pDepth);
+  } else {
+    return 1.0;
+  };
+}
+
+void main() {
+  // get our values...
+#ifdef barreldist
+  vec2 Te = barreldist(screenToEye(V), 1);
+  if ((Te.x < 0.0) || (Te.x > 1.0) || (Te.y < 0.0) || (Te.y > 1.0)) {
+    discard;
+  };
+#else
+  vec2 Te = (screenToEye(V) + 1.0) / 2.0;
+#endif
+  vec2 T = eyeToBuffer(Te, V);
+  if (texture(ambient, T).a < 0.1) {
+    // if no alpha is set, there is nothing here!
+    discard;
+  };
+
+  vec4 V = readPos(T);
+
+  // find our cluster, in stereo our clusters cover both eyes
+  ivec2 tile = min(ivec2(Te * vec2(CLUSTER_TILESX, CLUSTER_TILESY)), ivec2(CLUSTER_TILESX - 1, CLUSTER_TILESY - 1));
+  int slice = int(floor((log(-V.z) * sliceScale) + sliceBias));
+  if ((slice < 0) || (slice >= CLUSTER_SLICES)) {
+    discard;
+  };
+  uvec2 cluster = texelFetch(clusterGrid, (((slice * CLUSTER_TILESY) + tile.y) * CLUSTER_TILESX) + tile.x).xy;
+  if (cluster.y == 0u) {
+    // no lights touch this cluster
+    discard;
+  };
+
+  vec3 difColor = texture(diffuse, T).rgb;
+  vec4 specColor = texture(specular, T);
+  vec3 N = readNormal(T);
+  vec3 E = normalize(V.xyz);
+  vec3 W = (invView * V).xyz;
+  float shininess = specColor.a * 256.0;
+  vec3 color = vec3(0.0, 0.0, 0.0);
+
+  for (uint i = 0u; i < cluster.y; i++) {
+    int l = int(texelFetch(clusterIndices, int(cluster.x + i)).r);
+
+    // Get the normalized directional vector between our surface position and our light position
+    vec3  LmV = lights[l].lightPos - V.xyz;
+    float Dist = length(LmV);
+    if (Dist > lights[l].radius) {
+      // we're too far away from the light for it to effect us
+      continue;
+    };
+
+    // we use our cube shadow logic
+    float shadowFactor = clusterShadow(lights[l].shadowSlot, W - lights[l].shadowPos, lights[l].shadowDepth);
+
+    // get our light vector
+    vec3  L = normalize(LmV);
+    float NdotL = max(0.0, dot(N, L));
+    vec3  lightColor = difColor * NdotL * lights[l].lightCol * shadowFactor;
+
+    if ((NdotL != 0.0) && (shininess != 0.0)) {
+      // slightly different way to calculate our specular highlight
+      vec3  halfVector  = normalize(L - E);
+      float nxHalf = max(0.0, dot(N, halfVector));
+      float specPower = pow(nxHalf, shininess);
+
+      lightColor += lights[l].lightCol * specColor.rgb * specPower * shadowFactor;
+    };
+
+    // now calculate our attenuation
+    float attenuation = lights[l].attConstant + (lights[l].attLinear * Dist) + (lights[l].attExp * Dist * Dist);
+
+    // and add our light
+    if (attenuation < 1.0) {
+      color += lightColor;
+    } else {
+      color += lightColor / attenuation;
+    };
+  };
+
+  fragcolor = vec4(color, 1.0);
+}
\ No newline at end of file
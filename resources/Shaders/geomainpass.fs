@@ -2,9 +2,7 @@
 
 #include "inputs.fs"
 
-// info about our light
-uniform vec3      lightPos;                         // position of our light after view matrix was applied
-uniform vec3      lightCol;                         // color of the light of our sun
+#include "light.inc"
 
 #include "shadowmap.fs"
 #include "barrel.inc"
@@ -15,22 +13,23 @@ out vec4 fragcolor;
 void main() {
   // get our values...
 #ifdef barreldist
-  vec2 T = barreldist(V, 1);
+  vec2 Te = barreldist(screenToEye(V), 1);
 #else
-  vec2 T = (V + 1.0) / 2.0;
+  vec2 Te = (screenToEye(V) + 1.0) / 2.0;
 #endif
+  vec2 T = eyeToBuffer(Te, V);
   vec4 ambColor = texture(ambient, T);  
   if (ambColor.a < 0.1) {
     // if no alpha is set, there is nothing here!
     fragcolor = vec4(0.0, 0.0, 0.0, 1.0);
 #ifdef barreldist
-  } else if ((T.x < 0.0) || (T.x > 1.0) || (T.y < 0.0) || (T.y > 1.0)) {
+  } else if ((Te.x < 0.0) || (Te.x > 1.0) || (Te.y < 0.0) || (Te.y > 1.0)) {
     fragcolor = vec4(0.0, 0.0, 0.0, 1.0);
 #endif
   } else {
-    vec4 V = vec4((texture(worldPos, T).xyz - 0.5) * posScale, 1.0);
+    vec4 V = readPos(T);
     vec3 difColor = texture(diffuse, T).rgb;
-    vec3 N = (texture(normal, T).xyz - 0.5) * 2.0;
+    vec3 N = readNormal(T);
     vec4 specColor = texture(specular, T);
 
     // calculate our shadow factor
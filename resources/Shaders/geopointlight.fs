@@ -2,13 +2,7 @@
 
 #include "inputs.fs"
 
-// info about our light
-uniform vec3      lightPos;                         // position of our light after view matrix was applied
-uniform vec3      lightCol;                         // color of the light of our sun
-uniform float     radius = 100.0;                   // maximum distance to light at which we still illuminate things
-uniform float     attConstant = 0.0;
-uniform float     attLinear = 0.0;
-uniform float     attExp = 0.0;
+#include "light.inc"
 
 #include "shadowmap.fs"
 #include "barrel.inc"
@@ -21,21 +15,22 @@ out vec4 fragcolor;
 void main() {
   // get our values...
 #ifdef barreldist
-  vec2 T = barreldist(V, 1);
-  if ((T.x < 0.0) || (T.x > 1.0) || (T.y < 0.0) || (T.y > 1.0)) {
+  vec2 Te = barreldist(screenToEye(V), 1);
+  if ((Te.x < 0.0) || (Te.x > 1.0) || (Te.y < 0.0) || (Te.y > 1.0)) {
     discard;
   } else {
 #else
-  vec2 T = (V + 1.0) / 2.0;
+  vec2 Te = (screenToEye(V) + 1.0) / 2.0;
 #endif
+    vec2 T = eyeToBuffer(Te, V);
 
-    vec4 V = vec4((texture(worldPos, T).xyz - 0.5) * posScale, 1.0);
+    vec4 V = readPos(T);
     vec3 difColor = texture(diffuse, T).rgb;
     vec4 specColor = texture(specular, T);
-    vec3 N = (texture(normal, T).xyz - 0.5) * 2.0;
+    vec3 N = readNormal(T);
 
-    // we use our box shadow logic
-    float shadowFactor = boxShadow(V);
+    // we use our cube shadow logic
+    float shadowFactor = cubeShadow(V);
 
     // Get the normalized directional vector between our surface position and our light position
     vec3  LmV = lightPos - V.xyz;
@@ -4,11 +4,11 @@
 
 #define PI 3.1415926535897932384626433832795
 
-uniform float   radius = 100.0;       // maximum distance to light at which we still illuminate things
-uniform mat4    projection;
-uniform vec3    lightPos;
+#include "frame.inc"
+#include "light.inc"
 
 #include "barrel.inc"
+#include "stereo.inc"
 
 out vec2 V;
 out float R;
@@ -29,19 +29,32 @@ void main() {
   //      9   ---  7
   //           8
 
+#ifdef stereo
+  // we draw our light once for each eye
+  int eye = gl_InstanceID;
+  mat4 P = eyeProjection[eye];
+#else
+  mat4 P = projection;
+#endif
+
   if (gl_VertexID == 0) {
-    vec4 Vproj = projection * vec4(lightPos, 1.0);
+    vec4 Vproj = P * vec4(lightPos, 1.0);
     V = Vproj.xy / Vproj.w;
     R = radius;
   } else {
     float ang = (gl_VertexID - 1) * 10;
     ang = ang * PI / 180.0;
-    vec4 Vproj = projection * vec4(lightPos.x - (radius * cos(ang)), lightPos.y + (radius * sin(ang)), lightPos.z, 1.0);
+    vec4 Vproj = P * vec4(lightPos.x - (radius * cos(ang)), lightPos.y + (radius * sin(ang)), lightPos.z, 1.0);
     V = Vproj.xy / Vproj.w;
     R = 0.0;
   };
 #ifdef barreldist
   V = barreldist(V, 0);
 #endif
+#ifdef stereo
+  gl_Position = eyeClip(vec4(V, 0.0, 1.0), eye);
+  V = gl_Position.xy;
+#else
   gl_Position = vec4(V, 0.0, 1.0);
+#endif
 }
@@ -1,19 +1,34 @@
+// our heightmap shader - chunked LOD version
+
+// We render each chunk of our terrain (see terrain.h) with the same grid, our model matrix scales it to the size of our chunk
+// and we look up our heights here. Vertices morph into the grid of our parent chunk as they approach the distance at which
+// our parent takes over so switching levels doesn't pop.
+
 #version 330
 
-layout (location=0) in vec3 positions;
+layout (location=0) in vec3 positions;  // our grid covers 0.0 to 1.0, y is -1.0 for our skirt
+
+#include "frame.inc"
+#include "stereo.inc"
+#ifdef instanced
+layout (location=3) in mat4 instanceModel; // model matrix for this instance (uses locations 3 to 6)
+#else
+#include "object.inc"
+#endif
 
-uniform vec3 eyePos;        // our eye position
-uniform mat4 projection;    // our projection matrix
-uniform mat4 view;          // our view matrix
 uniform sampler2D bumpMap;  // our height map
 
 uniform float mapscale = 50000.0; // our map scale
 uniform float mapheight = 1000.0; // our map height
-uniform float tilescale = 2000.0; // our tile scale
+uniform float gridsize = 32.0; // number of quads along the edge of our chunk
+uniform float terrainsize = 204800.0; // size of our root chunk
+uniform vec3 lodInfo[8]; // morph start, morph end and skirt depth for each level, this must match TERRAIN_MAXLEVELS
 
+#ifndef shadow
 out vec4 V;
 out vec3 N;
 out vec2 T;
+#endif
 
 float getHeight(vec2 pos) {
   vec4 col = texture(bumpMap, pos / mapscale);
@@ -21,6 +36,7 @@ float getHeight(vec2 pos) {
   return col.r * mapheight;
 }
 
+#ifndef shadow
 vec3 calcNormal(vec2 pos) {
   vec3 cN;
 
@@ -30,33 +46,56 @@ vec3 calcNormal(vec2 pos) {
 
   return normalize(cN);
 }
+#endif
 
 void main(void) {
-  // get our position, we're ignoring our normal and texture coordinates...
-  V = vec4(positions, 1.0);
-
-  // our start scale, note that we may vary this depending on distance of ground to camera
-  float scale = tilescale;
-
-  // and scale it up
-  V.x = (V.x * scale);
-  V.z = (V.z * scale);
-
-  // Use our eyepos defines our center. Use our center size.
-  V.x = V.x + (int(eyePos.x / scale) * scale);
-  V.z = V.z + (int(eyePos.z / scale) * scale);
-
-  // and get our height from our hmap.
-  V.y = getHeight(V.xz);
-
+#ifdef instanced
+  mat4 model = instanceModel;
+#endif
+
+  // find out which level we're rendering from the size of our chunk
+  float size = model[0][0];
+  int level = clamp(int(log2(terrainsize / size) + 0.5), 0, 7);
+  vec3 info = lodInfo[level];
+
+  // get our morph factor from the distance to our unmorphed vertex
+  vec4 W = model * vec4(positions.x, 0.0, positions.z, 1.0);
+  W.y = getHeight(W.xz);
+  float morph = 0.0;
+  if (info.y > info.x) {
+    morph = clamp((distance(W.xyz, eyePos) - info.x) / (info.y - info.x), 0.0, 1.0);
+  }
+
+  // move our odd vertices onto the even vertices our parent shares with us
+  vec2 grid = positions.xz;
+  grid -= fract(grid * gridsize * 0.5) * 2.0 / gridsize * morph;
+
+  // and get our world position
+  W = model * vec4(grid.x, 0.0, grid.y, 1.0);
+  W.y = getHeight(W.xz);
+  if (positions.y < 0.0) {
+    // lower our skirt
+    W.y -= info.z;
+  }
+
+#ifdef shadow
+  // lower our terrain a little so our slopes don't shadow themselves
+  W.y -= 20.0;
+  gl_Position = viewProjection * W;
+#else
   // calculate our normal.
-  N = calcNormal(V.xz);
+  N = calcNormal(W.xz);
   N = (view * vec4(N+eyePos, 1.0)).xyz;
 
   // and use our coordinates as texture coordinates in our fragment shader
-  T = vec2(V.x / 2000.0, V.z / 2000.0);
+  T = vec2(W.x / 2000.0, W.z / 2000.0);
 
   // our on screen position by applying our view and projection matrix
-  V = view * V;
+  V = view * W;
+#ifdef stereo
+  gl_Position = eyeProject(V, gl_InstanceID % 2);
+#else
   gl_Position = projection * V;
-}
\ No newline at end of file
+#endif
+#endif
+}
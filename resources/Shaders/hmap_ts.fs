@@ -4,7 +4,7 @@
 
 #version 410 core
 
-uniform float       ambient=0.3;    // ambient factor 
+#include "material.inc"
 uniform sampler2D   textureMap;     // our texture map
 
 in GS_OUT {
@@ -20,8 +20,7 @@ void main() {
   vec4 fragcolor = texture(textureMap, fs_in.T);
 
   // Do our outputs without any light calculations
-  WorldPosOut = vec4((fs_in.V.xyz / posScale) + 0.5, 1.0); // our world pos adjusted by view scaled so it fits in 0.0 - 1.0 range
-  NormalOut = vec4((fs_in.N / 2.0) + 0.5, 1.0); // our normal adjusted by view
+  writePosNormal(fs_in.V.xyz, fs_in.N);
   AmbientOut = vec4(fragcolor.rgb * ambient, 1.0);
   DiffuseOut = vec4(fragcolor.rgb * (1.0 - ambient), 1.0);
   SpecularOut = vec4(0.0, 0.0, 0.0, 0.0);
@@ -9,12 +9,19 @@
 layout(triangles) in;
 layout(triangle_strip, max_vertices=3) out;
 
+#include "frame.inc"
+#include "stereo.inc"
+
 in TE_OUT {
   vec2 T;
   vec3 N;
   vec4 V;
 } gs_in[];
 
+#ifdef stereo
+in int teEye[];
+#endif
+
 out GS_OUT {
   vec2  T;
   vec3  N;
@@ -24,7 +31,11 @@ out GS_OUT {
 void main() {
   // first emit our ground primitive
   for (int i=0; i<3; i++) {
+#ifdef stereo
+    gl_Position = eyeProject(gs_in[i].V, teEye[i]);
+#else
     gl_Position = gl_in[i].gl_Position;
+#endif
     gs_out.T     = gs_in[i].T;
     gs_out.N     = gs_in[i].N;
     gs_out.V     = gs_in[i].V;
@@ -15,6 +15,10 @@ uniform int maxTessGenLevel = 16;  // maximum tesselation level
 
 // input from our vertex shader, note that this is an array of 4!!
 in vec3 Vp[];
+#ifdef stereo
+in int vsEye[];
+patch out int tcEye;
+#endif
 
 void main(void) {
   if (gl_InvocationID == 0) {
@@ -69,6 +73,10 @@ void main(void) {
     }
   };
   
+#ifdef stereo
+  tcEye = vsEye[0];
+#endif
+
   // just copy our vertices as control points
   gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
 }
\ No newline at end of file
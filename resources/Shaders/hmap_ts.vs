@@ -8,9 +8,7 @@
 
 layout (location=0) in vec3 positions;
 
-uniform vec3 eyePos;        // our eye position
-uniform mat4 projection;    // our projection matrix
-uniform mat4 view;          // our view matrix
+#include "frame.inc"
 uniform sampler2D bumpMap;  // our height map
 uniform float mapscale = 50000.0; // our map scale
 uniform float mapheight = 1000.0; // our map height
@@ -18,6 +16,9 @@ uniform float tilescale = 2000.0; // our tile scale
 
 // we only output our projected V
 out vec3 Vp;
+#ifdef stereo
+out int vsEye;  // the eye we're rendering
+#endif
 
 float getHeight(vec2 pos) {
   vec4 col = texture(bumpMap, pos / mapscale);
@@ -47,6 +48,12 @@ void main(void) {
   V.y = getHeight(V.xz);
 
   // apply our projection, this will help our tesselation shader
+#ifdef stereo
+  // in stereo we use the projection of the eye we're rendering and pass on which eye that is
+  vsEye = gl_InstanceID % 2;
+  V = eyeProjection[vsEye] * view * V;
+#else
   V = projection * view * V;
+#endif
   Vp = V.xyz / V.w; // and go to screen coordinates
 }
\ No newline at end of file
@@ -1,7 +1,66 @@
+#include "frame.inc"
+
+#ifdef thingbuffer
+uniform sampler2D depthMap;
+#else
 uniform sampler2D worldPos;
+#endif
 uniform sampler2D normal;
 uniform sampler2D ambient;
 uniform sampler2D diffuse;
 uniform sampler2D specular;
 
 uniform float posScale = 10000.0;
+
+// decode a normal we've encoded with octEncode
+vec3 octDecode(vec2 pE) {
+  vec2 E = (pE * 2.0) - 1.0;
+  vec3 N = vec3(E, 1.0 - abs(E.x) - abs(E.y));
+  if (N.z < 0.0) {
+    N.xy = (1.0 - abs(N.yx)) * vec2(N.x >= 0.0 ? 1.0 : -1.0, N.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(N);
+}
+
+// get the projection matrix we rendered the pixel at pT with and the screen coordinate of that pixel for that projection,
+// in stereo each eye has its own projection and covers its own half of our buffer
+#ifdef stereo
+mat4 projectionAt(vec2 pT) {
+  return eyeProjection[pT.x < 0.5 ? 0 : 1];
+}
+
+vec2 screenAt(vec2 pT) {
+  return vec2((pT.x * 4.0) - (pT.x < 0.5 ? 1.0 : 3.0), (pT.y * 2.0) - 1.0);
+}
+#else
+mat4 projectionAt(vec2 pT) {
+  return projection;
+}
+
+vec2 screenAt(vec2 pT) {
+  return (pT * 2.0) - 1.0;
+}
+#endif
+
+// get our position (with our view applied) at pT
+// our thin gBuffer reconstructs it from our depth and our projection matrix
+vec4 readPos(vec2 pT) {
+#ifdef thingbuffer
+  mat4 P = projectionAt(pT);
+  float Z = (texture(depthMap, pT).r * 2.0) - 1.0;
+  vec2 XY = screenAt(pT);
+  float z = -P[3][2] / (Z + P[2][2]);
+  return vec4(((-z * (XY + vec2(P[2][0], P[2][1]))) - vec2(P[3][0], P[3][1])) / vec2(P[0][0], P[1][1]), z, 1.0);
+#else
+  return vec4((texture(worldPos, pT).xyz - 0.5) * posScale, 1.0);
+#endif
+}
+
+// get our normal (with our view applied) at pT
+vec3 readNormal(vec2 pT) {
+#ifdef thingbuffer
+  return octDecode(texture(normal, pT).rg);
+#else
+  return (texture(normal, pT).xyz - 0.5) * 2.0;
+#endif
+}
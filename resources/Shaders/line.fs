@@ -1,6 +1,6 @@
 #version 330
 
-uniform vec3      matColor;
+#include "material.inc"
 
 in float          alp;
 out vec4          fragcolor;
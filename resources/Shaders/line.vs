@@ -1,7 +1,7 @@
 #version 330
 
 layout (location=0) in vec3 positions;
-uniform mat4 mvp;
+#include "object.inc"
 
 out float alp;
 
@@ -1,7 +1,32 @@
+#ifdef thingbuffer
+layout (location = 0) out vec2 NormalOut; 
+layout (location = 1) out vec4 AmbientOut; 
+layout (location = 2) out vec4 DiffuseOut; 
+layout (location = 3) out vec4 SpecularOut; 
+#else
 layout (location = 0) out vec4 WorldPosOut; 
 layout (location = 1) out vec4 NormalOut; 
 layout (location = 2) out vec4 AmbientOut; 
 layout (location = 3) out vec4 DiffuseOut; 
 layout (location = 4) out vec4 SpecularOut; 
+#endif
 
 uniform float posScale = 10000.0;
+
+// encode our normal onto an octahedron folded into a square so it fits in two channels
+vec2 octEncode(vec3 pN) {
+  vec3 N = pN / (abs(pN.x) + abs(pN.y) + abs(pN.z));
+  vec2 E = N.z >= 0.0 ? N.xy : (1.0 - abs(N.yx)) * vec2(N.x >= 0.0 ? 1.0 : -1.0, N.y >= 0.0 ? 1.0 : -1.0);
+  return (E * 0.5) + 0.5;
+}
+
+// output our position and normal (both with our view applied)
+// our thin gBuffer doesn't store our position, it's reconstructed from our depth buffer
+void writePosNormal(vec3 pV, vec3 pN) {
+#ifdef thingbuffer
+  NormalOut = octEncode(normalize(pN));
+#else
+  WorldPosOut = vec4((pV / posScale) + 0.5, 1.0); // our world pos adjusted by view scaled so it fits in 0.0 - 1.0 range
+  NormalOut = vec4((pN / 2.0) + 0.5, 1.0); // our normal adjusted by view
+#endif
+}
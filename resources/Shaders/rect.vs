@@ -1,6 +1,6 @@
 #version 330
 
-uniform mat4      mvp;            // our model-view-projection matrix
+#include "object.inc"
 out vec2 T;
 
 void main(void) {
@@ -0,0 +1,81 @@
+#version 330
+
+// Our layered shadow shader, we render each triangle into each face of our shadow cube map it is visible in.
+// Our view matrix moves our light to the origin and our projection matrix is the projection of a single face,
+// we rotate our triangle towards each face in turn.
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices=18) out;
+
+#include "frame.inc"
+
+in vec2           vT[];           // coordinates for each vertex within our texture map
+out vec2          T;              // coordinates for this fragment within our texture map
+
+// the direction and up vector of each face of our cube map, in the order OpenGL lays out its faces (+X, -X, +Y, -Y, +Z, -Z)
+const vec3 faceDir[6] = vec3[](
+  vec3( 1.0,  0.0,  0.0),
+  vec3(-1.0,  0.0,  0.0),
+  vec3( 0.0,  1.0,  0.0),
+  vec3( 0.0, -1.0,  0.0),
+  vec3( 0.0,  0.0,  1.0),
+  vec3( 0.0,  0.0, -1.0)
+);
+
+const vec3 faceUp[6] = vec3[](
+  vec3( 0.0, -1.0,  0.0),
+  vec3( 0.0, -1.0,  0.0),
+  vec3( 0.0,  0.0,  1.0),
+  vec3( 0.0,  0.0, -1.0),
+  vec3( 0.0, -1.0,  0.0),
+  vec3( 0.0, -1.0,  0.0)
+);
+
+void main() {
+  vec4 V[3];
+  vec4 P[3];
+
+  for (int i = 0; i < 3; i++) {
+    V[i] = view * gl_in[i].gl_Position;
+  };
+
+  for (int face = 0; face < 6; face++) {
+    // build the lookat matrix for this face
+    vec3 f = faceDir[face];
+    vec3 s = cross(f, faceUp[face]);
+    vec3 u = cross(s, f);
+    mat4 faceProjection = projection * mat4(
+      vec4(s.x, u.x, -f.x, 0.0),
+      vec4(s.y, u.y, -f.y, 0.0),
+      vec4(s.z, u.z, -f.z, 0.0),
+      vec4(0.0, 0.0,  0.0, 1.0)
+    );
+
+    for (int i = 0; i < 3; i++) {
+      P[i] = faceProjection * V[i];
+    };
+
+    // skip this face if our triangle lies entirely outside of one of its planes
+    if ((P[0].x > P[0].w) && (P[1].x > P[1].w) && (P[2].x > P[2].w)) {
+      continue;
+    } else if ((P[0].x < -P[0].w) && (P[1].x < -P[1].w) && (P[2].x < -P[2].w)) {
+      continue;
+    } else if ((P[0].y > P[0].w) && (P[1].y > P[1].w) && (P[2].y > P[2].w)) {
+      continue;
+    } else if ((P[0].y < -P[0].w) && (P[1].y < -P[1].w) && (P[2].y < -P[2].w)) {
+      continue;
+    } else if ((P[0].z > P[0].w) && (P[1].z > P[1].w) && (P[2].z > P[2].w)) {
+      continue;
+    } else if ((P[0].z < -P[0].w) && (P[1].z < -P[1].w) && (P[2].z < -P[2].w)) {
+      continue;
+    };
+
+    for (int i = 0; i < 3; i++) {
+      gl_Layer = face;
+      gl_Position = P[i];
+      T = vT[i];
+      EmitVertex();
+    };
+    EndPrimitive();
+  };
+}
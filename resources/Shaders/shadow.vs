@@ -3,14 +3,40 @@
 layout (location=0) in vec3 positions;
 layout (location=2) in vec2 texcoords;
 
-uniform mat4      mvp;            // our model-view-projection matrix
+// packed meshes store positions relative to their bounds, for other meshes our scale is 1 and our offset is 0
+layout (location=7) in vec3 positionScale;
+layout (location=8) in vec3 positionOffset;
+
+#ifdef instanced
+layout (location=3) in mat4 instanceModel; // model matrix for this instance (uses locations 3 to 6)
+
+#include "frame.inc"
+#else
+#include "object.inc"
+#endif
+
+#ifdef layered
+out vec2          vT;             // coordinates for this vertex within our texture map, our geometry shader passes these on
+#define T vT
+#else
 out vec2          T;              // coordinates for this fragment within our texture map
+#endif
 
 void main(void) {
+#ifdef instanced
+  mat4 model = instanceModel;
+  mat4 mvp = viewProjection * instanceModel;
+#endif
+
   // load up our values
-  vec4 V = vec4(positions, 1.0);
+  vec4 V = vec4(positions * positionScale + positionOffset, 1.0);
   T = texcoords;
-  
+
+#ifdef layered
+  // our geometry shader projects our vertex for each face of our cube map so we only apply our model matrix
+  gl_Position = model * V;
+#else
   // our on screen position by applying our model-view-projection matrix
   gl_Position = mvp * V;
+#endif
 }
@@ -1,7 +1,7 @@
-// functions we include into fragment shaders for our shadow map logic
+// functions we include into fragment shaders for our shadow map logic, our shadow matrices are in light.inc
 
 uniform sampler2D   shadowMap[6];   // our shadow map, hardcoded support for 6 shadow maps, we need to make this setable
-uniform mat4        shadowMat[6];   // our shadows view-projection matrix with inverse of our camera view applied
+uniform samplerCube shadowCube;     // our shadow cube map for point lights
 
 // Precision ring
 //      9 9 9
@@ -84,53 +84,31 @@ float cascadedShadow(vec4 pV) {
   return factor;
 }
 
-// box shadow mapping
-float boxShadow(vec4 pV) {
-  vec4  V;
-  vec3  Proj;
-
-  // need to find a better way to figure out which shadow map to use, we should be able to compare our position to our lights center
-  
-  V = shadowMat[0] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 0, 4);
-  };
-
-  V = shadowMat[1] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    // bring it into the range of 0.0 to 1.0 instead of -1.0 to 1.0
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 1, 4);
-  };
-
-  V = shadowMat[2] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    // bring it into the range of 0.0 to 1.0 instead of -1.0 to 1.0
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 2, 4);
-  };
-
-  V = shadowMat[3] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    // bring it into the range of 0.0 to 1.0 instead of -1.0 to 1.0
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 3, 4);
-  };
-
-  V = shadowMat[4] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    // bring it into the range of 0.0 to 1.0 instead of -1.0 to 1.0
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 4, 4);
+// sample our shadow cube map in direction pD, the direction from our light to what we're lighting
+// pDepth are the depth terms of the projection we used to render our cube map
+float sampleCube(samplerCube pCube, vec3 pD, vec2 pDepth) {
+  float bias = 0.0000005; // our bias
+  float result = 1.0; // our result
+  vec3  A = abs(pD);
+  float ma = max(A.x, max(A.y, A.z));
+
+  // the face our direction falls on is the one for our largest axis, so that gives us the depth we would have
+  // written with the projection used to render our cube map
+  float Z = 0.5 * ((pDepth.y / ma) - pDepth.x) + 0.5;
+
+  // sample around our direction, our offsets scale with our distance so they cover the same area on our face
+  for (int i = 0; i < 4; i++) {
+    vec3 offset = vec3(offsets[i + 1], 0.0005 * float((i & 1) * 2 - 1)) * 2.0 * ma;
+    float Depth = texture(pCube, pD + offset).x;
+    if (Z - bias > Depth) {
+      result -= 0.2;
+    };
   };
 
-  V = shadowMat[5] * pV;
-  Proj = V.xyz / V.w;
-  if ((abs(Proj.x) < 1.00) && (abs(Proj.y) < 1.00) && (abs(Proj.z) < 1.00)) {
-    // bring it into the range of 0.0 to 1.0 instead of -1.0 to 1.0
-    return samplePCF(0.5 * Proj.z + 0.5, vec2(0.5 * Proj.x + 0.5, 0.5 * Proj.y + 0.5), 5, 4);
-  };
+  return result;
+}
 
-  return 0.2;
+// cube shadow mapping for point lights, shadowMat[0] gives us the direction from our light to our position
+float cubeShadow(vec4 pV) {
+  return sampleCube(shadowCube, (shadowMat[0] * pV).xyz, shadowDepth);
 }
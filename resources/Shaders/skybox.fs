@@ -7,8 +7,7 @@ in vec2           T;                                // coordinates for this frag
 #include "outputs.fs"
 
 void main() {
-  WorldPosOut = vec4(0.0, 0.0, 0.0, 1.0); // we don't care
-  NormalOut = vec4(0.0, 0.0, 1.0, 1.0); // we don't care
+  writePosNormal(vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0)); // we don't care
 
   AmbientOut = vec4(texture(textureMap, T).rgb, 1.0);
   DiffuseOut = vec4(0.0, 0.0, 0.0, 0.0);
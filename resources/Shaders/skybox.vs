@@ -3,9 +3,8 @@
 layout (location=0) in vec3	positions;
 layout (location=2) in vec2	texcoords;
 
-uniform vec3      eyePos;         // our eye position
-uniform mat4      view;           // our view matrix
-uniform mat4      projection;     // our projection matrix
+#include "frame.inc"
+#include "stereo.inc"
 
 // these are in view
 out vec2          T;              // coordinates for this fragment within our texture map
@@ -16,5 +15,9 @@ void main(void) {
   T = texcoords;
   
   // our on screen position by applying our model-view-projection matrix
-  gl_Position = projection * view * V;  
+#ifdef stereo
+  gl_Position = eyeProject(view * V, gl_InstanceID % 2);
+#else
+  gl_Position = viewProjection * V;  
+#endif
 }
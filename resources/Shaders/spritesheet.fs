@@ -13,8 +13,7 @@ void main() {
     discard;
   }
 
-  WorldPosOut = vec4((V.xyz / posScale) + 0.5, 1.0);
-  NormalOut = vec4(0.0, 0.0, 1.0, 1.0);
+  writePosNormal(V.xyz, vec3(0.0, 0.0, 1.0));
   AmbientOut = vec4(fragcolor.rgb * 0.2, 1.0);
   DiffuseOut = vec4(fragcolor.rgb * 0.8, 0.0);
   SpecularOut = vec4(0.0, 0.0, 0.0, 0.0);
@@ -1,7 +1,6 @@
 #version 330
 
-uniform mat4 mvp;              // our model-view-projection matrix
-uniform mat4 modelView;				 // our model-view matrix
+#include "object.inc"
 uniform vec2 textureSize;      // size of our texture in pixels
 uniform vec2 spriteLeftTop;    // top/left position of our sprite in our texture
 uniform vec2 spriteSize;       // size of our sprite within our texture in pixels
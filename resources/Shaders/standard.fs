@@ -1,15 +1,9 @@
 #version 330
 
-// info about our material
-uniform float     alpha = 1.0;                      // alpha for our material
-uniform float     ambient = 0.3;                    // ambient factor
+#include "material.inc"
 #ifdef textured
 uniform sampler2D textureMap;                       // our texture map
-#else
-uniform vec3      matColor = vec3(0.8, 0.8, 0.8);   // color of our material
 #endif
-uniform vec3      matSpecColor = vec3(1.0, 1.0, 1.0); // specular color of our material
-uniform float		  shininess = 100.0;                // shininess
 
 #ifdef reflect
 uniform sampler2D reflectMap;                       // our reflection map
@@ -32,6 +26,18 @@ in vec3           Binormal;                         // binormal
 
 #include "outputs.fs"
 
+#ifdef compressednormals
+// our normal maps are stored as BC5 which only holds x and y, z is always positive
+vec3 decodeNormal(vec4 pColor) {
+  vec2 xy = (pColor.rg * 2.0) - 1.0;
+  return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+#else
+vec3 decodeNormal(vec4 pColor) {
+  return normalize((pColor.rgb * 2.0) - 1.0);
+}
+#endif
+
 void main() {
 #ifdef textured
   // start by getting our color from our texture
@@ -46,18 +52,16 @@ void main() {
 #endif
   
   // Do our outputs without any light calculations
-  WorldPosOut = vec4((V.xyz / posScale) + 0.5, 1.0); // our world pos adjusted by view scaled so it fits in 0.0 - 1.0 range
-
 #ifdef normalmap
   // TangentToView matrix idea taken from http://gamedev.stackexchange.com/questions/34475/deferred-rendering-and-normal-mapping
   mat3 tangentToView = mat3(Tangent.x, Binormal.x, Nv.x,
                             Tangent.y, Binormal.y, Nv.y,
                             Tangent.z, Binormal.z, Nv.z);
-  vec3 adjNormal = normalize((texture(bumpMap, T).rgb * 2.0) - 1.0);
+  vec3 adjNormal = decodeNormal(texture(bumpMap, T));
   adjNormal = adjNormal * tangentToView;
-  NormalOut = vec4((adjNormal / 2.0) + 0.5, 1.0); // our normal adjusted by view
+  writePosNormal(V.xyz, adjNormal);
 #else
-  NormalOut = vec4((Nv / 2.0) + 0.5, 1.0); // our normal adjusted by view
+  writePosNormal(V.xyz, Nv);
 #endif
 
 #ifdef reflect
@@ -4,12 +4,17 @@ layout (location=0) in vec3	positions;
 layout (location=1) in vec3	normals;
 layout (location=2) in vec2	texcoords;
 
-uniform vec3      eyePos;         // position of our eye
-uniform mat4      model;          // our model matrix
-uniform mat4      modelView;      // our model-view matrix
-uniform mat3      normalMatrix;   // our normal matrix
-uniform mat3      normalView;     // our normalView matrix
-uniform mat4      mvp;            // our model-view-projection matrix
+// packed meshes store positions relative to their bounds, for other meshes our scale is 1 and our offset is 0
+layout (location=7) in vec3	positionScale;
+layout (location=8) in vec3	positionOffset;
+
+#include "frame.inc"
+#include "stereo.inc"
+#ifdef instanced
+layout (location=3) in mat4 instanceModel; // model matrix for this instance (uses locations 3 to 6)
+#else
+#include "object.inc"
+#endif
 
 // these are in world coordinates
 out vec3          E;              // normalized vector pointing from eye to V
@@ -26,13 +31,26 @@ out vec3          Binormal;       // binormal
 #endif
 
 void main(void) {
+#ifdef instanced
+  // calculate the matrices we otherwise get from our object block (see shdMatGetNormal and shdMatGetNormalView)
+  mat4 model = instanceModel;
+  mat4 modelView = view * model;
+  mat3 normalMatrix = mat3(modelView);
+  mat3 normalView = normalMatrix;
+  mat4 mvp = projection * modelView;
+#endif
+
   // load up our values
-  V = vec4(positions, 1.0);
+  V = vec4(positions * positionScale + positionOffset, 1.0);
   N = normals;
   T = texcoords;
   
   // our on screen position by applying our model-view-projection matrix
+#ifdef stereo
+  gl_Position = eyeProject(modelView * V, gl_InstanceID % 2);
+#else
   gl_Position = mvp * V;
+#endif
 
   // E is direction of eye
   E = (model * V).xyz;
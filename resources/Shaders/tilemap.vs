@@ -4,8 +4,7 @@ uniform vec2  mapSize;               // number of tiles wide and heigh our tile
 uniform int   tilesPerSide;          // number of tiles on each side, we assume square tiles
 uniform float textureSize;           // size of the texture, we assume we use square textures
 
-uniform mat4 mvp;
-uniform mat4 modelView;
+#include "object.inc"
 uniform sampler2D mapdata;
 
 out vec4 V;
@@ -14,6 +14,19 @@
 
 EngineKeyPressed engineKeyPressedCallback = NULL;
 
+// framebuffer we render our final output to, 0 is our screen
+GLuint        outputFrameBuffer = 0;
+
+// camera path we use if none is specified, this flies from our house out over our forest
+const char *  defaultCameraPath =
+  "# time  eye                          lookat\n"
+  "   0.0      0.0  1000.0   1300.0       0.0  1000.0      0.0\n"
+  "   4.0   1500.0   900.0      0.0       0.0   800.0      0.0\n"
+  "   8.0      0.0  1100.0  -2000.0       0.0   900.0      0.0\n"
+  "  12.0  -4000.0  1200.0  -4000.0  -10000.0   900.0 -10000.0\n"
+  "  16.0  -8000.0  2500.0      0.0       0.0   800.0      0.0\n"
+  "  20.0      0.0  4000.0   8000.0       0.0   500.0      0.0\n";
+
 // info about what is supported, this should move into our shader library at some point
 int           maxPatches = 0; // how many patches can our shader output
 int           maxTessLevel = 0; // what is the maximum tesselation level we support
@@ -21,6 +34,8 @@ int           maxTessLevel = 0; // what is the maximum tesselation level we supp
 // object info
 llist *       materials = NULL;
 texturemap *  heightMap = NULL;
+heightField * hmapField = NULL;
+terrain *     hmapTerrain = NULL;
 meshNode *    scene = NULL;
 meshNode *    tieNodes[10] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
@@ -37,7 +52,11 @@ shaderInfo *  shaders[NUM_SHADERS];
 lightSource * sun = NULL;
 lightSource * lights[MAX_LIGHTS];
 
+// number of textures we're still streaming in
+unsigned int  texturesPending = 0;
+
 // our camera
+benchPath *   cameraPath = NULL;
 mat4          view;
 vec3          camera_eye = { 0.0, 1000.0, 1300.0 };
 vec3          camera_lookat =  { 0.0, 1000.0, 0.0 };
@@ -47,10 +66,20 @@ float         projectionPlane = 200.0;
 // our gBuffer
 gBuffer *     geoBuffer = NULL;
 
+// our jobs, cameraView culls our scene for our camera while we render our shadow maps
+int           jobWorkers = -1;
+renderView *  cameraView = NULL;
+
 // and some runtime variables.
 bool          wireframe = false;
 bool          showinfo = true;
+bool          thinGBuffer = false;
+bool          stereo = false;
+bool          compressedTextures = false;
+bool          shaderCache = true;
+bool          cpuTerrain = false;
 bool          bounds = false;
+bool          instancing = true;
 double        frames = 0.0f;
 double        fps = 0.0f;
 double        lastframes = 0.0f;
@@ -65,6 +94,80 @@ void engineSetKeyPressedCallback(EngineKeyPressed pCallback) {
   engineKeyPressedCallback = pCallback;
 };
 
+//////////////////////////////////////////////////////////
+// output
+
+// sets the framebuffer engineRender outputs to, use this
+// when we're not rendering to screen
+void engineSetFrameBuffer(GLuint pFrameBuffer) {
+  outputFrameBuffer = pFrameBuffer;
+};
+
+// show or hide our info overlay
+void engineSetShowInfo(bool pShow) {
+  showinfo = pShow;
+};
+
+// use our thin gBuffer layout, this must be called before engineLoad
+void engineSetThinGBuffer(bool pThin) {
+  thinGBuffer = pThin;
+};
+
+// render both eyes side by side in a single pass, this must be called before engineLoad
+// and we must then render with pMode 3
+void engineSetStereo(bool pStereo) {
+  stereo = pStereo;
+};
+
+// load the meshes of our models in our packed vertex layout, this must be called before engineLoad
+void engineSetPackedVertices(bool pPacked) {
+  meshSetPackObj(pPacked);
+};
+
+// stream our textures in block compressed from our texture cache, this must be called before engineLoad
+void engineSetCompressedTextures(bool pCompressed) {
+  compressedTextures = pCompressed;
+  tmapSetCompression(pCompressed);
+};
+
+// load our shader programs from our program cache, this must be called before engineLoad
+void engineSetShaderCache(bool pCache) {
+  shaderCache = pCache;
+};
+
+// render our heightfield as chunks selected on the CPU even if we support tesselation, this must be called before engineLoad
+void engineSetCPUTerrain(bool pCPU) {
+  cpuTerrain = pCPU;
+};
+
+// number of workers that cull our views, negative starts one less then we have cores and 0 culls on our GL thread.
+// This must be called before engineLoad
+void engineSetJobWorkers(int pWorkers) {
+  jobWorkers = pWorkers;
+};
+
+//////////////////////////////////////////////////////////
+// camera path
+
+// make our camera follow a path instead of our input,
+// pPath is the text of our path, NULL for our default path
+bool engineSetCameraPath(const char * pPath) {
+  if (cameraPath != NULL) {
+    benchPathFree(cameraPath);
+  };
+
+  cameraPath = newBenchPath();
+  if (cameraPath == NULL) {
+    return false;
+  } else if (!benchPathParse(cameraPath, pPath == NULL ? defaultCameraPath : pPath)) {
+    benchPathFree(cameraPath);
+    cameraPath = NULL;
+    return false;
+  };
+
+  return true;
+};
+
 //////////////////////////////////////////////////////////
 // fonts
 void load_font() {
@@ -74,6 +177,8 @@ void load_font() {
     // then we load our font
     #ifdef __APPLE__
       font = fonsAddFont(fs, "sans", "Fonts/DroidSerif-Regular.ttf");
+    #elif defined(__linux__)
+      font = fonsAddFont(fs, "sans", "Resources/Fonts/DroidSerif-Regular.ttf");
     #else
       font = fonsAddFont(fs, "sans", "Resources\\Fonts\\DroidSerif-Regular.ttf");
     #endif
@@ -101,10 +206,57 @@ void unload_font() {
 //////////////////////////////////////////////////////////
 // Shaders
 
+// loads an instanced variant of one of our shaders, it is released together with the shader
+void load_instanced_shader(int pShader, const char * pVertexShader, const char * pFragmentShader, const char * pDefines) {
+  shaderInfo *  instanced;
+  char          name[50];
+
+  if (shaders[pShader] == NULL) {
+    return;
+  };
+
+  sprintf(name, "%s_inst", shaders[pShader]->name);
+  instanced = newShader(name, pVertexShader, NULL, NULL, NULL, pFragmentShader, pDefines);
+  if (instanced != NULL) {
+    shaderSetInstanced(shaders[pShader], instanced);
+    shaderRelease(instanced); // now retained by our shader
+  };
+};
+
+// loads a layered variant of one of our shadow shaders and its instanced variant, these render to all faces of a cube map at once
+void load_layered_shader(int pShader, const char * pVertexShader, const char * pGeometryShader, const char * pFragmentShader, const char * pDefines) {
+  shaderInfo *  layered;
+  shaderInfo *  instanced;
+  char          name[50];
+  char          defines[250];
+
+  if (shaders[pShader] == NULL) {
+    return;
+  };
+
+  sprintf(name, "%s_cube", shaders[pShader]->name);
+  sprintf(defines, "layered %s", pDefines);
+  layered = newShader(name, pVertexShader, NULL, NULL, pGeometryShader, pFragmentShader, defines);
+  if (layered != NULL) {
+    sprintf(name, "%s_cube_inst", shaders[pShader]->name);
+    sprintf(defines, "layered instanced %s", pDefines);
+    instanced = newShader(name, pVertexShader, NULL, NULL, pGeometryShader, pFragmentShader, defines);
+    if (instanced != NULL) {
+      shaderSetInstanced(layered, instanced);
+      shaderRelease(instanced); // now retained by our layered shader
+    };
+
+    shaderSetLayered(shaders[pShader], layered);
+    shaderRelease(layered); // now retained by our shader
+  };
+};
+
 void load_shaders() {
   // init some paths
   #ifdef __APPLE__
     shaderSetPath("Shaders/");
+  #elif defined(__linux__)
+    shaderSetPath("Resources/Shaders/");
   #else
     shaderSetPath("Resources\\Shaders\\");
   #endif
@@ -127,10 +279,15 @@ void load_shaders() {
   shaders[RECTDEPTH_SHADER] = newShader("rect","rect.vs", NULL, NULL, NULL, "rect.fs", "DEPTHMAP");
   shaders[SKYBOX_SHADER] = newShader("skybox", "skybox.vs", NULL, NULL, NULL, "skybox.fs", "");
 
-  if (maxPatches >= 4) {
+  if ((maxPatches >= 4) && !cpuTerrain) {
     shaders[HMAP_SHADER] = newShader("hmap", "hmap_ts.vs", "hmap_ts.ts", "hmap_ts.te", "hmap_ts.gs", "hmap_ts.fs", "");
   } else {
+    // without tesselation (or when tesselation is slow, such as on llvmpipe) we render our heightfield as chunks of our terrain,
+    // these also cast shadows
     shaders[HMAP_SHADER] = newShader("hmap", "hmap.vs", NULL, NULL, NULL, "hmap.fs", "");
+    load_instanced_shader(HMAP_SHADER, "hmap.vs", "hmap.fs", "instanced");
+    shaders[HMAPSHADOW_SHADER] = newShader("hmapshadow", "hmap.vs", NULL, NULL, NULL, "shadow.fs", "shadow");
+    load_instanced_shader(HMAPSHADOW_SHADER, "hmap.vs", "shadow.fs", "instanced shadow");
   };
   shaders[BILLBOARD_SHADER] = newShader("billboard", "billboard.vs", NULL, NULL, NULL, "billboard.fs", "");
 
@@ -142,6 +299,20 @@ void load_shaders() {
 
   shaders[SOLIDSHADOW_SHADER] = newShader("solidshadow", "shadow.vs", NULL, NULL, NULL, "shadow.fs", "");
   shaders[TEXTURESHADOW_SHADER] = newShader("textureshadow", "shadow.vs", NULL, NULL, NULL, "shadow.fs", "textured");
+
+  // and instanced variants for rendering many copies of the same mesh (such as our trees) in one go
+  load_instanced_shader(COLOR_SHADER, "standard.vs", "standard.fs", "instanced");
+  load_instanced_shader(TEXTURED_SHADER, "standard.vs", "standard.fs", "instanced textured");
+  load_instanced_shader(BUMP_SHADER, "standard.vs", "standard.fs", "instanced normalmap");
+  load_instanced_shader(BUMPTEXT_SHADER, "standard.vs", "standard.fs", "instanced textured normalmap");
+  load_instanced_shader(REFLECT_SHADER, "standard.vs", "standard.fs", "instanced reflect");
+
+  load_instanced_shader(SOLIDSHADOW_SHADER, "shadow.vs", "shadow.fs", "instanced");
+  load_instanced_shader(TEXTURESHADOW_SHADER, "shadow.vs", "shadow.fs", "instanced textured");
+
+  // and layered variants for rendering our point light shadows into a cube map in one pass
+  load_layered_shader(SOLIDSHADOW_SHADER, "shadow.vs", "shadow.gs", "shadow.fs", "");
+  load_layered_shader(TEXTURESHADOW_SHADER, "shadow.vs", "shadow.gs", "shadow.fs", "textured");
 };
 
 void unload_shaders() {
@@ -157,15 +328,6 @@ void unload_shaders() {
 //////////////////////////////////////////////////////////
 // Objects
 
-float getHeight(float x, float y) {
-  vec4 col = tmapGetPixel(heightMap, x / 50000.0, y / 50000.0);
-  float h =(col.x * 1000.0);
-
-//  errorlog(0, "At %f, %f color = %f, height = %f", x, y, col.x, h);
-
-  return h;
-};
-
 void initHMap() {
   material *    mat;
   meshNode *    mnode;
@@ -175,27 +337,50 @@ void initHMap() {
   heightMap = getTextureMapByFileName("heightfield.jpg", GL_LINEAR, GL_REPEAT, true);
   tmapRetain(heightMap);
 
+  // and we convert it into a height field for our height lookups
+  hmapField = newHeightField(heightMap, 50000.0, 1000.0);
+
   mat = newMaterial("hmap");                  // create a material for our heightmap
   mat->priority = 99;                         // render as late as possible
   mat->ambient = 0.2;                         // ambient factor
-  matSetShader(mat, shaders[HMAP_SHADER]);    // texture shader for now, we do not set a shadow shader
-  matSetDiffuseMap(mat, getTextureMapByFileName("grass.jpg", GL_LINEAR, GL_REPEAT, false));
+  matSetShader(mat, shaders[HMAP_SHADER]);    // texture shader for now
+  matSetDiffuseMap(mat, getStreamedTextureMap("Grass.jpg", GL_LINEAR, GL_REPEAT, TMAP_PLACEHOLDER_GRAY));
   matSetBumpMap(mat, heightMap);
 
-  mesh = newMesh(102 * 102, 101 * 101 * 3 * 2);
-  strcpy(mesh->name, "hmap");
-  meshSetMaterial(mesh, mat);
-  meshMakePlane(mesh, 101, 101, 101.0, 101.0, maxPatches >= 4 ? 4 : 3);
-  meshCopyToGL(mesh, true);
+  mnode = newMeshNode("hmap");
+
+  if ((shaders[HMAPSHADOW_SHADER] != NULL) && (hmapField != NULL)) {
+    // our terrain covers the area our old grid did, chunks on our last level have 32x32 quads of 200 units which is about
+    // the size of a pixel in our height map
+    hmapTerrain = newTerrain(hmapField, 204800.0, 6, 32);
+  };
+
+  if (hmapTerrain != NULL) {
+    // our terrain is a single sheet so we need to render both sides to get it into our shadow maps
+    mat->twoSided = true;
+    matSetShadowShader(mat, shaders[HMAPSHADOW_SHADER]);
+    meshSetMaterial(hmapTerrain->mesh, mat);
+    terrainLoadUniforms(hmapTerrain, shaders[HMAP_SHADER]);
+    terrainLoadUniforms(hmapTerrain, shaders[HMAPSHADOW_SHADER]);
+
+    meshNodeSetTerrain(mnode, hmapTerrain);
+  } else {
+    mesh = newMesh(102 * 102, 101 * 101 * 3 * 2);
+    strcpy(mesh->name, "hmap");
+    meshSetMaterial(mesh, mat);
+    meshMakePlane(mesh, 101, 101, 101.0, 101.0, maxPatches >= 4 ? 4 : 3);
+    meshCopyToGL(mesh, true);
+
+    meshNodeSetMesh(mnode, mesh);
+    meshRelease(mesh);
+  };
 
   // now add our heightfield to our scene
-  mnode = newMeshNode("hmap");
-  meshNodeSetMesh(mnode, mesh);
   meshNodeAddChild(scene, mnode);
 
   // we can release these seeing its now all contained within our scene
+  meshNodeRelease(mnode);
   matRelease(mat);
-  meshRelease(mesh);
 };
 
 void initSkybox() {
@@ -207,7 +392,7 @@ void initSkybox() {
   mat->priority = 100;                        // render as late as possible
   matSetShader(mat, shaders[SKYBOX_SHADER]);  // use our skybox shader, this will cause our lighting and positioning to be ignored!!!
   // we also do not set a shadow shader
-  matSetDiffuseMap(mat, getTextureMapByFileName("skybox.png", GL_LINEAR, GL_CLAMP_TO_EDGE, false)); // load our texture map (courtesy of http://rbwhitaker.wikidot.com/texture-library)
+  matSetDiffuseMap(mat, getStreamedTextureMap("skybox.png", GL_LINEAR, GL_CLAMP_TO_EDGE, TMAP_PLACEHOLDER_GRAY)); // load our texture map (courtesy of http://rbwhitaker.wikidot.com/texture-library)
  
   mesh = newMesh(24, 36);                     // init our cube with enough space for our buffers
   strcpy(mesh->name,"skybox");                // set name to cube
@@ -227,21 +412,16 @@ void initSkybox() {
 };
 
 void addTieBombers(const char *pModelPath) {
-  char *        text;
+  llist *       meshes = newMeshList();
   vec3          tmpvector;
   mat4          adjust;
 
-  // load our tie-bomber obj file
-  text = loadFile(pModelPath, "tie-bomber.obj");
-  if (text != NULL) {
-    llist *       meshes = newMeshList();
-
-    // setup our adjustment matrix to center our object
-    mat4Identity(&adjust);
-    mat4Translate(&adjust, vec3Set(&tmpvector, 250.0, -100.0, 100.0));
+  // setup our adjustment matrix to center our object
+  mat4Identity(&adjust);
+  mat4Translate(&adjust, vec3Set(&tmpvector, 250.0, -100.0, 100.0));
 
-    // parse our object file
-    meshParseObj(text, meshes, materials, &adjust);
+  // load our tie-bomber obj file
+  if (meshLoadObj(pModelPath, "tie-bomber.obj", meshes, materials, &adjust)) {
 
     // add our tie bomber mesh to our containing node
     tieNodes[0] = newMeshNode("tie-bomber-0");
@@ -251,14 +431,13 @@ void addTieBombers(const char *pModelPath) {
     // create a bounding box for our tie-bomber
     meshNodeMakeBounds(tieNodes[0]);
 
+    // our tie-bombers fly around so we render their shadows every frame on top of our cached static shadows
+    meshNodeSetDynamic(tieNodes[0], true);
+
     // and add it to our scene, note that we could free up our tie-bomber node here as it is references by our scene
     // but we keep it so we can interact with them.
     meshNodeAddChild(scene, tieNodes[0]);
 
-    // and free up what we no longer need
-    llistFree(meshes);
-    free(text);
-
     // instance our tie bomber a few times, note that we're copying our tieNodes[0] model matrix as well so all our other bombers will be placed relative to it.
     tieNodes[1] = newCopyMeshNode("tie-bomber-1", tieNodes[0], false);
     mat4Translate(&tieNodes[1]->position, vec3Set(&tmpvector, -400.0, 0.0, -100.0));
@@ -296,26 +475,24 @@ void addTieBombers(const char *pModelPath) {
     mat4Translate(&tieNodes[9]->position, vec3Set(&tmpvector, 0.0, 0.0, -1000.0));
     meshNodeAddChild(scene, tieNodes[9]);
   };
+
+  // and free up what we no longer need
+  llistFree(meshes);
 };
 
 void addHouse(char *pModelPath) {
-  char *        text;
+  llist *       meshes = newMeshList();
   vec3          tmpvector;
   mat4          adjust;
 
+  // setup our adjustment matrix to center our object
+  mat4Identity(&adjust);
+  mat4Scale(&adjust, vec3Set(&tmpvector, 2.0, 2.0, 2.0));
+
   // load our house obj file
-  text = loadFile(pModelPath, "House.obj");
-  if (text != NULL) {
-    llist *       meshes = newMeshList();
+  if (meshLoadObj(pModelPath, "House.obj", meshes, materials, &adjust)) {
     meshNode *    house = newMeshNode("House");
 
-    // setup our adjustment matrix to center our object
-    mat4Identity(&adjust);
-    mat4Scale(&adjust, vec3Set(&tmpvector, 2.0, 2.0, 2.0));
-
-    // parse our object file
-    meshParseObj(text, meshes, materials, &adjust);
-
     // add our house mesh to our containing node (note we may get a tree through our house as we position them randomly...)
     mat4Translate(&house->position, vec3Set(&tmpvector, -1000.0, 460.0, 1000.0));
     meshNodeAddChildren(house, meshes);
@@ -329,6 +506,9 @@ void addHouse(char *pModelPath) {
     // we don't need to keep this now that it is in our scene
     meshNodeRelease(house);
   };
+
+  // and free up what we no longer need
+  llistFree(meshes);
 };
 
 float randomF(float pMin, float pMax) {
@@ -343,7 +523,7 @@ float randomF(float pMin, float pMax) {
 };
 
 void addTrees(const char *pModelPath) {
-  char *        text;
+  llist *       meshes;
   vec3          tmpvector;
   mat4          adjust;
   meshNode *    treeLod1 = NULL;
@@ -351,55 +531,52 @@ void addTrees(const char *pModelPath) {
   meshNode *    treeLod3 = NULL;
   meshNode *    treeGroups[101][101];
   int           i, j, tree;
+  int           numTrees = 5000, numGroups = 21;
+  float *       treeX;
+  float *       treeZ;
+  float *       treeY;
+  float *       treeSpin;
 
   // zero out our tree groups
   memset(treeGroups, 0, sizeof(treeGroups));
 
   // load our tree obj files
-  text = loadFile(pModelPath, "TreeLOD1.obj");
-  if (text != NULL) {
-    llist *       meshes = newMeshList();
+  meshes = newMeshList();
 
-    // just scale it up a bit
-    mat4Identity(&adjust);
-    mat4Scale(&adjust, vec3Set(&tmpvector, 40.0, 40.0, 40.0));
-
-    // parse our object file
-    meshParseObj(text, meshes, materials, &adjust);
+  // just scale it up a bit
+  mat4Identity(&adjust);
+  mat4Scale(&adjust, vec3Set(&tmpvector, 40.0, 40.0, 40.0));
 
+  // load our object file
+  if (meshLoadObj(pModelPath, "TreeLOD1.obj", meshes, materials, &adjust)) {
     // and package as a tree node
     treeLod1 = newMeshNode("treeLod1");
     treeLod1->maxDist = 5000.0;
     meshNodeAddChildren(treeLod1, meshes);
     meshNodeMakeBounds(treeLod1);
-
-    // and free up what we no longer need
-    llistFree(meshes);
-    free(text);
   };
 
-  text = loadFile(pModelPath, "TreeLOD2.obj");
-  if (text != NULL) {
-    llist *       meshes = newMeshList();
+  // and free up what we no longer need
+  llistFree(meshes);
 
-    // just scale it up a bit
-    mat4Identity(&adjust);
-    mat4Scale(&adjust, vec3Set(&tmpvector, 40.0, 40.0, 40.0));
+  meshes = newMeshList();
 
-    // parse our object file
-    meshParseObj(text, meshes, materials, &adjust);
+  // just scale it up a bit
+  mat4Identity(&adjust);
+  mat4Scale(&adjust, vec3Set(&tmpvector, 40.0, 40.0, 40.0));
 
+  // load our object file
+  if (meshLoadObj(pModelPath, "TreeLOD2.obj", meshes, materials, &adjust)) {
     // and package as a tree node
     treeLod2 = newMeshNode("treeLod2");
     treeLod2->maxDist = 15000.0;
     meshNodeAddChildren(treeLod2, meshes); 
     meshNodeMakeBounds(treeLod2);
-
-    // and free up what we no longer need
-    llistFree(meshes);
-    free(text);
   };
 
+  // and free up what we no longer need
+  llistFree(meshes);
+
   /* temporarily disabled, now that we're doing defered lighting we either need to change this logic or simply load an image :) 
 
   // the last LOD we'll create by rendering to texture
@@ -475,8 +652,40 @@ void addTrees(const char *pModelPath) {
   };
   */
 
-  // add some trees
-  for (tree = 0; tree < 5000; tree++) {
+  // pick where our trees go first so we can look up all their heights in one batch, we use a fixed seed so we get the same forest each time we run.
+  // Our tree groups are placed on a grid of 5000 units, the heights of our grid follow those of our trees in the same batch
+  treeX = (float *) malloc(sizeof(float) * ((3 * (numTrees + (numGroups * numGroups))) + (4 * numTrees)));
+  if (treeX == NULL) {
+    errorlog(-1, "Couldn't allocate memory for our trees");
+    numTrees = 0;
+  } else {
+    treeZ = treeX + numTrees + (numGroups * numGroups);
+    treeY = treeZ + numTrees + (numGroups * numGroups);
+    treeSpin = treeY + numTrees + (numGroups * numGroups);
+
+    srand(1);
+    for (tree = 0; tree < numTrees; tree++) {
+      treeX[tree] = randomF(-50000.0, 50000.0);
+      treeZ[tree] = randomF(-50000.0, 50000.0);
+
+      // our rotation and scale
+      treeSpin[(tree * 4)] = randomF(0.0, 360.0);
+      treeSpin[(tree * 4) + 1] = randomF(0.9, 1.1);
+      treeSpin[(tree * 4) + 2] = randomF(0.9, 1.1);
+      treeSpin[(tree * 4) + 3] = randomF(0.9, 1.1);
+    };
+    for (j = 0; j < numGroups; j++) {
+      for (i = 0; i < numGroups; i++) {
+        treeX[numTrees + (j * numGroups) + i] = (5000.0 * i) - 50000.0;
+        treeZ[numTrees + (j * numGroups) + i] = (5000.0 * j) - 50000.0;
+      };
+    };
+
+    hfieldGetHeights(hmapField, treeX, treeZ, treeY, numTrees + (numGroups * numGroups));
+  };
+
+  // add our trees
+  for (tree = 0; tree < numTrees; tree++) {
     meshNode * treeNode;
     char       nodeName[100];
 
@@ -497,9 +706,9 @@ void addTrees(const char *pModelPath) {
     };
 
     // position our node
-    tmpvector.x = randomF(-50000.0, 50000.0);
-    tmpvector.z = randomF(-50000.0, 50000.0);
-    tmpvector.y = getHeight(tmpvector.x, tmpvector.z) - 15.0;
+    tmpvector.x = treeX[tree];
+    tmpvector.z = treeZ[tree];
+    tmpvector.y = treeY[tree] - 15.0;
     mat4Translate(&treeNode->position, &tmpvector);
 
     // and add to our scene
@@ -513,9 +722,9 @@ void addTrees(const char *pModelPath) {
       treeGroups[i][j] = newMeshNode(nodeName);
 
       // position our node
-      tmpvector.x = (5000.0 * i) - 50000.0;
-      tmpvector.z = (5000.0 * j) - 50000.0;
-      tmpvector.y = getHeight(tmpvector.x, tmpvector.z) - 25.0;
+      tmpvector.x = treeX[numTrees + (j * numGroups) + i];
+      tmpvector.z = treeZ[numTrees + (j * numGroups) + i];
+      tmpvector.y = treeY[numTrees + (j * numGroups) + i] - 25.0;
       mat4Translate(&treeGroups[i][j]->position, &tmpvector);
 
       // set a maximum distance as we wouldn't be rendering any trees if it's this far away
@@ -534,15 +743,19 @@ void addTrees(const char *pModelPath) {
     // Must do this after we finish positioning our tree as this is applied in 'reverse' order...
 
     // apply some random rotation to our tree
-    mat4Rotate(&treeNode->position, randomF(0.0, 360.0), vec3Set(&tmpvector, 0.0, 1.0, 0.0));
+    mat4Rotate(&treeNode->position, treeSpin[(tree * 4)], vec3Set(&tmpvector, 0.0, 1.0, 0.0));
 
     // and a bit of a random scale
-    mat4Scale(&treeNode->position, vec3Set(&tmpvector, randomF(0.9, 1.1), randomF(0.9, 1.1), randomF(0.9, 1.1)));
+    mat4Scale(&treeNode->position, vec3Set(&tmpvector, treeSpin[(tree * 4) + 1], treeSpin[(tree * 4) + 2], treeSpin[(tree * 4) + 3]));
 
     // and we no longer need this
     meshNodeRelease(treeNode);
   };
 
+  if (treeX != NULL) {
+    free(treeX);
+  };
+
   // free our trees, we don't need to hang on to it anymore
   if (treeLod1 != NULL) {
     meshNodeRelease(treeLod1);
@@ -574,6 +787,9 @@ void load_objects() {
   #ifdef __APPLE__
     tmapSetTexturePath("Textures/");
     strcpy(modelPath,"Models/");
+  #elif defined(__linux__)
+    tmapSetTexturePath("Resources/Textures/");
+    strcpy(modelPath,"Resources/Models/");
   #else
     tmapSetTexturePath("Resources\\Textures\\");
     strcpy(modelPath,"Resources\\Models\\");
@@ -671,6 +887,9 @@ void load_objects() {
 
     // And create our skybox, we no longer add this to our scene so we can handle this last in our rendering loop
     initSkybox();
+
+    // and build our BVH so we can quickly cull what is off screen, this must be done once all our nodes are added
+    meshNodeBuildBVH(scene);
   }; 
 };
 
@@ -698,11 +917,24 @@ void unload_objects() {
     materials = NULL;
   };
 
+  if (hmapTerrain != NULL) {
+    terrainRelease(hmapTerrain);
+    hmapTerrain = NULL;
+  };
+
+  if (hmapField != NULL) {
+    hfieldRelease(hmapField);
+    hmapField = NULL;
+  };
+
   if (heightMap != NULL) {
     tmapRelease(heightMap);
     heightMap = NULL;
   };
 
+  // stop streaming before we release our textures
+  tmapStopStreaming();
+
   // do this last just in case...
   tmapReleaseCachedTextureMaps();
 };
@@ -718,13 +950,30 @@ void engineInit() {
 // engineLoad loads any data that we need to load before we can start outputting stuff
 void engineLoad(bool pHMD) {
   vec3  upvector, tmpvector;
+  char  defines[256];
   int   i;
   
   // load our font
   load_font();
     
-  // load, compile and link our shader(s)
+  // load, compile and link our shader(s), our material shaders need to know our gBuffer layout
+  // and whether our normal maps are compressed
+  defines[0] = '\0';
+  if (thinGBuffer) {
+    strcat(defines, "thingbuffer ");
+  };
+  if (stereo) {
+    strcat(defines, "stereo ");
+  };
+  if (compressedTextures) {
+    strcat(defines, "compressednormals ");
+  };
+  shaderSetGlobalDefines(defines[0] == '\0' ? NULL : defines);
+  shaderCacheInit(shaderCache);
   load_shaders();
+
+  // decode our textures in the background while we load our objects, we upload up to 4MB each frame
+  tmapStartStreaming(0, 4 * 1024 * 1024);
   
   // load our objects (note, this also sets up our texture folder so do this before loading our lightmaps!)
   load_objects();
@@ -756,7 +1005,7 @@ void engineLoad(bool pHMD) {
   lights[3]->type = 2;
   lights[3]->lightAngle = 160.0;
   lights[3]->lightRadius = 300.0;
-  lsSetLightMap(lights[3], getTextureMapByFileName("lightmap.png", GL_LINEAR, GL_CLAMP_TO_EDGE, false));
+  lsSetLightMap(lights[3], getStreamedTextureMap("lightmap.png", GL_LINEAR, GL_CLAMP_TO_EDGE, TMAP_PLACEHOLDER_WHITE));
 //  lsSetLightMap(lights[3], getTextureMapByFileName("batman-symbol.jpg", GL_LINEAR, GL_CLAMP_TO_EDGE, false));
 
   lights[4] = newLightSource("SpotLight 2", vec3Set(&tmpvector, -450.0, 500.0, 1000.0));
@@ -765,7 +1014,7 @@ void engineLoad(bool pHMD) {
   lights[4]->type = 2;
   lights[4]->lightRadius = 500.0;
   lights[4]->lightAngle = 80.0;
-  lsSetLightMap(lights[4], getTextureMapByFileName("batman-symbol.jpg", GL_LINEAR, GL_CLAMP_TO_EDGE, false));
+  lsSetLightMap(lights[4], getStreamedTextureMap("batman-symbol.jpg", GL_LINEAR, GL_CLAMP_TO_EDGE, TMAP_PLACEHOLDER_WHITE));
   
   // init our view matrix
   mat4Identity(&view);
@@ -773,7 +1022,14 @@ void engineLoad(bool pHMD) {
 
 
   // create our gbuffer
-  geoBuffer = newGBuffer(pHMD); // if we're rendering for an HMD we need barrel distorion
+  geoBuffer = newGBuffer(pHMD, thinGBuffer, stereo); // if we're rendering for an HMD we need barrel distorion
+
+  // start our job workers, our views are culled by these while we render
+  jobsStart(jobWorkers);
+  cameraView = newRenderView();
+
+  // and log how long our shaders took, this includes the light shaders of our gBuffer
+  shaderCacheLogStats();
 };
 
 // engineUnload unloads and frees up any data associated with our engine
@@ -792,14 +1048,32 @@ void engineUnload() {
     sun = NULL;
   };
 
+  if (cameraView != NULL) {
+    rviewFree(cameraView);
+    cameraView = NULL;
+  };
+
   if (geoBuffer != NULL) {
     freeGBuffer(geoBuffer);
     geoBuffer = NULL;
   };
 
   unload_shaders();
+  shaderSetGlobalDefines(NULL);
+  shaderFreeSources();
   unload_objects();
   unload_font();
+
+  if (cameraPath != NULL) {
+    benchPathFree(cameraPath);
+    cameraPath = NULL;
+  };
+
+  meshNodeFreeInstancing();
+  meshNodeFreeRenderQueues();
+  shaderRingFree();
+  profFree();
+  jobsStop();
 };
 
 // engineUpdate is called to handle any updates of our data
@@ -905,8 +1179,13 @@ void engineUpdate(double pSecondsPassed) {
     vec3Add(&camera_lookat, &avector);
   };
 
+  // if we're following a path that overrides our input
+  if (cameraPath != NULL) {
+    benchPathEval(cameraPath, pSecondsPassed, &camera_eye, &camera_lookat);
+  };
+
   // get our height at the camera position
-  height = 30.0 + getHeight(camera_eye.x, camera_eye.z);
+  height = 30.0 + hfieldGetHeight(hmapField, camera_eye.x, camera_eye.z);
   if (height > camera_eye.y) {
     height -= camera_eye.y;
     camera_eye.y += height;
@@ -952,8 +1231,8 @@ void drawRect(GLuint pTexture, int pX, int pY, int pWidth, int pHeight, shaderMa
 
   glUseProgram(shader->program);
 
-  if (shader->mvpId >= 0) {
-    glUniformMatrix4fv(shader->mvpId, 1, false, (const GLfloat *) shdMatGetMvp(pMatrices)->m);
+  if (shader->objectBlockId >= 0) {
+    shdMatBindObject(pMatrices);
   };
 
   if (shader->textureMapId >= 0) {
@@ -964,6 +1243,7 @@ void drawRect(GLuint pTexture, int pX, int pY, int pWidth, int pHeight, shaderMa
 
   // and draw
   glDrawArrays(GL_TRIANGLES, 0, 3 * 2);
+  benchCountDraw(2, 1);
 
   // done with this
   glBindVertexArray(0);
@@ -972,7 +1252,7 @@ void drawRect(GLuint pTexture, int pX, int pY, int pWidth, int pHeight, shaderMa
 
 // engineRender is called to render our stuff
 // pWidth and pHeight define the size of our drawing buffer
-// pMode is 0 => mono, 1 => left eye, 2 => right eye
+// pMode is 0 => mono, 1 => left eye, 2 => right eye, 3 => both eyes side by side (see engineSetStereo)
 void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
   mat4            tmpmatrix;
   shaderMatrices  matrices;
@@ -984,20 +1264,104 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
   // remember our current viewport as our shadow mapping and gBuffer rendering will alter it
   glGetIntegerv(GL_VIEWPORT, &wasviewport[0]);
 
+  // upload any textures our workers have decoded, once per frame
+  if (pMode != 2) {
+    unsigned int pending;
+
+    profBegin("texture streaming");
+    pending = tmapStreamUpdate(0);
+    if (pending < texturesPending) {
+      // our cached static shadows were rendered with our placeholders, rebuild them now our alpha is known
+      lsInvalidateShadows(sun, NULL);
+      for (i = 0; i < MAX_LIGHTS; i++) {
+        lsInvalidateShadows(lights[i], NULL);
+      };
+    };
+    texturesPending = pending;
+    profEnd();
+  };
+
+  // our terrain picks its chunks based on how large they are on screen
+  if ((pMode != 2) && terrainSetScreen(hmapTerrain, pHeight, 45.0)) {
+    terrainLoadUniforms(hmapTerrain, shaders[HMAP_SHADER]);
+    terrainLoadUniforms(hmapTerrain, shaders[HMAPSHADOW_SHADER]);
+    matResetLastUsed();
+
+    // our cached shadows were rendered with different chunks
+    lsInvalidateShadows(sun, NULL);
+    for (i = 0; i < MAX_LIGHTS; i++) {
+      lsInvalidateShadows(lights[i], NULL);
+    };
+  };
+
+  // init our projection matrix, we use a 3D projection matrix now
+  mat4Identity(&tmpmatrix);
+  if (pMode == 3) {
+    mat4 eyes[2];
+
+    // we cull once with a projection that contains both eyes and render each eye with its own projection
+    mat4StereoUnion(&tmpmatrix, 45.0, pRatio, 1.0, 100000.0, iod, projectionPlane);
+    shdMatSetProjection(&matrices, &tmpmatrix);
+
+    mat4Identity(&eyes[0]);
+    mat4Stereo(&eyes[0], 45.0, pRatio, 1.0, 100000.0, iod, projectionPlane, 1);
+    mat4Identity(&eyes[1]);
+    mat4Stereo(&eyes[1], 45.0, pRatio, 1.0, 100000.0, iod, projectionPlane, 2);
+    shdMatSetEyeProjections(&matrices, &eyes[0], &eyes[1]);
+  } else {
+    // distance between eyes is on average 6.5 cm, this should be setable
+    mat4Stereo(&tmpmatrix, 45.0, pRatio, 1.0, 100000.0, iod, projectionPlane, pMode);
+    shdMatSetProjection(&matrices, &tmpmatrix); // call our set function to reset our flags
+  };
+
+  // copy our view matrix into our state
+  shdMatSetView(&matrices, &view);
+
+  // start culling our scene for our camera and for our shadow maps, our workers build these while we render
+  if (scene != NULL) {
+    // update the boxes of anything that moved before our workers cull against them
+    meshNodeRefitBVH(scene);
+    rviewQueue(cameraView, scene, &matrices, 0.0, MESHNODE_ALLCASTERS, false);
+  };
+  if (pMode != 2) {
+    lsPrepareShadowMapForSun(sun, 0,  1500, &camera_eye, scene);
+    lsPrepareShadowMapForSun(sun, 1,  3000, &camera_eye, scene);
+    lsPrepareShadowMapForSun(sun, 2, 10000, &camera_eye, scene);
+
+    for (i = 0; i < MAX_LIGHTS; i++) {
+      if (lights[i] != NULL) {
+        lsPrepareShadowMapsForLight(lights[i], scene);
+      };
+    };
+  };
+
   // only render our shadow maps once per frame, we can reuse them if we're doing our right eye as well
   if (pMode != 2) {
+    profBegin("shadows");
+
+    profBegin("sun cascade 0");
     lsRenderShadowMapForSun(sun, 0, 4096,  1500, &camera_eye, scene);
+    profEnd();
+    profBegin("sun cascade 1");
     lsRenderShadowMapForSun(sun, 1, 4096,  3000, &camera_eye, scene);
+    profEnd();
+    profBegin("sun cascade 2");
     lsRenderShadowMapForSun(sun, 2, 4096, 10000, &camera_eye, scene);
+    profEnd();
 
     for (i = 0; i < MAX_LIGHTS; i++) {
       if (lights[i] != NULL) {
+        profBegin("light");
         lsRenderShadowMapsForLight(lights[i], 512, scene);
+        profEnd();
       };
     };
+
+    profEnd();
   };
 
   // render to our gbuffer first...
+  profBegin("gbuffer");
   if (gBufferRenderTo(geoBuffer, pWidth, pHeight)) {        
     // enable and configure our backface culling
     glEnable(GL_CULL_FACE);   // enable culling
@@ -1028,43 +1392,52 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
     // reset our last material used
     matResetLastUsed();
 
-    // init our projection matrix, we use a 3D projection matrix now
-    mat4Identity(&tmpmatrix);
-    // distance between eyes is on average 6.5 cm, this should be setable
-    mat4Stereo(&tmpmatrix, 45.0, pRatio, 1.0, 100000.0, iod, projectionPlane, pMode);
-    shdMatSetProjection(&matrices, &tmpmatrix); // call our set function to reset our flags
-  
-    // copy our view matrix into our state
-    shdMatSetView(&matrices, &view);
-
-    // and render our scene
+    // and render our scene, when rendering both eyes each mesh is drawn as two instances each clipped to its half of our buffer
     if (scene != NULL) {
-      meshNodeRender(scene, &matrices, (material *) materials->first->data);    
+      if (pMode == 3) {
+        meshSetViews(2);
+        glEnable(GL_CLIP_DISTANCE0);
+      };
+      meshNodeRenderView(cameraView, &matrices, (material *) materials->first->data);
+      if (pMode == 3) {
+        meshSetViews(1);
+        glDisable(GL_CLIP_DISTANCE0);
+      };
     };
+    profEnd();
 
     // now do our lighting
 
     // set our output to screen
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFrameBuffer);
     glViewport(wasviewport[0],wasviewport[1],wasviewport[2],wasviewport[3]);  
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     // First we do our global lighting
+    profBegin("main pass");
     gBufferDoMainPass(geoBuffer, &matrices, sun);  
+    profEnd();
 
     // now use blending for our additional lights
     glEnable(GL_BLEND);
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_ONE, GL_ONE);
 
-    // loop through our lights
-    for (i = 0; i < MAX_LIGHTS; i++) {
-      if (lights[i] != NULL) {
-        gBufferDoLight(geoBuffer, &matrices, lights[i]);
-      };
-    };
+    // and do our lights, our point lights are shaded together in our clustered pass
+    profBegin("lights");
+    gBufferDoLights(geoBuffer, &matrices, lights, MAX_LIGHTS);
+    profEnd();
+  } else {
+    // close our gbuffer scope
+    profEnd();
+
+    // our scene may change after we return so we can't leave our camera view culling
+    rviewWait(cameraView);
   };
 
+  // none of our views are being culled now so we can hide anything whose material failed
+  meshNodeHideFailed();
+
   // unset stuff
   glBindVertexArray(0);
   glUseProgram(0);
@@ -1072,6 +1445,7 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
   if (showinfo) {
     ////////////////////////////////////
     // UI
+    profBegin("ui");
       
     // change our state a little
     glDisable(GL_DEPTH_TEST);
@@ -1124,9 +1498,18 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
         };
       };
 
-      // lets display our log
-      for (i = 0; i < 20; i++) {
-        fonsDrawText(fs, 100.0, -250.0f + (i * 20.0f), getLogLine(i), NULL);        
+      // lets display our profile if we're profiling, else our log
+      if (profIsEnabled()) {
+        char          lines[20][PROF_LINELEN];
+        unsigned int  count = profGetOverlay(lines, 20);
+
+        for (i = 0; i < count; i++) {
+          fonsDrawText(fs, 100.0, -250.0f + (i * 20.0f), lines[i], NULL);
+        };
+      } else {
+        for (i = 0; i < 20; i++) {
+          fonsDrawText(fs, 100.0, -250.0f + (i * 20.0f), getLogLine(i), NULL);        
+        };
       };
 
       glDisable(GL_BLEND);
@@ -1134,7 +1517,12 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
 
       // display some buffers
       if (geoBuffer != NULL) {
-        drawRect(geoBuffer->textureIds[0], -pRatio * 250.0f, -190.0f, 80.0f * pRatio, 80.0f, &matrices, false);
+        if (geoBuffer->thin) {
+          // we don't have a position buffer, show our depth buffer instead
+          drawRect(geoBuffer->depthBufferId, -pRatio * 250.0f, -190.0f, 80.0f * pRatio, 80.0f, &matrices, true);
+        } else {
+          drawRect(geoBuffer->textureIds[0], -pRatio * 250.0f, -190.0f, 80.0f * pRatio, 80.0f, &matrices, false);
+        };
         drawRect(geoBuffer->textureIds[1], -pRatio * 160.0f, -190.0f, 80.0f * pRatio, 80.0f, &matrices, false);
         drawRect(geoBuffer->textureIds[2], -pRatio * 70.0f, -190.0f, 80.0f * pRatio, 80.0f, &matrices, false);
         drawRect(geoBuffer->textureIds[3], -pRatio * 250.0f, -100.0f, 80.0f * pRatio, 80.0f, &matrices, false);
@@ -1148,18 +1536,12 @@ void engineRender(int pWidth, int pHeight, float pRatio, int pMode) {
         drawRect(sun->shadowMap[2]->textureId, -pRatio * 250.0f + 220.0f, -10.0f, 100.0f, 100.0f, &matrices, true);
       };
 
-      if (lights[0]->shadowMap[0] != NULL) {
-        drawRect(lights[0]->shadowMap[0]->textureId, -pRatio * 250.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-        drawRect(lights[0]->shadowMap[1]->textureId, -pRatio * 250.0f + 60.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-        drawRect(lights[0]->shadowMap[2]->textureId, -pRatio * 250.0f + 120.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-        drawRect(lights[0]->shadowMap[3]->textureId, -pRatio * 250.0f + 180.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-        drawRect(lights[0]->shadowMap[4]->textureId, -pRatio * 250.0f + 240.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-        drawRect(lights[0]->shadowMap[5]->textureId, -pRatio * 250.0f + 300.0f, 100.0f, 50.0f, 50.0f, &matrices, true);
-      }; 
       if (lights[3]->shadowMap[0] != NULL) {
         drawRect(lights[3]->shadowMap[0]->textureId, -pRatio * 250.0f, 160.0f, 50.0f, 50.0f, &matrices, true);
       };
     };
+
+    profEnd();
   };
 };
 
@@ -1171,6 +1553,11 @@ void engineKeyPressed(int pKey) {
   } else if (pKey == GLFW_KEY_I) {
     // toggle info
     showinfo = !showinfo;
+  } else if (pKey == GLFW_KEY_T) {
+    // toggle our profiler, our timings replace our log in our info overlay
+    bool enable = !profIsEnabled();
+    profSetEnabled(enable);
+    infolog("Profiler %s", enable ? "enabled" : "disabled");
   } else if (pKey == GLFW_KEY_P) {
     lights[3]->position.y += 10;
     infolog("Moved light to y = %f", lights[3]->position.y);
@@ -1180,6 +1567,11 @@ void engineKeyPressed(int pKey) {
   } else if (pKey == GLFW_KEY_B) {
     bounds = !bounds;
     meshNodeSetRenderBounds(bounds);
+  } else if (pKey == GLFW_KEY_G) {
+    // toggle instanced rendering
+    instancing = !instancing;
+    meshNodeSetInstancing(instancing);
+    infolog("Instancing %s", instancing ? "enabled" : "disabled");
   } else if (pKey == GLFW_KEY_O) {
     iod -= 0.1f;
     if (iod < 1.0f) {
@@ -7,6 +7,10 @@
 #define LINKEDLIST_IMPLEMENTATION
 #define DYNARRAY_IMPLEMENTATION
 #define MATH3D_IMPLEMENTATION
+#define CULL_IMPLEMENTATION
+#define RQUEUE_IMPLEMENTATION
+#define BENCH_IMPLEMENTATION
+#define PROFILER_IMPLEMENTATION
 #define SHADER_IMPLEMENTATION
 #define TILEMAP_IMPLEMENTATION
 #define TEXTURE_IMPLEMENTATION
@@ -14,14 +18,198 @@
 #define SPRITE_IMPLEMENTATION
 #define MATERIAL_IMPLEMENTATION
 #define MESH_IMPLEMENTATION
+#define JOBS_IMPLEMENTATION
+#define HEIGHTFIELD_IMPLEMENTATION
+#define TERRAIN_IMPLEMENTATION
 #define JOYSTICK_IMPLEMENTATION
 
+#ifdef HEADLESS
+// Include our offscreen context
+#define HEADLESS_IMPLEMENTATION
+#include "headless.h"
+#else
 // Include our setup handler
 #include "setup.h"
+#endif
 
 // Include our engine
 #include "engine.h"
 
+#ifdef HEADLESS
+
+////////////////////////////////////////////////////////////////////////////////////////
+// headless version, renders a number of frames offscreen without any user interaction
+
+// we have no keyboard
+bool keypressed_callback(int pKey) {
+  return false;
+};
+
+int main(int argc, char ** argv) {
+  headlessContext context;
+  int             width = 1280, height = 720, frames = 100, i;
+  const char *    screenshot = NULL;
+  const char *    csvFile = NULL;
+  const char *    pathFile = NULL;
+  const char *    traceFile = NULL;
+  bool            thin = false;
+  bool            stereo = false;
+  bool            packed = false;
+  bool            compressed = false;
+  bool            shaderCache = true;
+  bool            cpuTerrain = false;
+  int             jobWorkers = -1;
+  char *          pathText = NULL;
+  benchmark *     bench = NULL;
+  double          start, milliseconds;
+
+  // Just mark that we've been loaded
+  errorlog(0, "GLFW Tutorial started headless");
+
+  // check our parameters
+  for (i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--size") == 0) && (i + 1 < argc) && (sscanf(argv[i + 1], "%ix%i", &width, &height) == 2)) {
+      i++;
+    } else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc)) {
+      frames = atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--screenshot") == 0) && (i + 1 < argc)) {
+      screenshot = argv[++i];
+    } else if ((strcmp(argv[i], "--benchmark") == 0) && (i + 1 < argc)) {
+      csvFile = argv[++i];
+    } else if ((strcmp(argv[i], "--path") == 0) && (i + 1 < argc)) {
+      pathFile = argv[++i];
+    } else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      traceFile = argv[++i];
+    } else if (strcmp(argv[i], "--thin-gbuffer") == 0) {
+      thin = true;
+    } else if (strcmp(argv[i], "--stereo") == 0) {
+      stereo = true;
+    } else if (strcmp(argv[i], "--packed-vertices") == 0) {
+      packed = true;
+    } else if (strcmp(argv[i], "--compressed-textures") == 0) {
+      compressed = true;
+    } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+      shaderCache = false;
+    } else if (strcmp(argv[i], "--cpu-terrain") == 0) {
+      cpuTerrain = true;
+    } else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc)) {
+      jobWorkers = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [--size <width>x<height>] [--frames <count>] [--screenshot <file.ppm>] [--benchmark <file.csv>] [--path <camera path>] [--trace <file.json>] [--thin-gbuffer] [--stereo] [--packed-vertices] [--compressed-textures] [--no-shader-cache] [--cpu-terrain] [--jobs <workers>]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    };
+  };
+
+  if ((width <= 0) || (height <= 0) || (frames <= 0)) {
+    errorlog(-1, "Invalid size %i x %i or number of frames %i", width, height, frames);
+    exit(EXIT_FAILURE);
+  } else if (pathFile != NULL) {
+    pathText = loadFile("", pathFile);
+    if (pathText == NULL) {
+      exit(EXIT_FAILURE);
+    };
+  };
+
+  if (!headlessInit(&context, width, height)) {
+    exit(EXIT_FAILURE);
+  };
+
+  // clear out our joystick info, we never update it
+  initJoystickInfo();
+
+  // load and initialize our engine
+  engineInit();
+  engineSetKeyPressedCallback(keypressed_callback);
+  engineSetFrameBuffer(context.frameBufferId);
+  engineSetThinGBuffer(thin);
+  engineSetStereo(stereo);
+  engineSetPackedVertices(packed);
+  engineSetCompressedTextures(compressed);
+  engineSetShaderCache(shaderCache);
+  engineSetCPUTerrain(cpuTerrain);
+  engineSetJobWorkers(jobWorkers);
+  engineLoad(false);
+
+  // we render a fixed number of frames so make sure all our textures are resident before we start
+  tmapStreamFlush();
+
+  // when benchmarking we follow a camera path (our default one if none is given) and hide our info overlay
+  if ((pathText != NULL) || (csvFile != NULL)) {
+    if (!engineSetCameraPath(pathText)) {
+      errorlog(-1, "Couldn't load our camera path");
+    };
+  };
+  if (csvFile != NULL) {
+    engineSetShowInfo(false);
+    bench = newBenchmark();
+  };
+
+  // when tracing we profile every frame we render
+  if (traceFile != NULL) {
+    profSetEnabled(true);
+    profStartCapture();
+  };
+
+  // and render our frames, we advance our time by a fixed step so each run renders the same frames
+  start = benchGetTime();
+  for (i = 0; i < frames; i++) {
+    benchFrameStart(bench);
+    profFrameStart();
+
+    engineUpdate(i / 60.0);
+
+    // make sure we're bound to our framebuffer
+    headlessBind(&context);
+    glViewport(0, 0, width, height);
+
+    engineRender(width, height, (float) width / (float) height, stereo ? 3 : 0);
+
+    profFrameEnd();
+    benchFrameEnd(bench);
+  };
+  glFinish();
+  milliseconds = benchGetTime() - start;
+
+  errorlog(0, "Rendered %i frames of %i x %i in %0.3f seconds, %0.3f ms per frame", frames, width, height, milliseconds / 1000.0, milliseconds / frames);
+
+  if (bench != NULL) {
+    benchFinish(bench);
+    benchWriteCSV(bench, csvFile);
+    benchLogSummary(bench);
+    benchFree(bench);
+  };
+
+  if (traceFile != NULL) {
+    char          lines[50][PROF_LINELEN];
+    unsigned int  count;
+
+    profFlush();
+    profWriteTrace(traceFile);
+
+    // and log the averages of our last frames
+    count = profGetOverlay(lines, 50);
+    for (i = 0; i < count; i++) {
+      errorlog(0, "%s", lines[i]);
+    };
+  };
+
+  if (screenshot != NULL) {
+    headlessSavePPM(&context, screenshot);
+  };
+
+  // lets be nice and cleanup
+  if (pathText != NULL) {
+    free(pathText);
+  };
+
+  engineUnload();
+  headlessTerminate(&context);
+
+  return 0;
+};
+
+#else
+
 // for now make our window global to make our key handling easier
 GLFWwindow* window;
 
@@ -69,11 +257,35 @@ bool keypressed_callback(int pKey) {
 ////////////////////////////////////////////////////////////////////////////////////////
 // and our main function
 
-int main(void) {
+int main(int argc, char ** argv) {
   glfw_setup    info;
+  bool          thin = false;
+  bool          packed = false;
+  bool          compressed = false;
+  bool          shaderCache = true;
+  bool          cpuTerrain = false;
+  int           jobWorkers = -1;
+  int           i;
     
   // Just mark that we've been loaded
   errorlog(0, "GLFW Tutorial started");
+
+  // check our parameters
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--thin-gbuffer") == 0) {
+      thin = true;
+    } else if (strcmp(argv[i], "--packed-vertices") == 0) {
+      packed = true;
+    } else if (strcmp(argv[i], "--compressed-textures") == 0) {
+      compressed = true;
+    } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+      shaderCache = false;
+    } else if (strcmp(argv[i], "--cpu-terrain") == 0) {
+      cpuTerrain = true;
+    } else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc)) {
+      jobWorkers = atoi(argv[++i]);
+    };
+  };
   
   // tell GLFW how to inform us of issues
   glfwSetErrorCallback(error_callback_glfw);
@@ -145,6 +357,13 @@ int main(void) {
     // load and initialize our engine
     engineInit();
     engineSetKeyPressedCallback(keypressed_callback);
+    engineSetThinGBuffer(thin);
+    engineSetStereo(info.stereomode == 1); // our split screen renders both eyes in a single pass
+    engineSetPackedVertices(packed);
+    engineSetCompressedTextures(compressed);
+    engineSetShaderCache(shaderCache);
+    engineSetCPUTerrain(cpuTerrain);
+    engineSetJobWorkers(jobWorkers);
     engineLoad(info.hmd != 0);
 
     // and start our render loop
@@ -152,6 +371,9 @@ int main(void) {
       int windowWidth, windowHeight, frameWidth, frameHeight;
       float ratio;
 
+      // start profiling our frame, this does nothing unless our profiler is enabled
+      profFrameStart();
+
       // check our joysticks
       updateJoystickInfoGLFW();
       
@@ -174,23 +396,13 @@ int main(void) {
 
       switch (info.stereomode) {
         case 1: {
-          // split screen left/right
+          // split screen left/right, we render both eyes side by side in a single pass
 
-
-          // render split screen 3D
-          int halfWidth = frameWidth / 2;
-
-          // set our viewport
-          glViewport(0, 0, halfWidth, frameHeight);
-      
-          // and render left
-          engineRender(halfWidth, frameHeight, ratio, 1);          
-          
           // set our viewport
-          glViewport(halfWidth, 0, halfWidth, frameHeight);
+          glViewport(0, 0, frameWidth, frameHeight);
       
-          // and render right
-          engineRender(halfWidth, frameHeight, ratio, 2);
+          // and render both eyes
+          engineRender(frameWidth, frameHeight, ratio, 3);
 
           // for now we ignore our UI in stereo mode
         }; break;
@@ -220,6 +432,9 @@ int main(void) {
         }; break;
       };
       
+      // we don't include waiting for our buffer swap in our profile
+      profFrameEnd();
+
       // swap our buffers around so the user sees our new frame
       glfwSwapBuffers(window);
       glfwPollEvents();
@@ -238,6 +453,8 @@ int main(void) {
   glfwTerminate();
 };
 
+#endif /* !HEADLESS */
+
 
 
 